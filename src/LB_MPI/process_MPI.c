@@ -25,13 +25,14 @@
 
 #include "LB_MPI/process_MPI.h"
 
-#include "LB_MPI/DPD.h"
 #include "LB_MPI/MPI_calls_coded.h"
 #include "LB_core/DLB_kernel.h"
+#include "LB_core/spd.h"
 #include "apis/DLB_interface.h"
 #include "support/tracing.h"
 #include "support/options.h"
 #include "support/debug.h"
+#include "support/dpd.h"
 #include "support/types.h"
 
 #include <mpi.h>
@@ -51,11 +52,12 @@ static int init_from_mpi = 0;
 static int mpi_ready = 0;
 static int is_iter = 0;
 static int periodo = 0;
+static dpd_t dpd;
 static mpi_set_t lewi_mpi_calls = MPISET_ALL;
 static MPI_Comm mpi_comm_node; /* MPI Communicator specific to the node */
 
 void before_init(void) {
-    DPDWindowSize(300);
+    dpd_init(&dpd, 300);
 }
 
 void after_init(void) {
@@ -153,26 +155,32 @@ void after_init(void) {
 
     // Obtain MPI options
     const options_t *options = get_global_options();
-    // Policies that used dpd have been temporarily disabled
-    //use_dpd = (policy == POLICY_RAL || policy == POLICY_WEIGHT || policy == POLICY_JUST_PROF);
-    use_dpd = 0;
     lewi_mpi_calls = options->lewi_mpi_calls;
 
+    // Detect iterations only if the policy makes use of them
+    const subprocess_descriptor_t *spd = get_global_spd();
+    use_dpd = spd && spd->lb_descriptor
+        && spd->lb_descriptor->flags & DLB_POLICY_USES_ITERATIONS;
+
     mpi_ready = 1;
 }
 
 void before_mpi(mpi_call call_type, intptr_t buf, intptr_t dest) {
-    int valor_dpd;
+    long valor_dpd;
     if(mpi_ready) {
         IntoCommunication();
 
         if(use_dpd) {
             long value = (long)((((buf>>5)^dest)<<5)|call_type);
+            int previous_periodo = periodo;
 
-            valor_dpd=DPD(value,&periodo);
+            valor_dpd=dpd_sample(&dpd,value,&periodo);
             //Only update if already treated previous iteration
-            if(is_iter==0)  { is_iter=valor_dpd; }
+            if(is_iter==0)  { is_iter=(valor_dpd!=0); }
 
+            if (periodo != previous_periodo) {
+                add_event(ITERATION_PERIOD_EVENT, periodo);
+            }
         }
 
         if ((lewi_mpi_calls == MPISET_ALL && is_blocking(call_type)) ||
@@ -20,58 +20,381 @@
 #include "LB_comm/comm_lend_light.h"
 
 #include "LB_comm/shmem.h"
+#include "support/mask_utils.h"
 #include "support/tracing.h"
 #include "support/debug.h"
 
 #include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <limits.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
 
 #define MIN(X, Y)  ((X) < (Y) ? (X) : (Y))
+#define MAX(X, Y)  ((X) > (Y) ? (X) : (Y))
+
+enum { MAX_SHARDS = 8 };
+
+/* Idle CPUs are split into shards, one per NUMA domain and each one in its own
+ * cache line. Processes lend to the shard of their domain and borrow from it
+ * first. CPUs reclaimed by their owner while borrowed by other processes are
+ * accounted as debt, which borrowers repay before borrowing again.
+ * Every process also keeps a ledger entry with the CPUs it has lent and
+ * borrowed. When the owner cannot take back its CPUs from the idle ones, the
+ * debt is assigned to the specific borrowers as owed CPUs, so that they are the
+ * ones returning them. Only the debt that cannot be assigned is shared.
+ * All counters are only modified with CAS loops, so that at any time:
+ *   sum(CPUs in use) + idle CPUs - debt - sum(owed) == sum(default CPUs) */
+struct shard {
+    volatile int idleCpus;
+} __attribute__((aligned(64)));
+
+/* Borrowed and owed CPUs are packed in the same word, owed <= borrowed */
+struct ledger_entry {
+    volatile pid_t pid;
+    volatile int lent;                  // only modified by the owner
+    volatile uint64_t account;          // borrowed CPUs (high), owed CPUs (low)
+} __attribute__((aligned(64)));
 
-int defaultCPUS;
-int greedy;
 //pointers to the shared memory structures
 struct shdata {
-    int   idleCpus;
     int   attached_nprocs;
+    int   async_nprocs;                 // processes waiting for idleCpus changes
+    volatile unsigned int idle_epoch;   // futex word, incremented on idleCpus changes
+    volatile int debt;                  // CPUs reclaimed but still in use by borrowers
+    struct shard shards[MAX_SHARDS];
+    struct ledger_entry ledger[];
 };
 
-struct shdata *shdata;
-static shmem_handler_t *shm_handler = NULL;;
+/* Private state of each subprocess attached to the shared memory */
+struct LendLightHandle {
+    struct ledger_entry private_entry;  // used if no ledger entry is available
+    shmem_handler_t *shm_handler;
+    struct shdata *shdata;
+    struct ledger_entry *my_entry;
+    int default_cpus;
+    int greedy;
+    int my_shard;
+    int max_entries;
+    unsigned int wake_bit;              // futex bitset of the waiters of this process
+    struct LendLightHandle *next;
+};
+
+/* Open handles of this process, needed for the cleanup on fatal errors */
+static lend_light_t *handles = NULL;
+static pthread_mutex_t handles_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static inline uint64_t pack_account(int borrowed, int owed) {
+    return (uint64_t)borrowed << 32 | (uint32_t)owed;
+}
+
+static inline int get_borrowed(uint64_t account) {
+    return (int)(account >> 32);
+}
 
-void ConfigShMem(int defCPUS, int is_greedy, const char *shmem_key) {
+static inline int get_owed(uint64_t account) {
+    return (int)(uint32_t)account;
+}
+
+lend_light_t* ConfigShMem(int defCPUS, int is_greedy, const cpu_set_t *process_mask,
+        const char *shmem_key) {
     verbose(VB_SHMEM, "LoadCommonConfig");
-    defaultCPUS=defCPUS;
-    greedy=is_greedy;
+    lend_light_t *handle;
+    if (posix_memalign((void**)&handle, 64, sizeof(lend_light_t)) != 0) {
+        fatal("Could not allocate the LeWI shared memory handle");
+    }
+    handle->default_cpus=defCPUS;
+    handle->greedy=is_greedy;
 
-    shm_handler = shmem_init((void**)&shdata, sizeof(struct shdata), "lewi", shmem_key,
-            SHMEM_VERSION_IGNORE);
+    // The shard of the process is the domain of its first CPU
+    handle->my_shard = 0;
+    int cpuid;
+    for (cpuid = 0; cpuid < CPU_SETSIZE; ++cpuid) {
+        if (CPU_ISSET(cpuid, process_mask)) {
+            int parent_id = mu_get_parent_id(cpuid);
+            handle->my_shard = parent_id >= 0 ? parent_id % MAX_SHARDS : 0;
+            break;
+        }
+    }
+
+    handle->max_entries = mu_get_system_size();
+    handle->shm_handler = shmem_init((void**)&handle->shdata,
+            sizeof(struct shdata) + sizeof(struct ledger_entry)*handle->max_entries,
+            "lewi", shmem_key, SHMEM_VERSION_IGNORE);
 
-    if (__sync_fetch_and_add(&shdata->attached_nprocs, 1) == 0) {
+    if (__sync_fetch_and_add(&handle->shdata->attached_nprocs, 1) == 0) {
         // Initialize shared memory if this is the 1st process attached
         verbose(VB_SHMEM, "setting values to the shared mem");
 
         /* idleCPUS */
-        shdata->idleCpus = 0;
+        int i;
+        for (i = 0; i < MAX_SHARDS; ++i) {
+            handle->shdata->shards[i].idleCpus = 0;
+        }
+        handle->shdata->debt = 0;
         add_event(IDLE_CPUS_EVENT, 0);
+        handle->shdata->async_nprocs = 0;
 
         verbose(VB_SHMEM, "Finished setting values to the shared mem");
     }
+
+    // Register the ledger entry, the shared memory is zero-initialized
+    pid_t pid = getpid();
+    handle->my_entry = NULL;
+    int i;
+    for (i = 0; i < handle->max_entries; ++i) {
+        if (__sync_bool_compare_and_swap(&handle->shdata->ledger[i].pid, 0, pid)) {
+            handle->my_entry = &handle->shdata->ledger[i];
+            break;
+        }
+    }
+    if (handle->my_entry == NULL) {
+        // Borrowers will not be able to find this process, but it still works
+        warning("Could not register a LeWI ledger entry, all %d entries are in use",
+                handle->max_entries);
+        handle->my_entry = &handle->private_entry;
+        handle->my_entry->pid = pid;
+    }
+    handle->my_entry->lent = 0;
+    handle->my_entry->account = pack_account(0, 0);
+    unsigned int waiter_id = handle->my_entry == &handle->private_entry
+        ? (unsigned int)pid : (unsigned int)(handle->my_entry - handle->shdata->ledger);
+    handle->wake_bit = 1U << waiter_id % 32;
+
+    pthread_mutex_lock(&handles_mutex);
+    handle->next = handles;
+    handles = handle;
+    pthread_mutex_unlock(&handles_mutex);
+
+    return handle;
+}
+
+/* The epoch lives in a shared memory, futexes must not be private */
+static void notify_idle_change(lend_light_t *handle) {
+    if (handle->shdata->async_nprocs > 0) {
+        __sync_fetch_and_add(&handle->shdata->idle_epoch, 1);
+        syscall(SYS_futex, &handle->shdata->idle_epoch, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+    }
+}
+
+/* Put ncpus in the shard of the process */
+static void put_idle_cpus(lend_light_t *handle, int ncpus) {
+    if (ncpus > 0) {
+        __sync_fetch_and_add(&handle->shdata->shards[handle->my_shard].idleCpus, ncpus);
+    }
+}
+
+/* Take up to ncpus idle CPUs, starting from the shard of the process */
+static int take_idle_cpus(lend_light_t *handle, int ncpus) {
+    int taken = 0;
+    int i;
+    for (i = 0; i < MAX_SHARDS && taken < ncpus; ++i) {
+        struct shard *shard = &handle->shdata->shards[(handle->my_shard + i) % MAX_SHARDS];
+        int idle = shard->idleCpus;
+        while (idle > 0) {
+            int take = MIN(idle, ncpus - taken);
+            int prev = __sync_val_compare_and_swap(&shard->idleCpus, idle, idle - take);
+            if (prev == idle) {
+                taken += take;
+                break;
+            }
+            idle = prev;
+        }
+    }
+    return taken;
+}
+
+/* Decrease the debt by up to ncpus, return the number of CPUs paid */
+static int pay_debt(lend_light_t *handle, int ncpus) {
+    int debt = handle->shdata->debt;
+    while (debt > 0 && ncpus > 0) {
+        int pay = MIN(debt, ncpus);
+        int prev = __sync_val_compare_and_swap(&handle->shdata->debt, debt, debt - pay);
+        if (prev == debt) {
+            return pay;
+        }
+        debt = prev;
+    }
+    return 0;
+}
+
+/* Add ncpus to the borrowed CPUs of the process */
+static void add_borrowed(lend_light_t *handle, int ncpus) {
+    if (ncpus <= 0) return;
+    uint64_t account = handle->my_entry->account;
+    while (1) {
+        uint64_t new_account = pack_account(get_borrowed(account) + ncpus,
+                get_owed(account));
+        uint64_t prev = __sync_val_compare_and_swap(&handle->my_entry->account, account, new_account);
+        if (prev == account) break;
+        account = prev;
+    }
+}
+
+/* Return up to ncpus borrowed CPUs, the owed ones first. Return the number of
+ * owed CPUs paid and the number of borrowed CPUs returned in *returned */
+static int return_borrowed(lend_light_t *handle, int ncpus, int *returned) {
+    uint64_t account = handle->my_entry->account;
+    while (1) {
+        int borrowed = get_borrowed(account);
+        int owed = get_owed(account);
+        int ret = MIN(borrowed, ncpus);
+        int paid = MIN(owed, ret);
+        uint64_t new_account = pack_account(borrowed - ret, owed - paid);
+        uint64_t prev = __sync_val_compare_and_swap(&handle->my_entry->account, account, new_account);
+        if (prev == account) {
+            *returned = ret;
+            return paid;
+        }
+        account = prev;
+    }
+}
+
+/* The process no longer uses borrowed CPUs, any owed CPU becomes shared debt */
+static void drop_borrowed(lend_light_t *handle) {
+    uint64_t account = handle->my_entry->account;
+    while (get_borrowed(account) > 0) {
+        uint64_t prev = __sync_val_compare_and_swap(&handle->my_entry->account, account,
+                pack_account(0, 0));
+        if (prev == account) {
+            if (get_owed(account) > 0) {
+                __sync_fetch_and_add(&handle->shdata->debt, get_owed(account));
+            }
+            break;
+        }
+        account = prev;
+    }
+}
+
+/* Assign up to ncpus to the borrowers as owed CPUs, return the number of CPUs
+ * assigned */
+static int assign_owed(lend_light_t *handle, int ncpus) {
+    int assigned = 0;
+    int i;
+    for (i = 0; i < handle->max_entries && assigned < ncpus; ++i) {
+        struct ledger_entry *entry = &handle->shdata->ledger[i];
+        if (entry == handle->my_entry || entry->pid == 0) continue;
+        uint64_t account = entry->account;
+        while (1) {
+            int borrowed = get_borrowed(account);
+            int owed = get_owed(account);
+            int assign = MIN(borrowed - owed, ncpus - assigned);
+            if (assign <= 0) break;
+            uint64_t prev = __sync_val_compare_and_swap(&entry->account, account,
+                    pack_account(borrowed, owed + assign));
+            if (prev == account) {
+                assigned += assign;
+                break;
+            }
+            account = prev;
+        }
+    }
+    return assigned;
+}
+
+/* Released CPUs pay what the process owes, then the shared debt, and the rest
+ * become idle */
+static void return_cpus(lend_light_t *handle, int ncpus) {
+    int returned;
+    int paid = return_borrowed(handle, ncpus, &returned);
+    handle->my_entry->lent += ncpus - returned;
+    ncpus -= paid;
+    put_idle_cpus(handle, ncpus - pay_debt(handle, ncpus));
+}
+
+/* Reclaimed CPUs are taken from the idle ones, the rest are still in use by
+ * other processes and must be returned by their borrowers */
+static void reclaim_cpus(lend_light_t *handle, int ncpus) {
+    handle->my_entry->lent = MAX(handle->my_entry->lent - ncpus, 0);
+    int taken = take_idle_cpus(handle, ncpus);
+    if (taken < ncpus) {
+        int pending = ncpus - taken;
+        pending -= assign_owed(handle, pending);
+        if (pending > 0) {
+            __sync_fetch_and_add(&handle->shdata->debt, pending);
+        }
+    }
+}
+
+/* Lending and reclaiming may race so that there are idle CPUs and debt at the
+ * same time, cancel them out */
+static void settle_debt(lend_light_t *handle) {
+    int debt = handle->shdata->debt;
+    if (debt > 0) {
+        int taken = take_idle_cpus(handle, debt);
+        put_idle_cpus(handle, taken - pay_debt(handle, taken));
+    }
+}
+
+int getIdleCpus(lend_light_t *handle) {
+    int idle = 0;
+    int i;
+    for (i = 0; i < MAX_SHARDS; ++i) {
+        idle += handle->shdata->shards[i].idleCpus;
+    }
+    return idle;
 }
 
-void finalize_comm() {
-    if (shm_handler) {
-        bool shmem_empty = __sync_fetch_and_sub(&shdata->attached_nprocs, 1) == 1;
-        shmem_finalize(shm_handler, shmem_empty ? SHMEM_DELETE : SHMEM_NODELETE);
+int getDebtCpus(lend_light_t *handle) {
+    int debt = handle->shdata->debt;
+    int i;
+    for (i = 0; i < handle->max_entries; ++i) {
+        if (handle->shdata->ledger[i].pid != 0) {
+            debt += get_owed(handle->shdata->ledger[i].account);
+        }
     }
+    return debt;
 }
 
-int releaseCpus(int cpus) {
+void getLedgerEntry(lend_light_t *handle, int *lent, int *borrowed, int *owed) {
+    uint64_t account = handle->my_entry->account;
+    *lent = handle->my_entry->lent;
+    *borrowed = get_borrowed(account);
+    *owed = get_owed(account);
+}
+
+void finalize_comm(lend_light_t *handle) {
+    if (handle == NULL) return;
+
+    pthread_mutex_lock(&handles_mutex);
+    lend_light_t **prev = &handles;
+    while (*prev != NULL && *prev != handle) {
+        prev = &(*prev)->next;
+    }
+    if (*prev == handle) *prev = handle->next;
+    pthread_mutex_unlock(&handles_mutex);
+
+    if (handle->my_entry != &handle->private_entry) {
+        drop_borrowed(handle);
+        handle->my_entry->pid = 0;
+    }
+    bool shmem_empty = __sync_fetch_and_sub(&handle->shdata->attached_nprocs, 1) == 1;
+    shmem_finalize(handle->shm_handler, shmem_empty ? SHMEM_DELETE : SHMEM_NODELETE);
+    free(handle);
+}
+
+/* Best effort, finalize every handle of the process */
+void finalize_comm_all(void) {
+    while (handles != NULL) {
+        finalize_comm(handles);
+    }
+}
+
+int releaseCpus(lend_light_t *handle, int cpus) {
     verbose(VB_SHMEM, "Releasing CPUS...");
 
-    __sync_fetch_and_add (&(shdata->idleCpus), cpus);
-    add_event(IDLE_CPUS_EVENT, shdata->idleCpus);
+    if (cpus >= 0) {
+        return_cpus(handle, cpus);
+    } else {
+        reclaim_cpus(handle, -cpus);
+    }
+    add_event(IDLE_CPUS_EVENT, getIdleCpus(handle) - handle->shdata->debt);
+    notify_idle_change(handle);
 
-    verbose(VB_SHMEM, "DONE Releasing CPUS (idle %d)", shdata->idleCpus);
+    verbose(VB_SHMEM, "DONE Releasing CPUS (idle %d, debt %d)",
+            getIdleCpus(handle), handle->shdata->debt);
 
     return 0;
 }
@@ -80,18 +403,28 @@ int releaseCpus(int cpus) {
 Returns de number of cpus
 that are assigned
 */
-int acquireCpus(int current_cpus) {
+int acquireCpus(lend_light_t *handle, int current_cpus) {
     verbose(VB_SHMEM, "Acquiring CPUS...");
-    int cpus = defaultCPUS-current_cpus;
+    int cpus = handle->default_cpus-current_cpus;
 
-//I don't care if there aren't enough cpus
+    if (cpus < 0) {
+        /* Borrowed CPUs are returned */
+        releaseCpus(handle, -cpus);
+    } else if (cpus > 0) {
+        reclaim_cpus(handle, cpus);
+    }
 
-    if((__sync_sub_and_fetch (&(shdata->idleCpus), cpus)>0) && greedy) {
-        cpus+=__sync_val_compare_and_swap(&(shdata->idleCpus), shdata->idleCpus, 0);
+    if (handle->greedy && handle->shdata->debt == 0) {
+        int taken = take_idle_cpus(handle, INT_MAX);
+        add_borrowed(handle, taken);
+        cpus += taken;
     }
-    add_event(IDLE_CPUS_EVENT, shdata->idleCpus);
+    add_event(IDLE_CPUS_EVENT, getIdleCpus(handle) - handle->shdata->debt);
+    /* Borrowers may need to return CPUs */
+    if (cpus > 0) notify_idle_change(handle);
 
-    verbose(VB_SHMEM, "Using %d CPUS... %d Idle", cpus, shdata->idleCpus);
+    verbose(VB_SHMEM, "Using %d CPUS... %d Idle, %d debt",
+            cpus+current_cpus, getIdleCpus(handle), handle->shdata->debt);
 
     return cpus+current_cpus;
 }
@@ -100,30 +433,69 @@ int acquireCpus(int current_cpus) {
 Returns de number of cpus
 that are assigned
 */
-int checkIdleCpus(int myCpus, int maxResources) {
-    verbose(VB_SHMEM, "Checking idle CPUS... %d", shdata->idleCpus);
-    int cpus;
-    int aux;
-//WARNING//
-    //if more CPUS than the availables are used release some
-    if ((shdata->idleCpus < 0) && (myCpus>defaultCPUS) ) {
-        aux=shdata->idleCpus;
-        cpus=MIN(abs(aux), myCpus-defaultCPUS);
-        if(__sync_bool_compare_and_swap(&(shdata->idleCpus), aux, aux+cpus)) {
-            myCpus-=cpus;
-        }
+int checkIdleCpus(lend_light_t *handle, int myCpus, int maxResources) {
+    verbose(VB_SHMEM, "Checking idle CPUS... %d", getIdleCpus(handle));
 
-        //if there are idle CPUS use them
-    } else if( shdata->idleCpus > 0) {
-        aux=shdata->idleCpus;
-        if(aux>maxResources) { aux=maxResources; }
+    settle_debt(handle);
 
-        if(__sync_bool_compare_and_swap(&(shdata->idleCpus), shdata->idleCpus, shdata->idleCpus-aux)) {
-            myCpus+=aux;
+    int owed = get_owed(handle->my_entry->account);
+    if (myCpus <= handle->default_cpus) {
+        // Nothing borrowed, owed CPUs may have been assigned too late
+        drop_borrowed(handle);
+        owed = 0;
+    }
+
+    if ((owed > 0 || handle->shdata->debt > 0) && myCpus > handle->default_cpus) {
+        //if more CPUS than the availables are used release some
+        int cpus = MIN(myCpus-handle->default_cpus, owed + handle->shdata->debt);
+        if (cpus > 0) {
+            return_cpus(handle, cpus);
+            myCpus -= cpus;
+            notify_idle_change(handle);
         }
+    } else if (maxResources > 0) {
+        //if there are idle CPUS use them
+        int taken = take_idle_cpus(handle, maxResources);
+        int over = MAX(myCpus + taken - handle->default_cpus, 0) - MAX(myCpus - handle->default_cpus, 0);
+        add_borrowed(handle, over);
+        handle->my_entry->lent = MAX(handle->my_entry->lent - (taken - over), 0);
+        myCpus += taken;
     }
-    add_event(IDLE_CPUS_EVENT, shdata->idleCpus);
+    add_event(IDLE_CPUS_EVENT, getIdleCpus(handle) - handle->shdata->debt);
 
-    verbose(VB_SHMEM, "Using %d CPUS... %d Idle", myCpus, shdata->idleCpus);
+    verbose(VB_SHMEM, "Using %d CPUS... %d Idle, %d debt",
+            myCpus, getIdleCpus(handle), handle->shdata->debt);
     return myCpus;
 }
+
+/*
+Asynchronous mode: processes registered as waiters
+are woken up whenever idleCpus changes
+*/
+void registerIdleCpusWaiter(lend_light_t *handle) {
+    __sync_fetch_and_add(&handle->shdata->async_nprocs, 1);
+}
+
+/* Wake up the waiter of this process. The epoch is changed so that the wake up
+ * cannot be lost, but only the waiters with the bit of this process are woken.
+ * The other waiters see the new epoch the next time they are woken up, which
+ * only costs them an extra borrow attempt */
+void unregisterIdleCpusWaiter(lend_light_t *handle) {
+    __sync_fetch_and_sub(&handle->shdata->async_nprocs, 1);
+    __sync_fetch_and_add(&handle->shdata->idle_epoch, 1);
+    syscall(SYS_futex, &handle->shdata->idle_epoch, FUTEX_WAKE_BITSET, INT_MAX, NULL, NULL,
+            handle->wake_bit);
+}
+
+unsigned int getIdleCpusEpoch(lend_light_t *handle) {
+    return handle->shdata->idle_epoch;
+}
+
+/* Block while the epoch does not change, return the new epoch */
+unsigned int waitIdleCpusChange(lend_light_t *handle, unsigned int epoch) {
+    while (handle->shdata->idle_epoch == epoch) {
+        syscall(SYS_futex, &handle->shdata->idle_epoch, FUTEX_WAIT_BITSET, epoch, NULL, NULL,
+                handle->wake_bit);
+    }
+    return handle->shdata->idle_epoch;
+}
@@ -20,15 +20,37 @@
 #ifndef COMM_LEND_LIGHT_H
 #define COMM_LEND_LIGHT_H
 
-void ConfigShMem(int defCPUS, int is_greedy, const char *shmem_key);
+#include <sched.h>
 
-int releaseCpus(int cpus);
+/* Each subprocess attaches through its own handle */
+typedef struct LendLightHandle lend_light_t;
 
-int acquireCpus(int current_cpus);
+lend_light_t* ConfigShMem(int defCPUS, int is_greedy, const cpu_set_t *process_mask,
+        const char *shmem_key);
 
-int checkIdleCpus(int myCpus, int maxResources);
+int releaseCpus(lend_light_t *handle, int cpus);
 
-void finalize_comm();
+int acquireCpus(lend_light_t *handle, int current_cpus);
+
+int checkIdleCpus(lend_light_t *handle, int myCpus, int maxResources);
+
+int getIdleCpus(lend_light_t *handle);
+
+int getDebtCpus(lend_light_t *handle);
+
+void getLedgerEntry(lend_light_t *handle, int *lent, int *borrowed, int *owed);
+
+void finalize_comm(lend_light_t *handle);
+
+void finalize_comm_all(void);
+
+void registerIdleCpusWaiter(lend_light_t *handle);
+
+void unregisterIdleCpusWaiter(lend_light_t *handle);
+
+unsigned int getIdleCpusEpoch(lend_light_t *handle);
+
+unsigned int waitIdleCpusChange(lend_light_t *handle, unsigned int epoch);
 
 #endif //COMM_LEND_LIGHT
 
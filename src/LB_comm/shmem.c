@@ -69,10 +69,13 @@ static bool shmem_consistency_add_pid(pid_t *pidlist, pid_t pid) {
 
 static bool shmem_consistency_remove_pid(pid_t *pidlist, pid_t pid) {
     bool last_one = true;
+    bool removed = false;
     int i;
     for(i=0; i<mu_get_system_size(); ++i) {
-        if (pidlist[i] == pid) {
+        /* A process may be attached more than once, one per subprocess */
+        if (!removed && pidlist[i] == pid) {
             pidlist[i] = 0;
+            removed = true;
         } else if (pidlist[i] != 0) {
             last_one = false;
         }
@@ -100,9 +103,10 @@ shmem_handler_t* shmem_init(void **shdata, size_t shdata_size, const char *shmem
     /* Calculate total shmem size:
      *   shmem = shsync + shdata
      *   shsync and shdata are both variable in size
+     *   shdata starts at a cache line boundary
      */
     size_t shsync_size = sizeof(shmem_sync_t) + sizeof(pid_t) * mu_get_system_size();
-    shsync_size = (shsync_size + 7) & ~7; // round up to 8 bytes
+    shsync_size = (shsync_size + 63) & ~63; // round up to a cache line
     handler->shm_size = shsync_size + shdata_size;
 
     /* Get /dev/shm/ file names to create */
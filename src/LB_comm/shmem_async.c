@@ -22,6 +22,8 @@
 #include "LB_comm/shmem.h"
 #include "LB_comm/shmem_cpuinfo.h"
 #include "LB_comm/shmem_procinfo.h"
+#include "LB_core/DLB_kernel.h"
+#include "LB_core/spd.h"
 #include "LB_numThreads/numThreads.h"
 #include "apis/dlb_errors.h"
 #include "support/mask_utils.h"
@@ -31,10 +33,18 @@
 #include <unistd.h>
 #include <errno.h>
 #include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <dirent.h>
+#include <linux/futex.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
 
 enum { NOBODY = 0 };
-enum { QUEUE_SIZE = 100 };
+enum { QUEUE_SIZE = 8 };    /* must be a power of 2 */
+enum { DIRTY_BITS = sizeof(unsigned long) * 8 };
+enum { DIRTY_WORDS = CPU_SETSIZE / DIRTY_BITS };
 
 typedef enum HelperAction {
     ACTION_NONE = 0,
@@ -46,23 +56,41 @@ typedef enum HelperAction {
 
 typedef struct Message {
     action_t action;
-    int cpuid;
     cpu_set_t mask;
 } message_t;
 
+/* Each slot holds a sequence number to know whether the slot is ready to be
+ * written (seq == position) or read (seq == position + 1) */
+typedef struct Slot {
+    volatile unsigned int seq;
+    message_t message;
+} slot_t;
+
+/* CPU actions are not queued. Each CPU keeps only the latest requested action
+ * and a dirty bit, so that the helper applies the net change in one pass and
+ * bursts of requests cannot overflow the helper. The queue is only used for
+ * the other actions, which are also coalesced: at most one set mask petition
+ * and one join may be queued at the same time. */
 typedef struct {
-    /* Queue attributes */
-    message_t       queue[QUEUE_SIZE];
-    unsigned int    q_head;
-    unsigned int    q_tail;
-    pthread_mutex_t q_lock;
-    pthread_cond_t  q_wait_data;
+    /* Latest action requested for each CPU */
+    volatile unsigned char  cpu_action[CPU_SETSIZE];
+    volatile unsigned long  cpu_dirty[DIRTY_WORDS];
+    volatile int            mask_pending;
+
+    /* Lock-free multiple-producer single-consumer queue */
+    slot_t                  queue[QUEUE_SIZE];
+    volatile unsigned int   q_head;             // next position to write, shared by producers
+    volatile unsigned int   q_tail;             // next position to read, only the helper
+    volatile unsigned int   q_futex;            // futex word, incremented on each wake up
+    volatile int            q_sleeping;         // whether the helper may be sleeping
 
     /* Helper metadata */
     pid_t pid;
     pthread_t pth;
     cpu_set_t mask;
-    const pm_interface_t *pm;
+    cpu_set_t domain;       // CPUs whose requests are attended by this helper
+    bool primary;           // whether it attends the process-wide requests
+    const subprocess_descriptor_t *spd;
 } helper_t;
 
 
@@ -70,7 +98,7 @@ typedef struct {
     helper_t helpers[0];
 } shdata_t;
 
-enum { SHMEM_ASYNC_VERSION = 1 };
+enum { SHMEM_ASYNC_VERSION = 4 };
 
 static int max_helpers = 0;
 static shdata_t *shdata = NULL;
@@ -79,95 +107,398 @@ static shmem_handler_t *shm_handler = NULL;
 static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
 static int subprocesses_attached = 0;
 
+/* Return the primary helper of the process */
 static helper_t* get_helper(pid_t pid) {
     int h;
     for (h = 0; h < max_helpers; ++h) {
-        if (shdata->helpers[h].pid == pid) {
+        if (shdata->helpers[h].pid == pid && shdata->helpers[h].primary) {
             return &shdata->helpers[h];
         }
     }
     return NULL;
 }
 
-static void enqueue_message(helper_t *helper, const message_t *message) {
-    pthread_mutex_lock(&helper->q_lock);
+/* Return the helper of the process that attends the requests of cpuid */
+static helper_t* get_cpu_helper(pid_t pid, int cpuid) {
+    int h;
+    for (h = 0; h < max_helpers; ++h) {
+        helper_t *helper = &shdata->helpers[h];
+        if (helper->pid == pid && CPU_ISSET(cpuid, &helper->domain)) {
+            return helper;
+        }
+    }
+    return NULL;
+}
+
+/* The queue lives in a shared memory, futexes must not be private */
+static void futex_wait(volatile unsigned int *addr, unsigned int value) {
+    syscall(SYS_futex, addr, FUTEX_WAIT, value, NULL, NULL, 0);
+}
+
+static void futex_wake(volatile unsigned int *addr) {
+    syscall(SYS_futex, addr, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+/* Wake up helper only if it is sleeping */
+static void wake_up_helper(helper_t *helper) {
+    __sync_synchronize();
+    if (helper->q_sleeping) {
+        __sync_fetch_and_add(&helper->q_futex, 1);
+        futex_wake(&helper->q_futex);
+    }
+}
+
+/* Returns DLB_ERR_REQST if the queue is full, which cannot happen as long as
+ * the queued actions are coalesced */
+static int enqueue_message(helper_t *helper, const message_t *message) {
+    /* Reserve a slot */
+    unsigned int pos = helper->q_head;
+    slot_t *slot;
+    while (true) {
+        slot = &helper->queue[pos & (QUEUE_SIZE-1)];
+        int diff = (int)(slot->seq - pos);
+        if (diff == 0) {
+            if (__sync_bool_compare_and_swap(&helper->q_head, pos, pos+1)) {
+                break;
+            }
+        } else if (__builtin_expect((diff < 0), 0)) {
+            warning("Max petitions requested for asynchronous thread");
+            return DLB_ERR_REQST;
+        }
+        pos = helper->q_head;
+    }
+
+    /* Write message and publish slot */
+    verbose(VB_ASYNC, "Writing message %u", pos);
+    slot->message = *message;
+    __sync_synchronize();
+    slot->seq = pos + 1;
+
+    wake_up_helper(helper);
+    return DLB_SUCCESS;
+}
+
+static void set_cpu_action(helper_t *helper, int cpuid, action_t action) {
+    /* The action must be visible before the dirty bit */
+    helper->cpu_action[cpuid] = action;
+    unsigned long bit = 1UL << (cpuid % DIRTY_BITS);
+    unsigned long old = __sync_fetch_and_or(&helper->cpu_dirty[cpuid / DIRTY_BITS], bit);
+
+    /* If the CPU was already dirty, the helper will read the new action */
+    if (!(old & bit)) {
+        wake_up_helper(helper);
+    }
+}
+
+static void set_cpu_mask_action(helper_t *helper, const cpu_set_t *mask, action_t action) {
+    bool wake_up = false;
+    int w;
+    for (w = 0; w < DIRTY_WORDS; ++w) {
+        unsigned long bits = 0;
+        int b;
+        for (b = 0; b < DIRTY_BITS; ++b) {
+            int cpuid = w * DIRTY_BITS + b;
+            if (CPU_ISSET(cpuid, mask)) {
+                helper->cpu_action[cpuid] = action;
+                bits |= 1UL << b;
+            }
+        }
+        if (bits) {
+            unsigned long old = __sync_fetch_and_or(&helper->cpu_dirty[w], bits);
+            wake_up = wake_up || (old & bits) != bits;
+        }
+    }
+    if (wake_up) {
+        wake_up_helper(helper);
+    }
+}
+
+static bool try_dequeue_message(helper_t *helper, message_t *message) {
+    unsigned int pos = helper->q_tail;
+    slot_t *slot = &helper->queue[pos & (QUEUE_SIZE-1)];
+    if (slot->seq != pos + 1) {
+        /* Empty, or a producer has not published the slot yet */
+        return false;
+    }
+    __sync_synchronize();
+    *message = slot->message;
+    verbose(VB_ASYNC, "Reading message %u", pos);
+
+    /* Release the slot for the next lap */
+    __sync_synchronize();
+    slot->seq = pos + QUEUE_SIZE;
+    helper->q_tail = pos + 1;
+    return true;
+}
+
+static bool has_pending_work(const helper_t *helper) {
+    unsigned int pos = helper->q_tail;
+    if (helper->queue[pos & (QUEUE_SIZE-1)].seq == pos + 1) {
+        return true;
+    }
+    int w;
+    for (w = 0; w < DIRTY_WORDS; ++w) {
+        if (helper->cpu_dirty[w]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void wait_for_work(helper_t *helper) {
+    while (!has_pending_work(helper)) {
+        /* Announce that the helper is going to sleep and check again to
+         * avoid missing a request published in the meantime */
+        unsigned int futex_value = helper->q_futex;
+        helper->q_sleeping = 1;
+        __sync_synchronize();
+        if (has_pending_work(helper)) {
+            helper->q_sleeping = 0;
+            break;
+        }
+        futex_wait(&helper->q_futex, futex_value);
+        helper->q_sleeping = 0;
+    }
+}
 
-    /* Get next_head index and check that buffer is not full */
-    unsigned int next_head = (helper->q_head + 1) % QUEUE_SIZE;
-    if (__builtin_expect((next_head == helper->q_tail), 0)) {
-        pthread_mutex_unlock(&helper->q_lock);
-        fatal("Max petitions requested for asynchronous thread");
+/* Apply the latest action of every dirty CPU, with one runtime call for
+ * all the CPUs to disable and another one for all the CPUs to enable */
+static void apply_cpu_actions(helper_t *helper, const pm_interface_t *pm) {
+    cpu_set_t enable_mask, disable_mask;
+    CPU_ZERO(&enable_mask);
+    CPU_ZERO(&disable_mask);
+    int w;
+    for (w = 0; w < DIRTY_WORDS; ++w) {
+        if (helper->cpu_dirty[w] == 0) continue;
+
+        /* Clear the dirty bits before reading the actions, a concurrent
+         * request will set them again */
+        unsigned long dirty = __sync_fetch_and_and(&helper->cpu_dirty[w], 0);
+        while (dirty) {
+            int cpuid = w * DIRTY_BITS + __builtin_ctzl(dirty);
+            dirty &= dirty - 1;
+            switch(helper->cpu_action[cpuid]) {
+                case ACTION_ENABLE_CPU:
+                    CPU_SET(cpuid, &enable_mask);
+                    break;
+                case ACTION_DISABLE_CPU:
+                    CPU_SET(cpuid, &disable_mask);
+                    break;
+                default:
+                    break;
+            }
+        }
     }
 
-    /* Enqueue message and update head */
-    verbose(VB_ASYNC, "Writing message %d, head is now %d", helper->q_head, next_head);
-    helper->queue[helper->q_head] = *message;
-    helper->q_head = next_head;
+    if (CPU_COUNT(&disable_mask) > 0) {
+        verbose(VB_ASYNC, "Helper thread disabling CPUs %s", mu_to_str(&disable_mask));
+        disable_cpu_set(pm, &disable_mask);
+    }
+    if (CPU_COUNT(&enable_mask) > 0) {
+        verbose(VB_ASYNC, "Helper thread enabling CPUs %s", mu_to_str(&enable_mask));
+        enable_cpu_set(pm, &enable_mask);
+    }
+}
 
-    /* Signal helper */
-    pthread_cond_signal(&helper->q_wait_data);
+/* Number of threads of this process, other than the helper, that last ran on each CPU */
+static void get_threads_per_cpu(int *nthreads) {
+    memset(nthreads, 0, sizeof(int)*CPU_SETSIZE);
+    DIR *dir = opendir("/proc/self/task");
+    if (dir == NULL) return;
+
+    pid_t self = syscall(SYS_gettid);
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        pid_t tid = strtol(entry->d_name, NULL, 10);
+        if (tid <= 0 || tid == self) continue;
+
+        char path[64];
+        snprintf(path, sizeof(path), "/proc/self/task/%d/stat", tid);
+        FILE *fd = fopen(path, "r");
+        if (fd == NULL) continue;
+        char line[1024];
+        if (fgets(line, sizeof(line), fd)) {
+            /* The comm field may contain spaces, fields are counted from the
+             * last parenthesis: state is the 3rd field, processor the 39th */
+            char *field = strrchr(line, ')');
+            int i;
+            for (i = 2; field && i < 39; ++i) {
+                field = strchr(field + 1, ' ');
+            }
+            if (field) {
+                int cpuid = strtol(field + 1, NULL, 10);
+                if (cpuid >= 0 && cpuid < CPU_SETSIZE) {
+                    ++nthreads[cpuid];
+                }
+            }
+        }
+        fclose(fd);
+    }
+    closedir(dir);
+}
+
+/* Compute the CPUs where the helper should run according to the placement option,
+ * considering only the process CPUs in the helper domain. Placements that cannot
+ * be satisfied fall back to those process CPUs. */
+static void compute_helper_mask(const helper_t *helper, cpu_set_t *helper_mask) {
+    const subprocess_descriptor_t *spd = helper->spd;
+    const options_t *options = &spd->options;
+    cpu_set_t local_mask;
+    CPU_AND(&local_mask, &spd->process_mask, &helper->domain);
+    const cpu_set_t *process_mask = CPU_COUNT(&local_mask) > 0
+        ? &local_mask : &spd->process_mask;
+    CPU_ZERO(helper_mask);
+
+    switch(options->async_placement) {
+        case HELPER_PROCESS:
+            break;
+        case HELPER_SERVICE:
+            CPU_AND(helper_mask, &options->async_cpus, &helper->domain);
+            break;
+        case HELPER_SIBLING:
+            {
+                /* SMT siblings of the local CPUs not owned by the process */
+                int cpuid;
+                for (cpuid = 0; cpuid < CPU_SETSIZE; ++cpuid) {
+                    if (CPU_ISSET(cpuid, process_mask)) {
+                        cpu_set_t siblings;
+                        mu_get_core_siblings(cpuid, &siblings);
+                        CPU_OR(helper_mask, helper_mask, &siblings);
+                    }
+                }
+                mu_substract(helper_mask, helper_mask, &spd->process_mask);
+            }
+            break;
+        case HELPER_LEAST_LOADED:
+            {
+                /* Owned CPU where fewer threads of this process last ran. On ties,
+                 * the highest one, since runtimes usually bind from the lowest CPU */
+                int nthreads[CPU_SETSIZE];
+                get_threads_per_cpu(nthreads);
+                int cpuid;
+                int least_loaded = -1;
+                for (cpuid = 0; cpuid < CPU_SETSIZE; ++cpuid) {
+                    if (CPU_ISSET(cpuid, process_mask)
+                            && (least_loaded == -1
+                                || nthreads[cpuid] <= nthreads[least_loaded])) {
+                        least_loaded = cpuid;
+                    }
+                }
+                if (least_loaded != -1) {
+                    CPU_SET(least_loaded, helper_mask);
+                }
+            }
+            break;
+    }
 
-    pthread_mutex_unlock(&helper->q_lock);
+    if (CPU_COUNT(helper_mask) == 0) {
+        if (options->async_placement != HELPER_PROCESS) {
+            verbose(VB_ASYNC, "Helper placement %s not available, using the process CPUs",
+                    helper_placement_tostr(options->async_placement));
+        }
+        memcpy(helper_mask, process_mask, sizeof(cpu_set_t));
+    }
 }
 
-static void dequeue_message(helper_t *helper, message_t *message) {
-    pthread_mutex_lock(&helper->q_lock);
+/* Pin the calling helper thread to its computed mask */
+static void pin_helper(helper_t *helper) {
+    int error = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &helper->mask);
+    if (error) {
+        warning("Helper thread could not be pinned to %s: %s",
+                mu_to_str(&helper->mask), strerror(error));
+    } else {
+        verbose(VB_ASYNC, "Helper thread pinned to %s", mu_to_str(&helper->mask));
+    }
+}
 
-    /* Block until there's some message in the queue */
-    while (helper->q_head == helper->q_tail) {
-        pthread_cond_wait(&helper->q_wait_data, &helper->q_lock);
+/* Set the scheduling policy and priority of the calling thread */
+static void set_helper_scheduling(const options_t *options) {
+    int policy;
+    switch(options->async_sched) {
+        case HELPER_SCHED_OTHER: policy = SCHED_OTHER; break;
+        case HELPER_SCHED_BATCH: policy = SCHED_BATCH; break;
+        case HELPER_SCHED_IDLE:  policy = SCHED_IDLE;  break;
+        case HELPER_SCHED_FIFO:  policy = SCHED_FIFO;  break;
+        case HELPER_SCHED_RR:    policy = SCHED_RR;    break;
+        case HELPER_SCHED_INHERIT:
+        default:
+            policy = -1;
     }
 
-    /* Dequeue message and update tail */
-    unsigned int next_tail = (helper->q_tail + 1) % QUEUE_SIZE;
-    verbose(VB_ASYNC, "Reading message %d, tail is now %d", helper->q_tail, next_tail);
-    *message = helper->queue[helper->q_tail];
-    helper->q_tail = next_tail;
+    if (policy != -1) {
+        struct sched_param param = { .sched_priority = 0 };
+        if (policy == SCHED_FIFO || policy == SCHED_RR) {
+            int min = sched_get_priority_min(policy);
+            int max = sched_get_priority_max(policy);
+            param.sched_priority = options->async_priority < min ? min
+                : options->async_priority > max ? max
+                : options->async_priority;
+        }
+        int error = pthread_setschedparam(pthread_self(), policy, &param);
+        if (error) {
+            warning("Helper thread could not set scheduling policy %s: %s",
+                    helper_sched_tostr(options->async_sched), strerror(error));
+        }
+    }
 
-    pthread_mutex_unlock(&helper->q_lock);
+    /* For non real-time policies, the priority is the nice value of the thread */
+    if (policy != SCHED_FIFO && policy != SCHED_RR && options->async_priority != 0) {
+        pid_t tid = syscall(SYS_gettid);
+        if (setpriority(PRIO_PROCESS, tid, options->async_priority) != 0) {
+            warning("Helper thread could not set nice value %d: %s",
+                    options->async_priority, strerror(errno));
+        }
+    }
 }
 
 static void* thread_start(void *arg) {
     helper_t *helper = arg;
-    const pm_interface_t* const pm = helper->pm;
-    pthread_setaffinity_np(helper->pth, sizeof(cpu_set_t), &helper->mask);
-    verbose(VB_ASYNC, "Helper thread started, pinned to %s", mu_to_str(&helper->mask));
+    const subprocess_descriptor_t* const spd = helper->spd;
+    const pm_interface_t* const pm = &spd->pm;
+    compute_helper_mask(helper, &helper->mask);
+    pin_helper(helper);
+    set_helper_scheduling(&spd->options);
+    verbose(VB_ASYNC, "Helper thread started");
 
     bool join = false;
-    while(!join || helper->q_head != helper->q_tail) {
-        message_t message;
-        dequeue_message(helper, &message);
-        verbose(VB_ASYNC, "Helper thread attending petition %d", message.action);
+    while(!join) {
+        wait_for_work(helper);
+        apply_cpu_actions(helper, pm);
 
-        int error = 0;
-        switch(message.action) {
-            case ACTION_NONE:
-                break;
-            case ACTION_ENABLE_CPU:
-                error = enable_cpu(pm, message.cpuid);
-                break;
-            case ACTION_DISABLE_CPU:
-                error = disable_cpu(pm, message.cpuid);
-                break;
-            case ACTION_SET_MASK:
-                break;
-            case ACTION_JOIN:
-                join = true;
-                break;
-        }
-        if (error) {
-            // error ?
+        message_t message;
+        while (try_dequeue_message(helper, &message)) {
+            verbose(VB_ASYNC, "Helper thread attending petition %d", message.action);
+            switch(message.action) {
+                case ACTION_SET_MASK:
+                    /* Clear before polling, so that newer masks are requested again */
+                    helper->mask_pending = 0;
+                    __sync_synchronize();
+                    verbose(VB_ASYNC, "Applying new process mask %s",
+                            mu_to_str(&message.mask));
+                    poll_drom_async(spd);
+                    /* Follow the new process mask unless pinned to service CPUs */
+                    if (spd->options.async_placement != HELPER_SERVICE) {
+                        compute_helper_mask(helper, &helper->mask);
+                        pin_helper(helper);
+                    }
+                    break;
+                case ACTION_JOIN:
+                    join = true;
+                    break;
+                default:
+                    break;
+            }
         }
     }
+
+    /* CPU actions requested before the join */
+    apply_cpu_actions(helper, pm);
+
     verbose(VB_ASYNC, "Helper thread finalizing");
     return NULL;
 }
 
-int shmem_async_init(pid_t pid, const pm_interface_t *pm, const cpu_set_t *process_mask,
-        const char *shmem_key) {
-    verbose(VB_ASYNC, "Creating helper thread");
-
-    // Shared memory creation
+static void open_shmem(const char *shmem_key) {
     pthread_mutex_lock(&mutex);
     {
         if (shm_handler == NULL) {
@@ -181,99 +512,284 @@ int shmem_async_init(pid_t pid, const pm_interface_t *pm, const cpu_set_t *proce
         }
     }
     pthread_mutex_unlock(&mutex);
+}
 
-    helper_t *helper = NULL;
+static void close_shmem(void) {
+    pthread_mutex_lock(&mutex);
+    {
+        if (--subprocesses_attached == 0) {
+            shmem_finalize(shm_handler, SHMEM_DELETE);
+            shm_handler = NULL;
+            shdata = NULL;
+        }
+    }
+    pthread_mutex_unlock(&mutex);
+}
+
+/* Compute the domains of the helpers of a process, either a single one with all
+ * the CPUs, or one per NUMA domain of the process mask. Return the number of domains */
+static int get_helper_domains(const subprocess_descriptor_t *spd, cpu_set_t *domains) {
+    int ndomains = 0;
+    if (spd->options.async_numa_helpers) {
+        cpu_set_t covered;
+        CPU_ZERO(&covered);
+        int cpuid;
+        for (cpuid = 0; cpuid < CPU_SETSIZE && ndomains < max_helpers; ++cpuid) {
+            if (CPU_ISSET(cpuid, &spd->process_mask) && !CPU_ISSET(cpuid, &covered)) {
+                cpu_set_t cpu;
+                CPU_ZERO(&cpu);
+                CPU_SET(cpuid, &cpu);
+                mu_get_parents_covering_cpuset(&domains[ndomains], &cpu);
+                if (CPU_COUNT(&domains[ndomains]) == 0) {
+                    CPU_SET(cpuid, &domains[ndomains]);
+                }
+                CPU_OR(&covered, &covered, &domains[ndomains]);
+                ++ndomains;
+            }
+        }
+    }
+
+    if (ndomains == 0) {
+        ndomains = 1;
+    }
+
+    /* The first domain also attends any CPU not covered by the rest */
+    cpu_set_t others;
+    CPU_ZERO(&others);
+    int d;
+    for (d = 1; d < ndomains; ++d) {
+        CPU_OR(&others, &others, &domains[d]);
+    }
+    memset(&domains[0], 0xff, sizeof(cpu_set_t));
+    mu_substract(&domains[0], &domains[0], &others);
+
+    return ndomains;
+}
+
+int shmem_async_init(const subprocess_descriptor_t *spd, const char *shmem_key) {
+    verbose(VB_ASYNC, "Creating helper thread");
+
+    // Shared memory creation
+    open_shmem(shmem_key);
+
+    cpu_set_t domains[max_helpers];
+    int ndomains = get_helper_domains(spd, domains);
+
+    int nhelpers = 0;
     // Lock shmem to register new subprocess
     shmem_lock(shm_handler);
     {
+        /* Reserve one helper per domain */
+        helper_t *helpers[ndomains];
         int h;
-        for (h = 0; h < max_helpers; ++h) {
-            // Register helper
+        for (h = 0; h < max_helpers && nhelpers < ndomains; ++h) {
             if (shdata->helpers[h].pid == NOBODY) {
-                helper = &shdata->helpers[h];
-
-                /* Initialize queue structure */
-                memset(helper->queue, 0, sizeof(helper->queue));
-                helper->q_head = 0;
-                helper->q_tail = 0;
-
-                /* Initialize queue sync attributes */
-                pthread_mutexattr_t mutex_attr;
-                fatal_cond_strerror( pthread_mutexattr_init(&mutex_attr) );
-                fatal_cond_strerror( pthread_mutexattr_setpshared(&mutex_attr,
-                            PTHREAD_PROCESS_SHARED) );
-                fatal_cond_strerror( pthread_mutex_init(&helper->q_lock, &mutex_attr) );
-                fatal_cond_strerror( pthread_mutexattr_destroy(&mutex_attr) );
-                pthread_condattr_t cond_attr;
-                fatal_cond_strerror( pthread_condattr_init(&cond_attr) );
-                fatal_cond_strerror( pthread_condattr_setpshared(&cond_attr,
-                            PTHREAD_PROCESS_SHARED) );
-                fatal_cond_strerror( pthread_cond_init(&helper->q_wait_data, &cond_attr) );
-                fatal_cond_strerror( pthread_condattr_destroy(&cond_attr) );
-
-                // Initialize helper metadata and create thread
-                helper->pm = pm;
-                helper->pid = pid;
-                memcpy(&helper->mask, process_mask, sizeof(cpu_set_t));
-                pthread_create(&helper->pth, NULL, thread_start, (void*)helper);
-                break;
+                helpers[nhelpers++] = &shdata->helpers[h];
+            }
+        }
+        if (nhelpers < ndomains) {
+            nhelpers = 0;
+        }
+
+        int d;
+        for (d = 0; d < nhelpers; ++d) {
+            helper_t *helper = helpers[d];
+
+            /* Initialize queue structure */
+            memset(helper->queue, 0, sizeof(helper->queue));
+            unsigned int i;
+            for (i = 0; i < QUEUE_SIZE; ++i) {
+                helper->queue[i].seq = i;
             }
+            helper->q_head = 0;
+            helper->q_tail = 0;
+            helper->q_futex = 0;
+            helper->q_sleeping = 0;
+            memset((void*)helper->cpu_action, ACTION_NONE, sizeof(helper->cpu_action));
+            memset((void*)helper->cpu_dirty, 0, sizeof(helper->cpu_dirty));
+            helper->mask_pending = 0;
+
+            // Initialize helper metadata and create thread
+            helper->spd = spd;
+            helper->pid = spd->id;
+            helper->primary = d == 0;
+            memcpy(&helper->domain, &domains[d], sizeof(cpu_set_t));
+            memcpy(&helper->mask, &spd->process_mask, sizeof(cpu_set_t));
+            pthread_create(&helper->pth, NULL, thread_start, (void*)helper);
         }
     }
     shmem_unlock(shm_handler);
 
-    return helper ? DLB_SUCCESS : DLB_ERR_NOMEM;
+    if (nhelpers == 0) {
+        close_shmem();
+        return DLB_ERR_NOMEM;
+    }
+    verbose(VB_ASYNC, "%d helper thread%s created", nhelpers, nhelpers > 1 ? "s" : "");
+    return DLB_SUCCESS;
+}
+
+int shmem_async_ext__init(const char *shmem_key) {
+    open_shmem(shmem_key);
+    return DLB_SUCCESS;
 }
 
 int shmem_async_finalize(pid_t pid) {
-    verbose(VB_ASYNC, "Finalizing helper thread for pid: %d", pid);
-    helper_t *helper = get_helper(pid);
-    if (helper) {
-        /* Enqueue JOIN message  */
-        message_t message = { .action = ACTION_JOIN };
-        enqueue_message(helper, &message);
+    if (shm_handler == NULL) return DLB_ERR_NOSHMEM;
+
+    verbose(VB_ASYNC, "Finalizing helper threads for pid: %d", pid);
+    int nhelpers = 0;
+    int h;
+    for (h = 0; h < max_helpers; ++h) {
+        helper_t *helper = &shdata->helpers[h];
+        if (helper->pid == pid) {
+            /* Enqueue JOIN message, the helper keeps draining the queue if full */
+            message_t message = { .action = ACTION_JOIN };
+            while (enqueue_message(helper, &message) != DLB_SUCCESS) {
+                sched_yield();
+            }
+            ++nhelpers;
+        }
+    }
 
-        /* Wait helper thread to finish */
-        pthread_join(helper->pth, NULL);
-        verbose(VB_ASYNC, "Helper thread joined");
+    if (nhelpers > 0) {
+        /* Wait helper threads to finish */
+        for (h = 0; h < max_helpers; ++h) {
+            helper_t *helper = &shdata->helpers[h];
+            if (helper->pid == pid) {
+                pthread_join(helper->pth, NULL);
+            }
+        }
+        verbose(VB_ASYNC, "Helper threads joined");
 
         /* Clear helper data */
         shmem_lock(shm_handler);
         {
-            helper->pm = NULL;
-            helper->pid = NOBODY;
-            pthread_mutex_destroy(&helper->q_lock);
-            pthread_cond_destroy(&helper->q_wait_data);
+            for (h = 0; h < max_helpers; ++h) {
+                helper_t *helper = &shdata->helpers[h];
+                if (helper->pid == pid) {
+                    helper->spd = NULL;
+                    helper->primary = false;
+                    helper->pid = NOBODY;
+                }
+            }
         }
         shmem_unlock(shm_handler);
 
         /* Shared memory destruction */
-        pthread_mutex_lock(&mutex);
-        {
-            if (--subprocesses_attached == 0) {
-                shmem_finalize(shm_handler, SHMEM_DELETE);
-                shm_handler = NULL;
-            }
-        }
-        pthread_mutex_unlock(&mutex);
+        close_shmem();
     }
 
-    return helper ? DLB_SUCCESS : DLB_ERR_NOPROC;
+    return nhelpers > 0 ? DLB_SUCCESS : DLB_ERR_NOPROC;
+}
+
+int shmem_async_ext__finalize(void) {
+    if (shm_handler == NULL) return DLB_ERR_NOSHMEM;
+    close_shmem();
+    return DLB_SUCCESS;
 }
 
 
 void shmem_async_enable_cpu(pid_t pid, int cpuid) {
     verbose(VB_ASYNC, "Enqueuing petition for pid: %d, enable cpuid %d", pid, cpuid);
-    helper_t *helper = get_helper(pid);
+    helper_t *helper = get_cpu_helper(pid, cpuid);
     ensure(helper, "No helper found in enable_cpu function");
-    message_t message = { .action = ACTION_ENABLE_CPU, .cpuid = cpuid };
-    enqueue_message(helper, &message);
+    set_cpu_action(helper, cpuid, ACTION_ENABLE_CPU);
 }
 
 void shmem_async_disable_cpu(pid_t pid, int cpuid) {
     verbose(VB_ASYNC, "Enqueuing petition for pid: %d, disable cpuid %d", pid, cpuid);
-    helper_t *helper = get_helper(pid);
+    helper_t *helper = get_cpu_helper(pid, cpuid);
     ensure(helper, "No helper found in disable_cpu function");
-    message_t message = { .action = ACTION_DISABLE_CPU, .cpuid = cpuid };
-    enqueue_message(helper, &message);
+    set_cpu_action(helper, cpuid, ACTION_DISABLE_CPU);
+}
+
+/* Split the mask among the helpers of the process */
+static void set_process_mask_action(pid_t pid, const cpu_set_t *mask, action_t action) {
+    DLB_DEBUG( bool found = false; )
+    int h;
+    for (h = 0; h < max_helpers; ++h) {
+        helper_t *helper = &shdata->helpers[h];
+        if (helper->pid == pid) {
+            DLB_DEBUG( found = true; )
+            cpu_set_t local_mask;
+            CPU_AND(&local_mask, mask, &helper->domain);
+            if (CPU_COUNT(&local_mask) > 0) {
+                set_cpu_mask_action(helper, &local_mask, action);
+            }
+        }
+    }
+    ensure(found, "No helper found in set_process_mask_action function");
+}
+
+void shmem_async_enable_cpu_mask(pid_t pid, const cpu_set_t *mask) {
+    verbose(VB_ASYNC, "Enqueuing petition for pid: %d, enable CPUs %s", pid, mu_to_str(mask));
+    set_process_mask_action(pid, mask, ACTION_ENABLE_CPU);
+}
+
+void shmem_async_disable_cpu_mask(pid_t pid, const cpu_set_t *mask) {
+    verbose(VB_ASYNC, "Enqueuing petition for pid: %d, disable CPUs %s", pid, mu_to_str(mask));
+    set_process_mask_action(pid, mask, ACTION_DISABLE_CPU);
+}
+
+/* Group the CPUs by process, pids[cpuid] being the process of each CPU, or
+ * non-positive if none, to send one request per process */
+static void set_cpus_action(const pid_t *pids, action_t action) {
+    bool done[max_helpers];
+    memset(done, 0, sizeof(done));
+    int cpuid;
+    for (cpuid = 0; cpuid < max_helpers; ++cpuid) {
+        pid_t pid = pids[cpuid];
+        if (done[cpuid] || pid <= 0) continue;
+
+        cpu_set_t mask;
+        CPU_ZERO(&mask);
+        int c;
+        for (c = cpuid; c < max_helpers; ++c) {
+            if (pids[c] == pid) {
+                CPU_SET(c, &mask);
+                done[c] = true;
+            }
+        }
+        if (action == ACTION_ENABLE_CPU) {
+            shmem_async_enable_cpu_mask(pid, &mask);
+        } else {
+            shmem_async_disable_cpu_mask(pid, &mask);
+        }
+    }
+}
+
+void shmem_async_enable_cpus(const pid_t *pids) {
+    set_cpus_action(pids, ACTION_ENABLE_CPU);
+}
+
+void shmem_async_disable_cpus(const pid_t *pids) {
+    set_cpus_action(pids, ACTION_DISABLE_CPU);
+}
+
+int shmem_async_set_mask(pid_t pid, const cpu_set_t *mask) {
+    if (shm_handler == NULL) return DLB_ERR_NOSHMEM;
+
+    /* The helper may not exist if the target process is not in asynchronous
+     * mode. The lock is held until the petition is enqueued so that the helper
+     * is not cleared by shmem_async_finalize in the meantime */
+    int error = DLB_SUCCESS;
+    shmem_lock(shm_handler);
+    {
+        helper_t *helper = get_helper(pid);
+        if (helper == NULL) {
+            error = DLB_ERR_NOPROC;
+        } else if (__sync_bool_compare_and_swap(&helper->mask_pending, 0, 1)) {
+            /* The helper polls the latest mask, only one petition may be pending */
+            verbose(VB_ASYNC, "Enqueuing petition for pid: %d, set mask %s",
+                    pid, mu_to_str(mask));
+            message_t message = { .action = ACTION_SET_MASK };
+            memcpy(&message.mask, mask, sizeof(cpu_set_t));
+            if (enqueue_message(helper, &message) != DLB_SUCCESS) {
+                helper->mask_pending = 0;
+                error = DLB_ERR_REQST;
+            }
+        }
+    }
+    shmem_unlock(shm_handler);
+    return error;
 }
@@ -23,13 +23,20 @@
 #include <sched.h>
 #include <sys/types.h>
 
-struct pm_interface;
+struct SubProcessDescriptor;
 
-int shmem_async_init(pid_t pid, const struct pm_interface *pm,
-        const cpu_set_t *process_mask, const char *shmem_key);
+int shmem_async_init(const struct SubProcessDescriptor *spd, const char *shmem_key);
+int shmem_async_ext__init(const char *shmem_key);
 int shmem_async_finalize(pid_t pid);
+int shmem_async_ext__finalize(void);
 
 void shmem_async_enable_cpu(pid_t pid, int cpuid);
 void shmem_async_disable_cpu(pid_t pid, int cpuid);
+void shmem_async_enable_cpu_mask(pid_t pid, const cpu_set_t *mask);
+void shmem_async_disable_cpu_mask(pid_t pid, const cpu_set_t *mask);
+/* pids[cpuid] is the process that must enable/disable each CPU, if positive */
+void shmem_async_enable_cpus(const pid_t *pids);
+void shmem_async_disable_cpus(const pid_t *pids);
+int  shmem_async_set_mask(pid_t pid, const cpu_set_t *mask);
 
 #endif /* SHMEM_ASYNC_H */
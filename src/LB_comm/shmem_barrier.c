@@ -21,43 +21,283 @@
 
 #include "LB_core/DLB_kernel.h"
 #include "LB_comm/shmem.h"
+#include "apis/dlb_errors.h"
 #include "support/debug.h"
 #include "support/mask_utils.h"
+#include "support/mytime.h"
+#include "support/options.h"
 #include "support/tracing.h"
 
-#include <semaphore.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
 
+enum { BARRIER_NAME_MAX = 32 };
+enum { BARRIER_MAX_DOMAINS = 8 };
+enum { CACHE_LINE_SIZE = 64 };
+enum { BARRIER_CLAIMED = INT_MIN/2 };
+
+/* Sense-reversing barrier level: each participant reads the current sense
+ * before arriving, the last one to arrive resets the counter and flips the
+ * sense, waking up all the waiters at once.
+ * The counter of a level holds BARRIER_CLAIMED plus the arrivals of the next
+ * episode from the moment it is completed until it is released.
+ * Each level is aligned to its own cache line so that independent groups do
+ * not share a hot counter. The arrival timestamps of the current episode are
+ * accumulated in the same line */
+typedef struct {
+    volatile int participants;      // atomically updated, read without the lock
+    volatile int count;
+    volatile unsigned int sense;    // futex word, incremented on each release
+    volatile int orphaned;          // domain level completed by a detaching process
+    volatile int nprocs;            // processes arrived in this episode
+    volatile int64_t first_arrival; // earliest arrival in this episode, 0 if none
+    volatile int64_t sum_arrivals;  // sum of arrival timestamps in this episode
+} __attribute__((aligned(CACHE_LINE_SIZE))) barrier_level_t;
+
+/* Arrival skew statistics, only updated by the process releasing each episode.
+ * Waiting and episode times are only accounted from the second episode on */
 typedef struct {
-    bool initialized;
-    int count;
-    int participants;
-    sem_t sem;
+    int64_t num_episodes;
+    int64_t total_skew;             // time between the first and the last arrival
+    int64_t max_skew;
+    int64_t total_wait;             // time waited by all the participants
+    int64_t total_time;             // time between releases, per participant
+    int64_t last_release;
+} __attribute__((aligned(CACHE_LINE_SIZE))) barrier_stats_t;
+
+/* A flat barrier only uses the top level, where all processes arrive.
+ * A hierarchical barrier uses one level per NUMA domain; the last process of
+ * each domain arrives to the top level, whose participants are the domains in
+ * use. The last domain releases the top level, waking up the domain leaders,
+ * which in turn release their domains.
+ * A barrier is in use while its name is set */
+typedef struct {
+    char name[BARRIER_NAME_MAX];
+    bool hierarchical;
+    barrier_stats_t stats;
+    barrier_level_t top;
+    barrier_level_t domains[BARRIER_MAX_DOMAINS];
 } barrier_t;
 
 typedef struct {
     barrier_t barriers[0];
 } shdata_t;
 
-enum { SHMEM_BARRIER_VERSION = 1 };
+enum { SHMEM_BARRIER_VERSION = 6 };
 
-static int global_barrier_ids[2] = {0, 1};
-static int local_barrier_id = 0;
+static const char *default_barrier_name = "default";
 static int max_barriers;
+static int domain_id = 0;           // process NUMA domain, for hierarchical barriers
+static bool hierarchical = false;   // type of the barriers created by this process
+static int64_t lend_threshold = 0;  // ns, lend only if the predicted wait is longer
+static bool *attached = NULL;       // process local, whether attached to each barrier
+static int64_t *predicted_wait = NULL;  // process local, per barrier
 static shmem_handler_t *shm_handler = NULL;
 static shdata_t *shdata = NULL;
 static const char *shmem_name = "barrier";
 
-static barrier_t* get_barrier() {
-    int bid = global_barrier_ids[local_barrier_id];
-    return &shdata->barriers[bid];
+static const char* get_barrier_name(const char *barrier_name) {
+    return barrier_name == NULL || barrier_name[0] == '\0'
+        ? default_barrier_name : barrier_name;
+}
+
+/* Names are truncated to BARRIER_NAME_MAX-1 characters */
+static bool barrier_name_eq(const barrier_t *barrier, const char *barrier_name) {
+    return strncmp(barrier->name, barrier_name, BARRIER_NAME_MAX-1) == 0;
+}
+
+/* Find a barrier by name among the ones this process is attached to.
+ * The name of an attached barrier cannot change, no lock is needed */
+static barrier_t* get_attached_barrier(const char *barrier_name) {
+    int i;
+    for (i = 0; i < max_barriers; ++i) {
+        if (attached[i] && barrier_name_eq(&shdata->barriers[i], barrier_name)) {
+            return &shdata->barriers[i];
+        }
+    }
+    return NULL;
+}
+
+/* The barrier lives in a shared memory, futexes must not be private */
+static void futex_wait(volatile unsigned int *addr, unsigned int value) {
+    syscall(SYS_futex, addr, FUTEX_WAIT, value, NULL, NULL, 0);
+}
+
+static void futex_wake_all(volatile unsigned int *addr) {
+    syscall(SYS_futex, addr, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+/* Only one process may complete each episode, so the counter is claimed only
+ * if it still holds the expected value. The level remains claimed until it is
+ * released, which for a domain level lasts until the top level is released */
+static bool claim_level(barrier_level_t *level, int count) {
+    return __sync_bool_compare_and_swap(&level->count, count, BARRIER_CLAIMED);
+}
+
+/* Accumulate arrivals to the level, either of one process or of a whole domain */
+static void add_arrivals(barrier_level_t *level, int nprocs, int64_t first_arrival,
+        int64_t sum_arrivals) {
+    int64_t first = level->first_arrival;
+    while ((first == 0 || first_arrival < first)
+            && !__sync_bool_compare_and_swap(&level->first_arrival, first, first_arrival)) {
+        first = level->first_arrival;
+    }
+    __sync_fetch_and_add(&level->sum_arrivals, sum_arrivals);
+    __sync_fetch_and_add(&level->nprocs, nprocs);
+}
+
+/* Move the arrivals of a completed domain to the top level */
+static void fold_arrivals(barrier_level_t *domain, barrier_level_t *top) {
+    add_arrivals(top, domain->nprocs, domain->first_arrival, domain->sum_arrivals);
+    domain->nprocs = 0;
+    domain->first_arrival = 0;
+    domain->sum_arrivals = 0;
+}
+
+/* Arrive to the level, whose sense has been read before arriving.
+ * Participants of a claimed level are all waiting, so an arrival to a claimed
+ * level comes from a process that attached meanwhile: it already counts for the
+ * next episode, but it must not be woken up by the release of the current one */
+static bool arrive_level(barrier_level_t *level, unsigned int *sense) {
+    int count = __sync_add_and_fetch(&level->count, 1);
+    if (count < 0) {
+        while (level->sense == *sense) {
+            futex_wait(&level->sense, *sense);
+        }
+        ++*sense;
+        count = level->count;
+    }
+    return count >= level->participants && claim_level(level, count);
+}
+
+/* Reset the counter before flipping the sense, so that participants released
+ * can already arrive to the next barrier. Arrivals to the claimed level are kept */
+static void release_level(barrier_level_t *level) {
+    __sync_fetch_and_sub(&level->count, BARRIER_CLAIMED);
+    __sync_fetch_and_add(&level->sense, 1);
+    futex_wake_all(&level->sense);
+}
+
+/* Each participant waited from its arrival until now */
+static void update_stats(barrier_t *barrier, int64_t now) {
+    barrier_level_t *top = &barrier->top;
+    barrier_stats_t *stats = &barrier->stats;
+    int64_t skew = top->first_arrival > 0 ? now - top->first_arrival : 0;
+    stats->num_episodes++;
+    stats->total_skew += skew;
+    if (skew > stats->max_skew) stats->max_skew = skew;
+    if (stats->last_release > 0) {
+        stats->total_wait += top->nprocs * now - top->sum_arrivals;
+        stats->total_time += top->nprocs * (now - stats->last_release);
+    }
+    stats->last_release = now;
+    top->nprocs = 0;
+    top->first_arrival = 0;
+    top->sum_arrivals = 0;
+}
+
+/* Domains completed by a detaching process have no leader waiting on the top
+ * level, the process releasing the top level also releases them */
+static void release_top(barrier_t *barrier) {
+    update_stats(barrier, get_time_in_ns());
+    release_level(&barrier->top);
+    if (barrier->hierarchical) {
+        int d;
+        for (d = 0; d < BARRIER_MAX_DOMAINS; ++d) {
+            barrier_level_t *domain = &barrier->domains[d];
+            if (domain->orphaned && __sync_bool_compare_and_swap(&domain->orphaned, 1, 0)) {
+                release_level(domain);
+            }
+        }
+    }
+}
+
+/* Attach to the barrier with the given name, or to a new one. Shmem must be locked */
+static int attach_barrier(const char *barrier_name) {
+    int i;
+    int free_id = -1;
+    for (i = 0; i < max_barriers; ++i) {
+        barrier_t *barrier = &shdata->barriers[i];
+        if (barrier->name[0] == '\0') {
+            if (free_id == -1) free_id = i;
+        } else if (barrier_name_eq(barrier, barrier_name)) {
+            if (attached[i]) return DLB_NOUPDT;
+            break;
+        }
+    }
+
+    if (i == max_barriers) {
+        // Barrier not found, initialize a new one
+        if (free_id == -1) {
+            return DLB_ERR_NOMEM;
+        }
+        i = free_id;
+        barrier_t *barrier = &shdata->barriers[i];
+        memset(barrier, 0, sizeof(barrier_t));
+        snprintf(barrier->name, BARRIER_NAME_MAX, "%s", barrier_name);
+        barrier->hierarchical = hierarchical;
+    }
+
+    barrier_t *barrier = &shdata->barriers[i];
+    if (barrier->hierarchical) {
+        if (__sync_add_and_fetch(&barrier->domains[domain_id].participants, 1) == 1) {
+            __sync_add_and_fetch(&barrier->top.participants, 1);
+        }
+    } else {
+        __sync_add_and_fetch(&barrier->top.participants, 1);
+    }
+    attached[i] = true;
+    predicted_wait[i] = lend_threshold;
+    verbose(VB_SHMEM, "Barrier %s participants: %d", barrier->name, barrier->top.participants);
+    return DLB_SUCCESS;
 }
-static void advance_barrier() {
-    local_barrier_id = (local_barrier_id+1)%2;
+
+/* Detach from the given barrier. Shmem must be locked */
+static void detach_barrier(barrier_t *barrier) {
+    attached[barrier - shdata->barriers] = false;
+
+    DLB_DEBUG( barrier_stats_t *stats = &barrier->stats; )
+    verbose(VB_STATS, "Barrier %s: %"PRId64" episodes, average skew %"PRId64" ns,"
+            " imbalance %.2f", barrier->name, stats->num_episodes,
+            stats->num_episodes > 0 ? stats->total_skew / stats->num_episodes : 0,
+            stats->total_time > 0 ? (double)stats->total_wait / stats->total_time : 0.0);
+
+    barrier_level_t *top = &barrier->top;
+    barrier_level_t *domain = &barrier->domains[domain_id];
+    if (barrier->hierarchical
+            && __sync_sub_and_fetch(&domain->participants, 1) > 0) {
+        int count = domain->count;
+        if (count > 0 && count >= domain->participants && claim_level(domain, count)) {
+            // Everyone else in the domain was already waiting for this participant,
+            // arrive to the top level on their behalf
+            fold_arrivals(domain, top);
+            domain->orphaned = 1;
+            unsigned int sense = top->sense;
+            if (arrive_level(top, &sense)) {
+                release_top(barrier);
+            }
+        }
+    } else {
+        // Decrement participants
+        __sync_sub_and_fetch(&top->participants, 1);
+        int count = top->count;
+        if (top->participants == 0) {
+            // Nullify barrier only if last participant
+            barrier->name[0] = '\0';
+        } else if (count > 0 && count >= top->participants && claim_level(top, count)) {
+            // Everyone else was already waiting for this participant
+            release_top(barrier);
+        }
+    }
+    verbose(VB_SHMEM, "Barrier %s participants: %d", barrier->name, top->participants);
 }
 
-void shmem_barrier_init(const char *shmem_key) {
+void shmem_barrier_init(const cpu_set_t *process_mask, const options_t *options) {
     // Protect double initialization
     if (shm_handler != NULL) {
         warning("Shared Memory is being initialized more than once");
@@ -65,38 +305,32 @@ void shmem_barrier_init(const char *shmem_key) {
         return;
     }
 
-    // more error checks to be done if the option is implemented
-    global_barrier_ids[0] = getenv("LB_BARRIER_ID") ? atoi(getenv("LB_BARRIER_ID")) : 0;
-    global_barrier_ids[1] = global_barrier_ids[0]+1;
-//    int qty = getenv("LB_BARRIER_QTY") ? atoi(getenv("LB_BARRIER_QTY")) : 0;
-
     max_barriers = mu_get_system_size()*2;
+    attached = calloc(max_barriers, sizeof(bool));
+    predicted_wait = calloc(max_barriers, sizeof(int64_t));
+    hierarchical = options->barrier_hierarchical;
+    lend_threshold = (int64_t)options->barrier_lend_threshold * 1000;
+
+    // The domain of the process is the one of its first CPU
+    domain_id = 0;
+    int cpuid;
+    for (cpuid = 0; cpuid < CPU_SETSIZE; ++cpuid) {
+        if (CPU_ISSET(cpuid, process_mask)) {
+            int parent_id = mu_get_parent_id(cpuid);
+            domain_id = parent_id >= 0 ? parent_id % BARRIER_MAX_DOMAINS : 0;
+            break;
+        }
+    }
 
     shmem_handler_t *init_handler = shmem_init((void**)&shdata,
             sizeof(shdata_t) + sizeof(barrier_t)*max_barriers,
-            shmem_name, shmem_key, SHMEM_BARRIER_VERSION);
+            shmem_name, options->shm_key, SHMEM_BARRIER_VERSION);
 
+    // Every process is attached to the default barrier
     shmem_lock(init_handler);
     {
-        // Initialize both barriers, only first process to arrive
-        int i;
-        for (i=0; i<2; ++i) {
-            barrier_t *barrier = get_barrier();
-            if (!barrier->initialized) {
-                /* Create Unnamed Semaphore(0): Barrier */
-                int error = sem_init(&barrier->sem, /*shared*/ 1, /*value*/ 0 );
-                if (error) {
-                    perror( "DLB_PANIC: Process unable to create/attach to semaphore (barrier)" );
-                    exit( EXIT_FAILURE );
-                }
-
-                barrier->count = 0;
-                barrier->participants = 0;
-                barrier->initialized = true;
-            }
-            barrier->participants++;
-            warning("barrier participants: %d", barrier->participants);
-            advance_barrier();
+        if (attach_barrier(default_barrier_name) == DLB_ERR_NOMEM) {
+            warning("Could not attach to the default barrier, no barriers available");
         }
     }
     shmem_unlock(init_handler);
@@ -111,79 +345,127 @@ void shmem_barrier_finalize(void) {
     shmem_lock(shm_handler);
     {
         int i;
-        for (i=0; i<2; ++i) {
-            barrier_t *barrier = get_barrier();
-            if (barrier->initialized) {
-                // TODO check if sempahore is not being used
-
-                // Decrement participants
-                --barrier->participants;
-
-                // Nulllify barrier only if last participant
-                if (barrier->participants == 0) {
-                    if (sem_destroy(&barrier->sem)) {
-                        perror("DLB ERROR: sem_close");
-                    }
-                    barrier->initialized = false;
-                }
+        for (i = 0; i < max_barriers; ++i) {
+            if (attached[i]) {
+                detach_barrier(&shdata->barriers[i]);
             }
-            advance_barrier();
         }
     }
     shmem_unlock(shm_handler);
 
     shmem_finalize(shm_handler, SHMEM_DELETE);
     shm_handler = NULL;
+    free(attached);
+    free(predicted_wait);
+    attached = NULL;
+    predicted_wait = NULL;
 }
 
-void shmem_barrier(void) {
-    if (shm_handler == NULL) return;
-
-    barrier_t *barrier = get_barrier();
+int shmem_barrier_attach(const char *barrier_name) {
+    if (shm_handler == NULL) return DLB_ERR_NOSHMEM;
 
-    if (!barrier->initialized) {
-        warning("Trying to use a non initialized barrier");
-        return;
+    int error;
+    shmem_lock(shm_handler);
+    {
+        error = attach_barrier(get_barrier_name(barrier_name));
     }
+    shmem_unlock(shm_handler);
+    return error;
+}
 
-    bool last_in;
+int shmem_barrier_detach(const char *barrier_name) {
+    if (shm_handler == NULL) return DLB_ERR_NOSHMEM;
+
+    int error;
     shmem_lock(shm_handler);
     {
-        last_in = ++barrier->count == barrier->participants;
+        barrier_t *barrier = get_attached_barrier(get_barrier_name(barrier_name));
+        if (barrier != NULL) {
+            detach_barrier(barrier);
+            error = DLB_SUCCESS;
+        } else {
+            error = DLB_ERR_PERM;
+        }
     }
     shmem_unlock(shm_handler);
+    return error;
+}
+
+int shmem_barrier(const char *barrier_name) {
+    if (shm_handler == NULL) return DLB_ERR_NOSHMEM;
+
+    barrier_t *barrier = get_attached_barrier(get_barrier_name(barrier_name));
+    if (barrier == NULL) return DLB_ERR_PERM;
+
+    barrier_level_t *top = &barrier->top;
+    barrier_level_t *domain = barrier->hierarchical ? &barrier->domains[domain_id] : NULL;
+    barrier_level_t *level = domain ? domain : top;
 
+    // The sense must be read before arriving, the atomic add is a full barrier.
+    // The last process entering the barrier wakes up everyone
+    int64_t arrival = get_time_in_ns();
+    unsigned int sense = level->sense;
+    add_arrivals(level, 1, arrival, arrival);
+    bool last_in = arrive_level(level, &sense);
+
+    // The last process of the domain arrives to the top level
+    bool domain_leader = false;
+    if (last_in && domain) {
+        domain_leader = true;
+        level = top;
+        sense = top->sense;
+        fold_arrivals(domain, top);
+        last_in = arrive_level(top, &sense);
+    }
+
+    int64_t *predicted = &predicted_wait[barrier - shdata->barriers];
     if (last_in) {
-        // Last process entering the barrier must signal someone
-        sem_post(&barrier->sem);
+        release_top(barrier);
+        if (domain_leader) release_level(domain);
+        *predicted = *predicted * 3 / 4;
     } else {
-        // Only if this process is not the last one, act as a blocking call
-        add_event(RUNTIME_EVENT, EVENT_LEND);
-        IntoBlockingCall(0, 0);
-        add_event(RUNTIME_EVENT, 0);
-    }
+        // Only if this process is not the last one and it expects to wait
+        // long enough, act as a blocking call
+        bool lend = *predicted >= lend_threshold;
+        if (lend) {
+            add_event(RUNTIME_EVENT, EVENT_LEND);
+            IntoBlockingCall(0, 0);
+            add_event(RUNTIME_EVENT, 0);
+        }
 
-    // Wait until everyone is in here
-    sem_wait(&barrier->sem);
+        // Wait until everyone is in here
+        while (level->sense == sense) {
+            futex_wait(&level->sense, sense);
+        }
+
+        // Tree wakeup, the domain leader releases its domain
+        if (domain_leader) release_level(domain);
+
+        *predicted = (*predicted * 3 + get_time_in_ns() - arrival) / 4;
 
-    if (!last_in) {
         // Recover resources for those processes that simulated a blocking call
-        add_event(RUNTIME_EVENT, EVENT_ACQUIRE);
-        OutOfBlockingCall(0);
-        add_event(RUNTIME_EVENT, 0);
+        if (lend) {
+            add_event(RUNTIME_EVENT, EVENT_ACQUIRE);
+            OutOfBlockingCall(0);
+            add_event(RUNTIME_EVENT, 0);
+        }
     }
 
-    bool last_out;
-    shmem_lock(shm_handler);
-    {
-        last_out = --barrier->count  == 0;
-    }
-    shmem_unlock(shm_handler);
+    return DLB_SUCCESS;
+}
 
-    if (!last_out) {
-        // Everyone except the last process out must signal the next one
-        sem_post(&barrier->sem);
-    }
+int shmem_barrier_get_stats(const char *barrier_name, int *episodes, double *avg_skew,
+        double *max_skew, double *imbalance) {
+    if (shm_handler == NULL) return DLB_ERR_NOSHMEM;
+
+    barrier_t *barrier = get_attached_barrier(get_barrier_name(barrier_name));
+    if (barrier == NULL) return DLB_ERR_PERM;
 
-    advance_barrier();
+    const barrier_stats_t *stats = &barrier->stats;
+    int64_t num_episodes = stats->num_episodes;
+    *episodes = num_episodes;
+    *avg_skew = num_episodes > 0 ? (double)stats->total_skew / num_episodes / 1e9 : 0.0;
+    *max_skew = (double)stats->max_skew / 1e9;
+    *imbalance = stats->total_time > 0 ? (double)stats->total_wait / stats->total_time : 0.0;
+    return DLB_SUCCESS;
 }
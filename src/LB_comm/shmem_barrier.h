@@ -20,8 +20,18 @@
 #ifndef SHMEM_BARRIER_H
 #define SHMEM_BARRIER_H
 
-void shmem_barrier_init(const char *shmem_key);
+#include <sched.h>
+
+struct Options;
+
+/* A NULL or empty barrier name refers to the default barrier, which every
+ * process attaches to on initialization */
+void shmem_barrier_init(const cpu_set_t *process_mask, const struct Options *options);
 void shmem_barrier_finalize(void);
-void shmem_barrier(void);
+int shmem_barrier_attach(const char *barrier_name);
+int shmem_barrier_detach(const char *barrier_name);
+int shmem_barrier(const char *barrier_name);
+int shmem_barrier_get_stats(const char *barrier_name, int *episodes, double *avg_skew,
+        double *max_skew, double *imbalance);
 
 #endif /* SHMEM_BARRIER_H */
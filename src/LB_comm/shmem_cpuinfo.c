@@ -31,6 +31,8 @@
 
 #include <sched.h>
 #include <unistd.h>
+#include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <sys/types.h>
 #include <sys/ioctl.h>
@@ -163,6 +165,9 @@ typedef struct {
     int             thread_id;              // Last thread owning the CPU
     bool            dirty;                  // Dirty flag to check thread rebinding
     cpu_state_t     state;
+    int64_t         lend_duration;          // Expected duration of the owner lends, 0 if unknown
+    int64_t         lend_time;              // Time of the last lend by the owner
+    int64_t         expected_return;        // Time the owner expects to reclaim it, 0 if unknown
     stats_state_t   stats_state;
     int64_t         acc_time[_NUM_STATS];   // Accumulated time for each state
     struct          timespec last_update;
@@ -177,7 +182,7 @@ typedef struct {
     cpuinfo_t        node_info[0];
 } shdata_t;
 
-enum { SHMEM_CPUINFO_VERSION = 1 };
+enum { SHMEM_CPUINFO_VERSION = 2 };
 
 static shmem_handler_t *shm_handler = NULL;
 static shdata_t *shdata = NULL;
@@ -262,6 +267,8 @@ static int register_process(pid_t pid, const cpu_set_t *mask, bool steal) {
             cpuinfo->id = cpuid;
             cpuinfo->owner = pid;
             cpuinfo->state = CPU_BUSY;
+            cpuinfo->lend_duration = 0;
+            cpuinfo->expected_return = 0;
             cpuinfo->thread_id = -1;
             cpuinfo->dirty = true;
             shdata->dirty = true;
@@ -358,6 +365,8 @@ static bool deregister_process(pid_t pid) {
         cpuinfo_t *cpuinfo = &shdata->node_info[cpuid];
         if (cpuinfo->owner == pid) {
             cpuinfo->owner = NOBODY;
+            cpuinfo->lend_duration = 0;
+            cpuinfo->expected_return = 0;
             if (cpuinfo->guest == pid) {
                 cpuinfo->guest = NOBODY;
                 update_cpu_stats(cpuid, STATS_IDLE);
@@ -446,10 +455,14 @@ int shmem_cpuinfo_ext__postfinalize(pid_t pid) {
  */
 static void lend_cpu(pid_t pid, int cpuid, pid_t *new_guest) {
     cpuinfo_t *cpuinfo = &shdata->node_info[cpuid];
+    int64_t now = get_time_in_ns();
 
     if (cpuinfo->owner == pid) {
         // If the CPU is owned by the process, just change the state
         cpuinfo->state = CPU_LENT;
+        cpuinfo->lend_time = now;
+        cpuinfo->expected_return = cpuinfo->lend_duration > 0
+            ? now + cpuinfo->lend_duration : 0;
     } else {
         // Otherwise, remove any previous request
         remove_cpu_request(&cpuinfo->requests, pid);
@@ -471,7 +484,7 @@ static void lend_cpu(pid_t pid, int cpuid, pid_t *new_guest) {
         *new_guest = -1;
     }
 
-    shdata->timestamp_cpu_lent = get_time_in_ns();
+    shdata->timestamp_cpu_lent = now;
 }
 
 int shmem_cpuinfo__lend_cpu(pid_t pid, int cpuid, pid_t *new_guest) {
@@ -655,12 +668,23 @@ int shmem_cpuinfo__reclaim_cpus(pid_t pid, int ncpus, pid_t new_guests[], pid_t
     //cpu_set_t recovered_cpus;
     //CPU_ZERO(&recovered_cpus);
 
+    /* Not every CPU is checked, output arrays need to be properly initialized */
+    int cpuid;
+    for (cpuid=0; cpuid<node_size; ++cpuid) {
+        new_guests[cpuid] = -1;
+        victims[cpuid] = -1;
+    }
+
     shmem_lock(shm_handler);
     {
-        int cpuid;
+        /* Only lent CPUs count, the ones in use are already reclaimed */
         for (cpuid=0; cpuid<node_size && ncpus>0; ++cpuid) {
-            if (shdata->node_info[cpuid].owner == pid) {
-                reclaim_cpu(pid, cpuid, &new_guests[cpuid], &victims[cpuid]);
+            if (shdata->node_info[cpuid].owner == pid
+                    && shdata->node_info[cpuid].state == CPU_LENT) {
+                if (reclaim_cpu(pid, cpuid, &new_guests[cpuid], &victims[cpuid])
+                        == DLB_NOTED) {
+                    error = DLB_NOTED;
+                }
                 --ncpus;
             }
             // Look for Idle CPUs, only in DEBUG or INSTRUMENTATION
@@ -669,12 +693,6 @@ int shmem_cpuinfo__reclaim_cpus(pid_t pid, int ncpus, pid_t new_guests[], pid_t
                 //DLB_DEBUG( CPU_SET(cpu, &idle_cpus); )
             //}
         }
-
-        /* Invalidate arguments out of ncpus */
-        for (; cpuid<node_size; ++cpuid) {
-            new_guests[cpuid] = -1;
-            victims[cpuid] = -1;
-        }
     }
     shmem_unlock(shm_handler);
 
@@ -795,6 +813,8 @@ int shmem_cpuinfo__acquire_cpu(pid_t pid, int cpuid, pid_t *new_guest, pid_t *vi
 
 /* exceptional case: acquire_cpus may need borrow_cpu  */
 static int borrow_cpu(pid_t pid, int cpuid, pid_t *victim);
+static const int* sort_by_availability(pid_t pid, priority_t priority,
+        const int *cpus_priority_array, int *sorted_array);
 
 int shmem_cpuinfo__acquire_cpus(pid_t pid, priority_t priority, int *cpus_priority_array,
         int64_t *last_borrow, int ncpus, pid_t new_guests[], pid_t victims[]) {
@@ -835,6 +855,10 @@ int shmem_cpuinfo__acquire_cpus(pid_t pid, priority_t priority, int *cpus_priori
             remove_global_request(&shdata->global_requests, pid);
             error = DLB_SUCCESS;
         } else {
+            /* Non-owned CPUs are sorted by their expected availability, if known */
+            int sorted_array[node_size];
+            const int *cpus_array = sort_by_availability(pid, priority, cpus_priority_array,
+                    sorted_array);
 
             /* Note: cpus_priority_array always have owned CPUs first so we split the
              * algorithm in two loops with different body for owned and non-owned CPUs
@@ -842,7 +866,7 @@ int shmem_cpuinfo__acquire_cpus(pid_t pid, priority_t priority, int *cpus_priori
 
             /* Acquire owned CPUs following the priority of cpus_priority_array */
             for (i=0; ncpus>0 && i<node_size; ++i) {
-                int cpuid = cpus_priority_array[i];
+                int cpuid = cpus_array[i];
                 /* Break if cpu array does not contain more valid CPU ids */
                 if (cpuid == -1) break;
                 /* Go to next loop if cpu array does not contain owned CPUs */
@@ -858,7 +882,7 @@ int shmem_cpuinfo__acquire_cpus(pid_t pid, priority_t priority, int *cpus_priori
 
             /* Borrow non-owned CPUs following the priority of cpus_priority_array */
             for (;ncpus>0 && i<node_size; ++i) {
-                int cpuid = cpus_priority_array[i];
+                int cpuid = cpus_array[i];
                 /* Break if cpu array does not contain more valid CPU ids */
                 if (cpuid == -1) break;
 
@@ -930,6 +954,96 @@ static int borrow_cpu(pid_t pid, int cpuid, pid_t *new_guest) {
     return error;
 }
 
+/* Sorting keys of the CPUs without a known remaining availability */
+static const int64_t AVAILABILITY_UNKNOWN = 0;
+static const int64_t AVAILABILITY_OVERDUE = -1;
+static const int64_t AVAILABILITY_NONE = INT64_MIN;
+
+typedef struct {
+    int cpuid;
+    int tier;                   // affinity tier, lower first
+    int position;               // position in cpus_priority_array
+    int64_t availability;       // expected remaining time until the owner reclaims it
+} borrow_candidate_t;
+
+static int cmp_borrow_candidates(const void *elem1, const void *elem2) {
+    const borrow_candidate_t *a = elem1;
+    const borrow_candidate_t *b = elem2;
+    if (a->tier != b->tier) return a->tier - b->tier;
+    if (a->availability != b->availability) return a->availability > b->availability ? -1 : 1;
+    return a->position - b->position;
+}
+
+/* Order the CPUs of cpus_priority_array to borrow first the ones that are
+ * expected to remain available for longer. Owned CPUs are kept first, and the
+ * rest are sorted within each affinity tier of the priority: CPUs with a known
+ * expected lend duration first, longest remaining time first, then CPUs with
+ * unknown duration, and last the ones whose owner is overdue.
+ * If no lent CPU has an expected duration, cpus_priority_array is returned
+ * unmodified, otherwise sorted_array is filled and returned.
+ * Shared memory lock must be held. */
+static const int* sort_by_availability(pid_t pid, priority_t priority,
+        const int *cpus_priority_array, int *sorted_array) {
+    int i, cpuid;
+    bool any_expected = false;
+    for (cpuid=0; cpuid<node_size && !any_expected; ++cpuid) {
+        const cpuinfo_t *cpuinfo = &shdata->node_info[cpuid];
+        any_expected = cpuinfo->owner != pid && cpuinfo->state == CPU_LENT
+            && cpuinfo->guest == NOBODY && cpuinfo->expected_return != 0;
+    }
+    if (!any_expected) return cpus_priority_array;
+
+    cpu_set_t nearby;
+    CPU_ZERO(&nearby);
+    if (priority == PRIO_NEARBY_FIRST) {
+        cpu_set_t owned;
+        CPU_ZERO(&owned);
+        for (cpuid=0; cpuid<node_size; ++cpuid) {
+            if (shdata->node_info[cpuid].owner == pid) {
+                CPU_SET(cpuid, &owned);
+            }
+        }
+        mu_get_parents_covering_cpuset(&nearby, &owned);
+    }
+
+    int64_t now = get_time_in_ns();
+    borrow_candidate_t candidates[node_size];
+    int ncandidates = 0;
+    for (i=0; i<node_size; ++i) {
+        cpuid = cpus_priority_array[i];
+        if (cpuid == -1) break;
+        const cpuinfo_t *cpuinfo = &shdata->node_info[cpuid];
+        borrow_candidate_t *candidate = &candidates[ncandidates++];
+        candidate->cpuid = cpuid;
+        candidate->position = i;
+        if (cpuinfo->owner == pid) {
+            candidate->tier = 0;
+            candidate->availability = 0;
+        } else {
+            candidate->tier = priority == PRIO_NEARBY_FIRST
+                && !CPU_ISSET(cpuid, &nearby) ? 2 : 1;
+            if (cpuinfo->state != CPU_LENT || cpuinfo->guest != NOBODY) {
+                candidate->availability = AVAILABILITY_NONE;
+            } else if (cpuinfo->expected_return == 0) {
+                candidate->availability = AVAILABILITY_UNKNOWN;
+            } else if (cpuinfo->expected_return > now) {
+                candidate->availability = cpuinfo->expected_return - now;
+            } else {
+                candidate->availability = AVAILABILITY_OVERDUE;
+            }
+        }
+    }
+    qsort(candidates, ncandidates, sizeof(borrow_candidate_t), cmp_borrow_candidates);
+
+    for (i=0; i<ncandidates; ++i) {
+        sorted_array[i] = candidates[i].cpuid;
+    }
+    for (; i<node_size; ++i) {
+        sorted_array[i] = -1;
+    }
+    return sorted_array;
+}
+
 int shmem_cpuinfo__borrow_all(pid_t pid, priority_t priority, int *cpus_priority_array,
         int64_t *last_borrow, pid_t new_guests[]) {
     /* Optimization: check first that last borrow is older than last CPU lent */
@@ -1013,9 +1127,13 @@ int shmem_cpuinfo__borrow_cpus(pid_t pid, priority_t priority, int *cpus_priorit
     int error = DLB_NOUPDT;
     shmem_lock(shm_handler);
     {
-        /* Borrow CPUs following the priority of cpus_priority_array, */
+        /* Borrow CPUs following the priority of cpus_priority_array,
+         * and their expected availability, if known */
+        int sorted_array[node_size];
+        const int *cpus_array = sort_by_availability(pid, priority, cpus_priority_array,
+                sorted_array);
         for (i=0; ncpus>0 && i<node_size; ++i) {
-            int cpuid = cpus_priority_array[i];
+            int cpuid = cpus_array[i];
             if (cpuid == -1) break;
             if (borrow_cpu(pid, cpuid, &new_guests[cpuid]) == DLB_SUCCESS) {
                 --ncpus;
@@ -1186,6 +1304,27 @@ int shmem_cpuinfo__reset(pid_t pid, pid_t new_guests[], pid_t victims[]) {
     return error;
 }
 
+/* Set the expected duration of the next lends of the CPUs owned by pid. It is
+ * used by the borrowers to prefer the CPUs that will remain available for
+ * longer. A duration of 0 means unknown */
+int shmem_cpuinfo__set_lend_duration(pid_t pid, int64_t duration) {
+    if (shm_handler == NULL) return DLB_ERR_NOSHMEM;
+    if (duration < 0) return DLB_ERR_PERM;
+
+    shmem_lock(shm_handler);
+    {
+        int cpuid;
+        for (cpuid=0; cpuid<node_size; ++cpuid) {
+            cpuinfo_t *cpuinfo = &shdata->node_info[cpuid];
+            if (cpuinfo->owner == pid) {
+                cpuinfo->lend_duration = duration;
+            }
+        }
+    }
+    shmem_unlock(shm_handler);
+    return DLB_SUCCESS;
+}
+
 /* Update CPU ownership according to the new process mask.
  * To avoid collisions, we only release the ownership if we still own it
  */
@@ -1210,6 +1349,8 @@ void shmem_cpuinfo__update_ownership(pid_t pid, const cpu_set_t *process_mask) {
             if (cpuinfo->owner != pid) {
                 // Steal CPU
                 cpuinfo->owner = pid;
+                cpuinfo->lend_duration = 0;
+                cpuinfo->expected_return = 0;
                 verbose(VB_SHMEM, "Acquiring ownership of CPU %d", cpuid);
             }
             if (cpuinfo->guest == NOBODY) {
@@ -1228,6 +1369,8 @@ void shmem_cpuinfo__update_ownership(pid_t pid, const cpu_set_t *process_mask) {
                 cpuinfo->dirty = false;
                 cpuinfo->owner = NOBODY;
                 cpuinfo->state = CPU_DISABLED;
+                cpuinfo->lend_duration = 0;
+                cpuinfo->expected_return = 0;
                 if (cpuinfo->guest == pid ) {
                     cpuinfo->guest = NOBODY;
                 }
@@ -1340,6 +1483,25 @@ int shmem_cpuinfo__check_cpu_availability(pid_t pid, int cpuid) {
     return error;
 }
 
+/* Mask of the CPUs currently used by the process, either owned or borrowed */
+int shmem_cpuinfo__get_guested_cpus(pid_t pid, cpu_set_t *mask) {
+    if (shm_handler == NULL) return DLB_ERR_NOSHMEM;
+
+    CPU_ZERO(mask);
+    shmem_lock(shm_handler);
+    {
+        int cpuid;
+        for (cpuid=0; cpuid<node_size; ++cpuid) {
+            if (shdata->node_info[cpuid].guest == pid) {
+                CPU_SET(cpuid, mask);
+            }
+        }
+    }
+    shmem_unlock(shm_handler);
+
+    return DLB_SUCCESS;
+}
+
 bool shmem_cpuinfo__exists(void) {
     return shm_handler != NULL;
 }
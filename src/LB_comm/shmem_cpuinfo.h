@@ -70,9 +70,11 @@ int shmem_cpuinfo__return_cpu_mask(pid_t pid, const cpu_set_t *mask, pid_t new_g
 
 /* Others */
 int shmem_cpuinfo__reset(pid_t pid, pid_t new_guests[], pid_t victims[]);
+int shmem_cpuinfo__set_lend_duration(pid_t pid, int64_t duration);
 void shmem_cpuinfo__update_ownership(pid_t pid, const cpu_set_t *process_mask);
 int shmem_cpuinfo__get_thread_binding(pid_t pid, int thread_num);
 int shmem_cpuinfo__check_cpu_availability(pid_t pid, int cpu);
+int shmem_cpuinfo__get_guested_cpus(pid_t pid, cpu_set_t *mask);
 bool shmem_cpuinfo__exists(void);
 bool shmem_cpuinfo__is_dirty(void);
 void shmem_cpuinfo__enable_request_queues(void);
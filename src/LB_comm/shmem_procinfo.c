@@ -20,6 +20,7 @@
 #include "LB_comm/shmem_procinfo.h"
 
 #include "LB_comm/shmem.h"
+#include "LB_comm/shmem_async.h"
 #include "LB_numThreads/numThreads.h"
 #include "apis/dlb_errors.h"
 #include "support/debug.h"
@@ -52,6 +53,16 @@ typedef struct {
     // Cpu Usage fields:
     double cpu_usage;
     double cpu_avg_usage;
+    // Efficiency fields:
+    double useful_fraction;
+    double mpi_fraction;
+    double dlb_fraction;
+    double ipc;
+    // Iteration fields:
+    int iter_period;            // blocking calls per iteration, 0 if unknown
+    double iter_time;           // seconds of the last iteration
+    // Balance fields:
+    process_balance_t balance;  // load measured over the last window of iterations
 #ifdef DLB_LOAD_AVERAGE
     // Load average fields:
     float load[3];              // 1min, 5min, 15mins
@@ -66,7 +77,7 @@ typedef struct {
     pinfo_t process_info[0];
 } shdata_t;
 
-enum { SHMEM_PROCINFO_VERSION = 1 };
+enum { SHMEM_PROCINFO_VERSION = 4 };
 
 static shmem_handler_t *shm_handler = NULL;
 static shdata_t *shdata = NULL;
@@ -81,6 +92,7 @@ static int subprocesses_attached = 0;
 static int  set_new_mask(pinfo_t *process, const cpu_set_t *mask, bool dry_run);
 static bool steal_cpu(pinfo_t* new_owner, pinfo_t *victim, int cpu, bool dry_run);
 static int  steal_mask(pinfo_t *new_owner, const cpu_set_t *mask, bool dry_run);
+static void notify_dirty_processes(void);
 
 
 static pinfo_t* get_process(pid_t pid) {
@@ -182,6 +194,10 @@ int shmem_procinfo__init(pid_t pid, const cpu_set_t *process_mask, cpu_set_t *ne
                 process->returncode = 0;
                 memcpy(&process->current_process_mask, process_mask, sizeof(cpu_set_t));
                 memcpy(&process->future_process_mask, process_mask, sizeof(cpu_set_t));
+                process->ipc = -1.0;
+                process->iter_period = 0;
+                process->iter_time = 0.0;
+                memset(&process->balance, 0, sizeof(process_balance_t));
 
 #ifdef DLB_LOAD_AVERAGE
                 process->load[0] = 0.0f;
@@ -242,6 +258,10 @@ int shmem_procinfo_ext__preinit(pid_t pid, const cpu_set_t *mask, int steal) {
                 process->returncode = 0;
                 CPU_ZERO(&process->current_process_mask);
                 CPU_ZERO(&process->future_process_mask);
+                process->ipc = -1.0;
+                process->iter_period = 0;
+                process->iter_time = 0.0;
+                memset(&process->balance, 0, sizeof(process_balance_t));
 
                 // Register process mask into the system
                 if (!steal) {
@@ -277,6 +297,7 @@ int shmem_procinfo_ext__preinit(pid_t pid, const cpu_set_t *mask, int steal) {
         }
     }
     shmem_unlock(shm_handler);
+    if (!error && steal) notify_dirty_processes();
     return error;
 }
 
@@ -365,6 +386,13 @@ int shmem_procinfo__finalize(pid_t pid, bool return_stolen) {
                 process->active_cpus = 0;
                 process->cpu_usage = 0.0;
                 process->cpu_avg_usage = 0.0;
+                process->useful_fraction = 0.0;
+                process->mpi_fraction = 0.0;
+                process->dlb_fraction = 0.0;
+                process->ipc = -1.0;
+                process->iter_period = 0;
+                process->iter_time = 0.0;
+                memset(&process->balance, 0, sizeof(process_balance_t));
 #ifdef DLB_LOAD_AVERAGE
                 process->load[3] = {0.0f, 0.0f, 0.0f};
                 process->last_ltime = {0};
@@ -446,6 +474,13 @@ int shmem_procinfo_ext__postfinalize(pid_t pid, bool return_stolen) {
             process->active_cpus = 0;
             process->cpu_usage = 0.0;
             process->cpu_avg_usage = 0.0;
+            process->useful_fraction = 0.0;
+            process->mpi_fraction = 0.0;
+            process->dlb_fraction = 0.0;
+            process->ipc = -1.0;
+            process->iter_period = 0;
+            process->iter_time = 0.0;
+            memset(&process->balance, 0, sizeof(process_balance_t));
 #ifdef DLB_LOAD_AVERAGE
             process->load[3] = {0.0f, 0.0f, 0.0f};
             process->last_ltime = {0};
@@ -477,6 +512,7 @@ int shmem_procinfo_ext__recover_stolen_cpus(int pid) {
         }
     }
     shmem_unlock(shm_handler);
+    if (!error) notify_dirty_processes();
     return error;
 }
 
@@ -576,6 +612,9 @@ int shmem_procinfo__setprocessmask(pid_t pid, const cpu_set_t *mask, dlb_drom_fl
     }
     shmem_unlock(shm_handler);
 
+    // Processes in asynchronous mode can apply the new mask immediately
+    if (!error) notify_dirty_processes();
+
     // Polling until dirty is cleared, and get returncode
     if (!error && flags & DLB_SYNC_QUERY) {
         int64_t elapsed;
@@ -616,6 +655,158 @@ int shmem_procinfo__setprocessmask(pid_t pid, const cpu_set_t *mask, dlb_drom_fl
     return error;
 }
 
+int shmem_procinfo__setprocessmasks(const pid_t *pids, const cpu_set_t *masks, int n,
+        dlb_drom_flags_t flags) {
+    if (shm_handler == NULL) return DLB_ERR_NOSHMEM;
+    if (n <= 0) return DLB_SUCCESS;
+
+    int error = DLB_SUCCESS;
+    int i, j, p;
+    pinfo_t *processes[n];
+    shmem_lock(shm_handler);
+    {
+        // Validate the whole partition before modifying anything
+        cpu_set_t requested;        // union of all the requested masks
+        cpu_set_t released;         // CPUs currently owned by the target processes
+        CPU_ZERO(&requested);
+        CPU_ZERO(&released);
+        for (i = 0; i < n && !error; ++i) {
+            processes[i] = get_process(pids[i]);
+            if (processes[i] == NULL) {
+                verbose(VB_DROM, "Setting masks: cannot find process with pid %d", pids[i]);
+                error = DLB_ERR_NOPROC;
+            } else if (processes[i]->dirty) {
+                verbose(VB_DROM, "Setting masks: process %d is already dirty", pids[i]);
+                error = DLB_ERR_PDIRTY;
+            } else if (CPU_COUNT(&masks[i]) == 0) {
+                verbose(VB_DROM, "Setting masks: process %d cannot have an empty mask", pids[i]);
+                error = DLB_ERR_PERM;
+            } else {
+                for (j = 0; j < i; ++j) {
+                    if (processes[j] == processes[i]) {
+                        verbose(VB_DROM, "Setting masks: process %d is repeated", pids[i]);
+                        error = DLB_ERR_PERM;
+                        break;
+                    }
+                }
+                cpu_set_t overlap;
+                CPU_AND(&overlap, &requested, &masks[i]);
+                if (!error && CPU_COUNT(&overlap) > 0) {
+                    verbose(VB_DROM, "Setting masks: CPUs %s requested by more than one process",
+                            mu_to_str(&overlap));
+                    error = DLB_ERR_PERM;
+                }
+                CPU_OR(&requested, &requested, &masks[i]);
+                CPU_OR(&released, &released, &processes[i]->future_process_mask);
+            }
+        }
+
+        // CPUs neither free nor owned by the targets must be stolen from other processes,
+        // none of which may be left without CPUs
+        cpu_set_t available;
+        CPU_OR(&available, &shdata->free_mask, &released);
+        for (p = 0; p < max_processes && !error; ++p) {
+            pinfo_t *victim = &shdata->process_info[p];
+            if (victim->pid == NOBODY) continue;
+            for (i = 0; i < n && processes[i] != victim; ++i);
+            if (i < n) continue;
+
+            cpu_set_t remaining;
+            mu_substract(&remaining, &victim->future_process_mask, &requested);
+            if (!CPU_EQUAL(&remaining, &victim->future_process_mask)
+                    && CPU_COUNT(&remaining) == 0) {
+                verbose(VB_DROM, "Setting masks: process %d would be left without CPUs",
+                        victim->pid);
+                error = DLB_ERR_PERM;
+            }
+            CPU_OR(&available, &available, &victim->future_process_mask);
+        }
+        if (!error && !mu_is_subset(&requested, &available)) {
+            verbose(VB_DROM, "Setting masks: some CPUs in %s are not available",
+                    mu_to_str(&requested));
+            error = DLB_ERR_PERM;
+        }
+
+        if (!error) {
+            // The plan is valid, apply it with mask operations only: victims lose the
+            // requested CPUs, targets get their new masks, and the CPUs released by the
+            // targets and not requested by anyone become free
+            for (p = 0; p < max_processes; ++p) {
+                pinfo_t *victim = &shdata->process_info[p];
+                if (victim->pid == NOBODY) continue;
+                for (i = 0; i < n && processes[i] != victim; ++i);
+                if (i < n) continue;
+
+                cpu_set_t stolen;
+                CPU_AND(&stolen, &victim->future_process_mask, &requested);
+                if (CPU_COUNT(&stolen) > 0) {
+                    CPU_OR(&victim->stolen_cpus, &victim->stolen_cpus, &stolen);
+                    mu_substract(&victim->future_process_mask,
+                            &victim->future_process_mask, &stolen);
+                    victim->dirty = true;
+                    verbose(VB_DROM, "CPUs %s have been removed from process %d",
+                            mu_to_str(&stolen), victim->pid);
+                }
+            }
+            for (i = 0; i < n; ++i) {
+                verbose(VB_DROM, "Process %d registering mask %s",
+                        processes[i]->pid, mu_to_str(&masks[i]));
+                memcpy(&processes[i]->future_process_mask, &masks[i], sizeof(cpu_set_t));
+                processes[i]->dirty = true;
+            }
+            CPU_OR(&shdata->free_mask, &shdata->free_mask, &released);
+            mu_substract(&shdata->free_mask, &shdata->free_mask, &requested);
+        }
+    }
+    shmem_unlock(shm_handler);
+
+    // Processes in asynchronous mode can apply the new masks immediately
+    if (!error) notify_dirty_processes();
+
+    // Polling until all the target processes have cleared their dirty flag
+    if (!error && flags & DLB_SYNC_QUERY) {
+        int64_t elapsed;
+        struct timespec start, now;
+        get_time_coarse(&start);
+        while(true) {
+
+            // Delay
+            usleep(SYNC_POLL_DELAY);
+
+            // Polling
+            bool done = true;
+            shmem_lock(shm_handler);
+            {
+                for (i = 0; i < n; ++i) {
+                    if (processes[i]->dirty) {
+                        done = false;
+                        break;
+                    }
+                }
+                if (done) {
+                    for (i = 0; i < n && !error; ++i) {
+                        error = processes[i]->returncode;
+                    }
+                }
+            }
+            shmem_unlock(shm_handler);
+
+            // Break if done
+            if (done) break;
+
+            // Break if timeout
+            get_time_coarse(&now);
+            elapsed = timespec_diff(&start, &now);
+            if (elapsed > SYNC_POLL_TIMEOUT) {
+                error = DLB_ERR_TIMEOUT;
+                break;
+            }
+        }
+    }
+
+    return error;
+}
+
 
 /*********************************************************************************/
 /* Generic Getters                                                               */
@@ -813,6 +1004,146 @@ void shmem_procinfo__getactivecpus_list(pid_t *cpuslist, int *nelems, int max_le
     shmem_unlock(shm_handler);
 }
 
+int shmem_procinfo__gettimefractions(pid_t pid, double *useful, double *mpi, double *dlb) {
+    if (shm_handler == NULL) return DLB_ERR_NOSHMEM;
+
+    int error = DLB_ERR_NOPROC;
+    shmem_lock(shm_handler);
+    {
+        pinfo_t *process = get_process(pid);
+        if (process) {
+            if (useful) *useful = process->useful_fraction;
+            if (mpi) *mpi = process->mpi_fraction;
+            if (dlb) *dlb = process->dlb_fraction;
+            error = DLB_SUCCESS;
+        }
+    }
+    shmem_unlock(shm_handler);
+    return error;
+}
+
+void shmem_procinfo__getusefulfraction_list(double *usefullist, int *nelems, int max_len) {
+    *nelems = 0;
+    if (shm_handler == NULL) return;
+    shmem_lock(shm_handler);
+    {
+        int p;
+        for (p = 0; p < max_processes; p++) {
+            if (shdata->process_info[p].pid != NOBODY) {
+                usefullist[(*nelems)++] = shdata->process_info[p].useful_fraction;
+            }
+            if (*nelems == max_len) {
+                break;
+            }
+        }
+    }
+    shmem_unlock(shm_handler);
+}
+
+int shmem_procinfo__getipc(pid_t pid, double *ipc) {
+    if (shm_handler == NULL) return DLB_ERR_NOSHMEM;
+
+    int error = DLB_ERR_NOPROC;
+    shmem_lock(shm_handler);
+    {
+        pinfo_t *process = get_process(pid);
+        if (process) {
+            *ipc = process->ipc;
+            error = DLB_SUCCESS;
+        }
+    }
+    shmem_unlock(shm_handler);
+    return error;
+}
+
+int shmem_procinfo__setstats(pid_t pid, const process_stats_t *stats) {
+    if (shm_handler == NULL) return DLB_ERR_NOSHMEM;
+
+    int error = DLB_ERR_NOPROC;
+    shmem_lock(shm_handler);
+    {
+        pinfo_t *process = get_process(pid);
+        if (process) {
+            process->active_cpus = CPU_COUNT(&process->current_process_mask);
+            process->cpu_usage = stats->cpu_usage;
+            process->cpu_avg_usage = stats->cpu_avg_usage;
+            process->useful_fraction = stats->useful_fraction;
+            process->mpi_fraction = stats->mpi_fraction;
+            process->dlb_fraction = stats->dlb_fraction;
+            process->ipc = stats->ipc;
+            error = DLB_SUCCESS;
+        }
+    }
+    shmem_unlock(shm_handler);
+    return error;
+}
+
+int shmem_procinfo__setiterinfo(pid_t pid, int period, double iter_time) {
+    if (shm_handler == NULL) return DLB_ERR_NOSHMEM;
+
+    int error = DLB_ERR_NOPROC;
+    shmem_lock(shm_handler);
+    {
+        pinfo_t *process = get_process(pid);
+        if (process) {
+            process->iter_period = period;
+            process->iter_time = iter_time;
+            error = DLB_SUCCESS;
+        }
+    }
+    shmem_unlock(shm_handler);
+    return error;
+}
+
+int shmem_procinfo__getiterinfo(pid_t pid, int *period, double *iter_time) {
+    if (shm_handler == NULL) return DLB_ERR_NOSHMEM;
+
+    int error = DLB_ERR_NOPROC;
+    shmem_lock(shm_handler);
+    {
+        pinfo_t *process = get_process(pid);
+        if (process) {
+            *period = process->iter_period;
+            *iter_time = process->iter_time;
+            error = DLB_SUCCESS;
+        }
+    }
+    shmem_unlock(shm_handler);
+    return error;
+}
+
+int shmem_procinfo__setbalance(pid_t pid, const process_balance_t *balance) {
+    if (shm_handler == NULL) return DLB_ERR_NOSHMEM;
+
+    int error = DLB_ERR_NOPROC;
+    shmem_lock(shm_handler);
+    {
+        pinfo_t *process = get_process(pid);
+        if (process) {
+            memcpy(&process->balance, balance, sizeof(process_balance_t));
+            error = DLB_SUCCESS;
+        }
+    }
+    shmem_unlock(shm_handler);
+    return error;
+}
+
+int shmem_procinfo__getbalance(pid_t pid, process_balance_t *balance) {
+    if (shm_handler == NULL) return DLB_ERR_NOSHMEM;
+
+    int error = DLB_ERR_NOPROC;
+    shmem_lock(shm_handler);
+    {
+        pinfo_t *process = get_process(pid);
+        if (process) {
+            memcpy(balance, &process->balance, sizeof(process_balance_t));
+            error = DLB_SUCCESS;
+        }
+    }
+    shmem_unlock(shm_handler);
+    return error;
+}
+
 int shmem_procinfo__getloadavg(pid_t pid, double *load) {
     if (shm_handler == NULL) return DLB_ERR_NOSHMEM;
     int error = DLB_ERR_UNKNOWN;
@@ -929,6 +1260,33 @@ bool shmem_procinfo__exists(void) {
 }
 
 
+// Send the future mask of every dirty process to its asynchronous helper, if any.
+// Unlike the functions below, the shm lock must not be acquired beforehand
+static void notify_dirty_processes(void) {
+    pid_t pidlist[max_processes];
+    cpu_set_t masks[max_processes];
+    int nelems = 0;
+    shmem_lock(shm_handler);
+    {
+        int p;
+        for (p = 0; p < max_processes; p++) {
+            pinfo_t *process = &shdata->process_info[p];
+            if (process->pid != NOBODY && process->dirty) {
+                pidlist[nelems] = process->pid;
+                memcpy(&masks[nelems], &process->future_process_mask, sizeof(cpu_set_t));
+                ++nelems;
+            }
+        }
+    }
+    shmem_unlock(shm_handler);
+
+    int i;
+    for (i = 0; i < nelems; ++i) {
+        shmem_async_set_mask(pidlist[i], &masks[i]);
+    }
+}
+
+
 /*** Helper functions, the shm lock must have been acquired beforehand ***/
 
 
@@ -26,6 +26,22 @@
 #include <stdbool.h>
 #include <sched.h>
 
+typedef struct ProcessStats {
+    double cpu_usage;           // CPU usage since the last update (%)
+    double cpu_avg_usage;       // CPU usage since the initialization (%)
+    double useful_fraction;     // Fraction of time outside MPI and DLB
+    double mpi_fraction;        // Fraction of time inside MPI
+    double dlb_fraction;        // Fraction of time inside DLB
+    double ipc;                 // Instructions per cycle, or -1.0 if not available
+} process_stats_t;
+
+typedef struct ProcessBalance {
+    unsigned int window;        // number of measurement windows completed, 0 if none
+    int ncpus;                  // CPUs owned by the process during the window
+    double work;                // CPU time per iteration outside blocking calls (s)
+    double blocked_fraction;    // fraction of the iteration time inside blocking calls
+} process_balance_t;
+
 /* Init / Register */
 int shmem_procinfo__init(pid_t pid, const cpu_set_t *process_mask, cpu_set_t *new_process_mask,
         const char *shmem_key);
@@ -40,6 +56,8 @@ int shmem_procinfo_ext__recover_stolen_cpus(int pid);
 
 int shmem_procinfo__getprocessmask(pid_t pid, cpu_set_t *mask, dlb_drom_flags_t flags);
 int shmem_procinfo__setprocessmask(pid_t pid, const cpu_set_t *mask, dlb_drom_flags_t flags);
+int shmem_procinfo__setprocessmasks(const pid_t *pids, const cpu_set_t *masks, int n,
+        dlb_drom_flags_t flags);
 
 /* Generic Getters */
 int shmem_procinfo__polldrom(pid_t pid, int *new_cpus, cpu_set_t *new_mask);
@@ -55,6 +73,14 @@ double  shmem_procinfo__getnodeavgusage(void);
 int     shmem_procinfo__getactivecpus(pid_t pid);
 void    shmem_procinfo__getactivecpus_list(pid_t *cpuslist, int *nelems, int max_len);
 int     shmem_procinfo__getloadavg(pid_t pid, double *load);
+int     shmem_procinfo__gettimefractions(pid_t pid, double *useful, double *mpi, double *dlb);
+void    shmem_procinfo__getusefulfraction_list(double *usefullist, int *nelems, int max_len);
+int     shmem_procinfo__getipc(pid_t pid, double *ipc);
+int     shmem_procinfo__setstats(pid_t pid, const process_stats_t *stats);
+int     shmem_procinfo__setiterinfo(pid_t pid, int period, double iter_time);
+int     shmem_procinfo__getiterinfo(pid_t pid, int *period, double *iter_time);
+int     shmem_procinfo__setbalance(pid_t pid, const process_balance_t *balance);
+int     shmem_procinfo__getbalance(pid_t pid, process_balance_t *balance);
 
 /* Misc */
 void shmem_procinfo__print_info(const char *shmem_key);
@@ -24,6 +24,8 @@
 #include "LB_core/DLB_kernel.h"
 
 #include "LB_core/spd.h"
+#include "LB_core/efficiency.h"
+#include "LB_core/policy_plugin.h"
 #include "LB_numThreads/numThreads.h"
 #include "LB_comm/shmem_async.h"
 #include "LB_comm/shmem_barrier.h"
@@ -31,7 +33,9 @@
 #include "LB_comm/shmem_procinfo.h"
 #include "apis/dlb_errors.h"
 #include "apis/DLB_interface.h"
+#include "support/cgroup.h"
 #include "support/debug.h"
+#include "support/error.h"
 #include "support/mytime.h"
 #include "support/tracing.h"
 #include "support/options.h"
@@ -39,6 +43,16 @@
 
 #include <sched.h>
 #include <string.h>
+#include <unistd.h>
+
+
+static const char plugin_prefix[] = "plugin:";
+
+/* Policies that manage CPUs through the cpuinfo shared memory */
+static inline bool policy_uses_cpuinfo(const subprocess_descriptor_t *spd) {
+    return spd->lb_descriptor != NULL
+        && spd->lb_descriptor->flags & DLB_POLICY_USES_CPUINFO;
+}
 
 
 /* Status */
@@ -53,14 +67,40 @@ int Initialize(subprocess_descriptor_t *spd, pid_t id, int ncpus,
     init_tracing(&spd->options);
     add_event(RUNTIME_EVENT, EVENT_INIT);
 
-    // Infer LeWI mode
+    // Infer LeWI mode, unless the policy is set explicitly
     spd->lb_policy = !spd->options.lewi ? POLICY_NONE :
         !mask ? POLICY_LEWI :
         POLICY_LEWI_MASK;
+    spd->lb_descriptor = NULL;
+    spd->plugin_handle = NULL;
+    if (spd->options.lewi && strncmp(spd->options.lewi_policy, plugin_prefix,
+                sizeof(plugin_prefix)-1) == 0) {
+        const char *path = spd->options.lewi_policy + sizeof(plugin_prefix)-1;
+        error = policy_plugin_load(path, &spd->lb_descriptor, &spd->plugin_handle);
+        if (error == DLB_SUCCESS) {
+            spd->lb_policy = POLICY_PLUGIN;
+        } else {
+            warning("Cannot load policy plugin %s: %s, using %s", path,
+                    error_get_str(error), policy_tostr(spd->lb_policy));
+            error = DLB_SUCCESS;
+        }
+    } else if (spd->options.lewi && spd->options.lewi_policy[0] != '\0') {
+        policy_t policy;
+        if (parse_policy(spd->options.lewi_policy, &policy) == DLB_SUCCESS
+                && policy != POLICY_NONE) {
+            spd->lb_policy = policy;
+        } else {
+            warning("Unknown LeWI policy %s, using %s", spd->options.lewi_policy,
+                    policy_tostr(spd->lb_policy));
+        }
+    }
 
     // Initialize the rest of the subprocess descriptor
     pm_init(&spd->pm);
-    set_lb_funcs(&spd->lb_funcs, spd->lb_policy);
+    if (spd->lb_descriptor == NULL) {
+        spd->lb_descriptor = get_policy_descriptor(spd->lb_policy);
+    }
+    set_policy_funcs(&spd->lb_funcs, spd->lb_descriptor);
     spd->id = spd->options.preinit_pid ? spd->options.preinit_pid : id;
     if (mask) {
         // Preferred case, mask is provided by the user
@@ -71,7 +111,7 @@ int Initialize(subprocess_descriptor_t *spd, pid_t id, int ncpus,
         CPU_ZERO(&spd->process_mask);
         int i;
         for (i=0; i<ncpus; ++i) CPU_SET(i, &spd->process_mask);
-    } else if (spd->lb_policy == POLICY_LEWI_MASK || spd->options.drom) {
+    } else if (policy_uses_cpuinfo(spd) || spd->options.drom) {
         // These modes require mask support, best effort querying the system
         cpu_set_t process_mask;
         sched_getaffinity(0, sizeof(cpu_set_t), &process_mask);
@@ -81,7 +121,24 @@ int Initialize(subprocess_descriptor_t *spd, pid_t id, int ncpus,
     // Initialize modules
     debug_init(&spd->options);
     timer_init();
-    if (spd->lb_policy == POLICY_LEWI_MASK || spd->options.drom || spd->options.statistics) {
+    bool cgroup_sync = spd->options.drom && spd->options.drom_cgroup[0] != '\0';
+    if (cgroup_sync) {
+        // The initial process mask must be contained in the cgroup cpuset
+        cpu_set_t cgroup_mask;
+        if (cgroup_init(&spd->cgroup, spd->options.drom_cgroup, getpid(),
+                    &cgroup_mask) == DLB_SUCCESS) {
+            cpu_set_t allowed_mask;
+            CPU_AND(&allowed_mask, &spd->process_mask, &cgroup_mask);
+            if (CPU_COUNT(&allowed_mask) > 0
+                    && !CPU_EQUAL(&allowed_mask, &spd->process_mask)) {
+                warning("Process mask restricted to the cgroup cpuset: %s",
+                        mu_to_str(&allowed_mask));
+                memcpy(&spd->process_mask, &allowed_mask, sizeof(cpu_set_t));
+                set_process_mask(&spd->pm, &allowed_mask);
+            }
+        }
+    }
+    if (policy_uses_cpuinfo(spd) || spd->options.drom || spd->options.statistics) {
         // If the process has been pre-initialized, the process mask may have changed
         // procinfo_init must return a new_mask if so
         cpu_set_t new_process_mask;
@@ -103,11 +160,17 @@ int Initialize(subprocess_descriptor_t *spd, pid_t id, int ncpus,
         error = shmem_cpuinfo__init(spd->id, &spd->process_mask, spd->options.shm_key);
         if (error != DLB_SUCCESS) return error;
     }
+    if (spd->options.statistics) {
+        efficiency_init(spd->id);
+    }
+    if (cgroup_sync) {
+        cgroup_set_mask(&spd->cgroup, &spd->process_mask);
+    }
     if (spd->options.barrier) {
-        shmem_barrier_init(spd->options.shm_key);
+        shmem_barrier_init(&spd->process_mask, &spd->options);
     }
     if (spd->options.mode == MODE_ASYNC) {
-        error = shmem_async_init(spd->id, &spd->pm, &spd->process_mask, spd->options.shm_key);
+        error = shmem_async_init(spd, spd->options.shm_key);
         if (error != DLB_SUCCESS) return error;
     }
 
@@ -122,7 +185,7 @@ int Initialize(subprocess_descriptor_t *spd, pid_t id, int ncpus,
     // Print initialization summary
     info0("%s %s", PACKAGE, VERSION);
     if (spd->lb_policy != POLICY_NONE) {
-        info0("Balancing policy: %s", policy_tostr(spd->lb_policy));
+        info0("Balancing policy: %s", spd->lb_descriptor->name);
     }
     verbose(VB_API, "Enabled verbose mode for DLB API");
     verbose(VB_MPI_API, "Enabled verbose mode for MPI API");
@@ -152,10 +215,23 @@ int Finish(subprocess_descriptor_t *spd) {
     if (spd->options.barrier) {
         shmem_barrier_finalize();
     }
-    if (spd->lb_policy == POLICY_LEWI_MASK || spd->options.drom || spd->options.statistics) {
+    if (spd->options.statistics) {
+        efficiency_finalize();
+    }
+    if (policy_uses_cpuinfo(spd) || spd->options.drom || spd->options.statistics) {
         shmem_cpuinfo__finalize(spd->id);
         shmem_procinfo__finalize(spd->id, spd->options.debug_opts & DBG_RETURNSTOLEN);
     }
+    if (spd->options.drom && spd->options.drom_cgroup[0] != '\0') {
+        cgroup_finalize(&spd->cgroup, getpid());
+    }
+    if (spd->plugin_handle != NULL) {
+        // Do not keep any reference to the plugin code
+        set_policy_funcs(&spd->lb_funcs, NULL);
+        spd->lb_descriptor = NULL;
+        policy_plugin_unload(spd->plugin_handle);
+        spd->plugin_handle = NULL;
+    }
     timer_finalize();
     add_event(RUNTIME_EVENT, EVENT_USER);
     return error;
@@ -192,6 +268,7 @@ int set_max_parallelism(subprocess_descriptor_t *spd, int max) {
 
 void IntoCommunication(void) {
     const subprocess_descriptor_t *spd = get_global_spd();
+    efficiency_into_mpi();
     if (spd->dlb_enabled) {
         spd->lb_funcs.into_communication(spd);
     }
@@ -202,18 +279,19 @@ void OutOfCommunication(void) {
     if (spd->dlb_enabled) {
         spd->lb_funcs.out_of_communication(spd);
     }
+    efficiency_out_of_mpi();
 }
 
 void IntoBlockingCall(int is_iter, int blocking_mode) {
     const subprocess_descriptor_t *spd = get_global_spd();
-    if (spd->dlb_enabled) {
+    if (spd && spd->dlb_enabled) {
         spd->lb_funcs.into_blocking_call(spd);
     }
 }
 
 void OutOfBlockingCall(int is_iter) {
     const subprocess_descriptor_t *spd = get_global_spd();
-    if (spd->dlb_enabled) {
+    if (spd && spd->dlb_enabled) {
         spd->lb_funcs.out_of_blocking_call(spd, is_iter);
     }
 }
@@ -227,7 +305,9 @@ int lend(const subprocess_descriptor_t *spd) {
         error = DLB_ERR_DISBLD;
     } else {
         add_event(RUNTIME_EVENT, EVENT_LEND);
+        efficiency_into_dlb();
         error = spd->lb_funcs.lend(spd);
+        efficiency_out_of_dlb();
         add_event(RUNTIME_EVENT, EVENT_USER);
     }
     return error;
@@ -239,7 +319,9 @@ int lend_cpu(const subprocess_descriptor_t *spd, int cpuid) {
         error = DLB_ERR_DISBLD;
     } else {
         add_event(RUNTIME_EVENT, EVENT_LEND);
+        efficiency_into_dlb();
         error = spd->lb_funcs.lend_cpu(spd, cpuid);
+        efficiency_out_of_dlb();
         add_event(RUNTIME_EVENT, EVENT_USER);
     }
     return error;
@@ -251,7 +333,9 @@ int lend_cpus(const subprocess_descriptor_t *spd, int ncpus) {
         error = DLB_ERR_DISBLD;
     } else {
         add_event(RUNTIME_EVENT, EVENT_LEND);
+        efficiency_into_dlb();
         error = spd->lb_funcs.lend_cpus(spd, ncpus);
+        efficiency_out_of_dlb();
         add_event(RUNTIME_EVENT, EVENT_USER);
     }
     return error;
@@ -263,12 +347,28 @@ int lend_cpu_mask(const subprocess_descriptor_t *spd, const cpu_set_t *mask) {
         error = DLB_ERR_DISBLD;
     } else {
         add_event(RUNTIME_EVENT, EVENT_LEND);
+        efficiency_into_dlb();
         error = spd->lb_funcs.lend_cpu_mask(spd, mask);
+        efficiency_out_of_dlb();
         add_event(RUNTIME_EVENT, EVENT_USER);
     }
     return error;
 }
 
+int set_lend_duration(const subprocess_descriptor_t *spd, int usecs) {
+    int error;
+    if (!spd->dlb_enabled) {
+        error = DLB_ERR_DISBLD;
+    } else if (!policy_uses_cpuinfo(spd)) {
+        error = DLB_ERR_NOPOL;
+    } else if (usecs < 0) {
+        error = DLB_ERR_PERM;
+    } else {
+        error = shmem_cpuinfo__set_lend_duration(spd->id, (int64_t)usecs * 1000);
+    }
+    return error;
+}
+
 
 /* Reclaim */
 
@@ -278,7 +378,9 @@ int reclaim(const subprocess_descriptor_t *spd) {
         error = DLB_ERR_DISBLD;
     } else {
         add_event(RUNTIME_EVENT, EVENT_RECLAIM);
+        efficiency_into_dlb();
         error = spd->lb_funcs.reclaim(spd);
+        efficiency_out_of_dlb();
         add_event(RUNTIME_EVENT, EVENT_USER);
     }
     return error;
@@ -290,7 +392,9 @@ int reclaim_cpu(const subprocess_descriptor_t *spd, int cpuid) {
         error = DLB_ERR_DISBLD;
     } else {
         add_event(RUNTIME_EVENT, EVENT_RECLAIM);
+        efficiency_into_dlb();
         error = spd->lb_funcs.reclaim_cpu(spd, cpuid);
+        efficiency_out_of_dlb();
         add_event(RUNTIME_EVENT, EVENT_USER);
     }
     return error;
@@ -302,7 +406,9 @@ int reclaim_cpus(const subprocess_descriptor_t *spd, int ncpus) {
         error = DLB_ERR_DISBLD;
     } else {
         add_event(RUNTIME_EVENT, EVENT_RECLAIM);
+        efficiency_into_dlb();
         error = spd->lb_funcs.reclaim_cpus(spd, ncpus);
+        efficiency_out_of_dlb();
         add_event(RUNTIME_EVENT, EVENT_USER);
     }
     return error;
@@ -314,7 +420,9 @@ int reclaim_cpu_mask(const subprocess_descriptor_t *spd, const cpu_set_t *mask)
         error = DLB_ERR_DISBLD;
     } else {
         add_event(RUNTIME_EVENT, EVENT_RECLAIM);
+        efficiency_into_dlb();
         error = spd->lb_funcs.reclaim_cpu_mask(spd, mask);
+        efficiency_out_of_dlb();
         add_event(RUNTIME_EVENT, EVENT_USER);
     }
     return error;
@@ -329,7 +437,9 @@ int acquire_cpu(const subprocess_descriptor_t *spd, int cpuid) {
         error = DLB_ERR_DISBLD;
     } else {
         add_event(RUNTIME_EVENT, EVENT_ACQUIRE);
+        efficiency_into_dlb();
         error = spd->lb_funcs.acquire_cpu(spd, cpuid);
+        efficiency_out_of_dlb();
         add_event(RUNTIME_EVENT, EVENT_USER);
     }
     return error;
@@ -341,7 +451,9 @@ int acquire_cpus(const subprocess_descriptor_t *spd, int ncpus) {
         error = DLB_ERR_DISBLD;
     } else {
         add_event(RUNTIME_EVENT, EVENT_ACQUIRE);
+        efficiency_into_dlb();
         error = spd->lb_funcs.acquire_cpus(spd, ncpus);
+        efficiency_out_of_dlb();
         add_event(RUNTIME_EVENT, EVENT_USER);
     }
     return error;
@@ -353,7 +465,9 @@ int acquire_cpu_mask(const subprocess_descriptor_t *spd, const cpu_set_t *mask)
         error = DLB_ERR_DISBLD;
     } else {
         add_event(RUNTIME_EVENT, EVENT_ACQUIRE);
+        efficiency_into_dlb();
         error = spd->lb_funcs.acquire_cpu_mask(spd, mask);
+        efficiency_out_of_dlb();
         add_event(RUNTIME_EVENT, EVENT_USER);
     }
     return error;
@@ -368,7 +482,9 @@ int borrow(const subprocess_descriptor_t *spd) {
         error = DLB_ERR_DISBLD;
     } else {
         add_event(RUNTIME_EVENT, EVENT_BORROW);
+        efficiency_into_dlb();
         error = spd->lb_funcs.borrow(spd);
+        efficiency_out_of_dlb();
         add_event(RUNTIME_EVENT, EVENT_USER);
     }
     return error;
@@ -380,7 +496,9 @@ int borrow_cpu(const subprocess_descriptor_t *spd, int cpuid) {
         error = DLB_ERR_DISBLD;
     } else {
         add_event(RUNTIME_EVENT, EVENT_BORROW);
+        efficiency_into_dlb();
         error = spd->lb_funcs.borrow_cpu(spd, cpuid);
+        efficiency_out_of_dlb();
         add_event(RUNTIME_EVENT, EVENT_USER);
     }
     return error;
@@ -392,7 +510,9 @@ int borrow_cpus(const subprocess_descriptor_t *spd, int ncpus) {
         error = DLB_ERR_DISBLD;
     } else {
         add_event(RUNTIME_EVENT, EVENT_BORROW);
+        efficiency_into_dlb();
         error = spd->lb_funcs.borrow_cpus(spd, ncpus);
+        efficiency_out_of_dlb();
         add_event(RUNTIME_EVENT, EVENT_USER);
     }
     return error;
@@ -404,7 +524,9 @@ int borrow_cpu_mask(const subprocess_descriptor_t *spd, const cpu_set_t *mask) {
         error = DLB_ERR_DISBLD;
     } else {
         add_event(RUNTIME_EVENT, EVENT_BORROW);
+        efficiency_into_dlb();
         error = spd->lb_funcs.borrow_cpu_mask(spd, mask);
+        efficiency_out_of_dlb();
         add_event(RUNTIME_EVENT, EVENT_USER);
     }
     return error;
@@ -419,7 +541,9 @@ int return_all(const subprocess_descriptor_t *spd) {
         error = DLB_ERR_DISBLD;
     } else {
         add_event(RUNTIME_EVENT, EVENT_RETURN);
+        efficiency_into_dlb();
         error = spd->lb_funcs.return_all(spd);
+        efficiency_out_of_dlb();
         add_event(RUNTIME_EVENT, EVENT_USER);
     }
     return error;
@@ -431,7 +555,9 @@ int return_cpu(const subprocess_descriptor_t *spd, int cpuid) {
         error = DLB_ERR_DISBLD;
     } else {
         add_event(RUNTIME_EVENT, EVENT_RETURN);
+        efficiency_into_dlb();
         error = spd->lb_funcs.return_cpu(spd, cpuid);
+        efficiency_out_of_dlb();
         add_event(RUNTIME_EVENT, EVENT_USER);
     }
     return error;
@@ -443,7 +569,9 @@ int return_cpu_mask(const subprocess_descriptor_t *spd, const cpu_set_t *mask) {
         error = DLB_ERR_DISBLD;
     } else {
         add_event(RUNTIME_EVENT, EVENT_RETURN);
+        efficiency_into_dlb();
         error = spd->lb_funcs.return_cpu_mask(spd, mask);
+        efficiency_out_of_dlb();
         add_event(RUNTIME_EVENT, EVENT_USER);
     }
     return error;
@@ -452,21 +580,30 @@ int return_cpu_mask(const subprocess_descriptor_t *spd, const cpu_set_t *mask) {
 
 /* Drom Responsive */
 
+int update_drom_mask(const subprocess_descriptor_t *spd, int *new_cpus, cpu_set_t *mask) {
+    int error = shmem_procinfo__polldrom(spd->id, new_cpus, mask);
+    if (error == DLB_SUCCESS) {
+        shmem_cpuinfo__update_ownership(spd->id, mask);
+        spd->lb_funcs.update_ownership_info(spd, mask);
+        if (spd->options.drom_cgroup[0] != '\0') {
+            cgroup_set_mask(&spd->cgroup, mask);
+        }
+    }
+    return error;
+}
+
 int poll_drom(const subprocess_descriptor_t *spd, int *new_cpus, cpu_set_t *new_mask) {
     int error;
     if (!spd->dlb_enabled || !spd->options.drom) {
         error = DLB_ERR_DISBLD;
     } else {
         add_event(RUNTIME_EVENT, EVENT_POLLDROM);
+        efficiency_into_dlb();
         // Use a local mask if new_mask was not provided
         cpu_set_t local_mask;
         cpu_set_t *mask = new_mask ? new_mask : &local_mask;
-
-        error = shmem_procinfo__polldrom(spd->id, new_cpus, mask);
-        if (error == DLB_SUCCESS) {
-            shmem_cpuinfo__update_ownership(spd->id, mask);
-            spd->lb_funcs.update_ownership_info(spd, mask);
-        }
+        error = update_drom_mask(spd, new_cpus, mask);
+        efficiency_out_of_dlb();
         add_event(RUNTIME_EVENT, EVENT_USER);
     }
     return error;
@@ -481,6 +618,20 @@ int poll_drom_update(const subprocess_descriptor_t *spd) {
     return error;
 }
 
+int poll_drom_async(const subprocess_descriptor_t *spd) {
+    int error;
+    if (!spd->dlb_enabled || !spd->options.drom) {
+        error = DLB_ERR_DISBLD;
+    } else {
+        cpu_set_t new_mask;
+        error = update_drom_mask(spd, NULL, &new_mask);
+        if (error == DLB_SUCCESS) {
+            set_process_mask(&spd->pm, &new_mask);
+        }
+    }
+    return error;
+}
+
 
 /* Misc */
 
@@ -494,11 +645,24 @@ int check_cpu_availability(const subprocess_descriptor_t *spd, int cpuid) {
     return error;
 }
 
-int node_barrier(void) {
+int node_barrier(const char *barrier_name) {
     add_event(RUNTIME_EVENT, EVENT_BARRIER);
-    shmem_barrier();
+    int error = shmem_barrier(barrier_name);
     add_event(RUNTIME_EVENT, 0);
-    return DLB_SUCCESS;
+    return error;
+}
+
+int node_barrier_attach(const char *barrier_name) {
+    return shmem_barrier_attach(barrier_name);
+}
+
+int node_barrier_detach(const char *barrier_name) {
+    return shmem_barrier_detach(barrier_name);
+}
+
+int node_barrier_get_stats(const char *barrier_name, int *episodes, double *avg_skew,
+        double *max_skew, double *imbalance) {
+    return shmem_barrier_get_stats(barrier_name, episodes, avg_skew, max_skew, imbalance);
 }
 
 int print_shmem(subprocess_descriptor_t *spd, int num_columns,
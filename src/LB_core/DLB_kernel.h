@@ -45,6 +45,7 @@ int lend(const subprocess_descriptor_t *spd);
 int lend_cpu(const subprocess_descriptor_t *spd, int cpuid);
 int lend_cpus(const subprocess_descriptor_t *spd, int ncpus);
 int lend_cpu_mask(const subprocess_descriptor_t *spd, const cpu_set_t *mask);
+int set_lend_duration(const subprocess_descriptor_t *spd, int usecs);
 
 /* Reclaim */
 int reclaim(const subprocess_descriptor_t *spd);
@@ -69,12 +70,22 @@ int return_cpu(const subprocess_descriptor_t *spd, int cpuid);
 int return_cpu_mask(const subprocess_descriptor_t *spd, const cpu_set_t *mask);
 
 /* DROM Responsive */
+/* Apply a pending process mask to the shared memories, the policy and the
+ * DROM cgroup. The programming model is not notified */
+int update_drom_mask(const subprocess_descriptor_t *spd, int *new_cpus, cpu_set_t *mask);
 int poll_drom(const subprocess_descriptor_t *spd, int *new_cpus, cpu_set_t *new_mask);
 int poll_drom_update(const subprocess_descriptor_t *spd);
+/* Same as poll_drom_update, called from the async helper thread. The time
+ * spent is not accounted as DLB time of the application */
+int poll_drom_async(const subprocess_descriptor_t *spd);
 
 /* Misc */
 int check_cpu_availability(const subprocess_descriptor_t *spd, int cpuid);
-int node_barrier(void);
+int node_barrier(const char *barrier_name);
+int node_barrier_attach(const char *barrier_name);
+int node_barrier_detach(const char *barrier_name);
+int node_barrier_get_stats(const char *barrier_name, int *episodes, double *avg_skew,
+        double *max_skew, double *imbalance);
 int print_shmem(subprocess_descriptor_t *spd, int num_columns,
         dlb_printshmem_flags_t print_flags);
 
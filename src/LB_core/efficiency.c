@@ -0,0 +1,287 @@
+/*********************************************************************************/
+/*  Copyright 2017 Barcelona Supercomputing Center                               */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <http://www.gnu.org/licenses/>.                 */
+/*********************************************************************************/
+
+#include "LB_core/efficiency.h"
+
+#include "LB_comm/shmem_procinfo.h"
+#include "support/debug.h"
+#include "support/mytime.h"
+
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/resource.h>
+#include <dirent.h>
+#include <errno.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+
+static const int64_t UPDATE_MIN_THRESHOLD = 100000000L;   // 10^8 ns = 100ms
+
+enum { PERF_CYCLES, PERF_INSTRUCTIONS, PERF_NUM_COUNTERS };
+
+/* Union of the intervals during which at least one thread is inside MPI, or
+ * inside DLB, so that concurrent calls are not accounted more than once */
+typedef struct TimeAccount {
+    pthread_mutex_t mutex;
+    int active;                         // threads currently inside
+    int64_t start;                      // ns, start of the current interval
+    int64_t total;                      // ns, accumulated closed intervals
+} time_account_t;
+
+static bool enabled = false;
+static pid_t process_id;
+static int64_t init_time;               // ns
+static int64_t init_cpu_time;           // ns
+static int64_t last_update_time;        // ns
+static int64_t last_cpu_time;           // ns
+static time_account_t mpi_account = { .mutex = PTHREAD_MUTEX_INITIALIZER };
+static time_account_t dlb_account = { .mutex = PTHREAD_MUTEX_INITIALIZER };
+/* One counter per thread that existed at the initialization */
+static int *perf_fds[PERF_NUM_COUNTERS] = { NULL, NULL };
+static int perf_nfds = 0;
+
+/* Nesting level of each thread, only the outermost call is accounted */
+static __thread int mpi_depth = 0;
+static __thread int dlb_depth = 0;
+
+
+/*** Hardware counters ***/
+
+/* Count the thread tid and, through inherit, the threads created by it later.
+ * Threads that already exist are not inherited, each one needs its own counter */
+static int open_perf_counter(uint64_t config, pid_t tid) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = config;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return syscall(__NR_perf_event_open, &attr, tid, -1, -1, 0);
+}
+
+static void close_perf_counters(void) {
+    int i, j;
+    for (i = 0; i < PERF_NUM_COUNTERS; ++i) {
+        for (j = 0; j < perf_nfds; ++j) {
+            if (perf_fds[i][j] != -1) close(perf_fds[i][j]);
+        }
+        free(perf_fds[i]);
+        perf_fds[i] = NULL;
+    }
+    perf_nfds = 0;
+}
+
+static void init_perf_counters(void) {
+    DIR *dir = opendir("/proc/self/task");
+    if (dir == NULL) {
+        verbose(VB_STATS, "Cannot list the process threads, IPC will not be computed");
+        return;
+    }
+
+    int max_fds = 16;
+    int i;
+    for (i = 0; i < PERF_NUM_COUNTERS; ++i) {
+        perf_fds[i] = malloc(sizeof(int)*max_fds);
+    }
+    bool available = true;
+    struct dirent *entry;
+    while (available && (entry = readdir(dir)) != NULL) {
+        pid_t tid = (pid_t)strtol(entry->d_name, NULL, 10);
+        if (tid <= 0) continue;
+        if (perf_nfds == max_fds) {
+            max_fds *= 2;
+            for (i = 0; i < PERF_NUM_COUNTERS; ++i) {
+                perf_fds[i] = realloc(perf_fds[i], sizeof(int)*max_fds);
+            }
+        }
+        int cycles_fd = open_perf_counter(PERF_COUNT_HW_CPU_CYCLES, tid);
+        int instructions_fd = open_perf_counter(PERF_COUNT_HW_INSTRUCTIONS, tid);
+        if (cycles_fd == -1 || instructions_fd == -1) {
+            // The thread may have exited since the directory was read
+            available = errno == ESRCH;
+            if (cycles_fd != -1) close(cycles_fd);
+            if (instructions_fd != -1) close(instructions_fd);
+            continue;
+        }
+        perf_fds[PERF_CYCLES][perf_nfds] = cycles_fd;
+        perf_fds[PERF_INSTRUCTIONS][perf_nfds] = instructions_fd;
+        ++perf_nfds;
+    }
+    closedir(dir);
+
+    if (!available || perf_nfds == 0) {
+        // Not permitted or not supported, IPC will not be available
+        verbose(VB_STATS, "Hardware counters not available, IPC will not be computed");
+        close_perf_counters();
+    }
+}
+
+static double read_ipc(void) {
+    if (perf_nfds == 0) return -1.0;
+
+    uint64_t cycles = 0;
+    uint64_t instructions = 0;
+    int i;
+    for (i = 0; i < perf_nfds; ++i) {
+        uint64_t task_cycles, task_instructions;
+        if (read(perf_fds[PERF_CYCLES][i], &task_cycles, sizeof(uint64_t))
+                != sizeof(uint64_t)
+                || read(perf_fds[PERF_INSTRUCTIONS][i], &task_instructions, sizeof(uint64_t))
+                != sizeof(uint64_t)) {
+            return -1.0;
+        }
+        cycles += task_cycles;
+        instructions += task_instructions;
+    }
+    if (cycles == 0) return -1.0;
+    return (double)instructions / (double)cycles;
+}
+
+/* Process CPU time, falling back to the CPU clocks if getrusage fails. The
+ * thread CPU clock is the last resort and only accounts the calling thread */
+static int64_t get_cpu_time(void) {
+    struct rusage usage;
+    struct timespec cpu_time;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        add_tv_to_ts(&usage.ru_utime, &usage.ru_stime, &cpu_time);
+    } else if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu_time) != 0
+            && clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_time) != 0) {
+        return 0;
+    }
+    return to_nsecs(&cpu_time);
+}
+
+static double fraction(int64_t part, int64_t total) {
+    if (total <= 0) return 0.0;
+    double f = (double)part / (double)total;
+    return f < 0.0 ? 0.0 : f > 1.0 ? 1.0 : f;
+}
+
+
+/*** Init / Finalize ***/
+
+void efficiency_init(pid_t pid) {
+    if (enabled) return;
+    process_id = pid;
+    init_time = get_time_in_ns();
+    last_update_time = init_time;
+    init_cpu_time = get_cpu_time();
+    last_cpu_time = init_cpu_time;
+    mpi_account.active = 0;
+    mpi_account.total = 0;
+    dlb_account.active = 0;
+    dlb_account.total = 0;
+    init_perf_counters();
+    enabled = true;
+}
+
+void efficiency_finalize(void) {
+    if (!enabled) return;
+    efficiency_update(true);
+    enabled = false;
+    close_perf_counters();
+}
+
+
+/*** Time accounting ***/
+
+static void account_enter(time_account_t *account, int *depth) {
+    if ((*depth)++ > 0) return;
+    pthread_mutex_lock(&account->mutex);
+    if (account->active++ == 0) {
+        account->start = get_time_in_ns();
+    }
+    pthread_mutex_unlock(&account->mutex);
+}
+
+static void account_exit(time_account_t *account, int *depth) {
+    if (*depth == 0 || --(*depth) > 0) return;
+    pthread_mutex_lock(&account->mutex);
+    if (account->active > 0 && --account->active == 0) {
+        account->total += get_time_in_ns() - account->start;
+    }
+    pthread_mutex_unlock(&account->mutex);
+}
+
+/* Accounted time up to now, including the interval still open */
+static int64_t account_get_time(time_account_t *account, int64_t now) {
+    pthread_mutex_lock(&account->mutex);
+    int64_t time = account->total;
+    if (account->active > 0) time += now - account->start;
+    pthread_mutex_unlock(&account->mutex);
+    return time;
+}
+
+void efficiency_into_mpi(void) {
+    if (!enabled) return;
+    account_enter(&mpi_account, &mpi_depth);
+}
+
+void efficiency_out_of_mpi(void) {
+    if (!enabled) return;
+    account_exit(&mpi_account, &mpi_depth);
+    efficiency_update(false);
+}
+
+void efficiency_into_dlb(void) {
+    if (!enabled) return;
+    account_enter(&dlb_account, &dlb_depth);
+}
+
+void efficiency_out_of_dlb(void) {
+    if (!enabled) return;
+    account_exit(&dlb_account, &dlb_depth);
+    efficiency_update(false);
+}
+
+
+/*** Publish ***/
+
+void efficiency_update(bool force) {
+    if (!enabled) return;
+
+    int64_t now = get_time_in_ns();
+    int64_t last = last_update_time;
+    if (!force && now - last < UPDATE_MIN_THRESHOLD) return;
+
+    // Only one thread at a time publishes the counters
+    if (!__sync_bool_compare_and_swap(&last_update_time, last, now)) return;
+
+    int64_t cpu_time = get_cpu_time();
+    int64_t interval = now - last;
+    int64_t elapsed = now - init_time;
+    process_stats_t stats = {
+        .cpu_usage = interval > 0 ? 100 * (double)(cpu_time - last_cpu_time) / interval : 0.0,
+        .cpu_avg_usage = elapsed > 0 ? 100 * (double)(cpu_time - init_cpu_time) / elapsed : 0.0,
+        .mpi_fraction = fraction(account_get_time(&mpi_account, now), elapsed),
+        .dlb_fraction = fraction(account_get_time(&dlb_account, now), elapsed),
+        .ipc = read_ipc(),
+    };
+    stats.useful_fraction = 1.0 - stats.mpi_fraction - stats.dlb_fraction;
+    if (stats.useful_fraction < 0.0) stats.useful_fraction = 0.0;
+    last_cpu_time = cpu_time;
+
+    shmem_procinfo__setstats(process_id, &stats);
+}
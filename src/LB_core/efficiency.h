@@ -17,32 +17,19 @@
 /*  along with DLB.  If not, see <http://www.gnu.org/licenses/>.                 */
 /*********************************************************************************/
 
-/* DPD.h: Declaraciones */
-
-#ifndef _DPD_H_
-#define _DPD_H_
-
-#define SIZEVENT 300
-#define POL 1
-
-/* Devuelve 0 si no es inicio de periodo y != (igual al valor de la muestra) si
-es inicio de periodo */
-/* muestra= valor de traceo ,en periode te devuelve la longitud del periodo */
-int DPD(long muestra, int *periode);
-
-/* Ventana maxima que mirara */
-void DPDWindowSize(int max);
-
-extern int max_period ;
-
-#else
-#endif
-
-
-
-
-
-
-
-
-
+#ifndef EFFICIENCY_H
+#define EFFICIENCY_H
+
+#include <sys/types.h>
+#include <stdbool.h>
+
+/* Per-process efficiency counters published into the procinfo shmem */
+void efficiency_init(pid_t pid);
+void efficiency_finalize(void);
+void efficiency_into_mpi(void);
+void efficiency_out_of_mpi(void);
+void efficiency_into_dlb(void);
+void efficiency_out_of_dlb(void);
+void efficiency_update(bool force);
+
+#endif /* EFFICIENCY_H */
@@ -20,6 +20,9 @@
 #include "LB_core/lb_funcs.h"
 #include "LB_policies/lewi.h"
 #include "LB_policies/lewi_mask.h"
+#include "LB_policies/RaL.h"
+#include "LB_policies/lewi_predict.h"
+#include "LB_policies/lewi_rebalance.h"
 #include "apis/dlb_errors.h"
 
 static int disabled() { return DLB_ERR_NOPOL; }
@@ -29,7 +32,219 @@ typedef int (*lb_func_kind1)(const struct SubProcessDescriptor*);
 typedef int (*lb_func_kind2)(const struct SubProcessDescriptor*, int);
 typedef int (*lb_func_kind3)(const struct SubProcessDescriptor*, const cpu_set_t*);
 
-void set_lb_funcs(balance_policy_t *lb_funcs, policy_t policy) {
+/* In-tree policies, described as any other plugin */
+
+static const dlb_policy_descriptor_t lewi_descriptor = {
+    .abi_version = DLB_PLUGIN_ABI_VERSION,
+    .name = "LeWI",
+    .flags = 0,
+    .funcs = {
+        .init                   = lewi_Init,
+        .finalize               = lewi_Finalize,
+        .enable                 = lewi_EnableDLB,
+        .disable                = lewi_DisableDLB,
+        .set_max_parallelism    = lewi_SetMaxParallelism,
+        .into_communication     = lewi_IntoCommunication,
+        .out_of_communication   = lewi_OutOfCommunication,
+        .into_blocking_call     = lewi_IntoBlockingCall,
+        .out_of_blocking_call   = lewi_OutOfBlockingCall,
+        .lend                   = lewi_Lend,
+        .reclaim                = lewi_Reclaim,
+        .borrow                 = lewi_Borrow,
+        .borrow_cpus            = lewi_BorrowCpus,
+    },
+};
+
+static const dlb_policy_descriptor_t lewi_mask_descriptor = {
+    .abi_version = DLB_PLUGIN_ABI_VERSION,
+    .name = "LeWI_mask",
+    .flags = DLB_POLICY_USES_CPUINFO,
+    .funcs = {
+        .init                   = lewi_mask_Init,
+        .finalize               = lewi_mask_Finalize,
+        .enable                 = lewi_mask_EnableDLB,
+        .disable                = lewi_mask_DisableDLB,
+        .set_max_parallelism    = lewi_mask_SetMaxParallelism,
+        .into_blocking_call     = lewi_mask_IntoBlockingCall,
+        .out_of_blocking_call   = lewi_mask_OutOfBlockingCall,
+        .lend                   = lewi_mask_Lend,
+        .lend_cpu               = lewi_mask_LendCpu,
+        .lend_cpu_mask          = lewi_mask_LendCpuMask,
+        .reclaim                = lewi_mask_Reclaim,
+        .reclaim_cpu            = lewi_mask_ReclaimCpu,
+        .reclaim_cpus           = lewi_mask_ReclaimCpus,
+        .reclaim_cpu_mask       = lewi_mask_ReclaimCpuMask,
+        .acquire_cpu            = lewi_mask_AcquireCpu,
+        .acquire_cpus           = lewi_mask_AcquireCpus,
+        .acquire_cpu_mask       = lewi_mask_AcquireCpuMask,
+        .borrow                 = lewi_mask_Borrow,
+        .borrow_cpu             = lewi_mask_BorrowCpu,
+        .borrow_cpus            = lewi_mask_BorrowCpus,
+        .borrow_cpu_mask        = lewi_mask_BorrowCpuMask,
+        .return_all             = lewi_mask_Return,
+        .return_cpu             = lewi_mask_ReturnCpu,
+        .return_cpu_mask        = lewi_mask_ReturnCpuMask,
+        .check_cpu_availability = lewi_mask_CheckCpuAvailability,
+        .update_ownership_info  = lewi_mask_UpdateOwnershipInfo,
+    },
+};
+
+/* RaL and PERaL only differ from LeWI_mask in init, finalize, blocking calls
+ * and borrow */
+static const dlb_policy_descriptor_t ral_descriptor = {
+    .abi_version = DLB_PLUGIN_ABI_VERSION,
+    .name = "RaL",
+    .flags = DLB_POLICY_USES_CPUINFO | DLB_POLICY_USES_ITERATIONS,
+    .funcs = {
+        .init                   = RaL_Init,
+        .finalize               = RaL_Finalize,
+        .enable                 = lewi_mask_EnableDLB,
+        .disable                = lewi_mask_DisableDLB,
+        .set_max_parallelism    = lewi_mask_SetMaxParallelism,
+        .into_blocking_call     = RaL_IntoBlockingCall,
+        .out_of_blocking_call   = RaL_OutOfBlockingCall,
+        .lend                   = lewi_mask_Lend,
+        .lend_cpu               = lewi_mask_LendCpu,
+        .lend_cpu_mask          = lewi_mask_LendCpuMask,
+        .reclaim                = lewi_mask_Reclaim,
+        .reclaim_cpu            = lewi_mask_ReclaimCpu,
+        .reclaim_cpus           = lewi_mask_ReclaimCpus,
+        .reclaim_cpu_mask       = lewi_mask_ReclaimCpuMask,
+        .acquire_cpu            = lewi_mask_AcquireCpu,
+        .acquire_cpus           = lewi_mask_AcquireCpus,
+        .acquire_cpu_mask       = lewi_mask_AcquireCpuMask,
+        .borrow                 = RaL_Borrow,
+        .borrow_cpu             = lewi_mask_BorrowCpu,
+        .borrow_cpus            = RaL_BorrowCpus,
+        .borrow_cpu_mask        = lewi_mask_BorrowCpuMask,
+        .return_all             = lewi_mask_Return,
+        .return_cpu             = lewi_mask_ReturnCpu,
+        .return_cpu_mask        = lewi_mask_ReturnCpuMask,
+        .check_cpu_availability = lewi_mask_CheckCpuAvailability,
+        .update_ownership_info  = lewi_mask_UpdateOwnershipInfo,
+    },
+};
+
+static const dlb_policy_descriptor_t peral_descriptor = {
+    .abi_version = DLB_PLUGIN_ABI_VERSION,
+    .name = "PERaL",
+    .flags = DLB_POLICY_USES_CPUINFO | DLB_POLICY_USES_ITERATIONS,
+    .funcs = {
+        .init                   = PERaL_Init,
+        .finalize               = RaL_Finalize,
+        .enable                 = lewi_mask_EnableDLB,
+        .disable                = lewi_mask_DisableDLB,
+        .set_max_parallelism    = lewi_mask_SetMaxParallelism,
+        .into_blocking_call     = RaL_IntoBlockingCall,
+        .out_of_blocking_call   = RaL_OutOfBlockingCall,
+        .lend                   = lewi_mask_Lend,
+        .lend_cpu               = lewi_mask_LendCpu,
+        .lend_cpu_mask          = lewi_mask_LendCpuMask,
+        .reclaim                = lewi_mask_Reclaim,
+        .reclaim_cpu            = lewi_mask_ReclaimCpu,
+        .reclaim_cpus           = lewi_mask_ReclaimCpus,
+        .reclaim_cpu_mask       = lewi_mask_ReclaimCpuMask,
+        .acquire_cpu            = lewi_mask_AcquireCpu,
+        .acquire_cpus           = lewi_mask_AcquireCpus,
+        .acquire_cpu_mask       = lewi_mask_AcquireCpuMask,
+        .borrow                 = RaL_Borrow,
+        .borrow_cpu             = lewi_mask_BorrowCpu,
+        .borrow_cpus            = RaL_BorrowCpus,
+        .borrow_cpu_mask        = lewi_mask_BorrowCpuMask,
+        .return_all             = lewi_mask_Return,
+        .return_cpu             = lewi_mask_ReturnCpu,
+        .return_cpu_mask        = lewi_mask_ReturnCpuMask,
+        .check_cpu_availability = lewi_mask_CheckCpuAvailability,
+        .update_ownership_info  = lewi_mask_UpdateOwnershipInfo,
+    },
+};
+
+/* LeWI_predict only differs from LeWI_mask in init, finalize and blocking calls */
+static const dlb_policy_descriptor_t lewi_predict_descriptor = {
+    .abi_version = DLB_PLUGIN_ABI_VERSION,
+    .name = "LeWI_predict",
+    .flags = DLB_POLICY_USES_CPUINFO | DLB_POLICY_USES_ITERATIONS,
+    .funcs = {
+        .init                   = lewi_predict_Init,
+        .finalize               = lewi_predict_Finalize,
+        .enable                 = lewi_mask_EnableDLB,
+        .disable                = lewi_mask_DisableDLB,
+        .set_max_parallelism    = lewi_mask_SetMaxParallelism,
+        .into_blocking_call     = lewi_predict_IntoBlockingCall,
+        .out_of_blocking_call   = lewi_predict_OutOfBlockingCall,
+        .lend                   = lewi_mask_Lend,
+        .lend_cpu               = lewi_mask_LendCpu,
+        .lend_cpu_mask          = lewi_mask_LendCpuMask,
+        .reclaim                = lewi_mask_Reclaim,
+        .reclaim_cpu            = lewi_mask_ReclaimCpu,
+        .reclaim_cpus           = lewi_mask_ReclaimCpus,
+        .reclaim_cpu_mask       = lewi_mask_ReclaimCpuMask,
+        .acquire_cpu            = lewi_mask_AcquireCpu,
+        .acquire_cpus           = lewi_mask_AcquireCpus,
+        .acquire_cpu_mask       = lewi_mask_AcquireCpuMask,
+        .borrow                 = lewi_mask_Borrow,
+        .borrow_cpu             = lewi_mask_BorrowCpu,
+        .borrow_cpus            = lewi_mask_BorrowCpus,
+        .borrow_cpu_mask        = lewi_mask_BorrowCpuMask,
+        .return_all             = lewi_mask_Return,
+        .return_cpu             = lewi_mask_ReturnCpu,
+        .return_cpu_mask        = lewi_mask_ReturnCpuMask,
+        .check_cpu_availability = lewi_mask_CheckCpuAvailability,
+        .update_ownership_info  = lewi_mask_UpdateOwnershipInfo,
+    },
+};
+
+/* LeWI_rebalance only differs from LeWI_mask in init, finalize and blocking calls */
+static const dlb_policy_descriptor_t lewi_rebalance_descriptor = {
+    .abi_version = DLB_PLUGIN_ABI_VERSION,
+    .name = "LeWI_rebalance",
+    .flags = DLB_POLICY_USES_CPUINFO | DLB_POLICY_USES_ITERATIONS,
+    .funcs = {
+        .init                   = lewi_rebalance_Init,
+        .finalize               = lewi_rebalance_Finalize,
+        .enable                 = lewi_mask_EnableDLB,
+        .disable                = lewi_mask_DisableDLB,
+        .set_max_parallelism    = lewi_mask_SetMaxParallelism,
+        .into_blocking_call     = lewi_rebalance_IntoBlockingCall,
+        .out_of_blocking_call   = lewi_rebalance_OutOfBlockingCall,
+        .lend                   = lewi_mask_Lend,
+        .lend_cpu               = lewi_mask_LendCpu,
+        .lend_cpu_mask          = lewi_mask_LendCpuMask,
+        .reclaim                = lewi_mask_Reclaim,
+        .reclaim_cpu            = lewi_mask_ReclaimCpu,
+        .reclaim_cpus           = lewi_mask_ReclaimCpus,
+        .reclaim_cpu_mask       = lewi_mask_ReclaimCpuMask,
+        .acquire_cpu            = lewi_mask_AcquireCpu,
+        .acquire_cpus           = lewi_mask_AcquireCpus,
+        .acquire_cpu_mask       = lewi_mask_AcquireCpuMask,
+        .borrow                 = lewi_mask_Borrow,
+        .borrow_cpu             = lewi_mask_BorrowCpu,
+        .borrow_cpus            = lewi_mask_BorrowCpus,
+        .borrow_cpu_mask        = lewi_mask_BorrowCpuMask,
+        .return_all             = lewi_mask_Return,
+        .return_cpu             = lewi_mask_ReturnCpu,
+        .return_cpu_mask        = lewi_mask_ReturnCpuMask,
+        .check_cpu_availability = lewi_mask_CheckCpuAvailability,
+        .update_ownership_info  = lewi_mask_UpdateOwnershipInfo,
+    },
+};
+
+const dlb_policy_descriptor_t* get_policy_descriptor(policy_t policy) {
+    switch(policy) {
+        case POLICY_LEWI:           return &lewi_descriptor;
+        case POLICY_LEWI_MASK:      return &lewi_mask_descriptor;
+        case POLICY_RAL:            return &ral_descriptor;
+        case POLICY_PERAL:          return &peral_descriptor;
+        case POLICY_LEWI_PREDICT:   return &lewi_predict_descriptor;
+        case POLICY_LEWI_REBALANCE: return &lewi_rebalance_descriptor;
+        default:                    return NULL;
+    }
+}
+
+#define SET_IF_PROVIDED(field) \
+    if (funcs->field) lb_funcs->field = funcs->field
+
+void set_policy_funcs(balance_policy_t *lb_funcs, const dlb_policy_descriptor_t *descriptor) {
     // Initialize all fields to a valid, but disabled, function
     *lb_funcs = (balance_policy_t){
         .init                   = dummy,
@@ -63,52 +278,41 @@ void set_lb_funcs(balance_policy_t *lb_funcs, policy_t policy) {
         .update_ownership_info  = (lb_func_kind3)disabled,
     };
 
-    // Set according to policy
-    switch(policy) {
-        case POLICY_NONE:
-            break;
-        case POLICY_LEWI:
-            lb_funcs->init                   = lewi_Init;
-            lb_funcs->finalize               = lewi_Finalize;
-            lb_funcs->enable                 = lewi_EnableDLB;
-            lb_funcs->disable                = lewi_DisableDLB;
-            lb_funcs->set_max_parallelism    = lewi_SetMaxParallelism;
-            lb_funcs->into_communication     = lewi_IntoCommunication;
-            lb_funcs->out_of_communication   = lewi_OutOfCommunication;
-            lb_funcs->into_blocking_call     = lewi_IntoBlockingCall;
-            lb_funcs->out_of_blocking_call   = lewi_OutOfBlockingCall;
-            lb_funcs->lend                   = lewi_Lend;
-            lb_funcs->reclaim                = lewi_Reclaim;
-            lb_funcs->borrow                 = lewi_Borrow;
-            lb_funcs->borrow_cpus            = lewi_BorrowCpus;
-            break;
-        case POLICY_LEWI_MASK:
-            lb_funcs->init                   = lewi_mask_Init;
-            lb_funcs->finalize               = lewi_mask_Finalize;
-            lb_funcs->enable                 = lewi_mask_EnableDLB;
-            lb_funcs->disable                = lewi_mask_DisableDLB;
-            lb_funcs->set_max_parallelism    = lewi_mask_SetMaxParallelism;
-            lb_funcs->into_blocking_call     = lewi_mask_IntoBlockingCall;
-            lb_funcs->out_of_blocking_call   = lewi_mask_OutOfBlockingCall;
-            lb_funcs->lend                   = lewi_mask_Lend;
-            lb_funcs->lend_cpu               = lewi_mask_LendCpu;
-            lb_funcs->lend_cpu_mask          = lewi_mask_LendCpuMask;
-            lb_funcs->reclaim                = lewi_mask_Reclaim;
-            lb_funcs->reclaim_cpu            = lewi_mask_ReclaimCpu;
-            lb_funcs->reclaim_cpus           = lewi_mask_ReclaimCpus;
-            lb_funcs->reclaim_cpu_mask       = lewi_mask_ReclaimCpuMask;
-            lb_funcs->acquire_cpu            = lewi_mask_AcquireCpu;
-            lb_funcs->acquire_cpus           = lewi_mask_AcquireCpus;
-            lb_funcs->acquire_cpu_mask       = lewi_mask_AcquireCpuMask;
-            lb_funcs->borrow                 = lewi_mask_Borrow;
-            lb_funcs->borrow_cpu             = lewi_mask_BorrowCpu;
-            lb_funcs->borrow_cpus            = lewi_mask_BorrowCpus;
-            lb_funcs->borrow_cpu_mask        = lewi_mask_BorrowCpuMask;
-            lb_funcs->return_all             = lewi_mask_Return;
-            lb_funcs->return_cpu             = lewi_mask_ReturnCpu;
-            lb_funcs->return_cpu_mask        = lewi_mask_ReturnCpuMask;
-            lb_funcs->check_cpu_availability = lewi_mask_CheckCpuAvailability;
-            lb_funcs->update_ownership_info  = lewi_mask_UpdateOwnershipInfo;
-            break;
-    }
+    if (descriptor == NULL) return;
+
+    // Set the callbacks provided by the policy
+    const balance_policy_t *funcs = &descriptor->funcs;
+    SET_IF_PROVIDED(init);
+    SET_IF_PROVIDED(finalize);
+    SET_IF_PROVIDED(enable);
+    SET_IF_PROVIDED(disable);
+    SET_IF_PROVIDED(set_max_parallelism);
+    SET_IF_PROVIDED(into_communication);
+    SET_IF_PROVIDED(out_of_communication);
+    SET_IF_PROVIDED(into_blocking_call);
+    SET_IF_PROVIDED(out_of_blocking_call);
+    SET_IF_PROVIDED(lend);
+    SET_IF_PROVIDED(lend_cpu);
+    SET_IF_PROVIDED(lend_cpus);
+    SET_IF_PROVIDED(lend_cpu_mask);
+    SET_IF_PROVIDED(reclaim);
+    SET_IF_PROVIDED(reclaim_cpu);
+    SET_IF_PROVIDED(reclaim_cpus);
+    SET_IF_PROVIDED(reclaim_cpu_mask);
+    SET_IF_PROVIDED(acquire_cpu);
+    SET_IF_PROVIDED(acquire_cpus);
+    SET_IF_PROVIDED(acquire_cpu_mask);
+    SET_IF_PROVIDED(borrow);
+    SET_IF_PROVIDED(borrow_cpu);
+    SET_IF_PROVIDED(borrow_cpus);
+    SET_IF_PROVIDED(borrow_cpu_mask);
+    SET_IF_PROVIDED(return_all);
+    SET_IF_PROVIDED(return_cpu);
+    SET_IF_PROVIDED(return_cpu_mask);
+    SET_IF_PROVIDED(check_cpu_availability);
+    SET_IF_PROVIDED(update_ownership_info);
+}
+
+void set_lb_funcs(balance_policy_t *lb_funcs, policy_t policy) {
+    set_policy_funcs(lb_funcs, get_policy_descriptor(policy));
 }
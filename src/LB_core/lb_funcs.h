@@ -20,53 +20,19 @@
 #ifndef LB_FUNCS_H
 #define LB_FUNCS_H
 
+#include "apis/dlb_plugin.h"
 #include "support/types.h"
 
 #include <sched.h>
 
-struct SubProcessDescriptor;
+/* In-tree and plugin policies share the same set of callbacks */
+typedef dlb_policy_funcs_t balance_policy_t;
 
-typedef struct BalancePolicy {
-    /* Status */
-    int (*init)(struct SubProcessDescriptor *spd);
-    int (*finalize)(struct SubProcessDescriptor *spd);
-    int (*enable)(const struct SubProcessDescriptor *spd);
-    int (*disable)(const struct SubProcessDescriptor *spd);
-    int (*set_max_parallelism)(const struct SubProcessDescriptor *spd, int max);
-    /* MPI specific */
-    int (*into_communication)(const struct SubProcessDescriptor *spd);
-    int (*out_of_communication)(const struct SubProcessDescriptor *spd);
-    int (*into_blocking_call)(const struct SubProcessDescriptor *spd);
-    int (*out_of_blocking_call)(const struct SubProcessDescriptor *spd, int is_iter);
-    /* Lend */
-    int (*lend)(const struct SubProcessDescriptor *spd);
-    int (*lend_cpu)(const struct SubProcessDescriptor *spd, int cpuid);
-    int (*lend_cpus)(const struct SubProcessDescriptor *spd, int ncpus);
-    int (*lend_cpu_mask)(const struct SubProcessDescriptor *spd, const cpu_set_t *mask);
-    /* Reclaim */
-    int (*reclaim)(const struct SubProcessDescriptor *spd);
-    int (*reclaim_cpu)(const struct SubProcessDescriptor *spd, int cpuid);
-    int (*reclaim_cpus)(const struct SubProcessDescriptor *spd, int ncpus);
-    int (*reclaim_cpu_mask)(const struct SubProcessDescriptor *spd, const cpu_set_t *mask);
-    /* Acquire */
-    int (*acquire_cpu)(const struct SubProcessDescriptor *spd, int cpuid);
-    int (*acquire_cpus)(const struct SubProcessDescriptor *spd, int ncpus);
-    int (*acquire_cpu_mask)(const struct SubProcessDescriptor *spd, const cpu_set_t *mask);
-    /* Borrow */
-    int (*borrow)(const struct SubProcessDescriptor *spd);
-    int (*borrow_cpu)(const struct SubProcessDescriptor *spd, int cpuid);
-    int (*borrow_cpus)(const struct SubProcessDescriptor *spd, int ncpus);
-    int (*borrow_cpu_mask)(const struct SubProcessDescriptor *spd, const cpu_set_t *mask);
-    /* Return */
-    int (*return_all)(const struct SubProcessDescriptor *spd);
-    int (*return_cpu)(const struct SubProcessDescriptor *spd, int cpuid);
-    int (*return_cpu_mask)(const struct SubProcessDescriptor *spd, const cpu_set_t *mask);
-    /* Misc */
-    int (*check_cpu_availability)(const struct SubProcessDescriptor *spd, int cpuid);
-    int (*update_ownership_info)(const struct SubProcessDescriptor *spd,
-            const cpu_set_t *process_mask);
-} balance_policy_t;
+/* Return the descriptor of an in-tree policy, NULL if POLICY_NONE */
+const dlb_policy_descriptor_t* get_policy_descriptor(policy_t policy);
 
+/* Set the callbacks provided by the descriptor, the rest are disabled */
+void set_policy_funcs(balance_policy_t *lb_funcs, const dlb_policy_descriptor_t *descriptor);
 void set_lb_funcs(balance_policy_t *lb_funcs, policy_t policy);
 
 #endif /* LB_FUNCS_H */
@@ -0,0 +1,153 @@
+/*********************************************************************************/
+/*  Copyright 2017 Barcelona Supercomputing Center                               */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <http://www.gnu.org/licenses/>.                 */
+/*********************************************************************************/
+
+#include "LB_core/policy_plugin.h"
+
+#include "LB_core/spd.h"
+#include "LB_comm/shmem_cpuinfo.h"
+#include "LB_comm/shmem_procinfo.h"
+#include "LB_numThreads/numThreads.h"
+#include "apis/dlb_errors.h"
+#include "support/debug.h"
+#include "support/mask_utils.h"
+
+#include <dlfcn.h>
+#include <string.h>
+
+
+/*********************************************************************************/
+/*  Services                                                                     */
+/*********************************************************************************/
+
+static pid_t get_pid(const subprocess_descriptor_t *spd) {
+    return spd->id;
+}
+
+static void get_process_mask(const subprocess_descriptor_t *spd, cpu_set_t *mask) {
+    memcpy(mask, &spd->process_mask, sizeof(cpu_set_t));
+}
+
+static void* get_policy_data(const subprocess_descriptor_t *spd) {
+    return spd->policy_info;
+}
+
+static void set_policy_data(subprocess_descriptor_t *spd, void *data) {
+    spd->policy_info = data;
+}
+
+static int set_num_threads(const subprocess_descriptor_t *spd, int nthreads) {
+    return update_threads(&spd->pm, nthreads);
+}
+
+static int pm_enable_cpu(const subprocess_descriptor_t *spd, int cpuid) {
+    return enable_cpu(&spd->pm, cpuid);
+}
+
+static int pm_disable_cpu(const subprocess_descriptor_t *spd, int cpuid) {
+    return disable_cpu(&spd->pm, cpuid);
+}
+
+static int procinfo_getprocessmask(pid_t pid, cpu_set_t *mask) {
+    return shmem_procinfo__getprocessmask(pid, mask, 0);
+}
+
+static const dlb_plugin_services_t services = {
+    .abi_version                    = DLB_PLUGIN_ABI_VERSION,
+    .get_pid                        = get_pid,
+    .get_process_mask               = get_process_mask,
+    .get_policy_data                = get_policy_data,
+    .set_policy_data                = set_policy_data,
+    .set_num_threads                = set_num_threads,
+    .enable_cpu                     = pm_enable_cpu,
+    .disable_cpu                    = pm_disable_cpu,
+    .get_system_size                = mu_get_system_size,
+    .cpuinfo_lend_cpu               = shmem_cpuinfo__lend_cpu,
+    .cpuinfo_lend_cpu_mask          = shmem_cpuinfo__lend_cpu_mask,
+    .cpuinfo_reclaim_all            = shmem_cpuinfo__reclaim_all,
+    .cpuinfo_reclaim_cpu            = shmem_cpuinfo__reclaim_cpu,
+    .cpuinfo_reclaim_cpu_mask       = shmem_cpuinfo__reclaim_cpu_mask,
+    .cpuinfo_acquire_cpu            = shmem_cpuinfo__acquire_cpu,
+    .cpuinfo_borrow_cpu             = shmem_cpuinfo__borrow_cpu,
+    .cpuinfo_borrow_cpu_mask        = shmem_cpuinfo__borrow_cpu_mask,
+    .cpuinfo_return_all             = shmem_cpuinfo__return_all,
+    .cpuinfo_return_cpu             = shmem_cpuinfo__return_cpu,
+    .cpuinfo_return_cpu_mask        = shmem_cpuinfo__return_cpu_mask,
+    .cpuinfo_check_cpu_availability = shmem_cpuinfo__check_cpu_availability,
+    .cpuinfo_get_guested_cpus       = shmem_cpuinfo__get_guested_cpus,
+    .procinfo_getpidlist            = shmem_procinfo__getpidlist,
+    .procinfo_getprocessmask        = procinfo_getprocessmask,
+    .procinfo_getcpuusage           = shmem_procinfo__getcpuusage,
+    .procinfo_getcpuavgusage        = shmem_procinfo__getcpuavgusage,
+    .procinfo_getloadavg            = shmem_procinfo__getloadavg,
+};
+
+const dlb_plugin_services_t* policy_plugin_get_services(void) {
+    return &services;
+}
+
+
+/*********************************************************************************/
+/*  Load / Unload                                                                */
+/*********************************************************************************/
+
+int policy_plugin_attach(dlb_plugin_entry_t entry, const dlb_policy_descriptor_t **descriptor) {
+    const dlb_policy_descriptor_t *plugin_descriptor = entry(&services);
+    if (plugin_descriptor == NULL) {
+        return DLB_ERR_NOPOL;
+    }
+    if (plugin_descriptor->abi_version != DLB_PLUGIN_ABI_VERSION) {
+        verbose(VB_API, "Policy plugin ABI version %u, expected %u",
+                plugin_descriptor->abi_version, DLB_PLUGIN_ABI_VERSION);
+        return DLB_ERR_NOCOMP;
+    }
+    *descriptor = plugin_descriptor;
+    return DLB_SUCCESS;
+}
+
+int policy_plugin_load(const char *path, const dlb_policy_descriptor_t **descriptor,
+        void **handle) {
+    void *dl_handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if (dl_handle == NULL) {
+        verbose(VB_API, "Cannot open policy plugin: %s", dlerror());
+        return DLB_ERR_NOENT;
+    }
+
+    dlb_plugin_entry_t entry;
+    *(void**)&entry = dlsym(dl_handle, DLB_PLUGIN_ENTRY_SYMBOL);
+    if (entry == NULL) {
+        verbose(VB_API, "Policy plugin %s does not export %s", path, DLB_PLUGIN_ENTRY_SYMBOL);
+        dlclose(dl_handle);
+        return DLB_ERR_NOENT;
+    }
+
+    int error = policy_plugin_attach(entry, descriptor);
+    if (error != DLB_SUCCESS) {
+        dlclose(dl_handle);
+        return error;
+    }
+
+    *handle = dl_handle;
+    return DLB_SUCCESS;
+}
+
+void policy_plugin_unload(void *handle) {
+    if (handle != NULL) {
+        dlclose(handle);
+    }
+}
@@ -17,26 +17,20 @@
 /*  along with DLB.  If not, see <http://www.gnu.org/licenses/>.                 */
 /*********************************************************************************/
 
-#ifndef PERAL_H
-#define PERAL_H
+#ifndef POLICY_PLUGIN_H
+#define POLICY_PLUGIN_H
 
-/******* Main Functions - LeWI Mask Balancing Policy ********/
+#include "apis/dlb_plugin.h"
 
-void PERaL_Init(const cpu_set_t *process_mask);
+/* Services table handed to every plugin */
+const dlb_plugin_services_t* policy_plugin_get_services(void);
 
-void PERaL_Finish( void );
+/* Validate the descriptor returned by the plugin entry function */
+int policy_plugin_attach(dlb_plugin_entry_t entry, const dlb_policy_descriptor_t **descriptor);
 
-void PERaL_IntoCommunication( void );
-
-void PERaL_OutOfCommunication( void );
-
-void PERaL_IntoBlockingCall(int is_iter, int blocking_mode);
-
-void PERaL_OutOfBlockingCall(int is_iter);
-
-void PERaL_UpdateResources( int max_resources );
-
-void PERaL_ReturnClaimedCpus( void );
-
-#endif /* PERAL_H */
+/* Load a policy plugin from a shared object, handle must be passed to unload */
+int policy_plugin_load(const char *path, const dlb_policy_descriptor_t **descriptor,
+        void **handle);
+void policy_plugin_unload(void *handle);
 
+#endif /* POLICY_PLUGIN_H */
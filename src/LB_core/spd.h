@@ -22,6 +22,7 @@
 
 #include "LB_core/lb_funcs.h"
 #include "LB_numThreads/numThreads.h"
+#include "support/cgroup.h"
 #include "support/options.h"
 #include "support/types.h"
 
@@ -39,7 +40,11 @@ typedef struct SubProcessDescriptor {
     pm_interface_t pm;
     policy_t lb_policy;
     balance_policy_t lb_funcs;
+    const dlb_policy_descriptor_t *lb_descriptor;
+    void *plugin_handle;
     void *lewi_info;
+    void *policy_info;
+    cgroup_info_t cgroup;
 } subprocess_descriptor_t;
 
 #endif /* SPD_H */
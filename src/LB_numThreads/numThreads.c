@@ -87,6 +87,14 @@ int pm_callback_set(pm_interface_t *pm, dlb_callbacks_t which,
             pm->dlb_callback_disable_cpu_ptr = (dlb_callback_disable_cpu_t)callback;
             pm->dlb_callback_disable_cpu_arg = arg;
             break;
+        case dlb_callback_enable_cpu_set:
+            pm->dlb_callback_enable_cpu_set_ptr = (dlb_callback_enable_cpu_set_t)callback;
+            pm->dlb_callback_enable_cpu_set_arg = arg;
+            break;
+        case dlb_callback_disable_cpu_set:
+            pm->dlb_callback_disable_cpu_set_ptr = (dlb_callback_disable_cpu_set_t)callback;
+            pm->dlb_callback_disable_cpu_set_arg = arg;
+            break;
         default:
             return DLB_ERR_NOCBK;
     }
@@ -124,6 +132,14 @@ int pm_callback_get(const pm_interface_t *pm, dlb_callbacks_t which,
             *callback = (dlb_callback_t)pm->dlb_callback_disable_cpu_ptr;
             *arg = pm->dlb_callback_disable_cpu_arg;
             break;
+        case dlb_callback_enable_cpu_set:
+            *callback = (dlb_callback_t)pm->dlb_callback_enable_cpu_set_ptr;
+            *arg = pm->dlb_callback_enable_cpu_set_arg;
+            break;
+        case dlb_callback_disable_cpu_set:
+            *callback = (dlb_callback_t)pm->dlb_callback_disable_cpu_set_ptr;
+            *arg = pm->dlb_callback_disable_cpu_set_arg;
+            break;
         default:
             return DLB_ERR_NOCBK;
     }
@@ -202,3 +218,40 @@ int disable_cpu(const pm_interface_t *pm, int cpuid) {
     pm->dlb_callback_disable_cpu_ptr(cpuid, pm->dlb_callback_disable_cpu_arg);
     return DLB_SUCCESS;
 }
+
+int enable_cpu_set(const pm_interface_t *pm, const cpu_set_t *cpu_set) {
+    if (pm->dlb_callback_enable_cpu_set_ptr == NULL) {
+        if (pm->dlb_callback_enable_cpu_ptr == NULL) {
+            return add_mask(pm, cpu_set);
+        }
+        int cpuid;
+        for (cpuid=0; cpuid<CPU_SETSIZE; ++cpuid) {
+            if (CPU_ISSET(cpuid, cpu_set)) {
+                pm->dlb_callback_enable_cpu_ptr(cpuid, pm->dlb_callback_enable_cpu_arg);
+            }
+        }
+        return DLB_SUCCESS;
+    }
+    pm->dlb_callback_enable_cpu_set_ptr(cpu_set, pm->dlb_callback_enable_cpu_set_arg);
+    return DLB_SUCCESS;
+}
+
+int disable_cpu_set(const pm_interface_t *pm, const cpu_set_t *cpu_set) {
+    if (pm->dlb_callback_disable_cpu_set_ptr == NULL) {
+        if (pm->dlb_callback_disable_cpu_ptr == NULL) {
+            cpu_set_t mask;
+            sched_getaffinity(0, sizeof(cpu_set_t), &mask);
+            mu_substract(&mask, &mask, cpu_set);
+            return set_mask(pm, &mask);
+        }
+        int cpuid;
+        for (cpuid=0; cpuid<CPU_SETSIZE; ++cpuid) {
+            if (CPU_ISSET(cpuid, cpu_set)) {
+                pm->dlb_callback_disable_cpu_ptr(cpuid, pm->dlb_callback_disable_cpu_arg);
+            }
+        }
+        return DLB_SUCCESS;
+    }
+    pm->dlb_callback_disable_cpu_set_ptr(cpu_set, pm->dlb_callback_disable_cpu_set_arg);
+    return DLB_SUCCESS;
+}
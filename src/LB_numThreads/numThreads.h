@@ -40,6 +40,10 @@ typedef struct pm_interface {
     void                            *dlb_callback_enable_cpu_arg;
     dlb_callback_disable_cpu_t       dlb_callback_disable_cpu_ptr;
     void                            *dlb_callback_disable_cpu_arg;
+    dlb_callback_enable_cpu_set_t    dlb_callback_enable_cpu_set_ptr;
+    void                            *dlb_callback_enable_cpu_set_arg;
+    dlb_callback_disable_cpu_set_t   dlb_callback_disable_cpu_set_ptr;
+    void                            *dlb_callback_disable_cpu_set_arg;
 } pm_interface_t;
 
 void pm_init(pm_interface_t *pm);
@@ -56,5 +60,7 @@ int add_mask(const pm_interface_t *pm, const cpu_set_t *cpu_set);
 int add_process_mask(const pm_interface_t *pm, const cpu_set_t *cpu_set);
 int enable_cpu(const pm_interface_t *pm, int cpuid);
 int disable_cpu(const pm_interface_t *pm, int cpuid);
+int enable_cpu_set(const pm_interface_t *pm, const cpu_set_t *cpu_set);
+int disable_cpu_set(const pm_interface_t *pm, const cpu_set_t *cpu_set);
 
 #endif //NUMTHREADS_H
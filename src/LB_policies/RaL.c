@@ -19,180 +19,209 @@
 
 #include "LB_policies/RaL.h"
 
-#include "LB_numThreads/numThreads.h"
-#include "LB_comm/shmem_bitset.h"
+#include "LB_policies/lewi_mask.h"
+#include "LB_comm/shmem_async.h"
+#include "LB_comm/shmem_cpuinfo.h"
 #include "LB_core/spd.h"
+#include "apis/dlb_errors.h"
 #include "support/debug.h"
-#include "support/tracing.h"
 #include "support/mask_utils.h"
+#include "support/tracing.h"
 #include "support/mytime.h"
 
 #include <sched.h>
 #include <stdlib.h>
-#include <string.h>
-#include <stdio.h>
-
-static int initial_nthreads;
-static int nthreads;
-static int max_cpus;
-
-static int iterNum;
-static struct timespec initIter;
-static struct timespec initComp;
-//static struct timespec compIter;
-static double iter_cpu;
-static double previous_iter;
-
-/******* Main Functions - LeWI Mask Balancing Policy ********/
 
-void RaL_Init(const cpu_set_t *process_mask) {
-    verbose( VB_MICROLB, "LeWI Mask Balancing Init" );
+/* RaL: LeWI_mask with iteration-aware limit of the own CPUs. After each
+ * blocking call the process only reclaims max_cpus of its CPUs, the rest are
+ * kept lent while the application does not need them. max_cpus is adapted
+ * at the end of each iteration from the measured CPU time:
+ *  - If the iteration was longer than the previous one, recover one CPU.
+ *  - Otherwise, if the computation would fit in the iteration time with one
+ *    CPU less, release one CPU.
+ * Borrowing is only allowed while the process uses all its CPUs or when the
+ * computation of the current iteration is long enough.
+ * PERaL is RaL that also traces the CPU time of each iteration. */
+typedef struct RaL_info {
+    int initial_cpus;
+    int max_cpus;
+    int iter_num;
+    int64_t iter_start;         // ns
+    int64_t comp_start;         // ns, start of the current computation phase
+    double iter_cpu;            // CPU seconds used in the current iteration
+    double previous_iter;       // seconds of the previous iteration
+    bool trace_iter_cpu;
+} ral_info_t;
+
+static int get_nthreads(const subprocess_descriptor_t *spd) {
+    cpu_set_t mask;
+    if (shmem_cpuinfo__get_guested_cpus(spd->id, &mask) != DLB_SUCCESS) return 0;
+    return CPU_COUNT(&mask);
+}
 
-    initial_nthreads = CPU_COUNT(process_mask);
-    nthreads = initial_nthreads;
-    max_cpus = initial_nthreads;
+/* Accumulate the CPU time of the computation since the last call */
+static void account_computation(const subprocess_descriptor_t *spd, int64_t now) {
+    ral_info_t *ral_info = spd->policy_info;
+    ral_info->iter_cpu += (now - ral_info->comp_start) / 1e9 * get_nthreads(spd);
+    ral_info->comp_start = now;
+}
 
-    //Initialize iterative info
-//   reset(&compIter);
-    iterNum=0;
-    iter_cpu=0;
+static void update_max_cpus(const subprocess_descriptor_t *spd, int64_t now) {
+    ral_info_t *ral_info = spd->policy_info;
+    if (ral_info->iter_num != 0) {
+        double iter_duration = (now - ral_info->iter_start) / 1e9;
+        verbose(VB_MICROLB, "Iter %d: %.4f (%.4f) max_cpus: %d", ral_info->iter_num,
+                iter_duration, ral_info->iter_cpu, ral_info->max_cpus);
+        if (ral_info->trace_iter_cpu) {
+            add_event(ITERATION_CPU_EVENT, (long)(ral_info->iter_cpu * 1e6));
+        }
+        if (iter_duration >= ral_info->previous_iter
+                && ral_info->max_cpus < ral_info->initial_cpus) {
+            /* Maybe something went wrong, recover one CPU */
+            ++ral_info->max_cpus;
+        } else if (ral_info->max_cpus > 1
+                && ral_info->iter_cpu / (ral_info->max_cpus-1) < iter_duration) {
+            /* Same computation with one CPU less fits in the iteration */
+            --ral_info->max_cpus;
+        }
+        ral_info->previous_iter = iter_duration;
+    }
+    add_event(ITERATION_EVENT, ral_info->iter_num);
+    ++ral_info->iter_num;
+    ral_info->iter_start = now;
+    ral_info->iter_cpu = 0;
+}
 
-    //Initialize shared memory
-    shmem_mask.init(process_mask, global_spd.options.shm_key);
+static int ral_init(subprocess_descriptor_t *spd, bool trace_iter_cpu) {
+    verbose(VB_MICROLB, "%s Init", trace_iter_cpu ? "PERaL" : "RaL");
+
+    int error = lewi_mask_Init(spd);
+    if (error != DLB_SUCCESS) return error;
+
+    /* Allocate and initialize private structure */
+    spd->policy_info = malloc(sizeof(ral_info_t));
+    ral_info_t *ral_info = spd->policy_info;
+    ral_info->initial_cpus = CPU_COUNT(&spd->process_mask);
+    ral_info->max_cpus = ral_info->initial_cpus;
+    ral_info->iter_num = 0;
+    ral_info->iter_start = get_time_in_ns();
+    ral_info->comp_start = ral_info->iter_start;
+    ral_info->iter_cpu = 0;
+    ral_info->previous_iter = 0;
+    ral_info->trace_iter_cpu = trace_iter_cpu;
+
+    return DLB_SUCCESS;
 }
 
-void RaL_Finish( void ) {
-    set_mask( &global_spd.pm, shmem_mask.recover_defmask() );
-    shmem_mask.finalize();
+int RaL_Init(subprocess_descriptor_t *spd) {
+    return ral_init(spd, false);
 }
 
-void RaL_IntoCommunication( void ) {}
+int PERaL_Init(subprocess_descriptor_t *spd) {
+    return ral_init(spd, true);
+}
 
-void RaL_OutOfCommunication( void ) {}
+int RaL_Finalize(subprocess_descriptor_t *spd) {
+    /* De-allocate private structure */
+    free(spd->policy_info);
+    spd->policy_info = NULL;
 
-/* Into Blocking Call - Lend the maximum number of threads */
-void RaL_IntoBlockingCall(int is_iter, int blocking_mode) {
-    struct timespec aux;
-    if (clock_gettime(CLOCK_REALTIME, &aux)<0) {
-        fprintf(stderr, "DLB ERROR: clock_gettime failed\n");
-    }
+    return lewi_mask_Finalize(spd);
+}
 
-    diff_time(initComp, aux, &aux);
-//   add_time(compIter, aux, &compIter);
-    iter_cpu+=to_secs(aux) * nthreads;
+/* Into Blocking Call - Lend all the CPUs but the current one */
+int RaL_IntoBlockingCall(const subprocess_descriptor_t *spd) {
+    account_computation(spd, get_time_in_ns());
 
-    cpu_set_t mask;
-    memcpy(&mask, &global_spd.active_mask, sizeof(cpu_set_t));
-
-    cpu_set_t cpu;
-    CPU_ZERO( &cpu );
-    sched_getaffinity( 0, sizeof(cpu_set_t), &cpu);
-
-    if ( blocking_mode == ONE_CPU ) {
-        // Remove current cpu from the mask
-        CPU_XOR( &mask, &mask, &cpu );
-        verbose( VB_MICROLB, "LENDING %d threads", nthreads-1 );
-        nthreads = 1;
-    } else if ( blocking_mode == BLOCK ) {
-        verbose( VB_MICROLB, "LENDING %d threads", nthreads );
-        nthreads = 0;
+    int error = lewi_mask_Lend(spd);
+    if (spd->options.lewi_mpi) {
+        error = lewi_mask_LendCpu(spd, sched_getcpu());
     }
-
-    set_mask( &global_spd.pm, &cpu );
-    shmem_mask.add_mask( &mask );
-    add_event( THREADS_USED_EVENT, nthreads );
+    add_event(THREADS_USED_EVENT, get_nthreads(spd));
+    return error;
 }
 
-/* Out of Blocking Call - Recover the default number of threads */
-void RaL_OutOfBlockingCall(int is_iter ) {
+/* Out of Blocking Call - Recover up to max_cpus own CPUs, the rest of them are
+ * kept lent and disabled in the programming model */
+int RaL_OutOfBlockingCall(const subprocess_descriptor_t *spd, int is_iter) {
+    ral_info_t *ral_info = spd->policy_info;
+    int64_t now = get_time_in_ns();
+    ral_info->comp_start = now;
+    if (is_iter) {
+        update_max_cpus(spd, now);
+    }
 
-    if (clock_gettime(CLOCK_REALTIME, &initComp)<0) {
-        fprintf(stderr, "DLB ERROR: clock_gettime failed\n");
+    int error = DLB_NOUPDT;
+    if (spd->options.lewi_mpi) {
+        /* The current CPU is always recovered first */
+        error = lewi_mask_AcquireCpu(spd, sched_getcpu());
     }
 
-    if (is_iter!=0) {
-        struct timespec aux;
-
-        if(iterNum!=0) {
-            double iter_duration;
-            //Finishing Iteration
-            //aux is the duration of the last iteration
-            diff_time(initIter, initComp, &aux);
-            iter_duration=to_secs(aux);
-            //If the iteration has been longer than the last maybe something went wrong, recover one cpu
-            verbose( VB_MICROLB, "Iter %d:  %.4f (%.4f) max_cpus:%d", iterNum, to_secs(aux), iter_cpu, max_cpus);
-            if ((iter_duration>=previous_iter) && (max_cpus<initial_nthreads)) { max_cpus++; }
-            else {
-                iter_cpu=iter_cpu/(max_cpus-1);
-                //If we can do the same computations with one cpu less in less time than the iteration time, release a cpu "forever"
-                //but only if we still have one cpu
-                if(iter_cpu<iter_duration && max_cpus>0) {
-                    max_cpus--;
-//          fprintf(stderr, "[%d] with one cpu less: %.4f - %.4f (iter): %d\n", _mpi_rank, iter_cpu, to_secs(aux), iter_cpu<to_secs(aux) );
-                }
-            }
-            previous_iter=iter_duration;
+    cpu_set_t guested;
+    if (shmem_cpuinfo__get_guested_cpus(spd->id, &guested) != DLB_SUCCESS) {
+        return DLB_ERR_NOSHMEM;
+    }
+    cpu_set_t reclaim_mask;
+    CPU_ZERO(&reclaim_mask);
+    int ncpus = ral_info->max_cpus - CPU_COUNT(&guested);
+    int cpuid;
+    for (cpuid=0; cpuid<CPU_SETSIZE && ncpus>0; ++cpuid) {
+        if (CPU_ISSET(cpuid, &spd->process_mask) && !CPU_ISSET(cpuid, &guested)) {
+            CPU_SET(cpuid, &reclaim_mask);
+            --ncpus;
         }
-        //Init Iteration
-        add_event(ITERATION_EVENT, iterNum);
-        iterNum++;
-        initIter=initComp;
-        iter_cpu=0;
+    }
+    if (CPU_COUNT(&reclaim_mask) > 0) {
+        verbose(VB_MICROLB, "RECOVERING %d cpus", CPU_COUNT(&reclaim_mask));
+        error = lewi_mask_ReclaimCpuMask(spd, &reclaim_mask);
     }
 
-    verbose( VB_MICROLB, "RECOVERING %d threads", max_cpus - nthreads );
-    cpu_set_t mask;
-    CPU_ZERO( &mask );
-    shmem_mask.recover_some_defcpus( &mask, max_cpus );
-    set_mask( &global_spd.pm, &mask );
-    nthreads = max_cpus;
-//printf(stderr, "[%d] Using %d threads\n", _mpi_rank, nthreads );
-
-    add_event( THREADS_USED_EVENT, nthreads );
-
+    /* Own CPUs neither guested nor reclaimed must not be used */
+    cpu_set_t lent_mask;
+    mu_substract(&lent_mask, &spd->process_mask, &guested);
+    mu_substract(&lent_mask, &lent_mask, &reclaim_mask);
+    if (CPU_COUNT(&lent_mask) > 0) {
+        if (spd->options.mode == MODE_ASYNC) {
+            shmem_async_disable_cpu_mask(spd->id, &lent_mask);
+        } else {
+            disable_cpu_set(&spd->pm, &lent_mask);
+        }
+    }
+    add_event(THREADS_USED_EVENT, get_nthreads(spd));
+    return error;
 }
 
-/* Update Resources - Try to acquire foreign threads */
-void RaL_UpdateResources( int max_resources ) {
-    cpu_set_t mask;
-    memcpy(&mask, &global_spd.active_mask, sizeof(cpu_set_t));
-
-    if( max_cpus==initial_nthreads || ((iter_cpu/max_cpus)>(previous_iter/2))) {
-        //fprintf(stderr, "[%d] max_cpus %d < default_threads %d = %d (max_resources=%d)\n", _mpi_rank, max_cpus, initial_nthreads, max_cpus<initial_nthreads, max_resources );
-
-        int new_threads = shmem_mask.collect_mask(&mask, max_resources, global_spd.options.priority);
-        //printf(stderr, "[%d] dirty:%d new_threads:%d\n", _mpi_rank, dirty, new_threads);
-
-        if ( new_threads > 0 ) {
-            struct timespec aux;
-            if (clock_gettime(CLOCK_REALTIME, &aux)<0) {
-                fprintf(stderr, "DLB ERROR: clock_gettime failed\n");
-            }
-
-            diff_time(initComp, aux, &initComp);
-            iter_cpu+=to_secs(initComp) * nthreads;
+/* Borrow only if the process is using all its CPUs, or if the computation of
+ * this iteration is longer than half the previous iteration */
+static bool can_borrow(const subprocess_descriptor_t *spd) {
+    ral_info_t *ral_info = spd->policy_info;
+    return ral_info->max_cpus == ral_info->initial_cpus
+        || ral_info->iter_cpu / ral_info->max_cpus > ral_info->previous_iter / 2;
+}
 
-            initComp=aux;
+int RaL_Borrow(const subprocess_descriptor_t *spd) {
+    account_computation(spd, get_time_in_ns());
+    if (!can_borrow(spd)) return DLB_NOUPDT;
 
-            nthreads += new_threads;
-            set_mask( &global_spd.pm, &mask );
-            verbose( VB_MICROLB, "ACQUIRING %d threads for a total of %d", new_threads, nthreads );
-            add_event( THREADS_USED_EVENT, nthreads );
-        }
+    int error = lewi_mask_Borrow(spd);
+    if (error == DLB_SUCCESS) {
+        add_event(THREADS_USED_EVENT, get_nthreads(spd));
     }
+    return error;
 }
 
-/* Return Claimed CPUs - Return foreign threads that have been claimed by its owner */
-void RaL_ReturnClaimedCpus( void ) {
-    cpu_set_t mask;
-    memcpy(&mask, &global_spd.active_mask, sizeof(cpu_set_t));
-
-    int returned = shmem_mask.return_claimed( &mask );
+int RaL_BorrowCpus(const subprocess_descriptor_t *spd, int ncpus) {
+    account_computation(spd, get_time_in_ns());
+    if (!can_borrow(spd)) return DLB_NOUPDT;
 
-    if ( returned > 0 ) {
-        nthreads -= returned;
-        set_mask( &global_spd.pm, &mask );
-        verbose( VB_MICROLB, "RETURNING %d threads for a total of %d", returned, nthreads );
-        add_event( THREADS_USED_EVENT, nthreads );
+    int error = lewi_mask_BorrowCpus(spd, ncpus);
+    if (error == DLB_SUCCESS) {
+        add_event(THREADS_USED_EVENT, get_nthreads(spd));
     }
+    return error;
+}
+
+int RaL_GetMaxCpus(const subprocess_descriptor_t *spd) {
+    ral_info_t *ral_info = spd->policy_info;
+    return ral_info->max_cpus;
 }
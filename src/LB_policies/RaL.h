@@ -20,23 +20,21 @@
 #ifndef RAL_H
 #define RAL_H
 
-/******* Main Functions - LeWI Mask Balancing Policy ********/
+#include "LB_core/spd.h"
 
-void RaL_Init(const cpu_set_t* process_mask);
+/* RaL and PERaL policies, built on top of LeWI_mask. The functions that are
+ * not defined here are the LeWI_mask ones */
 
-void RaL_Finish( void );
+int RaL_Init(subprocess_descriptor_t *spd);
+int PERaL_Init(subprocess_descriptor_t *spd);
+int RaL_Finalize(subprocess_descriptor_t *spd);
 
-void RaL_IntoCommunication( void );
+int RaL_IntoBlockingCall(const subprocess_descriptor_t *spd);
+int RaL_OutOfBlockingCall(const subprocess_descriptor_t *spd, int is_iter);
 
-void RaL_OutOfCommunication( void );
+int RaL_Borrow(const subprocess_descriptor_t *spd);
+int RaL_BorrowCpus(const subprocess_descriptor_t *spd, int ncpus);
 
-void RaL_IntoBlockingCall(int is_iter, int blocking_mode);
-
-void RaL_OutOfBlockingCall(int is_iter);
-
-void RaL_UpdateResources( int max_resources );
-
-void RaL_ReturnClaimedCpus( void );
+int RaL_GetMaxCpus(const subprocess_descriptor_t *spd);
 
 #endif /* RAL_H */
-
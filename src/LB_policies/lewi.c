@@ -29,27 +29,74 @@
 #include "support/debug.h"
 
 #include <sched.h>
+#include <stdlib.h>
 #include <limits.h>
-
-
-static int default_cpus;
-static int myCPUS = 0;
-static int enabled = 0;
-static int single = 0;
-static int max_parallelism = 0;
-static void setThreads_Lend_light(const pm_interface_t *pm, int numThreads);
+#include <pthread.h>
+
+
+/* Asynchronous mode: a helper thread borrows idle CPUs as soon as they are
+ * released, unless the process has lent its own CPUs. The mutex protects the
+ * policy state from the concurrent accesses of the helper.
+ * Note that the set_num_threads callback is then invoked from the helper, so
+ * it must apply the change to the whole process and not only to the calling
+ * thread, as omp_set_num_threads would do.
+ * All the state is private to each subprocess */
+typedef struct LeWI_info {
+    lend_light_t *comm;
+    int default_cpus;
+    int myCPUS;
+    int enabled;
+    int single;
+    int max_parallelism;
+    pthread_mutex_t mutex;
+    pthread_t helper_pth;
+    bool helper_running;
+    bool lent;
+} lewi_info_t;
+
+static void setThreads_Lend_light(lewi_info_t *lewi_info, const pm_interface_t *pm,
+        int numThreads);
+static int borrow_cpus(const subprocess_descriptor_t *spd, int maxResources);
 static int min(int a, int b) { return a < b ? a : b; }
 
+static void* lewi_helper(void *arg) {
+    const subprocess_descriptor_t *spd = arg;
+    lewi_info_t *lewi_info = spd->lewi_info;
+    unsigned int epoch = getIdleCpusEpoch(lewi_info->comm);
+    bool running = true;
+    while (running) {
+        pthread_mutex_lock(&lewi_info->mutex);
+        {
+            running = lewi_info->helper_running;
+            if (running && lewi_info->enabled && !lewi_info->single && !lewi_info->lent) {
+                borrow_cpus(spd, INT_MAX);
+            }
+        }
+        pthread_mutex_unlock(&lewi_info->mutex);
+        /* Finalize changes the epoch after clearing helper_running */
+        if (running) epoch = waitIdleCpusChange(lewi_info->comm, epoch);
+    }
+    return NULL;
+}
+
 /******* Main Functions LeWI Balancing Policy ********/
 
 int lewi_Init(subprocess_descriptor_t *spd) {
     verbose(VB_MICROLB, "LeWI Init");
 
-    default_cpus = CPU_COUNT(&spd->process_mask);
+    /* Allocate and initialize private structure */
+    spd->lewi_info = malloc(sizeof(lewi_info_t));
+    lewi_info_t *lewi_info = spd->lewi_info;
+    lewi_info->default_cpus = CPU_COUNT(&spd->process_mask);
+    lewi_info->myCPUS = 0;
+    lewi_info->single = 0;
+    lewi_info->max_parallelism = 0;
+    lewi_info->helper_running = false;
+    pthread_mutex_init(&lewi_info->mutex, NULL);
 
-    setThreads_Lend_light(&spd->pm, default_cpus);
+    setThreads_Lend_light(lewi_info, &spd->pm, lewi_info->default_cpus);
 
-    info0("Default cpus per process: %d", default_cpus);
+    info0("Default cpus per process: %d", lewi_info->default_cpus);
 
     bool greedy = spd->options.lewi_greedy;
     if (greedy) {
@@ -57,41 +104,74 @@ int lewi_Init(subprocess_descriptor_t *spd) {
     }
 
     //Initialize shared memory
-    ConfigShMem(default_cpus, greedy, spd->options.shm_key);
+    lewi_info->comm = ConfigShMem(lewi_info->default_cpus, greedy, &spd->process_mask,
+            spd->options.shm_key);
 
     if (spd->options.lewi_warmup) {
-        setThreads_Lend_light(&spd->pm, mu_get_system_size());
-        setThreads_Lend_light(&spd->pm, default_cpus);
+        setThreads_Lend_light(lewi_info, &spd->pm, mu_get_system_size());
+        setThreads_Lend_light(lewi_info, &spd->pm, lewi_info->default_cpus);
     }
 
-    enabled = 1;
+    lewi_info->enabled = 1;
+    lewi_info->lent = false;
+
+    if (spd->options.mode == MODE_ASYNC) {
+        registerIdleCpusWaiter(lewi_info->comm);
+        lewi_info->helper_running = true;
+        pthread_create(&lewi_info->helper_pth, NULL, lewi_helper, spd);
+    }
 
     return DLB_SUCCESS;
 }
 
 int lewi_Finalize(subprocess_descriptor_t *spd) {
-    finalize_comm();
+    lewi_info_t *lewi_info = spd->lewi_info;
+    if (lewi_info == NULL) return DLB_SUCCESS;
+
+    pthread_mutex_lock(&lewi_info->mutex);
+    bool helper_running = lewi_info->helper_running;
+    lewi_info->helper_running = false;
+    pthread_mutex_unlock(&lewi_info->mutex);
+    if (helper_running) {
+        unregisterIdleCpusWaiter(lewi_info->comm);
+        pthread_join(lewi_info->helper_pth, NULL);
+    }
+    finalize_comm(lewi_info->comm);
+
+    /* De-allocate private structure */
+    pthread_mutex_destroy(&lewi_info->mutex);
+    free(spd->lewi_info);
+    spd->lewi_info = NULL;
     return DLB_SUCCESS;
 }
 
 int lewi_EnableDLB(const subprocess_descriptor_t *spd) {
-    single = 0;
-    enabled = 1;
+    lewi_info_t *lewi_info = spd->lewi_info;
+    pthread_mutex_lock(&lewi_info->mutex);
+    lewi_info->single = 0;
+    lewi_info->enabled = 1;
+    pthread_mutex_unlock(&lewi_info->mutex);
     return DLB_SUCCESS;
 }
 
 int lewi_DisableDLB(const subprocess_descriptor_t *spd) {
-    if (enabled && !single) {
+    lewi_info_t *lewi_info = spd->lewi_info;
+    pthread_mutex_lock(&lewi_info->mutex);
+    if (lewi_info->enabled && !lewi_info->single) {
         verbose(VB_MICROLB, "ResetDLB");
-        acquireCpus(myCPUS);
-        setThreads_Lend_light(&spd->pm, default_cpus);
+        acquireCpus(lewi_info->comm, lewi_info->myCPUS);
+        setThreads_Lend_light(lewi_info, &spd->pm, lewi_info->default_cpus);
     }
-    enabled = 0;
+    lewi_info->enabled = 0;
+    pthread_mutex_unlock(&lewi_info->mutex);
     return DLB_SUCCESS;
 }
 
 int lewi_SetMaxParallelism(const subprocess_descriptor_t *spd, int max) {
-    max_parallelism = max;
+    lewi_info_t *lewi_info = spd->lewi_info;
+    pthread_mutex_lock(&lewi_info->mutex);
+    lewi_info->max_parallelism = max;
+    pthread_mutex_unlock(&lewi_info->mutex);
     return DLB_SUCCESS;
 }
 
@@ -100,49 +180,65 @@ int lewi_IntoCommunication(const subprocess_descriptor_t *spd) { return DLB_SUCC
 int lewi_OutOfCommunication(const subprocess_descriptor_t *spd) { return DLB_SUCCESS;}
 
 int lewi_IntoBlockingCall(const subprocess_descriptor_t *spd) {
+    lewi_info_t *lewi_info = spd->lewi_info;
 
-    if (enabled) {
+    pthread_mutex_lock(&lewi_info->mutex);
+    if (lewi_info->enabled) {
+        lewi_info->lent = true;
         if ( !spd->options.lewi_mpi ) {
             /* 1CPU */
-            verbose(VB_MICROLB, "LENDING %d cpus", myCPUS-1);
-            releaseCpus(myCPUS-1);
-            setThreads_Lend_light(&spd->pm, 1);
+            verbose(VB_MICROLB, "LENDING %d cpus", lewi_info->myCPUS-1);
+            releaseCpus(lewi_info->comm, lewi_info->myCPUS-1);
+            setThreads_Lend_light(lewi_info, &spd->pm, 1);
         } else {
             /* BLOCK */
-            verbose(VB_MICROLB, "LENDING %d cpus", myCPUS);
-            releaseCpus(myCPUS);
-            setThreads_Lend_light(&spd->pm, 0);
+            verbose(VB_MICROLB, "LENDING %d cpus", lewi_info->myCPUS);
+            releaseCpus(lewi_info->comm, lewi_info->myCPUS);
+            setThreads_Lend_light(lewi_info, &spd->pm, 0);
         }
     }
+    pthread_mutex_unlock(&lewi_info->mutex);
     return DLB_SUCCESS;
 }
 
 int lewi_OutOfBlockingCall(const subprocess_descriptor_t *spd, int is_iter) {
+    lewi_info_t *lewi_info = spd->lewi_info;
 
-    if (enabled) {
+    pthread_mutex_lock(&lewi_info->mutex);
+    if (lewi_info->enabled) {
         int cpus;
-        if (single) {
-            cpus = acquireCpus(1);
+        if (lewi_info->single) {
+            cpus = acquireCpus(lewi_info->comm, 1);
         } else {
-            cpus = acquireCpus(myCPUS);
+            cpus = acquireCpus(lewi_info->comm, lewi_info->myCPUS);
         }
-        setThreads_Lend_light(&spd->pm, cpus);
+        setThreads_Lend_light(lewi_info, &spd->pm, cpus);
         verbose(VB_MICROLB, "ACQUIRING %d cpus", cpus);
+        lewi_info->lent = false;
     }
+    pthread_mutex_unlock(&lewi_info->mutex);
     return DLB_SUCCESS;
 }
 
 int lewi_Lend(const subprocess_descriptor_t *spd) {
-    verbose(VB_MICROLB, "LENDING %d cpus", myCPUS-1);
-    releaseCpus(myCPUS-1);
-    setThreads_Lend_light(&spd->pm, 1);
+    lewi_info_t *lewi_info = spd->lewi_info;
+    pthread_mutex_lock(&lewi_info->mutex);
+    verbose(VB_MICROLB, "LENDING %d cpus", lewi_info->myCPUS-1);
+    lewi_info->lent = true;
+    releaseCpus(lewi_info->comm, lewi_info->myCPUS-1);
+    setThreads_Lend_light(lewi_info, &spd->pm, 1);
+    pthread_mutex_unlock(&lewi_info->mutex);
     return DLB_SUCCESS;
 }
 
 int lewi_Reclaim(const subprocess_descriptor_t *spd) {
-    int cpus = acquireCpus(myCPUS);
-    setThreads_Lend_light(&spd->pm, cpus);
+    lewi_info_t *lewi_info = spd->lewi_info;
+    pthread_mutex_lock(&lewi_info->mutex);
+    int cpus = acquireCpus(lewi_info->comm, lewi_info->myCPUS);
+    setThreads_Lend_light(lewi_info, &spd->pm, cpus);
     verbose(VB_MICROLB, "ACQUIRING %d cpus", cpus);
+    lewi_info->lent = false;
+    pthread_mutex_unlock(&lewi_info->mutex);
     return DLB_SUCCESS;
 }
 
@@ -151,14 +247,27 @@ int lewi_Borrow(const subprocess_descriptor_t *spd) {
 }
 
 int lewi_BorrowCpus(const subprocess_descriptor_t *spd, int maxResources) {
+    lewi_info_t *lewi_info = spd->lewi_info;
+    pthread_mutex_lock(&lewi_info->mutex);
+    /* The process is running again, the helper may borrow for it */
+    lewi_info->lent = false;
+    int error = borrow_cpus(spd, maxResources);
+    pthread_mutex_unlock(&lewi_info->mutex);
+    return error;
+}
+
+/******* Auxiliar Functions LeWI Balancing Policy ********/
+static int borrow_cpus(const subprocess_descriptor_t *spd, int maxResources) {
+    lewi_info_t *lewi_info = spd->lewi_info;
     int error = DLB_NOUPDT;
-    if (enabled && !single) {
-        int max_resources = max_parallelism > 0 ?
-            min(maxResources, max_parallelism - myCPUS) : maxResources;
-        int cpus = checkIdleCpus(myCPUS, max_resources);
+    if (lewi_info->enabled && !lewi_info->single) {
+        int myCPUS = lewi_info->myCPUS;
+        int max_resources = lewi_info->max_parallelism > 0 ?
+            min(maxResources, lewi_info->max_parallelism - myCPUS) : maxResources;
+        int cpus = checkIdleCpus(lewi_info->comm, myCPUS, max_resources);
         if (myCPUS!=cpus) {
             verbose(VB_MICROLB, "Using %d cpus", cpus);
-            setThreads_Lend_light(&spd->pm, cpus);
+            setThreads_Lend_light(lewi_info, &spd->pm, cpus);
             error = DLB_SUCCESS;
         }
     } else {
@@ -167,12 +276,12 @@ int lewi_BorrowCpus(const subprocess_descriptor_t *spd, int maxResources) {
     return error;
 }
 
-/******* Auxiliar Functions LeWI Balancing Policy ********/
-static void setThreads_Lend_light(const pm_interface_t *pm, int numThreads) {
+static void setThreads_Lend_light(lewi_info_t *lewi_info, const pm_interface_t *pm,
+        int numThreads) {
 
-    if (myCPUS!=numThreads) {
+    if (lewi_info->myCPUS!=numThreads) {
         verbose(VB_MICROLB, "Using %d cpus", numThreads);
         update_threads(pm, numThreads);
-        myCPUS=numThreads;
+        lewi_info->myCPUS=numThreads;
     }
 }
@@ -29,26 +29,116 @@
 #include <sched.h>
 #include <stdlib.h>
 #include <string.h>
-
-/* Node size is constant across subprocesses, it is safe to be shared */
-static int node_size = -1;
+#include <pthread.h>
 
 /* These variables cannot be shared, so they need a private allocation */
 typedef struct LeWI_mask_info {
+    int node_size;
     int64_t last_borrow;
     int *cpus_priority_array;
+    pthread_mutex_t mutex;      // protects cpus_priority_array from async DROM updates
 } lewi_info_t;
 
+static inline int get_node_size(const subprocess_descriptor_t *spd) {
+    return ((lewi_info_t*)spd->lewi_info)->node_size;
+}
 
-int lewi_mask_Init(subprocess_descriptor_t *spd) {
-    /* Value is always updated to allow testing different node sizes */
-    node_size = mu_get_system_size();
+/* In async mode, the helper thread may update the priority array at any time,
+ * so the borrow functions work on a private copy */
+static void get_cpus_priority_array(const subprocess_descriptor_t *spd,
+        int *cpus_priority_array) {
+    lewi_info_t *lewi_info = spd->lewi_info;
+    pthread_mutex_lock(&lewi_info->mutex);
+    memcpy(cpus_priority_array, lewi_info->cpus_priority_array,
+            sizeof(int)*lewi_info->node_size);
+    pthread_mutex_unlock(&lewi_info->mutex);
+}
+
+
+/*********************************************************************************/
+/*    Notify CPU changes to the affected processes, batched per process          */
+/*********************************************************************************/
+
+/* Notify the result of a reclaim or acquire operation */
+static void notify_reclaimed_cpus(const subprocess_descriptor_t *spd,
+        const pid_t new_guests[], const pid_t victims[]) {
+    int node_size = get_node_size(spd);
+    bool async = spd->options.mode == MODE_ASYNC;
+    cpu_set_t enable_mask;
+    CPU_ZERO(&enable_mask);
+    int cpuid;
+    for (cpuid=0; cpuid<node_size; ++cpuid) {
+        if (new_guests[cpuid] == spd->id && (!async || victims[cpuid] <= 0)) {
+            CPU_SET(cpuid, &enable_mask);
+        }
+    }
+    if (async) {
+        /* If the CPU is guested, just disable visitor */
+        shmem_async_disable_cpus(victims);
+        /* Only enable if the CPU is free */
+        if (CPU_COUNT(&enable_mask) > 0) {
+            shmem_async_enable_cpu_mask(spd->id, &enable_mask);
+        }
+    } else {
+        /* Oversubscribe even if the CPU is guested */
+        if (CPU_COUNT(&enable_mask) > 0) {
+            enable_cpu_set(&spd->pm, &enable_mask);
+        }
+    }
+}
+
+/* Notify the result of a borrow operation */
+static void notify_borrowed_cpus(const subprocess_descriptor_t *spd, const pid_t new_guests[]) {
+    int node_size = get_node_size(spd);
+    cpu_set_t enable_mask;
+    CPU_ZERO(&enable_mask);
+    int cpuid;
+    for (cpuid=0; cpuid<node_size; ++cpuid) {
+        if (new_guests[cpuid] == spd->id) {
+            CPU_SET(cpuid, &enable_mask);
+        }
+    }
+    if (CPU_COUNT(&enable_mask) > 0) {
+        if (spd->options.mode == MODE_ASYNC) {
+            shmem_async_enable_cpu_mask(spd->id, &enable_mask);
+        } else {
+            enable_cpu_set(&spd->pm, &enable_mask);
+        }
+    }
+}
 
+/* Notify the result of a return operation */
+static void notify_returned_cpus(const subprocess_descriptor_t *spd, const pid_t new_guests[]) {
+    int node_size = get_node_size(spd);
+    if (spd->options.mode == MODE_ASYNC) {
+        shmem_async_enable_cpus(new_guests);
+    } else {
+        cpu_set_t disable_mask;
+        CPU_ZERO(&disable_mask);
+        int cpuid;
+        for (cpuid=0; cpuid<node_size; ++cpuid) {
+            pid_t new_guest = new_guests[cpuid];
+            if (new_guest >= 0 && new_guest != spd->id) {
+                CPU_SET(cpuid, &disable_mask);
+            }
+        }
+        if (CPU_COUNT(&disable_mask) > 0) {
+            disable_cpu_set(&spd->pm, &disable_mask);
+        }
+    }
+}
+
+
+int lewi_mask_Init(subprocess_descriptor_t *spd) {
     /* Allocate and initialize private structure */
     spd->lewi_info = malloc(sizeof(lewi_info_t));
     lewi_info_t *lewi_info = spd->lewi_info;
+    /* Value is always updated to allow testing different node sizes */
+    int node_size = mu_get_system_size();
+    lewi_info->node_size = node_size;
     lewi_info->last_borrow = 0;
     lewi_info->cpus_priority_array = malloc(node_size*sizeof(int));
+    pthread_mutex_init(&lewi_info->mutex, NULL);
     lewi_mask_UpdateOwnershipInfo(spd, &spd->process_mask);
 
     /* Enable request queues only in async mode */
@@ -64,6 +154,7 @@ int lewi_mask_Finalize(subprocess_descriptor_t *spd) {
     int error = lewi_mask_Reclaim(spd);
 
     /* De-allocate private structure */
+    pthread_mutex_destroy(&((lewi_info_t*)spd->lewi_info)->mutex);
     free(((lewi_info_t*)spd->lewi_info)->cpus_priority_array);
     free(spd->lewi_info);
     spd->lewi_info = NULL;
@@ -76,29 +167,40 @@ int lewi_mask_EnableDLB(const subprocess_descriptor_t *spd) {
 }
 
 int lewi_mask_DisableDLB(const subprocess_descriptor_t *spd) {
+    int node_size = get_node_size(spd);
     pid_t new_guests[node_size];
     pid_t victims[node_size];
     int error = shmem_cpuinfo__reset(spd->id, new_guests, victims);
     if (error == DLB_SUCCESS) {
         bool async = spd->options.mode == MODE_ASYNC;
+        cpu_set_t enable_mask, disable_mask;
+        CPU_ZERO(&enable_mask);
+        CPU_ZERO(&disable_mask);
         int cpuid;
         for (cpuid=0; cpuid<node_size; ++cpuid) {
             pid_t new_guest = new_guests[cpuid];
-            pid_t victim = victims[cpuid];
-            if (async) {
-                if (victim > 0) {
-                    shmem_async_disable_cpu(victim, cpuid);
-                } else if (new_guest == spd->id) {
-                    shmem_async_enable_cpu(spd->id, cpuid);
-                } else if (new_guest >= 0) {
-                    shmem_async_disable_cpu(spd->id, cpuid);
-                }
-            } else {
-                if (new_guest == spd->id) {
-                    enable_cpu(&spd->pm, cpuid);
-                } else if (new_guest >= 0) {
-                    disable_cpu(&spd->pm, cpuid);
-                }
+            if (async && victims[cpuid] > 0) {
+                /* Visitors are disabled below */
+            } else if (new_guest == spd->id) {
+                CPU_SET(cpuid, &enable_mask);
+            } else if (new_guest >= 0) {
+                CPU_SET(cpuid, &disable_mask);
+            }
+        }
+        if (async) {
+            shmem_async_disable_cpus(victims);
+            if (CPU_COUNT(&enable_mask) > 0) {
+                shmem_async_enable_cpu_mask(spd->id, &enable_mask);
+            }
+            if (CPU_COUNT(&disable_mask) > 0) {
+                shmem_async_disable_cpu_mask(spd->id, &disable_mask);
+            }
+        } else {
+            if (CPU_COUNT(&enable_mask) > 0) {
+                enable_cpu_set(&spd->pm, &enable_mask);
+            }
+            if (CPU_COUNT(&disable_mask) > 0) {
+                disable_cpu_set(&spd->pm, &disable_mask);
             }
         }
     }
@@ -150,17 +252,12 @@ int lewi_mask_LendCpu(const subprocess_descriptor_t *spd, int cpuid) {
 }
 
 int lewi_mask_LendCpuMask(const subprocess_descriptor_t *spd, const cpu_set_t *mask) {
+    int node_size = get_node_size(spd);
     pid_t new_guests[node_size];
     int error = shmem_cpuinfo__lend_cpu_mask(spd->id, mask, new_guests);
     if (error == DLB_SUCCESS) {
         if (spd->options.mode == MODE_ASYNC) {
-            int cpuid;
-            for (cpuid=0; cpuid<node_size; ++cpuid) {
-                pid_t new_guest = new_guests[cpuid];
-                if (new_guest > 0) {
-                    shmem_async_enable_cpu(new_guest, cpuid);
-                }
-            }
+            shmem_async_enable_cpus(new_guests);
         }
     }
     return error;
@@ -172,30 +269,12 @@ int lewi_mask_LendCpuMask(const subprocess_descriptor_t *spd, const cpu_set_t *m
 /*********************************************************************************/
 
 int lewi_mask_Reclaim(const subprocess_descriptor_t *spd) {
+    int node_size = get_node_size(spd);
     pid_t new_guests[node_size];
     pid_t victims[node_size];
     int error = shmem_cpuinfo__reclaim_all(spd->id, new_guests, victims);
     if (error == DLB_SUCCESS || error == DLB_NOTED) {
-        bool async = spd->options.mode == MODE_ASYNC;
-        int cpuid;
-        for (cpuid=0; cpuid<node_size; ++cpuid) {
-            pid_t new_guest = new_guests[cpuid];
-            pid_t victim = victims[cpuid];
-            if (async) {
-                if (victim > 0) {
-                    /* If the CPU is guested, just disable visitor */
-                    shmem_async_disable_cpu(victim, cpuid);
-                } else if (new_guest == spd->id) {
-                    /* Only enable if the CPU is free */
-                    shmem_async_enable_cpu(new_guest, cpuid);
-                }
-            } else {
-                if (new_guest == spd->id) {
-                    /* Oversubscribe even if the CPU is guested */
-                    enable_cpu(&spd->pm, cpuid);
-                }
-            }
-        }
+        notify_reclaimed_cpus(spd, new_guests, victims);
     }
     return error;
 }
@@ -224,59 +303,23 @@ int lewi_mask_ReclaimCpu(const subprocess_descriptor_t *spd, int cpuid) {
 }
 
 int lewi_mask_ReclaimCpus(const subprocess_descriptor_t *spd, int ncpus) {
+    int node_size = get_node_size(spd);
     pid_t new_guests[node_size];
     pid_t victims[node_size];
     int error = shmem_cpuinfo__reclaim_cpus(spd->id, ncpus, new_guests, victims);
     if (error == DLB_SUCCESS || error == DLB_NOTED) {
-        bool async = spd->options.mode == MODE_ASYNC;
-        int cpuid;
-        for (cpuid=0; cpuid<node_size; ++cpuid) {
-            pid_t new_guest = new_guests[cpuid];
-            pid_t victim = victims[cpuid];
-            if (async) {
-                if (victim > 0) {
-                    /* If the CPU is guested, just disable visitor */
-                    shmem_async_disable_cpu(victim, cpuid);
-                } else if (new_guest == spd->id) {
-                    /* Only enable if the CPU is free */
-                    shmem_async_enable_cpu(new_guest, cpuid);
-                }
-            } else {
-                if (new_guest == spd->id) {
-                    /* Oversubscribe even if the CPU is guested */
-                    enable_cpu(&spd->pm, cpuid);
-                }
-            }
-        }
+        notify_reclaimed_cpus(spd, new_guests, victims);
     }
     return error;
 }
 
 int lewi_mask_ReclaimCpuMask(const subprocess_descriptor_t *spd, const cpu_set_t *mask) {
+    int node_size = get_node_size(spd);
     pid_t new_guests[node_size];
     pid_t victims[node_size];
     int error = shmem_cpuinfo__reclaim_cpu_mask(spd->id, mask, new_guests, victims);
     if (error == DLB_SUCCESS || error == DLB_NOTED) {
-        bool async = spd->options.mode == MODE_ASYNC;
-        int cpuid;
-        for (cpuid=0; cpuid<node_size; ++cpuid) {
-            pid_t new_guest = new_guests[cpuid];
-            pid_t victim = victims[cpuid];
-            if (async) {
-                if (victim > 0) {
-                    /* If the CPU is guested, just disable visitor */
-                    shmem_async_disable_cpu(victim, cpuid);
-                } else if (new_guest == spd->id) {
-                    /* Only enable if the CPU is free */
-                    shmem_async_enable_cpu(new_guest, cpuid);
-                }
-            } else {
-                if (new_guest == spd->id) {
-                    /* Oversubscribe even if the CPU is guested */
-                    enable_cpu(&spd->pm, cpuid);
-                }
-            }
-        }
+        notify_reclaimed_cpus(spd, new_guests, victims);
     }
     return error;
 }
@@ -310,62 +353,28 @@ int lewi_mask_AcquireCpu(const subprocess_descriptor_t *spd, int cpuid) {
 }
 
 int lewi_mask_AcquireCpus(const subprocess_descriptor_t *spd, int ncpus) {
+    int node_size = get_node_size(spd);
     pid_t new_guests[node_size];
     pid_t victims[node_size];
     bool async = spd->options.mode == MODE_ASYNC;
     int64_t *last_borrow = async ? NULL : &((lewi_info_t*)spd->lewi_info)->last_borrow;
-    int *cpus_priority_array = ((lewi_info_t*)spd->lewi_info)->cpus_priority_array;
+    int cpus_priority_array[node_size];
+    get_cpus_priority_array(spd, cpus_priority_array);
     int error = shmem_cpuinfo__acquire_cpus(spd->id, spd->options.lewi_affinity,
             cpus_priority_array, last_borrow, ncpus, new_guests, victims);
     if (error == DLB_SUCCESS || error == DLB_NOTED) {
-        int cpuid;
-        for (cpuid=0; cpuid<node_size; ++cpuid) {
-            pid_t new_guest = new_guests[cpuid];
-            pid_t victim = victims[cpuid];
-            if (async) {
-                if (victim > 0) {
-                    /* If the CPU is guested, just disable visitor */
-                    shmem_async_disable_cpu(victim, cpuid);
-                } else if (new_guest == spd->id) {
-                    /* Only enable if the CPU is free */
-                    shmem_async_enable_cpu(new_guest, cpuid);
-                }
-            } else {
-                if (new_guest == spd->id) {
-                    /* Oversubscribe even if the CPU is guested */
-                    enable_cpu(&spd->pm, cpuid);
-                }
-            }
-        }
+        notify_reclaimed_cpus(spd, new_guests, victims);
     }
     return error;
 }
 
 int lewi_mask_AcquireCpuMask(const subprocess_descriptor_t *spd, const cpu_set_t *mask) {
+    int node_size = get_node_size(spd);
     pid_t new_guests[node_size];
     pid_t victims[node_size];
     int error = shmem_cpuinfo__acquire_cpu_mask(spd->id, mask, new_guests, victims);
     if (error == DLB_SUCCESS || error == DLB_NOTED) {
-        bool async = spd->options.mode == MODE_ASYNC;
-        int cpuid;
-        for (cpuid=0; cpuid<node_size; ++cpuid) {
-            pid_t new_guest = new_guests[cpuid];
-            pid_t victim = victims[cpuid];
-            if (async) {
-                if (victim > 0) {
-                    /* If the CPU is guested, just disable visitor */
-                    shmem_async_disable_cpu(victim, cpuid);
-                } else if (new_guest == spd->id) {
-                    /* Only enable if the CPU is free */
-                    shmem_async_enable_cpu(new_guest, cpuid);
-                }
-            } else {
-                if (new_guest == spd->id) {
-                    /* Oversubscribe even if the CPU is guested */
-                    enable_cpu(&spd->pm, cpuid);
-                }
-            }
-        }
+        notify_reclaimed_cpus(spd, new_guests, victims);
     }
     return error;
 }
@@ -376,23 +385,16 @@ int lewi_mask_AcquireCpuMask(const subprocess_descriptor_t *spd, const cpu_set_t
 /*********************************************************************************/
 
 int lewi_mask_Borrow(const subprocess_descriptor_t *spd) {
+    int node_size = get_node_size(spd);
     pid_t new_guests[node_size];
     bool async = spd->options.mode == MODE_ASYNC;
     int64_t *last_borrow = async ? NULL : &((lewi_info_t*)spd->lewi_info)->last_borrow;
-    int *cpus_priority_array = ((lewi_info_t*)spd->lewi_info)->cpus_priority_array;
+    int cpus_priority_array[node_size];
+    get_cpus_priority_array(spd, cpus_priority_array);
     int error = shmem_cpuinfo__borrow_all(spd->id, spd->options.lewi_affinity,
             cpus_priority_array, last_borrow, new_guests);
     if (error == DLB_SUCCESS) {
-        int cpuid;
-        for (cpuid=0; cpuid<node_size; ++cpuid) {
-            if (new_guests[cpuid] == spd->id) {
-                if (async) {
-                    shmem_async_enable_cpu(spd->id, cpuid);
-                } else {
-                    enable_cpu(&spd->pm, cpuid);
-                }
-            }
-        }
+        notify_borrowed_cpus(spd, new_guests);
     }
     return error;
 }
@@ -413,42 +415,26 @@ int lewi_mask_BorrowCpu(const subprocess_descriptor_t *spd, int cpuid) {
 }
 
 int lewi_mask_BorrowCpus(const subprocess_descriptor_t *spd, int ncpus) {
+    int node_size = get_node_size(spd);
     pid_t new_guests[node_size];
     bool async = spd->options.mode == MODE_ASYNC;
     int64_t *last_borrow = async ? NULL : &((lewi_info_t*)spd->lewi_info)->last_borrow;
-    int *cpus_priority_array = ((lewi_info_t*)spd->lewi_info)->cpus_priority_array;
+    int cpus_priority_array[node_size];
+    get_cpus_priority_array(spd, cpus_priority_array);
     int error = shmem_cpuinfo__borrow_cpus(spd->id, spd->options.lewi_affinity,
             cpus_priority_array, last_borrow, ncpus, new_guests);
     if (error == DLB_SUCCESS) {
-        int cpuid;
-        for (cpuid=0; cpuid<node_size; ++cpuid) {
-            if (new_guests[cpuid] == spd->id) {
-                if (async) {
-                    shmem_async_enable_cpu(spd->id, cpuid);
-                } else {
-                    enable_cpu(&spd->pm, cpuid);
-                }
-            }
-        }
+        notify_borrowed_cpus(spd, new_guests);
     }
     return error;
 }
 
 int lewi_mask_BorrowCpuMask(const subprocess_descriptor_t *spd, const cpu_set_t *mask) {
+    int node_size = get_node_size(spd);
     pid_t new_guests[node_size];
     int error = shmem_cpuinfo__borrow_cpu_mask(spd->id, mask, new_guests);
     if (error == DLB_SUCCESS) {
-        bool async = spd->options.mode == MODE_ASYNC;
-        int cpuid;
-        for (cpuid=0; cpuid<node_size; ++cpuid) {
-            if (new_guests[cpuid] == spd->id) {
-                if (async) {
-                    shmem_async_enable_cpu(spd->id, cpuid);
-                } else {
-                    enable_cpu(&spd->pm, cpuid);
-                }
-            }
-        }
+        notify_borrowed_cpus(spd, new_guests);
     }
     return error;
 }
@@ -459,6 +445,7 @@ int lewi_mask_BorrowCpuMask(const subprocess_descriptor_t *spd, const cpu_set_t
 /*********************************************************************************/
 
 int lewi_mask_Return(const subprocess_descriptor_t *spd) {
+    int node_size = get_node_size(spd);
     if (spd->options.mode == MODE_ASYNC) {
         // ReturnAll should not be called in async mode
         return DLB_ERR_NOCOMP;
@@ -467,13 +454,7 @@ int lewi_mask_Return(const subprocess_descriptor_t *spd) {
     pid_t new_guests[node_size];
     int error = shmem_cpuinfo__return_all(spd->id, new_guests);
     if (error == DLB_SUCCESS) {
-        int cpuid;
-        for (cpuid=0; cpuid<node_size; ++cpuid) {
-            pid_t new_guest = new_guests[cpuid];
-            if (new_guest >= 0 && new_guest != spd->id) {
-                disable_cpu(&spd->pm, cpuid);
-            }
-        }
+        notify_returned_cpus(spd, new_guests);
     }
     return error;
 }
@@ -496,23 +477,11 @@ int lewi_mask_ReturnCpu(const subprocess_descriptor_t *spd, int cpuid) {
 }
 
 int lewi_mask_ReturnCpuMask(const subprocess_descriptor_t *spd, const cpu_set_t *mask) {
+    int node_size = get_node_size(spd);
     pid_t new_guests[node_size];
     int error = shmem_cpuinfo__return_cpu_mask(spd->id, mask, new_guests);
     if (error == DLB_SUCCESS) {
-        bool async = spd->options.mode == MODE_ASYNC;
-        int cpuid;
-        for (cpuid=0; cpuid<node_size; ++cpuid) {
-            pid_t new_guest = new_guests[cpuid];
-            if (async) {
-                if (new_guest > 0) {
-                    shmem_async_enable_cpu(new_guest, cpuid);
-                }
-            } else {
-                if (new_guest >= 0 && new_guest != spd->id) {
-                    disable_cpu(&spd->pm, cpuid);
-                }
-            }
-        }
+        notify_returned_cpus(spd, new_guests);
     }
     return error;
 }
@@ -532,6 +501,7 @@ int lewi_mask_CheckCpuAvailability(const subprocess_descriptor_t *spd, int cpuid
  */
 int lewi_mask_UpdateOwnershipInfo(const subprocess_descriptor_t *spd,
         const cpu_set_t *process_mask) {
+    int node_size = get_node_size(spd);
     int *prio1 = malloc(node_size*sizeof(int));
     int *prio2 = malloc(node_size*sizeof(int));
     int *prio3 = malloc(node_size*sizeof(int));
@@ -568,12 +538,16 @@ int lewi_mask_UpdateOwnershipInfo(const subprocess_descriptor_t *spd,
         }
     }
 
-    /* Merge [<[prio1][prio2][prio3][-1]>] */
-    int *cpus_priority_array = ((lewi_info_t*)spd->lewi_info)->cpus_priority_array;
+    /* Merge [<[prio1][prio2][prio3][-1]>] aside, then publish it at once */
+    int cpus_priority_array[node_size];
     memmove(&cpus_priority_array[0], prio1, sizeof(int)*i1);
     memmove(&cpus_priority_array[i1], prio2, sizeof(int)*i2);
     memmove(&cpus_priority_array[i1+i2], prio3, sizeof(int)*i3);
     for (i=i1+i2+i3; i<node_size; ++i) cpus_priority_array[i] = -1;
+    lewi_info_t *lewi_info = spd->lewi_info;
+    pthread_mutex_lock(&lewi_info->mutex);
+    memcpy(lewi_info->cpus_priority_array, cpus_priority_array, sizeof(int)*node_size);
+    pthread_mutex_unlock(&lewi_info->mutex);
 
     free(prio1);
     free(prio2);
@@ -0,0 +1,280 @@
+/*********************************************************************************/
+/*  Copyright 2017 Barcelona Supercomputing Center                               */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <http://www.gnu.org/licenses/>.                 */
+/*********************************************************************************/
+
+#include "LB_policies/lewi_predict.h"
+
+#include "LB_policies/lewi_mask.h"
+#include "LB_comm/shmem_cpuinfo.h"
+#include "LB_comm/shmem_procinfo.h"
+#include "LB_core/spd.h"
+#include "apis/dlb_errors.h"
+#include "support/debug.h"
+#include "support/mask_utils.h"
+#include "support/tracing.h"
+#include "support/mytime.h"
+
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+/* LeWI_predict: LeWI_mask driven by the iteration pattern of the blocking
+ * calls. The iteration boundaries are detected by DPD on the MPI calls; once
+ * two consecutive iterations have the same number of blocking calls, the
+ * duration of each blocking call in the iteration is predicted from the
+ * previous iterations:
+ *  - CPUs are lent at the beginning of a blocking call only if its predicted
+ *    duration is longer than --lewi-predict-threshold, so short calls do not
+ *    pay a lend and reclaim.
+ *  - A helper thread reclaims the CPUs shortly before the predicted end of the
+ *    call, so they are back when the process leaves it. In polling mode the
+ *    programming model is only called from the application thread, so the
+ *    helper only updates the shared memory and the reclaimed CPUs are enabled
+ *    when the process leaves the call.
+ *  - The time until that reclaim is published as the expected lend duration,
+ *    so borrowers prefer the CPUs lent in the longest calls.
+ * The period and the iteration time are traced and published to procinfo. */
+
+enum { MAX_CALLS = 64 };
+
+typedef struct LeWI_predict_info {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    pthread_t helper_pth;
+    bool helper_running;
+    int64_t threshold;          // ns, lend only if the predicted call is longer
+    int64_t deadline;           // ns, pre-reclaim time of the current call, 0 if none
+    bool lent;                  // CPUs lent in the current call
+    cpu_set_t pending_mask;     // CPUs reclaimed by the helper, not yet enabled
+    int call;                   // blocking calls since the iteration start
+    int ncalls;                 // blocking calls per iteration, 0 if unknown
+    int iter_num;
+    int64_t iter_start;         // ns
+    int64_t call_start;         // ns
+    int64_t expected[MAX_CALLS];// ns, expected duration of each blocking call
+} predict_info_t;
+
+static inline int get_nthreads(const subprocess_descriptor_t *spd) {
+    cpu_set_t mask;
+    if (shmem_cpuinfo__get_guested_cpus(spd->id, &mask) != DLB_SUCCESS) return 0;
+    return CPU_COUNT(&mask);
+}
+
+/* Predicted duration of the current call, 0 if unknown */
+static int64_t get_prediction(const predict_info_t *info) {
+    if (info->ncalls == 0) return 0;
+    return info->expected[info->call % info->ncalls];
+}
+
+/* Reclaim the lent CPUs, if any. Mutex must be held. Unless notify_pm is
+ * set, in polling mode the CPUs to enable are only added to pending_mask */
+static int reclaim_lent(const subprocess_descriptor_t *spd, bool notify_pm) {
+    predict_info_t *info = spd->policy_info;
+    int error = DLB_NOUPDT;
+    if (info->lent) {
+        info->lent = false;
+        if (notify_pm || spd->options.mode == MODE_ASYNC) {
+            error = lewi_mask_Reclaim(spd);
+        } else {
+            int node_size = mu_get_system_size();
+            pid_t new_guests[node_size];
+            pid_t victims[node_size];
+            error = shmem_cpuinfo__reclaim_all(spd->id, new_guests, victims);
+            if (error == DLB_SUCCESS || error == DLB_NOTED) {
+                int cpuid;
+                for (cpuid=0; cpuid<node_size; ++cpuid) {
+                    if (new_guests[cpuid] == spd->id) {
+                        CPU_SET(cpuid, &info->pending_mask);
+                    }
+                }
+            }
+        }
+        shmem_cpuinfo__set_lend_duration(spd->id, 0);
+        add_event(THREADS_USED_EVENT, get_nthreads(spd));
+    }
+    info->deadline = 0;
+    return error;
+}
+
+static void* predict_helper(void *arg) {
+    const subprocess_descriptor_t *spd = arg;
+    predict_info_t *info = spd->policy_info;
+    pthread_mutex_lock(&info->mutex);
+    while (info->helper_running) {
+        if (info->deadline == 0) {
+            pthread_cond_wait(&info->cond, &info->mutex);
+        } else if (get_time_in_ns() < info->deadline) {
+            struct timespec deadline = {
+                .tv_sec = info->deadline / 1000000000LL,
+                .tv_nsec = info->deadline % 1000000000LL,
+            };
+            pthread_cond_timedwait(&info->cond, &info->mutex, &deadline);
+        } else {
+            verbose(VB_MICROLB, "Reclaiming CPUs before the predicted end of call %d",
+                    info->call);
+            reclaim_lent(spd, false);
+        }
+    }
+    pthread_mutex_unlock(&info->mutex);
+    return NULL;
+}
+
+/* A new iteration starts with the call that has just finished */
+static void new_iteration(const subprocess_descriptor_t *spd) {
+    predict_info_t *info = spd->policy_info;
+    if (info->iter_num > 0) {
+        double iter_time = (info->call_start - info->iter_start) / 1e9;
+        int ncalls = info->call <= MAX_CALLS ? info->call : 0;
+        if (ncalls != info->ncalls) {
+            /* New pattern, previous predictions do not apply */
+            verbose(VB_MICROLB, "Iteration pattern of %d blocking calls", ncalls);
+            memset(info->expected, 0, sizeof(info->expected));
+            info->ncalls = ncalls;
+        }
+        verbose(VB_MICROLB, "Iter %d: %.4f", info->iter_num, iter_time);
+        add_event(ITERATION_TIME_EVENT, (long)(iter_time * 1e6));
+        shmem_procinfo__setiterinfo(spd->id, info->ncalls, iter_time);
+    }
+    add_event(ITERATION_EVENT, info->iter_num);
+    ++info->iter_num;
+    info->iter_start = info->call_start;
+    info->call = 0;
+}
+
+int lewi_predict_Init(subprocess_descriptor_t *spd) {
+    verbose(VB_MICROLB, "LeWI_predict Init");
+
+    int error = lewi_mask_Init(spd);
+    if (error != DLB_SUCCESS) return error;
+
+    /* Allocate and initialize private structure */
+    predict_info_t *info = malloc(sizeof(predict_info_t));
+    pthread_mutex_init(&info->mutex, NULL);
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&info->cond, &attr);
+    pthread_condattr_destroy(&attr);
+    info->threshold = (int64_t)spd->options.lewi_predict_threshold * 1000;
+    info->deadline = 0;
+    info->lent = false;
+    CPU_ZERO(&info->pending_mask);
+    info->call = 0;
+    info->ncalls = 0;
+    info->iter_num = 0;
+    info->iter_start = get_time_in_ns();
+    info->call_start = info->iter_start;
+    memset(info->expected, 0, sizeof(info->expected));
+    spd->policy_info = info;
+
+    info->helper_running = true;
+    pthread_create(&info->helper_pth, NULL, predict_helper, spd);
+
+    return DLB_SUCCESS;
+}
+
+int lewi_predict_Finalize(subprocess_descriptor_t *spd) {
+    predict_info_t *info = spd->policy_info;
+
+    /* Stop helper thread */
+    pthread_mutex_lock(&info->mutex);
+    info->helper_running = false;
+    pthread_cond_signal(&info->cond);
+    pthread_mutex_unlock(&info->mutex);
+    pthread_join(info->helper_pth, NULL);
+
+    /* De-allocate private structure */
+    pthread_cond_destroy(&info->cond);
+    pthread_mutex_destroy(&info->mutex);
+    free(info);
+    spd->policy_info = NULL;
+
+    return lewi_mask_Finalize(spd);
+}
+
+/* Into Blocking Call - Lend all the CPUs but the current one if the call is
+ * predicted to be long */
+int lewi_predict_IntoBlockingCall(const subprocess_descriptor_t *spd) {
+    predict_info_t *info = spd->policy_info;
+    int error = DLB_NOUPDT;
+    pthread_mutex_lock(&info->mutex);
+    {
+        info->call_start = get_time_in_ns();
+        int64_t prediction = get_prediction(info);
+        if (prediction > 0 && prediction >= info->threshold) {
+            /* Reclaim ahead of the predicted end by a fraction of the call */
+            info->deadline = info->call_start + prediction - prediction / 8;
+            shmem_cpuinfo__set_lend_duration(spd->id, info->deadline - info->call_start);
+            error = lewi_mask_Lend(spd);
+            if (spd->options.lewi_mpi) {
+                error = lewi_mask_LendCpu(spd, sched_getcpu());
+            }
+            info->lent = true;
+            pthread_cond_signal(&info->cond);
+            add_event(THREADS_USED_EVENT, get_nthreads(spd));
+        } else if (spd->options.lewi_mpi) {
+            error = lewi_mask_LendCpu(spd, sched_getcpu());
+        }
+    }
+    pthread_mutex_unlock(&info->mutex);
+    return error;
+}
+
+/* Out of Blocking Call - Update the prediction of this call and recover the
+ * CPUs if the helper did not already */
+int lewi_predict_OutOfBlockingCall(const subprocess_descriptor_t *spd, int is_iter) {
+    predict_info_t *info = spd->policy_info;
+    int error;
+    pthread_mutex_lock(&info->mutex);
+    {
+        error = reclaim_lent(spd, true);
+        if (CPU_COUNT(&info->pending_mask) > 0) {
+            /* Oversubscribe even if the CPUs are still guested, as LeWI_mask */
+            enable_cpu_set(&spd->pm, &info->pending_mask);
+            CPU_ZERO(&info->pending_mask);
+            error = DLB_SUCCESS;
+        }
+        if (spd->options.lewi_mpi) {
+            error = lewi_mask_AcquireCpu(spd, sched_getcpu());
+        }
+
+        if (is_iter) {
+            new_iteration(spd);
+        }
+
+        if (info->ncalls > 0) {
+            int64_t *expected = &info->expected[info->call % info->ncalls];
+            int64_t duration = get_time_in_ns() - info->call_start;
+            *expected = *expected == 0 ? duration : (*expected * 3 + duration) / 4;
+        }
+        ++info->call;
+    }
+    pthread_mutex_unlock(&info->mutex);
+    return error;
+}
+
+int lewi_predict_GetPeriod(const subprocess_descriptor_t *spd) {
+    predict_info_t *info = spd->policy_info;
+    return info->ncalls;
+}
+
+int64_t lewi_predict_GetPrediction(const subprocess_descriptor_t *spd) {
+    predict_info_t *info = spd->policy_info;
+    return get_prediction(info);
+}
@@ -0,0 +1,417 @@
+/*********************************************************************************/
+/*  Copyright 2017 Barcelona Supercomputing Center                               */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <http://www.gnu.org/licenses/>.                 */
+/*********************************************************************************/
+
+#include "LB_policies/lewi_rebalance.h"
+
+#include "LB_policies/lewi_mask.h"
+#include "LB_comm/shmem_cpuinfo.h"
+#include "LB_comm/shmem_procinfo.h"
+#include "LB_core/DLB_kernel.h"
+#include "LB_core/spd.h"
+#include "LB_numThreads/numThreads.h"
+#include "apis/dlb_errors.h"
+#include "support/debug.h"
+#include "support/error.h"
+#include "support/mask_utils.h"
+#include "support/rebalance.h"
+#include "support/tracing.h"
+#include "support/mytime.h"
+
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/* LeWI_rebalance: LeWI_mask that turns a persistent imbalance into a permanent
+ * redistribution of the CPU ownership. Every process measures, over a window
+ * of --lewi-rebalance-window iterations, its work (time outside blocking calls
+ * multiplied by the CPUs in use) and the fraction of the iteration it spends
+ * blocked, and publishes them to procinfo. The participant with the lowest pid
+ * acts as coordinator: once every participant has published a new window
+ * measured with its current mask, it computes a partition of their CPUs
+ * proportional to their work and applies it atomically through DROM. Each
+ * process takes its new mask at its next iteration boundary.
+ *
+ * Convergence control:
+ *  - The CPUs are not redistributed while the work per CPU of every process
+ *    is within --lewi-rebalance-tolerance of the average.
+ *  - A repartition only moves a fraction (gain) of the way towards the ideal
+ *    partition, or all the way if that is less than one CPU. The gain is
+ *    halved every time a process would change direction, and no repartition
+ *    is done once it would oscillate at the minimum gain.
+ *  - A process only lends its CPUs in blocking calls while it blocks for
+ *    more than the tolerance fraction of the iteration, so the lend and
+ *    reclaim of every iteration stop once the ownership is balanced. */
+
+enum { MIN_CPUS = 1 };
+static const double INITIAL_GAIN = 0.5;
+static const double MIN_GAIN = 0.125;
+
+/* Coordinator view of each participant */
+typedef struct Participant {
+    pid_t pid;
+    unsigned int window;        // last window evaluated
+    int direction;              // sign of the last change of CPUs
+} participant_t;
+
+typedef struct LeWI_rebalance_info {
+    int window_size;            // iterations per measurement window
+    double tolerance;
+    bool lend;                  // lend the CPUs in blocking calls
+    bool lent;                  // CPUs lent in the current call
+    int ncpus;                  // CPUs owned during the current window
+    int active;                 // CPUs in use since the last blocking call
+    bool measuring;             // an iteration boundary has been seen
+    int iters;                  // iterations in the current window
+    int64_t last_out;           // ns, end of the last blocking call
+    int64_t call_start;         // ns, start of the current blocking call
+    int64_t compute_time;       // ns, outside blocking calls in the current window
+    int64_t blocked_time;       // ns, inside blocking calls in the current window
+    double work;                // CPU ns, outside blocking calls in the current window
+    unsigned int windows;       // windows published
+    /* Coordinator state */
+    bool pending;               // a window was published since the last evaluation
+    double gain;
+    int repartitions;
+    int max_participants;
+    participant_t *participants;
+} rebalance_info_t;
+
+static inline int get_nthreads(const subprocess_descriptor_t *spd) {
+    cpu_set_t mask;
+    if (shmem_cpuinfo__get_guested_cpus(spd->id, &mask) != DLB_SUCCESS) return 0;
+    return CPU_COUNT(&mask);
+}
+
+static void reset_window(rebalance_info_t *info) {
+    info->iters = 0;
+    info->compute_time = 0;
+    info->blocked_time = 0;
+    info->work = 0.0;
+}
+
+/* An iteration finishes at the start of the blocking call that has just ended */
+static void end_iteration(const subprocess_descriptor_t *spd) {
+    rebalance_info_t *info = spd->policy_info;
+    if (!info->measuring) {
+        info->measuring = true;
+        reset_window(info);
+        return;
+    }
+
+    if (++info->iters < info->window_size) return;
+
+    int64_t iter_time = info->compute_time + info->blocked_time;
+    process_balance_t balance = {
+        .window = ++info->windows,
+        .ncpus = info->ncpus,
+        .work = info->work / info->iters / 1e9,
+        .blocked_fraction = iter_time > 0 ? (double)info->blocked_time / iter_time : 0.0,
+    };
+    shmem_procinfo__setbalance(spd->id, &balance);
+    verbose(VB_MICROLB, "Window %u: %d CPUs, work %.4f, blocked %.2f%%", balance.window,
+            balance.ncpus, balance.work, balance.blocked_fraction * 100);
+
+    bool lend = balance.blocked_fraction > info->tolerance;
+    if (lend != info->lend) {
+        verbose(VB_MICROLB, "%s lending CPUs in blocking calls", lend ? "Resume" : "Stop");
+        info->lend = lend;
+    }
+    info->pending = true;
+    reset_window(info);
+}
+
+static participant_t* get_participant(rebalance_info_t *info, pid_t pid) {
+    int i;
+    for (i = 0; i < info->max_participants; ++i) {
+        participant_t *participant = &info->participants[i];
+        if (participant->pid == pid) return participant;
+        if (participant->pid == 0) {
+            participant->pid = pid;
+            participant->window = 0;
+            participant->direction = 0;
+            return participant;
+        }
+    }
+    return NULL;
+}
+
+/* Whether some process would change its CPUs in the opposite direction than
+ * in the last repartition */
+static bool oscillates(const rebalance_process_t *procs, participant_t **participants,
+        int nprocs) {
+    int i;
+    for (i = 0; i < nprocs; ++i) {
+        int change = CPU_COUNT(&procs[i].new_mask) - CPU_COUNT(&procs[i].mask);
+        int direction = (change > 0) - (change < 0);
+        if (direction != 0 && direction == -participants[i]->direction) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Coordinator only: redistribute the CPUs of all the participants if every one
+ * of them has published a new window measured with its current mask */
+static void try_rebalance(const subprocess_descriptor_t *spd) {
+    rebalance_info_t *info = spd->policy_info;
+    int max_procs = info->max_participants;
+    pid_t pidlist[max_procs];
+    int npids;
+    shmem_procinfo__getpidlist(pidlist, &npids, max_procs);
+
+    rebalance_process_t procs[max_procs];
+    participant_t *participants[max_procs];
+    unsigned int windows[max_procs];
+    double work[max_procs];
+    int nprocs = 0;
+    int i;
+    for (i = 0; i < npids; ++i) {
+        process_balance_t balance;
+        if (shmem_procinfo__getbalance(pidlist[i], &balance) != DLB_SUCCESS
+                || balance.window == 0) {
+            // Not a participant
+            continue;
+        }
+        if (pidlist[i] < spd->id) {
+            // Not the coordinator
+            info->pending = false;
+            return;
+        }
+
+        rebalance_process_t *proc = &procs[nprocs];
+        proc->pid = pidlist[i];
+        if (shmem_procinfo__getprocessmask(proc->pid, &proc->mask, 0) != DLB_SUCCESS) {
+            return;
+        }
+        participants[nprocs] = get_participant(info, proc->pid);
+        if (participants[nprocs] == NULL) return;
+        if (balance.window == participants[nprocs]->window
+                || balance.ncpus != CPU_COUNT(&proc->mask)) {
+            // Wait for a window measured with the current mask
+            return;
+        }
+        windows[nprocs] = balance.window;
+        work[nprocs] = balance.work;
+        ++nprocs;
+    }
+    if (nprocs == 0) return;
+
+    info->pending = false;
+    for (i = 0; i < nprocs; ++i) {
+        participants[i]->window = windows[i];
+    }
+    if (nprocs < 2) return;
+
+    /* Load imbalance: maximum work per CPU relative to the average */
+    int total_cpus = 0;
+    double total_work = 0.0;
+    double max_work_per_cpu = 0.0;
+    for (i = 0; i < nprocs; ++i) {
+        int ncpus = CPU_COUNT(&procs[i].mask);
+        total_cpus += ncpus;
+        total_work += work[i];
+        if (work[i] / ncpus > max_work_per_cpu) {
+            max_work_per_cpu = work[i] / ncpus;
+        }
+    }
+    if (total_work <= 0.0) return;
+    double imbalance = max_work_per_cpu / (total_work / total_cpus) - 1.0;
+    if (imbalance <= info->tolerance) {
+        verbose(VB_MICROLB, "Load imbalance %.2f%% within tolerance", imbalance * 100);
+        return;
+    }
+
+    /* Move a fraction of the way towards the partition proportional to the work */
+    rebalance_config_t config = {
+        .min_cpus = MIN_CPUS,
+        .min_change = 1,
+        .hysteresis = 0.0,
+    };
+    double ideal[nprocs];
+    double max_diff = 0.0;
+    for (i = 0; i < nprocs; ++i) {
+        ideal[i] = total_cpus * work[i] / total_work;
+        double diff = fabs(ideal[i] - CPU_COUNT(&procs[i].mask));
+        if (diff > max_diff) max_diff = diff;
+    }
+    if (max_diff < 0.5) {
+        verbose(VB_MICROLB, "Load imbalance %.2f%%, partition converged", imbalance * 100);
+        return;
+    }
+    while (true) {
+        // Corrections smaller than one CPU are applied at once
+        double gain = info->gain * max_diff >= 1.0 ? info->gain : 1.0;
+        for (i = 0; i < nprocs; ++i) {
+            int ncpus = CPU_COUNT(&procs[i].mask);
+            procs[i].demand = ncpus + gain * (ideal[i] - ncpus);
+        }
+
+        int changed = rebalance_compute(&config, procs, nprocs, NULL, 0);
+        if (changed <= 0) return;
+        if (!oscillates(procs, participants, nprocs)) break;
+        if (info->gain <= MIN_GAIN) {
+            verbose(VB_MICROLB, "Load imbalance %.2f%%, partition oscillates", imbalance * 100);
+            return;
+        }
+        info->gain /= 2;
+    }
+
+    pid_t pids[nprocs];
+    cpu_set_t masks[nprocs];
+    for (i = 0; i < nprocs; ++i) {
+        pids[i] = procs[i].pid;
+        memcpy(&masks[i], &procs[i].new_mask, sizeof(cpu_set_t));
+    }
+    int error = shmem_procinfo__setprocessmasks(pids, masks, nprocs, 0);
+    if (error != DLB_SUCCESS) {
+        verbose(VB_MICROLB, "Repartition not applied: %s", error_get_str(error));
+        return;
+    }
+
+    ++info->repartitions;
+    for (i = 0; i < nprocs; ++i) {
+        int change = CPU_COUNT(&masks[i]) - CPU_COUNT(&procs[i].mask);
+        participants[i]->direction = (change > 0) - (change < 0);
+        verbose(VB_MICROLB, "Repartition %d: process %d, %d -> %d CPUs", info->repartitions,
+                pids[i], CPU_COUNT(&procs[i].mask), CPU_COUNT(&masks[i]));
+    }
+}
+
+/* Apply the new process mask, if any, and restart the measurement if the
+ * number of owned CPUs has changed */
+static void update_mask(const subprocess_descriptor_t *spd) {
+    rebalance_info_t *info = spd->policy_info;
+    cpu_set_t mask;
+    if (update_drom_mask(spd, NULL, &mask) == DLB_SUCCESS) {
+        set_process_mask(&spd->pm, &mask);
+    }
+    if (shmem_procinfo__getprocessmask(spd->id, &mask, 0) == DLB_SUCCESS
+            && CPU_COUNT(&mask) != info->ncpus) {
+        verbose(VB_MICROLB, "Owned CPUs: %d -> %d", info->ncpus, CPU_COUNT(&mask));
+        info->ncpus = CPU_COUNT(&mask);
+        reset_window(info);
+    }
+}
+
+int lewi_rebalance_Init(subprocess_descriptor_t *spd) {
+    verbose(VB_MICROLB, "LeWI_rebalance Init");
+
+    int error = lewi_mask_Init(spd);
+    if (error != DLB_SUCCESS) return error;
+
+    /* Allocate and initialize private structure */
+    rebalance_info_t *info = malloc(sizeof(rebalance_info_t));
+    info->window_size = spd->options.lewi_rebalance_window > 0
+        ? spd->options.lewi_rebalance_window : 1;
+    info->tolerance = spd->options.lewi_rebalance_tolerance / 100.0;
+    info->lend = true;
+    info->lent = false;
+    info->ncpus = CPU_COUNT(&spd->process_mask);
+    info->active = info->ncpus;
+    info->measuring = false;
+    info->last_out = get_time_in_ns();
+    info->call_start = info->last_out;
+    reset_window(info);
+    info->windows = 0;
+    info->pending = false;
+    info->gain = INITIAL_GAIN;
+    info->repartitions = 0;
+    info->max_participants = mu_get_system_size();
+    info->participants = calloc(info->max_participants, sizeof(participant_t));
+    spd->policy_info = info;
+
+    return DLB_SUCCESS;
+}
+
+int lewi_rebalance_Finalize(subprocess_descriptor_t *spd) {
+    /* De-allocate private structure */
+    rebalance_info_t *info = spd->policy_info;
+    free(info->participants);
+    free(info);
+    spd->policy_info = NULL;
+
+    return lewi_mask_Finalize(spd);
+}
+
+/* Into Blocking Call - Lend all the CPUs but the current one unless the process
+ * barely blocks */
+int lewi_rebalance_IntoBlockingCall(const subprocess_descriptor_t *spd) {
+    rebalance_info_t *info = spd->policy_info;
+    int error = DLB_NOUPDT;
+
+    info->call_start = get_time_in_ns();
+    if (info->measuring) {
+        int64_t compute = info->call_start - info->last_out;
+        info->compute_time += compute;
+        info->work += (double)compute * info->active;
+    }
+
+    if (info->lend) {
+        error = lewi_mask_Lend(spd);
+        info->lent = true;
+        add_event(THREADS_USED_EVENT, get_nthreads(spd));
+    }
+    if (spd->options.lewi_mpi) {
+        error = lewi_mask_LendCpu(spd, sched_getcpu());
+    }
+    return error;
+}
+
+/* Out of Blocking Call - Recover the lent CPUs, account the iteration and, at
+ * the iteration boundaries, redistribute and apply the CPU ownership */
+int lewi_rebalance_OutOfBlockingCall(const subprocess_descriptor_t *spd, int is_iter) {
+    rebalance_info_t *info = spd->policy_info;
+    int error = DLB_NOUPDT;
+
+    if (info->lent) {
+        info->lent = false;
+        error = lewi_mask_Reclaim(spd);
+    }
+    if (spd->options.lewi_mpi) {
+        error = lewi_mask_AcquireCpu(spd, sched_getcpu());
+    }
+
+    int64_t now = get_time_in_ns();
+    if (is_iter) {
+        end_iteration(spd);
+        if (info->pending) {
+            try_rebalance(spd);
+        }
+        update_mask(spd);
+    }
+    if (info->measuring) {
+        info->blocked_time += now - info->call_start;
+    }
+
+    info->active = get_nthreads(spd);
+    info->last_out = get_time_in_ns();
+    add_event(THREADS_USED_EVENT, info->active);
+    return error;
+}
+
+int lewi_rebalance_GetRepartitions(const subprocess_descriptor_t *spd) {
+    rebalance_info_t *info = spd->policy_info;
+    return info->repartitions;
+}
+
+bool lewi_rebalance_IsLending(const subprocess_descriptor_t *spd) {
+    rebalance_info_t *info = spd->policy_info;
+    return info->lend;
+}
@@ -0,0 +1,39 @@
+/*********************************************************************************/
+/*  Copyright 2017 Barcelona Supercomputing Center                               */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <http://www.gnu.org/licenses/>.                 */
+/*********************************************************************************/
+
+#ifndef LEWI_REBALANCE_H
+#define LEWI_REBALANCE_H
+
+#include "LB_core/spd.h"
+
+/* LeWI_rebalance policy, built on top of LeWI_mask. The functions that are not
+ * defined here are the LeWI_mask ones */
+
+int lewi_rebalance_Init(subprocess_descriptor_t *spd);
+int lewi_rebalance_Finalize(subprocess_descriptor_t *spd);
+
+int lewi_rebalance_IntoBlockingCall(const subprocess_descriptor_t *spd);
+int lewi_rebalance_OutOfBlockingCall(const subprocess_descriptor_t *spd, int is_iter);
+
+/* Number of repartitions applied by this process as coordinator */
+int lewi_rebalance_GetRepartitions(const subprocess_descriptor_t *spd);
+/* Whether the process currently lends its CPUs in blocking calls */
+bool lewi_rebalance_IsLending(const subprocess_descriptor_t *spd);
+
+#endif /* LEWI_REBALANCE_H */
@@ -109,6 +109,11 @@ int DLB_LendCpuMask(const_dlb_cpu_set_t mask) {
     return lend_cpu_mask(&spd, mask);
 }
 
+int DLB_SetLendDuration(int usecs) {
+    if (!spd.dlb_initialized) return DLB_ERR_NOINIT;
+    return set_lend_duration(&spd, usecs);
+}
+
 
 /* Reclaim */
 
@@ -212,7 +217,26 @@ int DLB_CheckCpuAvailability(int cpuid) {
 }
 
 int DLB_Barrier(void) {
-    return node_barrier();
+    // The default barrier is a no-op if the node barrier is not enabled
+    if (!spd.options.barrier) return DLB_SUCCESS;
+    return node_barrier(NULL);
+}
+
+int DLB_BarrierNamed(const char *barrier_name) {
+    return node_barrier(barrier_name);
+}
+
+int DLB_BarrierAttach(const char *barrier_name) {
+    return node_barrier_attach(barrier_name);
+}
+
+int DLB_BarrierDetach(const char *barrier_name) {
+    return node_barrier_detach(barrier_name);
+}
+
+int DLB_BarrierGetStats(const char *barrier_name, int *episodes, double *avg_skew,
+        double *max_skew, double *imbalance) {
+    return node_barrier_get_stats(barrier_name, episodes, avg_skew, max_skew, imbalance);
 }
 
 int DLB_SetVariable(const char *variable, const char *value) {
@@ -22,6 +22,7 @@
 #include "apis/dlb_drom.h"
 
 #include "apis/DLB_interface.h"
+#include "LB_comm/shmem_async.h"
 #include "LB_comm/shmem_cpuinfo.h"
 #include "LB_comm/shmem_procinfo.h"
 #include "apis/dlb_errors.h"
@@ -93,23 +94,25 @@ static void add_to_environ(const char *name, const char *value, char ***next_env
 #pragma GCC visibility push(default)
 
 int DLB_DROM_Attach(void) {
-    const char *shm_key;
+    char shm_key[MAX_OPTION_LENGTH];
     const options_t *global_options = get_global_options();
     if (global_options) {
-        shm_key = global_options->shm_key;
+        snprintf(shm_key, MAX_OPTION_LENGTH, "%s", global_options->shm_key);
     } else {
         options_t options;
         options_init(&options, NULL);
-        shm_key = options.shm_key;
+        snprintf(shm_key, MAX_OPTION_LENGTH, "%s", options.shm_key);
     }
     shmem_cpuinfo_ext__init(shm_key);
     shmem_procinfo_ext__init(shm_key);
+    shmem_async_ext__init(shm_key);
     return DLB_SUCCESS;
 }
 
 int DLB_DROM_Deattach(void) {
     int error = shmem_cpuinfo_ext__finalize();
     error = error ? error : shmem_procinfo_ext__finalize();
+    error = error ? error : shmem_async_ext__finalize();
     return error;
 }
 
@@ -130,6 +133,11 @@ int DLB_DROM_SetProcessMask(int pid, const_dlb_cpu_set_t mask, dlb_drom_flags_t
     return shmem_procinfo__setprocessmask(pid, mask, flags);
 }
 
+int DLB_DROM_SetProcessMasks(const int *pids, const_dlb_cpu_set_t masks, int n,
+        dlb_drom_flags_t flags) {
+    return shmem_procinfo__setprocessmasks(pids, masks, n, flags);
+}
+
 int DLB_DROM_PreInit(int pid, const_dlb_cpu_set_t mask, dlb_drom_flags_t flags,
         char ***next_environ) {
     /* Set up DROM args */
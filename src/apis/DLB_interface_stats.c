@@ -106,6 +106,23 @@ int DLB_Stats_GetLoadAvg(int pid, double *load) {
     return shmem_procinfo__getloadavg(pid, load);
 }
 
+int DLB_Stats_GetTimeFractions(int pid, double *useful, double *mpi, double *dlb) {
+    return shmem_procinfo__gettimefractions(pid, useful, mpi, dlb);
+}
+
+int DLB_Stats_GetUsefulFractionList(double *usefullist, int *nelems, int max_len) {
+    shmem_procinfo__getusefulfraction_list(usefullist, nelems, max_len);
+    return DLB_SUCCESS;
+}
+
+int DLB_Stats_GetIPC(int pid, double *ipc) {
+    return shmem_procinfo__getipc(pid, ipc);
+}
+
+int DLB_Stats_GetIterationInfo(int pid, int *period, double *iter_time) {
+    return shmem_procinfo__getiterinfo(pid, period, iter_time);
+}
+
 int DLB_Stats_GetCpuStateIdle(int cpu, float *percentage) {
     *percentage = shmem_cpuinfo_ext__getcpustate(cpu, STATS_IDLE);
     return DLB_SUCCESS;
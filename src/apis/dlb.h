@@ -108,7 +108,9 @@ int DLB_SetMaxParallelism(int max);
  *  Register a new \p callback for the callback type \p which. The callback
  *  type comes predefined by the enum values of ::dlb_callbacks_t.  It is
  *  highly recommended to register at least callbacks for
- *  ::dlb_callback_enable_cpu and ::dlb_callback_disable_cpu.
+ *  ::dlb_callback_enable_cpu and ::dlb_callback_disable_cpu. If registered,
+ *  ::dlb_callback_enable_cpu_set and ::dlb_callback_disable_cpu_set are used
+ *  instead to notify several CPUs at once.
  */
 int DLB_CallbackSet(dlb_callbacks_t which, dlb_callback_t callback, void *arg);
 
@@ -177,6 +179,22 @@ int DLB_LendCpus(int ncpus);
  */
 int DLB_LendCpuMask(const_dlb_cpu_set_t mask);
 
+/*! \brief Set the expected duration of the subsequent lends
+ *  \param[in] usecs Expected time in microseconds until the process reclaims the
+ *                   CPUs that it lends, or 0 if unknown
+ *  \return DLB_SUCCESS on success
+ *  \return DLB_ERR_NOINIT if DLB is not initialized
+ *  \return DLB_ERR_DISBLD if DLB is disabled
+ *  \return DLB_ERR_NOPOL if the policy does not keep per CPU information
+ *  \return DLB_ERR_PERM if usecs is negative
+ *
+ *  The duration applies to every CPU lent by the process from now on, until it
+ *  is set again. Processes that borrow CPUs prefer the ones that are expected
+ *  to remain available for longer, so they are less likely to be preempted
+ *  when the owner reclaims them.
+ */
+int DLB_SetLendDuration(int usecs);
+
 
 /*********************************************************************************/
 /*    Reclaim                                                                    */
@@ -432,6 +450,50 @@ int DLB_CheckCpuAvailability(int cpuid);
  */
 int DLB_Barrier(void);
 
+/*! \brief Barrier between the processes in the node attached to the named barrier
+ *  \param[in] barrier_name Name of the barrier, NULL for the default barrier
+ *  \return DLB_SUCCESS on success
+ *  \return DLB_ERR_NOSHMEM if the node barrier is not enabled
+ *  \return DLB_ERR_PERM if the process is not attached to the barrier
+ */
+int DLB_BarrierNamed(const char *barrier_name);
+
+/*! \brief Attach process to the named barrier, creating it if needed
+ *  \param[in] barrier_name Name of the barrier, NULL for the default barrier
+ *  \return DLB_SUCCESS on success
+ *  \return DLB_NOUPDT if the process was already attached
+ *  \return DLB_ERR_NOSHMEM if the node barrier is not enabled
+ *  \return DLB_ERR_NOMEM if there are no more barriers available
+ *
+ *  All processes are attached to the default barrier on initialization.
+ *  A process attaching to a barrier while other participants are already
+ *  waiting in it also takes part in the ongoing synchronization.
+ */
+int DLB_BarrierAttach(const char *barrier_name);
+
+/*! \brief Detach process from the named barrier
+ *  \param[in] barrier_name Name of the barrier, NULL for the default barrier
+ *  \return DLB_SUCCESS on success
+ *  \return DLB_ERR_NOSHMEM if the node barrier is not enabled
+ *  \return DLB_ERR_PERM if the process is not attached to the barrier
+ *
+ *  If the rest of participants are waiting for this process, they are released.
+ */
+int DLB_BarrierDetach(const char *barrier_name);
+
+/*! \brief Get the arrival skew statistics of the named barrier
+ *  \param[in] barrier_name Name of the barrier, NULL for the default barrier
+ *  \param[out] episodes Number of times the barrier has been completed
+ *  \param[out] avg_skew Average time between the first and the last arrival, in seconds
+ *  \param[out] max_skew Maximum time between the first and the last arrival, in seconds
+ *  \param[out] imbalance Fraction of time that participants spend waiting in the barrier
+ *  \return DLB_SUCCESS on success
+ *  \return DLB_ERR_NOSHMEM if the node barrier is not enabled
+ *  \return DLB_ERR_PERM if the process is not attached to the barrier
+ */
+int DLB_BarrierGetStats(const char *barrier_name, int *episodes, double *avg_skew,
+        double *max_skew, double *imbalance);
+
 /*! \brief Change the value of a DLB internal variable
  *  \param[in] variable Internal variable to set
  *  \param[in] value New value
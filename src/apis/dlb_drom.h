@@ -100,6 +100,32 @@ int DLB_DROM_GetProcessMask(int pid, dlb_cpu_set_t mask, dlb_drom_flags_t flags)
  */
 int DLB_DROM_SetProcessMask(int pid, const_dlb_cpu_set_t mask, dlb_drom_flags_t flags);
 
+/*! \brief Set the process masks of several PIDs at once
+ *  \param[in] pids Array of target Process IDs
+ *  \param[in] masks Array of n process masks (cpu_set_t), one per PID
+ *  \param[in] n Number of elements in both arrays
+ *  \param[in] flags DROM options
+ *  \return DLB_SUCCESS on success
+ *  \return DLB_ERR_NOSHMEM if cannot find shared memory
+ *  \return DLB_ERR_NOPROC if some target pid is not registered in the DLB system
+ *  \return DLB_ERR_PDIRTY if some target pid already has a pending operation
+ *  \return DLB_ERR_PERM if the masks overlap, some mask is empty, or some other
+ *                      process would be left without CPUs
+ *  \return DLB_ERR_TIMEOUT if the query is synchronous and times out
+ *  \return error code
+ *
+ *  The new partition is validated and applied as a whole, so either all the
+ *  processes get their new mask or none of them is modified. CPUs released by
+ *  some target process may be assigned to another target process in the same call.
+ *
+ *  Accepted flags for this function:\n
+ *      DLB_SYNC_QUERY: Synchronous query. The caller process gets blocked until all
+ *                      the target processes resolve their pending operations, or
+ *                      the query times out.
+ */
+int DLB_DROM_SetProcessMasks(const int *pids, const_dlb_cpu_set_t masks, int n,
+        dlb_drom_flags_t flags);
+
 /*! \brief Make room in the system for a new process with the given mask
  *  \param[in] pid Process ID that gets the reservation
  *  \param[in] mask Process mask to register
@@ -0,0 +1,160 @@
+/*********************************************************************************/
+/*  Copyright 2017 Barcelona Supercomputing Center                               */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <http://www.gnu.org/licenses/>.                 */
+/*********************************************************************************/
+
+#ifndef DLB_PLUGIN_H
+#define DLB_PLUGIN_H
+
+/* The plugin interface uses the glibc cpu_set_t type, _GNU_SOURCE must be
+ * defined before including any system header */
+#include <sched.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*********************************************************************************/
+/*    Balancing policy plugins                                                   */
+/*********************************************************************************/
+
+/* A balancing policy plugin is a shared object selected with the option
+ * --lewi-policy=plugin:<path>. The shared object must export a function named
+ * DLB_PLUGIN_ENTRY_SYMBOL of type dlb_plugin_entry_t, which is invoked once
+ * during DLB initialization with the table of services offered by DLB and
+ * returns the policy descriptor.
+ *
+ * DLB rejects any descriptor with a different DLB_PLUGIN_ABI_VERSION. The
+ * version is increased every time any of the structures in this file change
+ * in an incompatible way; new members are only appended at the end.
+ */
+
+#define DLB_PLUGIN_ABI_VERSION 1
+#define DLB_PLUGIN_ENTRY_SYMBOL "dlb_plugin_entry"
+
+/* Opaque sub-process descriptor, one per DLB instance */
+struct SubProcessDescriptor;
+typedef struct SubProcessDescriptor dlb_subprocess_t;
+
+/* Policy callbacks. Every member is optional, DLB_ERR_NOPOL is returned to the
+ * user for the ones not implemented. The in-tree policies are described with
+ * this same structure. */
+typedef struct BalancePolicy {
+    /* Status */
+    int (*init)(dlb_subprocess_t *spd);
+    int (*finalize)(dlb_subprocess_t *spd);
+    int (*enable)(const dlb_subprocess_t *spd);
+    int (*disable)(const dlb_subprocess_t *spd);
+    int (*set_max_parallelism)(const dlb_subprocess_t *spd, int max);
+    /* MPI specific */
+    int (*into_communication)(const dlb_subprocess_t *spd);
+    int (*out_of_communication)(const dlb_subprocess_t *spd);
+    int (*into_blocking_call)(const dlb_subprocess_t *spd);
+    int (*out_of_blocking_call)(const dlb_subprocess_t *spd, int is_iter);
+    /* Lend */
+    int (*lend)(const dlb_subprocess_t *spd);
+    int (*lend_cpu)(const dlb_subprocess_t *spd, int cpuid);
+    int (*lend_cpus)(const dlb_subprocess_t *spd, int ncpus);
+    int (*lend_cpu_mask)(const dlb_subprocess_t *spd, const cpu_set_t *mask);
+    /* Reclaim */
+    int (*reclaim)(const dlb_subprocess_t *spd);
+    int (*reclaim_cpu)(const dlb_subprocess_t *spd, int cpuid);
+    int (*reclaim_cpus)(const dlb_subprocess_t *spd, int ncpus);
+    int (*reclaim_cpu_mask)(const dlb_subprocess_t *spd, const cpu_set_t *mask);
+    /* Acquire */
+    int (*acquire_cpu)(const dlb_subprocess_t *spd, int cpuid);
+    int (*acquire_cpus)(const dlb_subprocess_t *spd, int ncpus);
+    int (*acquire_cpu_mask)(const dlb_subprocess_t *spd, const cpu_set_t *mask);
+    /* Borrow */
+    int (*borrow)(const dlb_subprocess_t *spd);
+    int (*borrow_cpu)(const dlb_subprocess_t *spd, int cpuid);
+    int (*borrow_cpus)(const dlb_subprocess_t *spd, int ncpus);
+    int (*borrow_cpu_mask)(const dlb_subprocess_t *spd, const cpu_set_t *mask);
+    /* Return */
+    int (*return_all)(const dlb_subprocess_t *spd);
+    int (*return_cpu)(const dlb_subprocess_t *spd, int cpuid);
+    int (*return_cpu_mask)(const dlb_subprocess_t *spd, const cpu_set_t *mask);
+    /* Misc */
+    int (*check_cpu_availability)(const dlb_subprocess_t *spd, int cpuid);
+    int (*update_ownership_info)(const dlb_subprocess_t *spd,
+            const cpu_set_t *process_mask);
+} dlb_policy_funcs_t;
+
+/* Policy descriptor flags */
+typedef enum dlb_policy_flags_e {
+    DLB_POLICY_USES_CPUINFO    = 1 << 0,    /* CPUs are managed through the cpuinfo shmem */
+    DLB_POLICY_USES_ITERATIONS = 1 << 1     /* iterations are detected on the MPI calls */
+} dlb_policy_flags_t;
+
+typedef struct dlb_policy_descriptor {
+    unsigned int abi_version;           /* must be DLB_PLUGIN_ABI_VERSION */
+    const char *name;
+    unsigned int flags;                 /* dlb_policy_flags_t */
+    dlb_policy_funcs_t funcs;
+} dlb_policy_descriptor_t;
+
+/* Services offered by DLB to the policies. The cpuinfo and procinfo primitives
+ * are only available if the descriptor sets DLB_POLICY_USES_CPUINFO.
+ * The new_guests and victims output arrays are indexed by CPU id and must
+ * have get_system_size() elements. Policies are responsible for enabling or
+ * disabling the CPUs assigned to or removed from their own process. */
+typedef struct dlb_plugin_services {
+    unsigned int abi_version;
+    /* Sub-process */
+    pid_t (*get_pid)(const dlb_subprocess_t *spd);
+    void  (*get_process_mask)(const dlb_subprocess_t *spd, cpu_set_t *mask);
+    void* (*get_policy_data)(const dlb_subprocess_t *spd);
+    void  (*set_policy_data)(dlb_subprocess_t *spd, void *data);
+    /* Programming model */
+    int (*set_num_threads)(const dlb_subprocess_t *spd, int nthreads);
+    int (*enable_cpu)(const dlb_subprocess_t *spd, int cpuid);
+    int (*disable_cpu)(const dlb_subprocess_t *spd, int cpuid);
+    int (*get_system_size)(void);
+    /* CPU info */
+    int (*cpuinfo_lend_cpu)(pid_t pid, int cpuid, pid_t *new_guest);
+    int (*cpuinfo_lend_cpu_mask)(pid_t pid, const cpu_set_t *mask, pid_t new_guests[]);
+    int (*cpuinfo_reclaim_all)(pid_t pid, pid_t new_guests[], pid_t victims[]);
+    int (*cpuinfo_reclaim_cpu)(pid_t pid, int cpuid, pid_t *new_guest, pid_t *victim);
+    int (*cpuinfo_reclaim_cpu_mask)(pid_t pid, const cpu_set_t *mask, pid_t new_guests[],
+            pid_t victims[]);
+    int (*cpuinfo_acquire_cpu)(pid_t pid, int cpuid, pid_t *new_guest, pid_t *victim);
+    int (*cpuinfo_borrow_cpu)(pid_t pid, int cpuid, pid_t *new_guest);
+    int (*cpuinfo_borrow_cpu_mask)(pid_t pid, const cpu_set_t *mask, pid_t new_guests[]);
+    int (*cpuinfo_return_all)(pid_t pid, pid_t new_guests[]);
+    int (*cpuinfo_return_cpu)(pid_t pid, int cpuid, pid_t *new_guest);
+    int (*cpuinfo_return_cpu_mask)(pid_t pid, const cpu_set_t *mask, pid_t new_guests[]);
+    int (*cpuinfo_check_cpu_availability)(pid_t pid, int cpuid);
+    int (*cpuinfo_get_guested_cpus)(pid_t pid, cpu_set_t *mask);
+    /* Process info */
+    int    (*procinfo_getpidlist)(pid_t *pidlist, int *nelems, int max_len);
+    int    (*procinfo_getprocessmask)(pid_t pid, cpu_set_t *mask);
+    double (*procinfo_getcpuusage)(pid_t pid);
+    double (*procinfo_getcpuavgusage)(pid_t pid);
+    int    (*procinfo_getloadavg)(pid_t pid, double *load);
+} dlb_plugin_services_t;
+
+/* Type of the function exported by the plugin */
+typedef const dlb_policy_descriptor_t* (*dlb_plugin_entry_t)(
+        const dlb_plugin_services_t *services);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DLB_PLUGIN_H */
@@ -107,7 +107,9 @@ int DLB_SetMaxParallelism_sp(dlb_handler_t handler, int max);
  *  Register a new \p callback for the callback type \p which. The callback
  *  type comes predefined by the enum values of ::dlb_callbacks_t.  It is
  *  highly recommended to register at least callbacks for
- *  ::dlb_callback_enable_cpu and ::dlb_callback_disable_cpu.
+ *  ::dlb_callback_enable_cpu and ::dlb_callback_disable_cpu. If registered,
+ *  ::dlb_callback_enable_cpu_set and ::dlb_callback_disable_cpu_set are used
+ *  instead to notify several CPUs at once.
  */
 int DLB_CallbackSet_sp(dlb_handler_t handler, dlb_callbacks_t which,
         dlb_callback_t callback, void *arg);
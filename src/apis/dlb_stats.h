@@ -117,6 +117,44 @@ int DLB_Stats_GetActiveCpusList(int *cpuslist,int *nelems,int max_len);
  */
 int DLB_Stats_GetLoadAvg(int pid, double *load);
 
+/*! \brief Get the fractions of time that a given process has spent in useful
+ *          computation, inside MPI and inside DLB since its initialization
+ *  \param[in] pid Process ID to consult
+ *  \param[out] useful optional, fraction of time outside MPI and DLB [0.0, 1.0]
+ *  \param[out] mpi optional, fraction of time inside MPI calls [0.0, 1.0]
+ *  \param[out] dlb optional, fraction of time inside DLB calls [0.0, 1.0]
+ *  \return error code
+ */
+int DLB_Stats_GetTimeFractions(int pid, double *useful, double *mpi, double *dlb);
+
+/*! \brief Get the useful time fraction of all the attached PIDs
+ *  \param[out] usefullist The output list
+ *  \param[out] nelems Number of elements in the list
+ *  \param[in] max_len Max capacity of the list
+ *  \return error code
+ */
+int DLB_Stats_GetUsefulFractionList(double *usefullist, int *nelems, int max_len);
+
+/*! \brief Get the Instructions Per Cycle of a given process
+ *  \param[in] pid Process ID to consult
+ *  \param[out] ipc the IPC of the given PID, or -1.0 if not available
+ *  \return DLB_SUCCESS on success
+ *  \return DLB_ERR_NOPROC if target pid is not registered in the DLB system
+ *
+ *  The hardware counters are opened for every thread of the process at the
+ *  initialization. Threads created afterwards are accounted as well.
+ */
+int DLB_Stats_GetIPC(int pid, double *ipc);
+
+/*! \brief Get the iteration pattern detected by the balancing policy of a given process
+ *  \param[in] pid Process ID to consult
+ *  \param[out] period number of blocking calls per iteration, or 0 if not detected
+ *  \param[out] iter_time duration in seconds of the last iteration
+ *  \return DLB_SUCCESS on success
+ *  \return DLB_ERR_NOPROC if target pid is not registered in the DLB system
+ */
+int DLB_Stats_GetIterationInfo(int pid, int *period, double *iter_time);
+
 /*! \brief Get the percentage of time that the CPU has been in state IDLE
  *  \param[in] cpu CPU id
  *  \param[out] percentage percentage of state/total
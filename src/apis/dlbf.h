@@ -86,6 +86,12 @@ interface
         type(c_ptr), value, intent(in) :: mask
     end function dlb_lendcpumask
 
+    function dlb_setlendduration(usecs) result (ierr) bind(c, name='DLB_SetLendDuration')
+        use iso_c_binding
+        integer(kind=c_int) :: ierr
+        integer(kind=c_int), value, intent(in) :: usecs
+    end function dlb_setlendduration
+
     function dlb_reclaim() result (ierr) bind(c, name='DLB_Reclaim')
         use iso_c_binding
         integer(kind=c_int) :: ierr
@@ -190,6 +196,35 @@ interface
         integer(kind=c_int) :: ierr
     end function dlb_barrier
 
+    function dlb_barriernamed(barrier_name) result (ierr) bind(c, name='DLB_BarrierNamed')
+        use iso_c_binding
+        integer(kind=c_int) :: ierr
+        character(kind=c_char), intent(in) :: barrier_name(*)
+    end function dlb_barriernamed
+
+    function dlb_barrierattach(barrier_name) result (ierr) bind(c, name='DLB_BarrierAttach')
+        use iso_c_binding
+        integer(kind=c_int) :: ierr
+        character(kind=c_char), intent(in) :: barrier_name(*)
+    end function dlb_barrierattach
+
+    function dlb_barrierdetach(barrier_name) result (ierr) bind(c, name='DLB_BarrierDetach')
+        use iso_c_binding
+        integer(kind=c_int) :: ierr
+        character(kind=c_char), intent(in) :: barrier_name(*)
+    end function dlb_barrierdetach
+
+    function dlb_barriergetstats(barrier_name, episodes, avg_skew, max_skew, imbalance) &
+            result (ierr) bind(c, name='DLB_BarrierGetStats')
+        use iso_c_binding
+        integer(kind=c_int) :: ierr
+        character(kind=c_char), intent(in) :: barrier_name(*)
+        integer(kind=c_int), intent(out) :: episodes
+        real(kind=c_double), intent(out) :: avg_skew
+        real(kind=c_double), intent(out) :: max_skew
+        real(kind=c_double), intent(out) :: imbalance
+    end function dlb_barriergetstats
+
     function dlb_setvariable(variable, val) result (ierr) bind(c, name='DLB_SetVariable')
         use iso_c_binding
         integer(kind=c_int) :: ierr
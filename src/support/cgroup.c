@@ -0,0 +1,243 @@
+/*********************************************************************************/
+/*  Copyright 2017 Barcelona Supercomputing Center                               */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <http://www.gnu.org/licenses/>.                 */
+/*********************************************************************************/
+
+#include "support/cgroup.h"
+
+#include "apis/dlb_errors.h"
+#include "support/debug.h"
+#include "support/mask_utils.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+static const char *proc_self_cgroup = "/proc/self/cgroup";
+static const char *cgroup_mount_point = "/sys/fs/cgroup";
+
+/* Read the first line of dir/file into buffer, without the trailing newline */
+static int read_cgroup_file(const char *dir, const char *file, char *buffer, size_t len) {
+    char filename[PATH_MAX];
+    if (snprintf(filename, PATH_MAX, "%s/%s", dir, file) >= PATH_MAX) return DLB_ERR_NOMEM;
+    FILE *fd = fopen(filename, "r");
+    if (fd == NULL) return DLB_ERR_NOENT;
+
+    int error = DLB_SUCCESS;
+    if (fgets(buffer, len, fd) == NULL) {
+        /* An empty file is a valid cpuset value (inherit from parent) */
+        *buffer = '\0';
+        error = ferror(fd) ? DLB_ERR_UNKNOWN : DLB_SUCCESS;
+    }
+    buffer[strcspn(buffer, "\n")] = '\0';
+    fclose(fd);
+    return error;
+}
+
+static int write_cgroup_file(const char *dir, const char *file, const char *value) {
+    char filename[PATH_MAX];
+    if (snprintf(filename, PATH_MAX, "%s/%s", dir, file) >= PATH_MAX) return DLB_ERR_NOMEM;
+    FILE *fd = fopen(filename, "w");
+    if (fd == NULL) return errno == ENOENT ? DLB_ERR_NOENT : DLB_ERR_PERM;
+
+    int error = DLB_SUCCESS;
+    if (fprintf(fd, "%s\n", value) < 0) error = DLB_ERR_PERM;
+    if (fclose(fd) != 0) error = DLB_ERR_PERM;
+    return error;
+}
+
+/* Count the processes attached to dir, other than pid */
+static int count_other_procs(const char *dir, pid_t pid, int *nprocs, int *nothers) {
+    char filename[PATH_MAX];
+    if (snprintf(filename, PATH_MAX, "%s/cgroup.procs", dir) >= PATH_MAX) return DLB_ERR_NOMEM;
+    FILE *fd = fopen(filename, "r");
+    if (fd == NULL) return DLB_ERR_NOENT;
+
+    *nprocs = 0;
+    *nothers = 0;
+    long proc;
+    while (fscanf(fd, "%ld", &proc) == 1) {
+        ++*nprocs;
+        if (proc != pid) ++*nothers;
+    }
+    fclose(fd);
+    return DLB_SUCCESS;
+}
+
+static int move_proc(const char *dir, pid_t pid) {
+    char value[16];
+    snprintf(value, 16, "%d", pid);
+    return write_cgroup_file(dir, "cgroup.procs", value);
+}
+
+int cgroup_find_dir(const char *proc_cgroup_file, const char *mount_point,
+        char *dir, size_t len) {
+    FILE *fd = fopen(proc_cgroup_file, "r");
+    if (fd == NULL) return DLB_ERR_NOENT;
+
+    /* cgroup v2 uses a single hierarchy with the format "0::/path" */
+    int error = DLB_ERR_NOENT;
+    char line[PATH_MAX];
+    while (fgets(line, PATH_MAX, fd) != NULL) {
+        line[strcspn(line, "\n")] = '\0';
+        if (strncmp(line, "0::", 3) == 0) {
+            const char *path = line + 3;
+            int n = snprintf(dir, len, "%s%s", mount_point, strcmp(path, "/") ? path : "");
+            error = (size_t)n < len ? DLB_SUCCESS : DLB_ERR_NOMEM;
+            break;
+        }
+    }
+    fclose(fd);
+    return error;
+}
+
+/* Create the leaf cgroup dir/dlb.<pid> and move the process into it */
+static int create_leaf(cgroup_info_t *cgroup, const char *dir, pid_t pid) {
+    if (snprintf(cgroup->path, PATH_MAX, "%s/dlb.%d", dir, pid) >= PATH_MAX) {
+        return DLB_ERR_NOMEM;
+    }
+    if (mkdir(cgroup->path, 0755) != 0 && errno != EEXIST) {
+        warning("Cannot create cgroup %s: %s", cgroup->path, strerror(errno));
+        return DLB_ERR_PERM;
+    }
+    cgroup->created = true;
+
+    /* Children only get a cpuset interface if the parent delegates it */
+    int error = write_cgroup_file(dir, "cgroup.subtree_control", "+cpuset");
+    if (error == DLB_SUCCESS) {
+        error = move_proc(cgroup->path, pid);
+    }
+    if (error != DLB_SUCCESS) {
+        warning("Cannot move process %d into cgroup %s", pid, cgroup->path);
+        rmdir(cgroup->path);
+    }
+    return error;
+}
+
+int cgroup_init(cgroup_info_t *cgroup, const char *cgroup_dir, pid_t pid,
+        cpu_set_t *cgroup_mask) {
+    *cgroup->path = '\0';
+    *cgroup->origin = '\0';
+    *cgroup->original_cpuset = '\0';
+    cgroup->created = false;
+
+    /* The origin is needed to move the process back if a leaf is created */
+    int error = cgroup_find_dir(proc_self_cgroup, cgroup_mount_point,
+            cgroup->origin, PATH_MAX);
+    char dir[PATH_MAX];
+    if (strcmp(cgroup_dir, "auto") == 0) {
+        if (error != DLB_SUCCESS) {
+            warning("Cannot find the cgroup v2 directory of the current process");
+            return error;
+        }
+        snprintf(dir, PATH_MAX, "%s", cgroup->origin);
+    } else {
+        snprintf(dir, PATH_MAX, "%s", cgroup_dir);
+    }
+
+    /* The configured cgroup must not be shared with other processes */
+    int nprocs, nothers;
+    error = count_other_procs(dir, pid, &nprocs, &nothers);
+    if (error != DLB_SUCCESS) {
+        warning("Cannot read cgroup.procs from cgroup %s", dir);
+        return error;
+    }
+    if (nothers > 0) {
+        warning("Cgroup %s is shared with %d other process%s, DROM cgroup"
+                " synchronization requires a cgroup per process",
+                dir, nothers, nothers > 1 ? "es" : "");
+        return DLB_ERR_PERM;
+    }
+
+    /* The effective cpuset contains the CPUs actually granted by the parents */
+    char cpuset[CGROUP_CPUSET_LEN];
+    error = read_cgroup_file(dir, "cpuset.cpus.effective", cpuset, CGROUP_CPUSET_LEN);
+    if (error != DLB_SUCCESS) {
+        error = read_cgroup_file(dir, "cpuset.cpus", cpuset, CGROUP_CPUSET_LEN);
+    }
+    if (error != DLB_SUCCESS) {
+        warning("Cannot read cpuset.cpus from cgroup %s", dir);
+        return error;
+    }
+
+    if (nprocs > 0) {
+        /* Already a per-process cgroup, save the cpuset to restore it on finalization */
+        snprintf(cgroup->path, PATH_MAX, "%s", dir);
+        error = read_cgroup_file(dir, "cpuset.cpus", cgroup->original_cpuset,
+                CGROUP_CPUSET_LEN);
+    } else {
+        error = create_leaf(cgroup, dir, pid);
+    }
+    if (error != DLB_SUCCESS) {
+        *cgroup->path = '\0';
+        cgroup->created = false;
+        return error;
+    }
+
+    CPU_ZERO(cgroup_mask);
+    if (*cpuset != '\0') {
+        mu_parse_mask(cpuset, cgroup_mask);
+    } else {
+        mu_get_system_mask(cgroup_mask);
+    }
+    verbose(VB_DROM, "Using cgroup %s with cpuset %s", cgroup->path, mu_to_str(cgroup_mask));
+
+    return DLB_SUCCESS;
+}
+
+int cgroup_set_mask(const cgroup_info_t *cgroup, const cpu_set_t *mask) {
+    if (*cgroup->path == '\0') return DLB_ERR_NOENT;
+
+    /* mu_to_str format is "[list]", cgroupfs only accepts "list" */
+    char cpuset[CGROUP_CPUSET_LEN];
+    snprintf(cpuset, CGROUP_CPUSET_LEN, "%s", mu_to_str(mask) + 1);
+    cpuset[strcspn(cpuset, "]")] = '\0';
+
+    int error = write_cgroup_file(cgroup->path, "cpuset.cpus", cpuset);
+    if (error != DLB_SUCCESS) {
+        warning("Cannot write cpuset %s into cgroup %s", cpuset, cgroup->path);
+    } else {
+        verbose(VB_DROM, "Cgroup %s updated with cpuset %s", cgroup->path, cpuset);
+    }
+    return error;
+}
+
+int cgroup_finalize(cgroup_info_t *cgroup, pid_t pid) {
+    if (*cgroup->path == '\0') return DLB_ERR_NOENT;
+
+    int error;
+    if (cgroup->created) {
+        /* The leaf belongs to this process only, move back and remove it */
+        error = *cgroup->origin != '\0' ? move_proc(cgroup->origin, pid) : DLB_ERR_NOENT;
+        if (error == DLB_SUCCESS && rmdir(cgroup->path) != 0) {
+            verbose(VB_DROM, "Cannot remove cgroup %s: %s", cgroup->path, strerror(errno));
+        }
+    } else {
+        error = write_cgroup_file(cgroup->path, "cpuset.cpus", cgroup->original_cpuset);
+    }
+    *cgroup->path = '\0';
+    *cgroup->original_cpuset = '\0';
+    cgroup->created = false;
+    return error;
+}
+
+void cgroup_testing_set_root(const char *proc_cgroup_file, const char *mount_point) {
+    proc_self_cgroup = proc_cgroup_file;
+    cgroup_mount_point = mount_point;
+}
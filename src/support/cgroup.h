@@ -0,0 +1,60 @@
+/*********************************************************************************/
+/*  Copyright 2017 Barcelona Supercomputing Center                               */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <http://www.gnu.org/licenses/>.                 */
+/*********************************************************************************/
+
+#ifndef CGROUP_H
+#define CGROUP_H
+
+#include <sched.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <sys/types.h>
+
+enum { CGROUP_CPUSET_LEN = CPU_SETSIZE*4 };
+
+/* State of the cgroup synchronization of one process. The cgroup written by
+ * DLB must only contain that process, so that DROM masks never affect other
+ * processes sharing the configured cgroup. */
+typedef struct CgroupInfo {
+    char path[PATH_MAX];                        // per-process cgroup, empty if disabled
+    char origin[PATH_MAX];                      // cgroup of the process before init
+    char original_cpuset[CGROUP_CPUSET_LEN];    // cpuset.cpus to restore on finalize
+    bool created;                               // path was created by DLB
+} cgroup_info_t;
+
+/* Synchronization of the process mask with a cgroup v2 cpuset controller.
+ * cgroup_dir may be an absolute path to the cgroup directory, or "auto" to
+ * use the cgroup of the current process. If the directory only contains the
+ * process pid, it is used as is. If it contains no processes, a leaf cgroup
+ * <cgroup_dir>/dlb.<pid> is created and the process is moved into it. A
+ * cgroup shared with other processes is rejected. */
+int  cgroup_init(cgroup_info_t *cgroup, const char *cgroup_dir, pid_t pid,
+        cpu_set_t *cgroup_mask);
+int  cgroup_set_mask(const cgroup_info_t *cgroup, const cpu_set_t *mask);
+int  cgroup_finalize(cgroup_info_t *cgroup, pid_t pid);
+
+/* Find the cgroup v2 directory of the current process given the contents of
+ * proc_cgroup_file (usually /proc/self/cgroup) and the cgroupfs mount point */
+int  cgroup_find_dir(const char *proc_cgroup_file, const char *mount_point,
+        char *dir, size_t len);
+
+/* Use a fake cgroupfs tree for 'auto' and for moving processes back */
+void cgroup_testing_set_root(const char *proc_cgroup_file, const char *mount_point);
+
+#endif /* CGROUP_H */
@@ -114,5 +114,6 @@ void dlb_clean(void) {
     shmem_procinfo_ext__finalize();
     shmem_barrier_finalize();
     shmem_async_finalize(pid);
-    finalize_comm();
+    shmem_async_ext__finalize();
+    finalize_comm_all();
 }
@@ -0,0 +1,97 @@
+/*********************************************************************************/
+/*  Copyright 2017 Barcelona Supercomputing Center                               */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <http://www.gnu.org/licenses/>.                 */
+/*********************************************************************************/
+
+#include "support/dpd.h"
+
+#include <string.h>
+
+void dpd_init(dpd_t *dpd, int window) {
+    if (window < 2) window = 2;
+    if (window > DPD_MAX_WINDOW) window = DPD_MAX_WINDOW;
+    memset(dpd, 0, sizeof(dpd_t));
+    dpd->window = window;
+}
+
+/* Update the number of consecutive matches of lags [1, nlags] with the new
+ * sample. Both arrays are traversed contiguously and without branches so that
+ * the loop can be vectorized */
+static inline void update_runs(uint32_t *restrict runs, const long *restrict past,
+        long sample, int nlags) {
+    int m;
+    for (m = DPD_MAX_WINDOW - nlags; m < DPD_MAX_WINDOW; ++m) {
+        runs[m] = (runs[m] + 1) & -(uint32_t)(past[m] == sample);
+    }
+}
+
+/* Lags are scanned in increasing order and a longer lag is only chosen if its
+ * run of matches is more than twice the best run so far. The period is only
+ * accepted if it has matched for at least a whole period */
+static inline int find_period(const uint32_t *runs, int nlags) {
+    int period = 0;
+    uint64_t best = 0;
+    int lag;
+    for (lag = 1; lag <= nlags; ++lag) {
+        uint64_t run = runs[DPD_MAX_WINDOW - lag];
+        if (run > 2*best) {
+            period = lag;
+            best = run;
+        }
+    }
+    return period > 0 && best >= (uint64_t)period ? period : 0;
+}
+
+long dpd_sample(dpd_t *dpd, long sample, int *period) {
+    int nlags = dpd->nsamples < dpd->window - 1 ? dpd->nsamples : dpd->window - 1;
+
+    /* history[head + DPD_MAX_WINDOW - lag] is the sample at that lag */
+    const long *past = &dpd->history[dpd->head];
+    update_runs(dpd->runs, past, sample, nlags);
+    int new_period = find_period(dpd->runs, nlags);
+
+    long mark = 0;
+    if (new_period > 0) {
+        mark = sample;
+        if (new_period != dpd->period) {
+            /* The period starts with the sample following the current one,
+             * which is at lag new_period-1 of the current sample */
+            dpd->period = new_period;
+            dpd->ref_sample = new_period > 1 ?
+                past[DPD_MAX_WINDOW - (new_period - 1)] : sample;
+            dpd->phase = -1;
+            if (dpd->ref_sample != sample) {
+                mark = 0;
+            }
+        } else if (dpd->ref_sample != sample || dpd->phase % dpd->period != 0) {
+            mark = 0;
+        }
+        ++dpd->phase;
+    } else {
+        dpd->period = 0;
+        dpd->ref_sample = 0;
+    }
+
+    /* Store the sample */
+    dpd->history[dpd->head] = sample;
+    dpd->history[dpd->head + DPD_MAX_WINDOW] = sample;
+    dpd->head = dpd->head + 1 < DPD_MAX_WINDOW ? dpd->head + 1 : 0;
+    ++dpd->nsamples;
+
+    *period = dpd->period;
+    return mark;
+}
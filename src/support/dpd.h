@@ -0,0 +1,55 @@
+/*********************************************************************************/
+/*  Copyright 2017 Barcelona Supercomputing Center                               */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <http://www.gnu.org/licenses/>.                 */
+/*********************************************************************************/
+
+#ifndef DPD_H
+#define DPD_H
+
+#include <stdint.h>
+
+/* DPD: Dynamic Periodicity Detector. Detects the period of a stream of
+ * samples, such as the MPI calls of a process, and marks the samples that
+ * start a new period. All the state is kept in the dpd_t object, which does
+ * not allocate memory, so any number of independent streams can be analyzed.
+ * The cost of each sample is linear in the window size. */
+
+enum { DPD_MAX_WINDOW = 320 };
+
+typedef struct DPD {
+    int window;                         // lags considered, the maximum period is window-1
+    int head;                           // history position of the next sample
+    int64_t nsamples;
+    int period;                         // current period, 0 if none
+    long ref_sample;                    // sample that starts each period
+    int64_t phase;                      // samples since the current period was detected
+    /* History of samples, every sample is stored twice so that the last
+     * window samples are always contiguous */
+    long history[2*DPD_MAX_WINDOW];
+    /* Number of consecutive matches of each lag, in reverse order so that
+     * runs[DPD_MAX_WINDOW-i] is aligned with the sample at lag i */
+    uint32_t runs[DPD_MAX_WINDOW];
+} dpd_t;
+
+/* Initialize or reset the state, window is clamped to [2, DPD_MAX_WINDOW] */
+void dpd_init(dpd_t *dpd, int window);
+
+/* Add a sample to the stream. Returns the sample if it starts a new period,
+ * 0 otherwise. period is set to the current period, or 0 if none. */
+long dpd_sample(dpd_t *dpd, long sample, int *period);
+
+#endif /* DPD_H */
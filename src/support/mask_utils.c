@@ -192,6 +192,18 @@ void mu_get_parents_covering_cpuset(cpu_set_t *parent_set, const cpu_set_t *cpus
     }
 }
 
+// Return index of the socket containing the CPU, or -1 if not found
+int mu_get_parent_id(int cpuid) {
+    if (!mu_initialized) mu_init();
+    int i;
+    for (i=0; i<sys.num_parents; ++i) {
+        if (CPU_ISSET(cpuid, &sys.parents[i])) {
+            return i;
+        }
+    }
+    return -1;
+}
+
 // Return Mask of sockets containing all CPUs in cpuset
 void mu_get_parents_inside_cpuset(cpu_set_t *parent_set, const cpu_set_t *cpuset) {
     if (!mu_initialized) mu_init();
@@ -219,6 +231,27 @@ void mu_substract(cpu_set_t *result, const cpu_set_t *minuend, const cpu_set_t *
     CPU_AND(result, minuend, &xor);
 }
 
+// Return the hardware threads sharing the same core as cpuid, including itself
+void mu_get_core_siblings(int cpuid, cpu_set_t *siblings) {
+    CPU_ZERO(siblings);
+    char path[64];
+    snprintf(path, sizeof(path),
+            "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", cpuid);
+    FILE *fd = fopen(path, "r");
+    if (fd) {
+        char line[256];
+        if (fgets(line, sizeof(line), fd)) {
+            line[strcspn(line, "\n")] = '\0';
+            mu_parse_mask(line, siblings);
+        }
+        fclose(fd);
+    }
+    /* No SMT information available */
+    if (CPU_COUNT(siblings) == 0) {
+        CPU_SET(cpuid, siblings);
+    }
+}
+
 // mu_to_str and mu_parse_mask functions are used by DLB utilities
 // We export their dynamic symbols to avoid code duplication,
 // although they do not belong to the public API
@@ -354,3 +387,18 @@ void mu_testing_set_sys_size(int size) {
         CPU_SET(i, &sys.sys_mask);
     }
 }
+
+void mu_testing_set_sys(int size, int num_parents) {
+    // For testing purposes only, CPUs are evenly split into parents
+    if (!mu_initialized) mu_init();
+    mu_testing_set_sys_size(size);
+    sys.num_parents = num_parents;
+    sys.parents = realloc(sys.parents, num_parents * sizeof(cpu_set_t));
+    int i;
+    for (i=0; i<num_parents; ++i) {
+        CPU_ZERO(&sys.parents[i]);
+    }
+    for (i=0; i<size; ++i) {
+        CPU_SET(i, &sys.parents[i * num_parents / size]);
+    }
+}
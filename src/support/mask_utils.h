@@ -29,12 +29,15 @@ int  mu_get_system_size(void);
 void mu_get_system_mask(cpu_set_t *mask);
 void mu_get_parents_covering_cpuset(cpu_set_t *parent_set, const cpu_set_t *cpuset);
 void mu_get_parents_inside_cpuset(cpu_set_t *parent_set, const cpu_set_t *cpuset);
+int  mu_get_parent_id(int cpuid);
 bool mu_is_subset(const cpu_set_t *subset, const cpu_set_t *superset);
+void mu_get_core_siblings(int cpuid, cpu_set_t *siblings);
 void mu_substract(cpu_set_t *result, const cpu_set_t *minuend, const cpu_set_t *substrahend);
 
 const char* mu_to_str(const cpu_set_t *cpu_set);
 void mu_parse_mask(const char *str, cpu_set_t *mask);
 
 void mu_testing_set_sys_size(int size);
+void mu_testing_set_sys(int size, int num_parents);
 
 #endif /* MASK_UTILS_H */
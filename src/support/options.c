@@ -48,7 +48,9 @@ typedef enum OptionTypes {
     OPT_POL_T,      // policy_t
     OPT_MASK_T,     // cpu_set_t
     OPT_MODE_T,     // interaction_mode_t
-    OPT_MPISET_T    // mpi_set_t
+    OPT_MPISET_T,   // mpi_set_t
+    OPT_HPLACE_T,   // helper_placement_t
+    OPT_HSCHED_T    // helper_sched_t
 } option_type_t;
 
 typedef struct {
@@ -108,6 +110,26 @@ static const opts_dict_t options_dictionary[] = {
         .offset         = offsetof(options_t, barrier),
         .type           = OPT_BOOL_T,
         .flags          = OPT_READONLY | OPT_OPTIONAL | OPT_ADVANCED
+    }, {
+        .var_name       = "LB_NULL",
+        .arg_name       = "--barrier-hierarchical",
+        .default_value  = "no",
+        .description    = "Synchronize the Shared Memory Barrier hierarchically: first the"
+                            " processes of each NUMA domain, then one process per domain."
+                            " Only applies to barriers created by this process.",
+        .offset         = offsetof(options_t, barrier_hierarchical),
+        .type           = OPT_BOOL_T,
+        .flags          = OPT_READONLY | OPT_OPTIONAL | OPT_ADVANCED
+    }, {
+        .var_name       = "LB_NULL",
+        .arg_name       = "--barrier-lend-threshold",
+        .default_value  = "0",
+        .description    = "Minimum predicted waiting time in the Shared Memory Barrier, in"
+                            " microseconds, for a process to lend its CPUs while waiting."
+                            " The prediction is based on the previous waits in that barrier.",
+        .offset         = offsetof(options_t, barrier_lend_threshold),
+        .type           = OPT_INT_T,
+        .flags          = OPT_READONLY | OPT_OPTIONAL | OPT_ADVANCED
     }, {
         .var_name       = "LB_MODE",
         .arg_name       = "--mode",
@@ -117,6 +139,53 @@ static const opts_dict_t options_dictionary[] = {
         .type           = OPT_MODE_T,
         .flags          = OPT_READONLY | OPT_OPTIONAL
     },
+    // async
+    {
+        .var_name       = "LB_NULL",
+        .arg_name       = "--async-placement",
+        .default_value  = "process",
+        .description    = "CPUs where the asynchronous helper thread runs: the whole process"
+                            " mask, the --async-cpus service CPUs, an SMT sibling not owned by"
+                            " the process, or the least loaded CPU of the process.",
+        .offset         = offsetof(options_t, async_placement),
+        .type           = OPT_HPLACE_T,
+        .flags          = OPT_READONLY | OPT_OPTIONAL | OPT_ADVANCED
+    }, {
+        .var_name       = "LB_NULL",
+        .arg_name       = "--async-cpus",
+        .default_value  = "",
+        .description    = "Service CPUs for the asynchronous helper thread.",
+        .offset         = offsetof(options_t, async_cpus),
+        .type           = OPT_MASK_T,
+        .flags          = OPT_READONLY | OPT_OPTIONAL | OPT_ADVANCED
+    }, {
+        .var_name       = "LB_NULL",
+        .arg_name       = "--async-sched",
+        .default_value  = "inherit",
+        .description    = "Scheduling policy of the asynchronous helper thread.",
+        .offset         = offsetof(options_t, async_sched),
+        .type           = OPT_HSCHED_T,
+        .flags          = OPT_READONLY | OPT_OPTIONAL | OPT_ADVANCED
+    }, {
+        .var_name       = "LB_NULL",
+        .arg_name       = "--async-priority",
+        .default_value  = "0",
+        .description    = "Priority of the asynchronous helper thread: the real-time priority"
+                            " for fifo and rr policies, or the nice value otherwise.",
+        .offset         = offsetof(options_t, async_priority),
+        .type           = OPT_INT_T,
+        .flags          = OPT_READONLY | OPT_OPTIONAL | OPT_ADVANCED
+    }, {
+        .var_name       = "LB_NULL",
+        .arg_name       = "--async-numa-helpers",
+        .default_value  = "no",
+        .description    = "Create one asynchronous helper thread per NUMA domain of the"
+                            " process, each one attending the requests of its own CPUs."
+                            " Callbacks may then be invoked concurrently.",
+        .offset         = offsetof(options_t, async_numa_helpers),
+        .type           = OPT_BOOL_T,
+        .flags          = OPT_READONLY | OPT_OPTIONAL | OPT_ADVANCED
+    },
     // verbose
     {
         .var_name       = "LB_VERBOSE",
@@ -195,6 +264,62 @@ static const opts_dict_t options_dictionary[] = {
         .offset         = offsetof(options_t, lewi_warmup),
         .type           = OPT_BOOL_T,
         .flags          = OPT_READONLY | OPT_OPTIONAL
+    }, {
+        .var_name       = "LB_NULL",
+        .arg_name       = "--lewi-policy",
+        .default_value  = "",
+        .description    = "LeWI balancing policy: LeWI, LeWI_mask, RaL, PERaL, LeWI_predict,"
+                            " LeWI_rebalance"
+                            " or plugin:<path> to load an external policy from a shared object."
+                            " If empty, LeWI_mask is used if DLB is initialized with a CPU"
+                            " mask and LeWI otherwise.",
+        .offset         = offsetof(options_t, lewi_policy),
+        .type           = OPT_STR_T,
+        .flags          = OPT_READONLY | OPT_OPTIONAL | OPT_ADVANCED
+    }, {
+        .var_name       = "LB_NULL",
+        .arg_name       = "--lewi-predict-threshold",
+        .default_value  = "1000",
+        .description    = "Minimum predicted duration of a blocking call, in microseconds,"
+                            " for the LeWI_predict policy to lend the CPUs during the call."
+                            " The prediction is based on the same call in previous iterations.",
+        .offset         = offsetof(options_t, lewi_predict_threshold),
+        .type           = OPT_INT_T,
+        .flags          = OPT_READONLY | OPT_OPTIONAL | OPT_ADVANCED
+    }, {
+        .var_name       = "LB_NULL",
+        .arg_name       = "--lewi-rebalance-window",
+        .default_value  = "5",
+        .description    = "Number of iterations over which the LeWI_rebalance policy measures"
+                            " the computation and blocking time of each process before"
+                            " redistributing the CPU ownership.",
+        .offset         = offsetof(options_t, lewi_rebalance_window),
+        .type           = OPT_INT_T,
+        .flags          = OPT_READONLY | OPT_OPTIONAL | OPT_ADVANCED
+    }, {
+        .var_name       = "LB_NULL",
+        .arg_name       = "--lewi-rebalance-tolerance",
+        .default_value  = "10",
+        .description    = "Load imbalance, in percentage, tolerated by the LeWI_rebalance"
+                            " policy. CPU ownership is not redistributed below it, and processes"
+                            " that block less than this fraction of the iteration stop lending"
+                            " their CPUs in blocking calls.",
+        .offset         = offsetof(options_t, lewi_rebalance_tolerance),
+        .type           = OPT_INT_T,
+        .flags          = OPT_READONLY | OPT_OPTIONAL | OPT_ADVANCED
+    },
+    // DROM
+    {
+        .var_name       = "LB_NULL",
+        .arg_name       = "--drom-cgroup",
+        .default_value  = "",
+        .description    = "cgroup v2 directory to synchronize with the DROM process mask,"
+                            " or 'auto' to use the cgroup of the process. The cgroup must"
+                            " not contain other processes; if it contains none, a leaf"
+                            " cgroup dlb.<pid> is created for the process.",
+        .offset         = offsetof(options_t, drom_cgroup),
+        .type           = OPT_STR_T,
+        .flags          = OPT_READONLY | OPT_OPTIONAL | OPT_ADVANCED
     },
     // misc
     {
@@ -248,12 +373,17 @@ static int set_value(option_type_t type, void *option, const char *str_value) {
         case(OPT_POL_T):
             return parse_policy(str_value, (policy_t*)option);
         case(OPT_MASK_T):
+            CPU_ZERO((cpu_set_t*)option);
             mu_parse_mask(str_value, (cpu_set_t*)option);
             return DLB_SUCCESS;
         case(OPT_MODE_T):
             return parse_mode(str_value, (interaction_mode_t*)option);
         case(OPT_MPISET_T):
             return parse_mpiset(str_value, (mpi_set_t*)option);
+        case(OPT_HPLACE_T):
+            return parse_helper_placement(str_value, (helper_placement_t*)option);
+        case(OPT_HSCHED_T):
+            return parse_helper_sched(str_value, (helper_sched_t*)option);
     }
     return DLB_ERR_NOENT;
 }
@@ -284,6 +414,10 @@ static const char * get_value(option_type_t type, void *option) {
             return mode_tostr(*(interaction_mode_t*)option);
         case OPT_MPISET_T:
             return mpiset_tostr(*(mpi_set_t*)option);
+        case OPT_HPLACE_T:
+            return helper_placement_tostr(*(helper_placement_t*)option);
+        case OPT_HSCHED_T:
+            return helper_sched_tostr(*(helper_sched_t*)option);
     }
     return "unknown";
 }
@@ -508,7 +642,7 @@ int options_get_variable(const options_t *options, const char *var_name, char *v
 
 /* API Printer */
 void options_print_variables(const options_t *options) {
-    enum { buffer_size = 2048 };
+    enum { buffer_size = 4096 };
     char buffer[buffer_size] = "DLB Options:\n\n"
                                 "The library configuration can be set using arguments\n"
                                 "added to the DLB_ARGS environment variable.\n"
@@ -544,6 +678,9 @@ void options_print_variables(const options_t *options) {
             case OPT_STR_T:
                 b += sprintf(b, "(string)");
                 break;
+            case OPT_MASK_T:
+                b += sprintf(b, "(cpuset)");
+                break;
             case OPT_VB_T:
                 b += sprintf(b, "{%s}", get_verbose_opts_choices());
                 break;
@@ -565,6 +702,12 @@ void options_print_variables(const options_t *options) {
             case OPT_MPISET_T:
                 b += sprintf(b, "[%s]", get_mpiset_choices());
                 break;
+            case OPT_HPLACE_T:
+                b += sprintf(b, "[%s]", get_helper_placement_choices());
+                break;
+            case OPT_HSCHED_T:
+                b += sprintf(b, "[%s]", get_helper_sched_choices());
+                break;
             default:
                 b += sprintf(b, "(unknown)");
         }
@@ -583,7 +726,7 @@ void options_print_variables(const options_t *options) {
 
 /* API Printer extra */
 void options_print_variables_extra(const options_t *options) {
-    enum { buffer_size = 2048 };
+    enum { buffer_size = 4096 };
     char buffer[buffer_size] = "DLB_ARGS options:\n";
     char *b = buffer + strlen(buffer);
     int i;
@@ -607,6 +750,9 @@ void options_print_variables_extra(const options_t *options) {
             case OPT_STR_T:
                 b += sprintf(b, "(string)");
                 break;
+            case OPT_MASK_T:
+                b += sprintf(b, "(cpuset)");
+                break;
             case OPT_VB_T:
                 b += sprintf(b, "{%s}", get_verbose_opts_choices());
                 break;
@@ -628,6 +774,12 @@ void options_print_variables_extra(const options_t *options) {
             case OPT_MPISET_T:
                 b += sprintf(b, "[%s]", get_mpiset_choices());
                 break;
+            case OPT_HPLACE_T:
+                b += sprintf(b, "[%s]", get_helper_placement_choices());
+                break;
+            case OPT_HSCHED_T:
+                b += sprintf(b, "[%s]", get_helper_sched_choices());
+                break;
             default:
                 b += sprintf(b, "(unknown)");
         }
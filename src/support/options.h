@@ -24,7 +24,7 @@
 #include <sched.h>
 #include <sys/types.h>
 
-enum { MAX_OPTION_LENGTH = 64 };
+enum { MAX_OPTION_LENGTH = 256 };
 enum { MAX_DESCRIPTION = 1024 };
 
 typedef struct Options {
@@ -33,7 +33,15 @@ typedef struct Options {
     bool               drom;
     bool               statistics;
     bool               barrier;
+    bool               barrier_hierarchical;
+    int                barrier_lend_threshold;
     interaction_mode_t mode;
+    /* async */
+    helper_placement_t async_placement;
+    cpu_set_t          async_cpus;
+    helper_sched_t     async_sched;
+    int                async_priority;
+    bool               async_numa_helpers;
     /* verbose */
     verbose_opts_t     verbose;
     verbose_fmt_t      verbose_fmt;
@@ -46,6 +54,12 @@ typedef struct Options {
     priority_t         lewi_affinity;
     bool               lewi_greedy;
     bool               lewi_warmup;
+    char               lewi_policy[MAX_OPTION_LENGTH];
+    int                lewi_predict_threshold;
+    int                lewi_rebalance_window;
+    int                lewi_rebalance_tolerance;
+    /* drom */
+    char               drom_cgroup[MAX_OPTION_LENGTH];
     /* misc */
     char               shm_key[MAX_OPTION_LENGTH];
     pid_t              preinit_pid;
@@ -0,0 +1,260 @@
+/*********************************************************************************/
+/*  Copyright 2017 Barcelona Supercomputing Center                               */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <http://www.gnu.org/licenses/>.                 */
+/*********************************************************************************/
+
+#include "support/rebalance.h"
+
+#include "support/mask_utils.h"
+#include "apis/dlb_errors.h"
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+
+/* Build the domain index of every CPU in pool. CPUs not covered by any domain
+ * are assigned to an extra domain with index ndomains. Returns the number of
+ * domains used, including the extra one. */
+static int build_domains(const cpu_set_t *pool, const cpu_set_t *domains, int ndomains,
+        int *domain_of) {
+    int cpu, d;
+    if (domains == NULL) {
+        // Discover the system parents covering each CPU
+        ndomains = 0;
+        cpu_set_t covered;
+        CPU_ZERO(&covered);
+        for (cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (!CPU_ISSET(cpu, pool)) continue;
+            if (CPU_ISSET(cpu, &covered)) continue;
+            cpu_set_t single, parent;
+            CPU_ZERO(&single);
+            CPU_SET(cpu, &single);
+            mu_get_parents_covering_cpuset(&parent, &single);
+            if (CPU_COUNT(&parent) == 0) {
+                CPU_SET(cpu, &parent);
+            }
+            int c;
+            for (c = 0; c < CPU_SETSIZE; ++c) {
+                if (CPU_ISSET(c, &parent) && !CPU_ISSET(c, &covered)) {
+                    domain_of[c] = ndomains;
+                }
+            }
+            CPU_OR(&covered, &covered, &parent);
+            ++ndomains;
+        }
+        return ndomains;
+    }
+
+    for (cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        domain_of[cpu] = ndomains;
+        for (d = 0; d < ndomains; ++d) {
+            if (CPU_ISSET(cpu, &domains[d])) {
+                domain_of[cpu] = d;
+                break;
+            }
+        }
+    }
+    return ndomains + 1;
+}
+
+/* Number of CPUs of mask per domain */
+static void count_per_domain(const cpu_set_t *mask, const int *domain_of, int *count,
+        int ndomains) {
+    memset(count, 0, sizeof(int)*ndomains);
+    int cpu;
+    for (cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (CPU_ISSET(cpu, mask)) {
+            ++count[domain_of[cpu]];
+        }
+    }
+}
+
+/* Compute the target number of CPUs of each process: every process gets the
+ * minimum guarantee and the rest is split proportionally to the demand above
+ * it, using the largest remainder method */
+static int compute_targets(const rebalance_config_t *config, const rebalance_process_t *procs,
+        int nprocs, int total, int *target) {
+    int min_cpus = config->min_cpus > 0 ? config->min_cpus : 1;
+    if (min_cpus * nprocs > total) {
+        if (nprocs > total) return DLB_ERR_PERM;
+        min_cpus = total / nprocs;
+    }
+
+    double weight[nprocs];
+    double weight_sum = 0.0;
+    int i;
+    for (i = 0; i < nprocs; ++i) {
+        int current = CPU_COUNT(&procs[i].mask);
+        double demand = procs[i].demand >= 0.0 ? procs[i].demand : current;
+        weight[i] = demand > min_cpus ? demand - min_cpus : 0.0;
+        weight_sum += weight[i];
+    }
+    if (weight_sum == 0.0) {
+        // Nobody needs more than the guarantee, keep the current proportions
+        for (i = 0; i < nprocs; ++i) {
+            weight[i] = CPU_COUNT(&procs[i].mask);
+            weight_sum += weight[i];
+        }
+    }
+
+    int spare = total - min_cpus * nprocs;
+    int assigned = 0;
+    double remainder[nprocs];
+    for (i = 0; i < nprocs; ++i) {
+        double quota = spare * weight[i] / weight_sum;
+        int share = (int)floor(quota);
+        target[i] = min_cpus + share;
+        remainder[i] = quota - share;
+        assigned += share;
+    }
+
+    // Assign the leftover CPUs to the largest remainders, preferring the
+    // processes that would otherwise lose CPUs
+    while (assigned < spare) {
+        int best = -1;
+        for (i = 0; i < nprocs; ++i) {
+            if (best == -1
+                    || remainder[i] > remainder[best]
+                    || (remainder[i] == remainder[best]
+                        && CPU_COUNT(&procs[i].mask) - target[i]
+                        > CPU_COUNT(&procs[best].mask) - target[best])) {
+                best = i;
+            }
+        }
+        ++target[best];
+        remainder[best] = -1.0;
+        ++assigned;
+    }
+
+    return DLB_SUCCESS;
+}
+
+static bool beyond_hysteresis(const rebalance_config_t *config,
+        const rebalance_process_t *procs, int nprocs, const int *target) {
+    int i;
+    for (i = 0; i < nprocs; ++i) {
+        int current = CPU_COUNT(&procs[i].mask);
+        int change = abs(target[i] - current);
+        double threshold = config->hysteresis * current;
+        if (threshold < config->min_change) threshold = config->min_change;
+        if (change > 0 && change >= threshold) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// rebalance_compute is used by DLB utilities
+// We export its dynamic symbol although it does not belong to the public API
+#pragma GCC visibility push(default)
+int rebalance_compute(const rebalance_config_t *config, rebalance_process_t *procs,
+        int nprocs, const cpu_set_t *domains, int ndomains) {
+    if (nprocs <= 0) return 0;
+
+    int i, d, cpu;
+    cpu_set_t pool;
+    CPU_ZERO(&pool);
+    for (i = 0; i < nprocs; ++i) {
+        if (CPU_COUNT(&procs[i].mask) == 0) return DLB_ERR_PERM;
+        CPU_OR(&pool, &pool, &procs[i].mask);
+        memcpy(&procs[i].new_mask, &procs[i].mask, sizeof(cpu_set_t));
+    }
+
+    int target[nprocs];
+    int error = compute_targets(config, procs, nprocs, CPU_COUNT(&pool), target);
+    if (error != DLB_SUCCESS) return error;
+
+    if (!beyond_hysteresis(config, procs, nprocs, target)) return 0;
+
+    int *domain_of = malloc(sizeof(int)*CPU_SETSIZE);
+    int num_domains = build_domains(&pool, domains, ndomains, domain_of);
+    int own[num_domains];
+    int free_count[num_domains];
+
+    /* Shrink: release CPUs from the domains where the process has fewer CPUs */
+    cpu_set_t free_mask;
+    CPU_ZERO(&free_mask);
+    for (i = 0; i < nprocs; ++i) {
+        cpu_set_t *mask = &procs[i].new_mask;
+        while (CPU_COUNT(mask) > target[i]) {
+            count_per_domain(mask, domain_of, own, num_domains);
+            int victim = -1;
+            for (d = num_domains-1; d >= 0; --d) {
+                if (own[d] > 0 && (victim == -1 || own[d] < own[victim])) {
+                    victim = d;
+                }
+            }
+            for (cpu = CPU_SETSIZE-1; cpu >= 0; --cpu) {
+                if (CPU_ISSET(cpu, mask) && domain_of[cpu] == victim) {
+                    CPU_CLR(cpu, mask);
+                    CPU_SET(cpu, &free_mask);
+                    break;
+                }
+            }
+        }
+    }
+
+    /* Grow: processes with larger deficit choose first, taking CPUs from the
+     * domains where they already have more CPUs */
+    bool served[nprocs];
+    memset(served, 0, sizeof(served));
+    int n;
+    for (n = 0; n < nprocs; ++n) {
+        int next = -1;
+        for (i = 0; i < nprocs; ++i) {
+            if (served[i]) continue;
+            if (next == -1 || target[i] - CPU_COUNT(&procs[i].new_mask)
+                    > target[next] - CPU_COUNT(&procs[next].new_mask)) {
+                next = i;
+            }
+        }
+        served[next] = true;
+
+        cpu_set_t *mask = &procs[next].new_mask;
+        while (CPU_COUNT(mask) < target[next]) {
+            count_per_domain(mask, domain_of, own, num_domains);
+            count_per_domain(&free_mask, domain_of, free_count, num_domains);
+            int best = -1;
+            for (d = 0; d < num_domains; ++d) {
+                if (free_count[d] == 0) continue;
+                if (best == -1
+                        || own[d] > own[best]
+                        || (own[d] == own[best] && free_count[d] > free_count[best])) {
+                    best = d;
+                }
+            }
+            for (cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+                if (CPU_ISSET(cpu, &free_mask) && domain_of[cpu] == best) {
+                    CPU_CLR(cpu, &free_mask);
+                    CPU_SET(cpu, mask);
+                    break;
+                }
+            }
+        }
+    }
+    free(domain_of);
+
+    int changed = 0;
+    for (i = 0; i < nprocs; ++i) {
+        if (!CPU_EQUAL(&procs[i].mask, &procs[i].new_mask)) {
+            ++changed;
+        }
+    }
+    return changed;
+}
+#pragma GCC visibility pop
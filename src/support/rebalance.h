@@ -0,0 +1,47 @@
+/*********************************************************************************/
+/*  Copyright 2017 Barcelona Supercomputing Center                               */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <http://www.gnu.org/licenses/>.                 */
+/*********************************************************************************/
+
+#ifndef REBALANCE_H
+#define REBALANCE_H
+
+#include <sys/types.h>
+#include <sched.h>
+
+typedef struct RebalanceConfig {
+    int     min_cpus;       // Minimum number of CPUs guaranteed to each process
+    int     min_change;     // Minimum change in CPUs of some process to accept a new partition
+    double  hysteresis;     // Minimum change relative to the current CPUs of some process
+} rebalance_config_t;
+
+typedef struct RebalanceProcess {
+    pid_t       pid;
+    cpu_set_t   mask;       // in: current process mask
+    double      demand;     // in: measured demand in number of CPUs, < 0 if unknown
+    cpu_set_t   new_mask;   // out: proposed process mask
+} rebalance_process_t;
+
+/* Compute a new partition of the CPUs owned by all processes, proportional to
+ * their demand. Processes keep as many of their current CPUs as possible and
+ * are packed into the fewest topology domains. If domains is NULL, the
+ * system topology is used. Returns the number of modified masks (0 if the
+ * change is below the hysteresis threshold), or an error code. */
+int rebalance_compute(const rebalance_config_t *config, rebalance_process_t *procs,
+        int nprocs, const cpu_set_t *domains, int ndomains);
+
+#endif /* REBALANCE_H */
@@ -91,6 +91,21 @@ void init_tracing(const options_t *options) {
         type=REBIND_EVENT;
         n_values=0;
         Extrae_define_event_type(&type, "DLB thread rebind", &n_values, NULL, NULL);
+
+        //ITERATION_CPU_EVENT
+        type=ITERATION_CPU_EVENT;
+        n_values=0;
+        Extrae_define_event_type(&type, "DLB iteration CPU time (us)", &n_values, NULL, NULL);
+
+        //ITERATION_TIME_EVENT
+        type=ITERATION_TIME_EVENT;
+        n_values=0;
+        Extrae_define_event_type(&type, "DLB iteration time (us)", &n_values, NULL, NULL);
+
+        //ITERATION_PERIOD_EVENT
+        type=ITERATION_PERIOD_EVENT;
+        n_values=0;
+        Extrae_define_event_type(&type, "DLB iteration period (MPI calls)", &n_values, NULL, NULL);
     } else {
         extrae_set_event = dummy;
     }
@@ -41,6 +41,9 @@
 #define EVENT_DISABLED       2
 #define EVENT_SINGLE         3
 #define REBIND_EVENT       800060
+#define ITERATION_CPU_EVENT 800070
+#define ITERATION_TIME_EVENT 800071
+#define ITERATION_PERIOD_EVENT 800072
 
 /*************************************/
 
@@ -212,9 +212,12 @@ const char* get_priority_choices(void) {
 }
 
 /* policy_t */
-static const policy_t policy_values[] = {POLICY_NONE, POLICY_LEWI, POLICY_LEWI_MASK};
-static const char* const policy_choices[] = {"no", "LeWI", "LeWI_mask"};
-static const char policy_choices_str[] = "no, LeWI, LeWI_mask";
+static const policy_t policy_values[] = {POLICY_NONE, POLICY_LEWI, POLICY_LEWI_MASK,
+    POLICY_RAL, POLICY_PERAL, POLICY_LEWI_PREDICT, POLICY_LEWI_REBALANCE};
+static const char* const policy_choices[] = {"no", "LeWI", "LeWI_mask", "RaL", "PERaL",
+    "LeWI_predict", "LeWI_rebalance"};
+static const char policy_choices_str[] =
+    "no, LeWI, LeWI_mask, RaL, PERaL, LeWI_predict, LeWI_rebalance";
 enum { policy_nelems = sizeof(policy_values) / sizeof(policy_values[0]) };
 
 int parse_policy(const char *str, policy_t *value) {
@@ -304,3 +307,71 @@ const char* get_mpiset_choices(void) {
     return mpiset_choices_str;
 }
 
+
+/* helper_placement_t */
+static const helper_placement_t helper_placement_values[] =
+    {HELPER_PROCESS, HELPER_SERVICE, HELPER_SIBLING, HELPER_LEAST_LOADED};
+static const char* const helper_placement_choices[] =
+    {"process", "service", "sibling", "least-loaded"};
+static const char helper_placement_choices_str[] =
+    "process, service, sibling, least-loaded";
+enum { helper_placement_nelems =
+    sizeof(helper_placement_values) / sizeof(helper_placement_values[0]) };
+
+int parse_helper_placement(const char *str, helper_placement_t *value) {
+    int i;
+    for (i=0; i<helper_placement_nelems; ++i) {
+        if (strcasecmp(str, helper_placement_choices[i]) == 0) {
+            *value = helper_placement_values[i];
+            return DLB_SUCCESS;
+        }
+    }
+    return DLB_ERR_NOENT;
+}
+
+const char* helper_placement_tostr(helper_placement_t value) {
+    int i;
+    for (i=0; i<helper_placement_nelems; ++i) {
+        if (helper_placement_values[i] == value) {
+            return helper_placement_choices[i];
+        }
+    }
+    return "unknown";
+}
+
+const char* get_helper_placement_choices(void) {
+    return helper_placement_choices_str;
+}
+
+/* helper_sched_t */
+static const helper_sched_t helper_sched_values[] = {HELPER_SCHED_INHERIT, HELPER_SCHED_OTHER,
+    HELPER_SCHED_BATCH, HELPER_SCHED_IDLE, HELPER_SCHED_FIFO, HELPER_SCHED_RR};
+static const char* const helper_sched_choices[] =
+    {"inherit", "other", "batch", "idle", "fifo", "rr"};
+static const char helper_sched_choices_str[] = "inherit, other, batch, idle, fifo, rr";
+enum { helper_sched_nelems = sizeof(helper_sched_values) / sizeof(helper_sched_values[0]) };
+
+int parse_helper_sched(const char *str, helper_sched_t *value) {
+    int i;
+    for (i=0; i<helper_sched_nelems; ++i) {
+        if (strcasecmp(str, helper_sched_choices[i]) == 0) {
+            *value = helper_sched_values[i];
+            return DLB_SUCCESS;
+        }
+    }
+    return DLB_ERR_NOENT;
+}
+
+const char* helper_sched_tostr(helper_sched_t value) {
+    int i;
+    for (i=0; i<helper_sched_nelems; ++i) {
+        if (helper_sched_values[i] == value) {
+            return helper_sched_choices[i];
+        }
+    }
+    return "unknown";
+}
+
+const char* get_helper_sched_choices(void) {
+    return helper_sched_choices_str;
+}
@@ -62,7 +62,12 @@ typedef enum PriorityType {
 typedef enum PolicyType {
     POLICY_NONE,
     POLICY_LEWI,
-    POLICY_LEWI_MASK
+    POLICY_LEWI_MASK,
+    POLICY_RAL,
+    POLICY_PERAL,
+    POLICY_LEWI_PREDICT,
+    POLICY_LEWI_REBALANCE,
+    POLICY_PLUGIN
 } policy_t;
 
 typedef enum InteractionMode {
@@ -76,6 +81,22 @@ typedef enum MPISet {
     MPISET_COLLECTIVES
 } mpi_set_t;
 
+typedef enum HelperPlacement {
+    HELPER_PROCESS,
+    HELPER_SERVICE,
+    HELPER_SIBLING,
+    HELPER_LEAST_LOADED
+} helper_placement_t;
+
+typedef enum HelperScheduler {
+    HELPER_SCHED_INHERIT,
+    HELPER_SCHED_OTHER,
+    HELPER_SCHED_BATCH,
+    HELPER_SCHED_IDLE,
+    HELPER_SCHED_FIFO,
+    HELPER_SCHED_RR
+} helper_sched_t;
+
 int parse_bool(const char *str, bool *value);
 int parse_int(const char *str, int *value);
 
@@ -114,4 +135,14 @@ int parse_mpiset(const char *str, mpi_set_t *value);
 const char* mpiset_tostr(mpi_set_t value);
 const char* get_mpiset_choices(void);
 
+/* helper_placement_t */
+int parse_helper_placement(const char *str, helper_placement_t *value);
+const char* helper_placement_tostr(helper_placement_t value);
+const char* get_helper_placement_choices(void);
+
+/* helper_sched_t */
+int parse_helper_sched(const char *str, helper_sched_t *value);
+const char* helper_sched_tostr(helper_sched_t value);
+const char* get_helper_sched_choices(void);
+
 #endif /* TYPES_H */
@@ -0,0 +1,304 @@
+/*********************************************************************************/
+/*  Copyright 2017 Barcelona Supercomputing Center                               */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <http://www.gnu.org/licenses/>.                 */
+/*********************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "apis/dlb.h"
+#include "apis/dlb_drom.h"
+#include "apis/dlb_stats.h"
+#include "support/mask_utils.h"
+#include "support/rebalance.h"
+
+#include <sched.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <getopt.h>
+#include <stdbool.h>
+
+typedef struct {
+    pid_t pid;
+    double demand;          // smoothed demand, in number of CPUs
+} sample_t;
+
+static volatile sig_atomic_t keep_running = 1;
+
+static void stop_handler(int signum) {
+    keep_running = 0;
+}
+
+static void __attribute__((__noreturn__)) usage(const char * program, FILE *out) {
+    fprintf(out, "DLB - Dynamic Load Balancing, version %s.\n", VERSION);
+    fprintf(out, "usage: %s [OPTION]...\n\n", program);
+
+    fputs("Periodically redistribute the CPU ownership of DLB processes according to\n"
+            "their measured CPU usage. Processes must be run with --statistics.\n\n", out);
+
+    fputs((
+                "Options:\n"
+                "  -i, --interval <ms>      sampling interval in milliseconds (default: 1000)\n"
+                "  -m, --min-cpus <n>       minimum number of CPUs guaranteed to each process (default: 1)\n"
+                "  -t, --threshold <f>      minimum relative change to repartition (default: 0.25)\n"
+                "  -c, --min-change <n>     minimum change in CPUs to repartition (default: 1)\n"
+                "  -w, --window <n>         consecutive samples a change must persist (default: 3)\n"
+                "  -a, --alpha <f>          smoothing factor of the demand, in (0,1] (default: 0.5)\n"
+                "  -n, --dry-run            only print the proposed partitions\n"
+                "  -o, --once               sample once and exit\n"
+                "  -v, --verbose            print every sample\n"
+                "  -h, --help               print this help\n"
+                ), out);
+
+    exit(out == stderr ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+/* Exponential moving average of the CPU usage of each process */
+static double update_demand(sample_t *samples, int *nsamples, pid_t pid, double usage,
+        double alpha) {
+    int i;
+    for (i = 0; i < *nsamples; ++i) {
+        if (samples[i].pid == pid) {
+            samples[i].demand = alpha * usage + (1.0 - alpha) * samples[i].demand;
+            return samples[i].demand;
+        }
+    }
+    samples[*nsamples].pid = pid;
+    samples[*nsamples].demand = usage;
+    ++*nsamples;
+    return usage;
+}
+
+static int sample(rebalance_process_t *procs, int max_procs, sample_t *samples,
+        int *nsamples, double alpha, bool verbose) {
+    int pidlist[max_procs];
+    int nelems = 0;
+    DLB_DROM_GetPidList(pidlist, &nelems, max_procs);
+
+    // Drop the history of processes that have finished
+    sample_t alive[max_procs];
+    int nalive = 0;
+    int i, j;
+    for (i = 0; i < *nsamples; ++i) {
+        for (j = 0; j < nelems; ++j) {
+            if (samples[i].pid == pidlist[j]) {
+                alive[nalive++] = samples[i];
+                break;
+            }
+        }
+    }
+    memcpy(samples, alive, sizeof(sample_t)*nalive);
+    *nsamples = nalive;
+
+    int nprocs = 0;
+    for (i = 0; i < nelems; ++i) {
+        rebalance_process_t *proc = &procs[nprocs];
+        proc->pid = pidlist[i];
+        if (DLB_DROM_GetProcessMask(proc->pid, &proc->mask, 0) != DLB_SUCCESS
+                || CPU_COUNT(&proc->mask) == 0) {
+            continue;
+        }
+        double usage;
+        DLB_Stats_GetCpuUsage(proc->pid, &usage);
+        if (usage > 0.0) {
+            // CPU usage accounts for owned CPUs not lent and borrowed CPUs
+            proc->demand = update_demand(samples, nsamples, proc->pid, usage / 100.0, alpha);
+        } else {
+            // Statistics not available, keep the current ownership
+            proc->demand = -1.0;
+        }
+        if (verbose) {
+            fprintf(stdout, "PID %d: mask %s, demand %.2f CPUs\n",
+                    proc->pid, mu_to_str(&proc->mask), proc->demand);
+        }
+        ++nprocs;
+    }
+    return nprocs;
+}
+
+static bool same_partition(const rebalance_process_t *a, int na,
+        const rebalance_process_t *b, int nb) {
+    if (na != nb) return false;
+    int i;
+    for (i = 0; i < na; ++i) {
+        if (a[i].pid != b[i].pid || !CPU_EQUAL(&a[i].new_mask, &b[i].new_mask)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static int apply(const rebalance_process_t *procs, int nprocs) {
+    int pids[nprocs];
+    cpu_set_t masks[nprocs];
+    int i, n = 0;
+    for (i = 0; i < nprocs; ++i) {
+        if (!CPU_EQUAL(&procs[i].mask, &procs[i].new_mask)) {
+            pids[n] = procs[i].pid;
+            memcpy(&masks[n], &procs[i].new_mask, sizeof(cpu_set_t));
+            ++n;
+        }
+    }
+    int error = DLB_DROM_SetProcessMasks(pids, masks, n, 0);
+    if (error != DLB_SUCCESS) {
+        fprintf(stderr, "Repartition did not succeed: %s\n", DLB_Strerror(error));
+    }
+    return error;
+}
+
+static void print_partition(const rebalance_process_t *procs, int nprocs, bool applied) {
+    int i;
+    for (i = 0; i < nprocs; ++i) {
+        if (!CPU_EQUAL(&procs[i].mask, &procs[i].new_mask)) {
+            fprintf(stdout, "PID %d's affinity %s %s -> ", procs[i].pid,
+                    applied ? "set to" : "would be set to", mu_to_str(&procs[i].mask));
+            fprintf(stdout, "%s\n", mu_to_str(&procs[i].new_mask));
+        }
+    }
+}
+
+
+int main(int argc, char *argv[]) {
+    int interval_ms = 1000;
+    int window = 3;
+    double alpha = 0.5;
+    bool dry_run = false;
+    bool once = false;
+    bool verbose = false;
+    rebalance_config_t config = {
+        .min_cpus = 1,
+        .min_change = 1,
+        .hysteresis = 0.25,
+    };
+
+    int opt;
+    extern char *optarg;
+    struct option long_options[] = {
+        {"interval",   required_argument, NULL, 'i'},
+        {"min-cpus",   required_argument, NULL, 'm'},
+        {"threshold",  required_argument, NULL, 't'},
+        {"min-change", required_argument, NULL, 'c'},
+        {"window",     required_argument, NULL, 'w'},
+        {"alpha",      required_argument, NULL, 'a'},
+        {"dry-run",    no_argument,       NULL, 'n'},
+        {"once",       no_argument,       NULL, 'o'},
+        {"verbose",    no_argument,       NULL, 'v'},
+        {"help",       no_argument,       NULL, 'h'},
+        {0,            0,                 NULL, 0 }
+    };
+
+    while ((opt = getopt_long(argc, argv, "i:m:t:c:w:a:novh", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'i':
+                interval_ms = strtol(optarg, NULL, 0);
+                break;
+            case 'm':
+                config.min_cpus = strtol(optarg, NULL, 0);
+                break;
+            case 't':
+                config.hysteresis = strtod(optarg, NULL);
+                break;
+            case 'c':
+                config.min_change = strtol(optarg, NULL, 0);
+                break;
+            case 'w':
+                window = strtol(optarg, NULL, 0);
+                break;
+            case 'a':
+                alpha = strtod(optarg, NULL);
+                break;
+            case 'n':
+                dry_run = true;
+                break;
+            case 'o':
+                once = true;
+                break;
+            case 'v':
+                verbose = true;
+                break;
+            case 'h':
+                usage(argv[0], stdout);
+                break;
+            default:
+                usage(argv[0], stderr);
+                break;
+        }
+    }
+
+    if (interval_ms <= 0 || window <= 0 || config.min_cpus <= 0
+            || alpha <= 0.0 || alpha > 1.0) {
+        usage(argv[0], stderr);
+    }
+    if (once) {
+        window = 1;
+    }
+
+    signal(SIGINT, stop_handler);
+    signal(SIGTERM, stop_handler);
+
+    int max_procs;
+    DLB_DROM_GetNumCpus(&max_procs);
+    DLB_DROM_Attach();
+    DLB_Stats_Init();
+
+    rebalance_process_t *procs = malloc(sizeof(rebalance_process_t)*max_procs);
+    rebalance_process_t *proposal = malloc(sizeof(rebalance_process_t)*max_procs);
+    sample_t *samples = malloc(sizeof(sample_t)*max_procs);
+    int nsamples = 0;
+    int nproposal = 0;
+    int streak = 0;
+
+    while (keep_running) {
+        int nprocs = sample(procs, max_procs, samples, &nsamples, alpha, verbose);
+        int changed = rebalance_compute(&config, procs, nprocs, NULL, 0);
+        if (changed > 0) {
+            // A new partition is only applied if it persists for some samples
+            streak = same_partition(procs, nprocs, proposal, nproposal) ? streak + 1 : 1;
+            memcpy(proposal, procs, sizeof(rebalance_process_t)*nprocs);
+            nproposal = nprocs;
+            if (streak >= window) {
+                bool applied = !dry_run && apply(procs, nprocs) == DLB_SUCCESS;
+                print_partition(procs, nprocs, applied);
+                streak = 0;
+                nproposal = 0;
+            }
+        } else {
+            streak = 0;
+            nproposal = 0;
+            if (changed < 0) {
+                fprintf(stderr, "Could not compute a new partition: %s\n",
+                        DLB_Strerror(changed));
+            }
+        }
+
+        if (once) break;
+        usleep(interval_ms * 1000);
+    }
+
+    free(samples);
+    free(proposal);
+    free(procs);
+    DLB_Stats_Finalize();
+    DLB_DROM_Deattach();
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,99 @@
+/*********************************************************************************/
+/*  Copyright 2017 Barcelona Supercomputing Center                               */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <http://www.gnu.org/licenses/>.                 */
+/*********************************************************************************/
+
+/* Policy plugin used by the tests: lend and reclaim the whole process mask */
+
+#define _GNU_SOURCE
+#include "dlb_plugin.h"
+#include "dlb_errors.h"
+
+#include <stdlib.h>
+
+static const dlb_plugin_services_t *services = NULL;
+
+typedef struct {
+    int nlends;
+} plugin_data_t;
+
+static int plugin_init(dlb_subprocess_t *spd) {
+    plugin_data_t *data = malloc(sizeof(plugin_data_t));
+    if (data == NULL) return DLB_ERR_NOMEM;
+    data->nlends = 0;
+    services->set_policy_data(spd, data);
+    return DLB_SUCCESS;
+}
+
+static int plugin_finalize(dlb_subprocess_t *spd) {
+    free(services->get_policy_data(spd));
+    services->set_policy_data(spd, NULL);
+    return DLB_SUCCESS;
+}
+
+static int plugin_lend(const dlb_subprocess_t *spd) {
+    plugin_data_t *data = services->get_policy_data(spd);
+    ++data->nlends;
+    cpu_set_t mask;
+    services->get_process_mask(spd, &mask);
+    pid_t new_guests[services->get_system_size()];
+    int error = services->cpuinfo_lend_cpu_mask(services->get_pid(spd), &mask, new_guests);
+    int cpuid;
+    for (cpuid = 0; cpuid < services->get_system_size(); ++cpuid) {
+        if (CPU_ISSET(cpuid, &mask)) {
+            services->disable_cpu(spd, cpuid);
+        }
+    }
+    return error;
+}
+
+static int plugin_reclaim(const dlb_subprocess_t *spd) {
+    pid_t pid = services->get_pid(spd);
+    pid_t new_guests[services->get_system_size()];
+    pid_t victims[services->get_system_size()];
+    int error = services->cpuinfo_reclaim_all(pid, new_guests, victims);
+    int cpuid;
+    for (cpuid = 0; cpuid < services->get_system_size(); ++cpuid) {
+        if (new_guests[cpuid] == pid) {
+            services->enable_cpu(spd, cpuid);
+        }
+    }
+    return error;
+}
+
+static const dlb_policy_descriptor_t plugin_descriptor = {
+    .abi_version = DLB_PLUGIN_ABI_VERSION,
+    .name = "test_plugin",
+    .flags = DLB_POLICY_USES_CPUINFO,
+    .funcs = {
+        .init       = plugin_init,
+        .finalize   = plugin_finalize,
+        .lend       = plugin_lend,
+        .reclaim    = plugin_reclaim,
+    },
+};
+
+/* Number of times the policy has lent the CPUs of the sub-process */
+int test_plugin_get_nlends(const dlb_subprocess_t *spd) {
+    plugin_data_t *data = services->get_policy_data(spd);
+    return data ? data->nlends : -1;
+}
+
+const dlb_policy_descriptor_t* dlb_plugin_entry(const dlb_plugin_services_t *s) {
+    services = s;
+    return &plugin_descriptor;
+}
@@ -0,0 +1,182 @@
+/*********************************************************************************/
+/*  Copyright 2017 Barcelona Supercomputing Center                               */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <http://www.gnu.org/licenses/>.                 */
+/*********************************************************************************/
+
+/*<testinfo>
+    test_generator="gens/basic-generator"
+</testinfo>*/
+
+#include "support/cgroup.h"
+#include "support/mask_utils.h"
+#include "apis/dlb_errors.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <assert.h>
+
+/* cgroup v2 cpuset synchronization against a fake cgroupfs tree */
+
+static void write_file(const char *dir, const char *file, const char *value) {
+    char filename[PATH_MAX];
+    snprintf(filename, PATH_MAX, "%s/%s", dir, file);
+    FILE *fd = fopen(filename, "w");
+    assert( fd != NULL );
+    fprintf(fd, "%s", value);
+    fclose(fd);
+}
+
+static void check_file(const char *dir, const char *file, const char *value) {
+    char filename[PATH_MAX];
+    char buffer[64];
+    snprintf(filename, PATH_MAX, "%s/%s", dir, file);
+    FILE *fd = fopen(filename, "r");
+    assert( fd != NULL );
+    assert( fgets(buffer, 64, fd) != NULL );
+    buffer[strcspn(buffer, "\n")] = '\0';
+    fclose(fd);
+    assert( strcmp(buffer, value) == 0 );
+}
+
+static void remove_file(const char *dir, const char *file) {
+    char filename[PATH_MAX];
+    snprintf(filename, PATH_MAX, "%s/%s", dir, file);
+    assert( unlink(filename) == 0 );
+}
+
+int main( int argc, char **argv ) {
+    mu_init();
+    mu_testing_set_sys_size(8);
+    pid_t pid = getpid();
+    char procs[32];
+
+    // Fake cgroupfs: <root>/job/step with a proc file pointing to it
+    char root[] = "/tmp/dlb_cgroup_XXXXXX";
+    assert( mkdtemp(root) != NULL );
+    char job[256];
+    char path[256];
+    snprintf(job, 256, "%s/job", root);
+    assert( mkdir(job, 0700) == 0 );
+    snprintf(path, 256, "%s/job/step", root);
+    assert( mkdir(path, 0700) == 0 );
+    write_file(root, "proc_cgroup", "0::/job/step\n");
+    write_file(path, "cpuset.cpus", "0-3\n");
+    write_file(path, "cpuset.cpus.effective", "0-2\n");
+    snprintf(procs, 32, "%d\n", pid);
+    write_file(path, "cgroup.procs", procs);
+
+    // Find cgroup directory from the proc file
+    char proc_file[PATH_MAX];
+    char dir[PATH_MAX];
+    snprintf(proc_file, PATH_MAX, "%s/proc_cgroup", root);
+    assert( cgroup_find_dir(proc_file, root, dir, PATH_MAX) == DLB_SUCCESS );
+    assert( strcmp(dir, path) == 0 );
+    assert( cgroup_find_dir(proc_file, root, dir, 4) == DLB_ERR_NOMEM );
+    write_file(root, "proc_cgroup", "1:cpuset:/job\n");
+    assert( cgroup_find_dir(proc_file, root, dir, PATH_MAX) == DLB_ERR_NOENT );
+    write_file(root, "proc_cgroup", "0::/job/step\n");
+    cgroup_testing_set_root(proc_file, root);
+
+    // Not initialized
+    cgroup_info_t cgroup = { .path = "" };
+    cpu_set_t mask;
+    assert( cgroup_set_mask(&cgroup, &mask) == DLB_ERR_NOENT );
+    assert( cgroup_finalize(&cgroup, pid) == DLB_ERR_NOENT );
+
+    // Init reads the effective cpuset of the per-process cgroup
+    cpu_set_t expected;
+    mu_parse_mask("0-2", &expected);
+    assert( cgroup_init(&cgroup, "auto", pid, &mask) == DLB_SUCCESS );
+    assert( CPU_EQUAL(&mask, &expected) );
+    assert( strcmp(cgroup.path, path) == 0 );
+    assert( !cgroup.created );
+
+    // New masks are written into cpuset.cpus
+    mu_parse_mask("1-2", &mask);
+    assert( cgroup_set_mask(&cgroup, &mask) == DLB_SUCCESS );
+    check_file(path, "cpuset.cpus", "1,2");
+    mu_parse_mask("0-2,5", &mask);
+    assert( cgroup_set_mask(&cgroup, &mask) == DLB_SUCCESS );
+    check_file(path, "cpuset.cpus", "0-2,5");
+
+    // Finalize restores the original cpuset
+    assert( cgroup_finalize(&cgroup, pid) == DLB_SUCCESS );
+    check_file(path, "cpuset.cpus", "0-3");
+
+    // Without effective cpuset, cpuset.cpus is used
+    remove_file(path, "cpuset.cpus.effective");
+    mu_parse_mask("0-3", &expected);
+    assert( cgroup_init(&cgroup, path, pid, &mask) == DLB_SUCCESS );
+    assert( CPU_EQUAL(&mask, &expected) );
+    assert( cgroup_finalize(&cgroup, pid) == DLB_SUCCESS );
+
+    // A cgroup shared with other processes is rejected and left untouched
+    snprintf(procs, 32, "%d\n%d\n", pid, pid+1);
+    write_file(path, "cgroup.procs", procs);
+    assert( cgroup_init(&cgroup, path, pid, &mask) == DLB_ERR_PERM );
+    assert( cgroup_set_mask(&cgroup, &mask) == DLB_ERR_NOENT );
+    check_file(path, "cpuset.cpus", "0-3");
+    snprintf(procs, 32, "%d\n", pid+1);
+    write_file(path, "cgroup.procs", procs);
+    assert( cgroup_init(&cgroup, path, pid, &mask) == DLB_ERR_PERM );
+
+    // A cgroup without processes gets a leaf cgroup per process
+    write_file(job, "cpuset.cpus", "0-7\n");
+    write_file(job, "cgroup.procs", "");
+    assert( cgroup_init(&cgroup, job, pid, &mask) == DLB_SUCCESS );
+    mu_parse_mask("0-7", &expected);
+    assert( CPU_EQUAL(&mask, &expected) );
+    char leaf[PATH_MAX];
+    snprintf(leaf, PATH_MAX, "%s/dlb.%d", job, pid);
+    assert( strcmp(cgroup.path, leaf) == 0 );
+    assert( cgroup.created );
+    check_file(job, "cgroup.subtree_control", "+cpuset");
+    snprintf(procs, 32, "%d", pid);
+    check_file(leaf, "cgroup.procs", procs);
+    mu_parse_mask("4-5", &mask);
+    assert( cgroup_set_mask(&cgroup, &mask) == DLB_SUCCESS );
+    check_file(leaf, "cpuset.cpus", "4,5");
+    check_file(job, "cpuset.cpus", "0-7");
+
+    // Finalize moves the process back to its original cgroup
+    write_file(path, "cgroup.procs", "");
+    assert( cgroup_finalize(&cgroup, pid) == DLB_SUCCESS );
+    check_file(path, "cgroup.procs", procs);
+
+    // Non-existent cgroup
+    assert( cgroup_init(&cgroup, root, pid, &mask) == DLB_ERR_NOENT );
+
+    // Clean up
+    remove_file(leaf, "cgroup.procs");
+    remove_file(leaf, "cpuset.cpus");
+    rmdir(leaf);
+    remove_file(path, "cpuset.cpus");
+    remove_file(path, "cgroup.procs");
+    rmdir(path);
+    remove_file(job, "cpuset.cpus");
+    remove_file(job, "cgroup.procs");
+    remove_file(job, "cgroup.subtree_control");
+    rmdir(job);
+    remove_file(root, "proc_cgroup");
+    rmdir(root);
+
+    return 0;
+}
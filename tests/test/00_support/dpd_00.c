@@ -0,0 +1,126 @@
+/*********************************************************************************/
+/*  Copyright 2017 Barcelona Supercomputing Center                               */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <http://www.gnu.org/licenses/>.                 */
+/*********************************************************************************/
+
+/*<testinfo>
+    test_generator="gens/basic-generator"
+</testinfo>*/
+
+#include "support/dpd.h"
+
+#include <stdlib.h>
+#include <assert.h>
+
+/* Synthetic stream of period p: p different samples, repeated */
+static long periodic_sample(int i, int p) {
+    return 1000 + (i % p) * 7;
+}
+
+/* Feed n samples of period p starting at sample i0, return the number of
+ * period starts marked, and the index of the last one */
+static int feed(dpd_t *dpd, int i0, int n, int p, int *period, int *last_mark) {
+    int nmarks = 0;
+    int i;
+    for (i = i0; i < i0 + n; ++i) {
+        long sample = periodic_sample(i, p);
+        long mark = dpd_sample(dpd, sample, period);
+        if (mark != 0) {
+            assert( mark == sample );
+            ++nmarks;
+            *last_mark = i;
+        }
+    }
+    return nmarks;
+}
+
+int main( int argc, char **argv ) {
+    dpd_t dpd;
+    int period, last_mark;
+
+    /* Period of 3 is detected after a whole period has matched, and then
+     * every third sample starts a new period */
+    dpd_init(&dpd, 300);
+    assert( feed(&dpd, 0, 5, 3, &period, &last_mark) == 0 );
+    assert( period == 0 );
+    assert( feed(&dpd, 5, 1, 3, &period, &last_mark) == 0 );
+    assert( period == 3 );
+    assert( feed(&dpd, 6, 30, 3, &period, &last_mark) == 10 );
+    assert( period == 3 );
+    assert( last_mark % 3 == 0 );
+
+    /* Reset */
+    dpd_init(&dpd, 300);
+    assert( dpd_sample(&dpd, periodic_sample(0, 3), &period) == 0 );
+    assert( period == 0 );
+
+    /* The period changes */
+    dpd_init(&dpd, 300);
+    feed(&dpd, 0, 50, 4, &period, &last_mark);
+    assert( period == 4 );
+    feed(&dpd, 0, 50, 9, &period, &last_mark);
+    assert( period == 9 );
+    int first = last_mark;
+    assert( feed(&dpd, 50, 90, 9, &period, &last_mark) == 10 );
+    assert( (last_mark - first) % 9 == 0 );
+
+    /* Periods must be shorter than the window */
+    dpd_init(&dpd, 32);
+    feed(&dpd, 0, 200, 40, &period, &last_mark);
+    assert( period == 0 );
+    dpd_init(&dpd, 64);
+    feed(&dpd, 0, 200, 40, &period, &last_mark);
+    assert( period == 40 );
+
+    /* Window is clamped */
+    dpd_init(&dpd, 10000);
+    assert( dpd.window == DPD_MAX_WINDOW );
+    dpd_init(&dpd, 0);
+    assert( dpd.window == 2 );
+
+    /* Independent streams with different periods */
+    dpd_t dpd_a, dpd_b;
+    int period_a, period_b, mark_a, mark_b;
+    dpd_init(&dpd_a, 300);
+    dpd_init(&dpd_b, 300);
+    int i;
+    for (i = 0; i < 100; ++i) {
+        feed(&dpd_a, i, 1, 5, &period_a, &mark_a);
+        feed(&dpd_b, i, 1, 7, &period_b, &mark_b);
+    }
+    assert( period_a == 5 && period_b == 7 );
+
+    /* Non-periodic stream */
+    dpd_init(&dpd, 300);
+    srand(0);
+    for (i = 0; i < 1000; ++i) {
+        assert( dpd_sample(&dpd, 1 + rand(), &period) == 0 );
+    }
+    assert( period == 0 );
+
+    /* Samples are compared exactly */
+    if (sizeof(long) > 4) {
+        dpd_init(&dpd, 300);
+        for (i = 0; i < 100; ++i) {
+            long sample = 1 + ((long)(i % 2) << 32);
+            dpd_sample(&dpd, sample, &period);
+        }
+        assert( period == 2 );
+    }
+
+    return 0;
+}
@@ -0,0 +1,87 @@
+/*********************************************************************************/
+/*  Copyright 2017 Barcelona Supercomputing Center                               */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <http://www.gnu.org/licenses/>.                 */
+/*********************************************************************************/
+
+/*<testinfo>
+    test_generator="gens/basic-generator"
+</testinfo>*/
+
+#include "support/dpd.h"
+#include "support/mytime.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+/* DPD microbenchmark: cost per sample of synthetic MPI call streams with the
+ * default window used for the MPI interception */
+
+enum { WINDOW = 300 };
+enum { NUM_SAMPLES = 200000 };
+enum { MAX_NS_PER_SAMPLE = 20000 };
+
+/* Stream of period p where each sample resembles the hash of an MPI call */
+static long mpi_like_sample(int i, int p) {
+    long buf = 0x7f0000001000L + (i % p) * 64;
+    long dest = (i % p) % 4;
+    long call_type = 1 + (i % p) % 5;
+    return (((buf>>5)^dest)<<5)|call_type;
+}
+
+static double bench(int p, int *period, int *nmarks) {
+    dpd_t dpd;
+    dpd_init(&dpd, WINDOW);
+    *nmarks = 0;
+    int64_t start = get_time_in_ns();
+    int i;
+    for (i = 0; i < NUM_SAMPLES; ++i) {
+        if (dpd_sample(&dpd, mpi_like_sample(i, p), period) != 0) {
+            ++*nmarks;
+        }
+    }
+    return (double)(get_time_in_ns() - start) / NUM_SAMPLES;
+}
+
+int main( int argc, char **argv ) {
+    const int periods[] = {2, 17, 100, 250};
+    int i;
+    for (i = 0; i < sizeof(periods)/sizeof(periods[0]); ++i) {
+        int p = periods[i];
+        int period, nmarks;
+        double ns_per_sample = bench(p, &period, &nmarks);
+        printf("period %3d: %8.1f ns/sample, %d periods\n", p, ns_per_sample, nmarks);
+        assert( period == p );
+        assert( nmarks >= NUM_SAMPLES / p - 3 );
+        assert( ns_per_sample < MAX_NS_PER_SAMPLE );
+    }
+
+    /* Non-periodic stream, all the lags are updated and none matches */
+    dpd_t dpd;
+    dpd_init(&dpd, WINDOW);
+    srand(0);
+    int period;
+    int64_t start = get_time_in_ns();
+    for (i = 0; i < NUM_SAMPLES; ++i) {
+        assert( dpd_sample(&dpd, 1 + rand(), &period) == 0 );
+    }
+    double ns_per_sample = (double)(get_time_in_ns() - start) / NUM_SAMPLES;
+    printf("random    : %8.1f ns/sample\n", ns_per_sample);
+    assert( ns_per_sample < MAX_NS_PER_SAMPLE );
+
+    return 0;
+}
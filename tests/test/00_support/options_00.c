@@ -121,6 +121,16 @@ int main( int argc, char **argv ) {
     // TODO: some variables are still not being checked
     options_init(&options_1, "--mode=async");
     assert(options_1.mode == MODE_ASYNC);
+    assert(options_1.async_placement == HELPER_PROCESS);
+    assert(options_1.async_sched == HELPER_SCHED_INHERIT);
+    assert(options_1.async_priority == 0);
+    assert(CPU_COUNT(&options_1.async_cpus) == 0);
+    options_init(&options_1, "--async-placement=service --async-cpus=0 --async-sched=idle"
+            " --async-priority=5");
+    assert(options_1.async_placement == HELPER_SERVICE);
+    assert(CPU_COUNT(&options_1.async_cpus) == 1 && CPU_ISSET(0, &options_1.async_cpus));
+    assert(options_1.async_sched == HELPER_SCHED_IDLE);
+    assert(options_1.async_priority == 5);
 
     // Unset all variables and check that default values are preserved
     options_init(&options_1, NULL);
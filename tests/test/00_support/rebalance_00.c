@@ -0,0 +1,167 @@
+/*********************************************************************************/
+/*  Copyright 2017 Barcelona Supercomputing Center                               */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <http://www.gnu.org/licenses/>.                 */
+/*********************************************************************************/
+
+/*<testinfo>
+    test_generator="gens/basic-generator"
+</testinfo>*/
+
+#include "assert_noshm.h"
+
+#include "support/rebalance.h"
+#include "support/mask_utils.h"
+#include "apis/dlb_errors.h"
+
+#include <sched.h>
+#include <string.h>
+#include <assert.h>
+
+static void set_proc(rebalance_process_t *proc, pid_t pid, const char *mask, double demand) {
+    proc->pid = pid;
+    mu_parse_mask(mask, &proc->mask);
+    proc->demand = demand;
+}
+
+static bool is_mask(const cpu_set_t *mask, const char *str) {
+    cpu_set_t expected;
+    mu_parse_mask(str, &expected);
+    return CPU_EQUAL(mask, &expected);
+}
+
+/* New masks are disjoint and cover exactly the same CPUs */
+static bool is_partition(const rebalance_process_t *procs, int nprocs) {
+    cpu_set_t old_union, new_union;
+    CPU_ZERO(&old_union);
+    CPU_ZERO(&new_union);
+    int i;
+    for (i = 0; i < nprocs; ++i) {
+        cpu_set_t intxn;
+        CPU_AND(&intxn, &new_union, &procs[i].new_mask);
+        if (CPU_COUNT(&intxn) > 0) return false;
+        CPU_OR(&old_union, &old_union, &procs[i].mask);
+        CPU_OR(&new_union, &new_union, &procs[i].new_mask);
+    }
+    return CPU_EQUAL(&old_union, &new_union);
+}
+
+int main(int argc, char *argv[]) {
+    mu_init();
+    mu_testing_set_sys_size(8);
+
+    cpu_set_t domains[2];
+    mu_parse_mask("0-3", &domains[0]);
+    mu_parse_mask("4-7", &domains[1]);
+
+    rebalance_config_t config = {
+        .min_cpus = 1,
+        .min_change = 1,
+        .hysteresis = 0.25,
+    };
+    rebalance_process_t procs[4];
+
+    /* Balanced demand, nothing to do */
+    set_proc(&procs[0], 111, "0-3", 4.0);
+    set_proc(&procs[1], 222, "4-7", 4.0);
+    assert( rebalance_compute(&config, procs, 2, domains, 2) == 0 );
+    assert( CPU_EQUAL(&procs[0].mask, &procs[0].new_mask) );
+    assert( CPU_EQUAL(&procs[1].mask, &procs[1].new_mask) );
+
+    /* Unknown demand keeps the current ownership */
+    set_proc(&procs[0], 111, "0-3", -1.0);
+    set_proc(&procs[1], 222, "4-7", -1.0);
+    assert( rebalance_compute(&config, procs, 2, domains, 2) == 0 );
+
+    /* Small imbalance, rounding favours the current ownership */
+    set_proc(&procs[0], 111, "0-3", 4.5);
+    set_proc(&procs[1], 222, "4-7", 3.5);
+    assert( rebalance_compute(&config, procs, 2, domains, 2) == 0 );
+
+    /* Imbalance above the hysteresis threshold */
+    set_proc(&procs[0], 111, "0-3", 5.0);
+    set_proc(&procs[1], 222, "4-7", 3.0);
+    assert( rebalance_compute(&config, procs, 2, domains, 2) == 2 );
+    assert( is_mask(&procs[0].new_mask, "0-3,7") );
+    assert( is_mask(&procs[1].new_mask, "4-6") );
+    assert( is_partition(procs, 2) );
+
+    /* Same imbalance below a larger hysteresis threshold */
+    config.hysteresis = 0.5;
+    assert( rebalance_compute(&config, procs, 2, domains, 2) == 0 );
+    config.hysteresis = 0.25;
+
+    /* Large imbalance, the minimum guarantee is respected */
+    set_proc(&procs[0], 111, "0-3", 8.0);
+    set_proc(&procs[1], 222, "4-7", 0.0);
+    assert( rebalance_compute(&config, procs, 2, domains, 2) == 2 );
+    assert( is_mask(&procs[0].new_mask, "0-3,5-7") );
+    assert( is_mask(&procs[1].new_mask, "4") );
+    config.min_cpus = 2;
+    assert( rebalance_compute(&config, procs, 2, domains, 2) == 2 );
+    assert( is_mask(&procs[0].new_mask, "0-3,6-7") );
+    assert( is_mask(&procs[1].new_mask, "4-5") );
+    config.min_cpus = 1;
+
+    /* Topology packing: growing processes take CPUs from their own domain */
+    set_proc(&procs[0], 111, "0,1", 3.0);
+    set_proc(&procs[1], 222, "2,3", 1.0);
+    set_proc(&procs[2], 333, "4,5", 3.0);
+    set_proc(&procs[3], 444, "6,7", 1.0);
+    assert( rebalance_compute(&config, procs, 4, domains, 2) == 4 );
+    assert( is_mask(&procs[0].new_mask, "0,1,3") );
+    assert( is_mask(&procs[1].new_mask, "2") );
+    assert( is_mask(&procs[2].new_mask, "4,5,7") );
+    assert( is_mask(&procs[3].new_mask, "6") );
+    assert( is_partition(procs, 4) );
+
+    /* Topology packing: shrinking processes release CPUs from their minor domain */
+    set_proc(&procs[0], 111, "0-2,4", 2.0);
+    set_proc(&procs[1], 222, "3,5-7", 6.0);
+    assert( rebalance_compute(&config, procs, 2, domains, 2) == 2 );
+    assert( is_mask(&procs[0].new_mask, "0-1") );
+    assert( is_mask(&procs[1].new_mask, "2-7") );
+    assert( is_partition(procs, 2) );
+
+    /* Minimum guarantee larger than the available CPUs is reduced */
+    config.min_cpus = 4;
+    set_proc(&procs[0], 111, "0-3", 0.0);
+    set_proc(&procs[1], 222, "4,5", 8.0);
+    set_proc(&procs[2], 333, "6,7", 0.0);
+    assert( rebalance_compute(&config, procs, 3, domains, 2) == 2 );
+    assert( is_mask(&procs[0].new_mask, "0,1") );
+    assert( is_mask(&procs[1].new_mask, "2-5") );
+    assert( is_mask(&procs[2].new_mask, "6,7") );
+    config.min_cpus = 1;
+
+    /* More processes than CPUs, or processes without CPUs */
+    set_proc(&procs[0], 111, "0", 1.0);
+    set_proc(&procs[1], 222, "0", 1.0);
+    assert( rebalance_compute(&config, procs, 2, domains, 2) == DLB_ERR_PERM );
+    CPU_ZERO(&procs[1].mask);
+    assert( rebalance_compute(&config, procs, 2, domains, 2) == DLB_ERR_PERM );
+
+    /* System topology */
+    set_proc(&procs[0], 111, "0-3", 1.0);
+    set_proc(&procs[1], 222, "4-7", 7.0);
+    assert( rebalance_compute(&config, procs, 2, NULL, 0) == 2 );
+    assert( CPU_COUNT(&procs[0].new_mask) == 1 );
+    assert( CPU_COUNT(&procs[1].new_mask) == 7 );
+    assert( is_partition(procs, 2) );
+
+    mu_finalize();
+    return 0;
+}
@@ -82,6 +82,14 @@ int main(int argc, char *argv[]) {
     printf("Policy: %s\n", policy_tostr(pol));
     err = parse_policy("lewi_mask", &pol);          assert(!err && pol==POLICY_LEWI_MASK);
     printf("Policy: %s\n", policy_tostr(pol));
+    err = parse_policy("ral", &pol);                assert(!err && pol==POLICY_RAL);
+    printf("Policy: %s\n", policy_tostr(pol));
+    err = parse_policy("peral", &pol);              assert(!err && pol==POLICY_PERAL);
+    printf("Policy: %s\n", policy_tostr(pol));
+    err = parse_policy("lewi_predict", &pol);       assert(!err && pol==POLICY_LEWI_PREDICT);
+    printf("Policy: %s\n", policy_tostr(pol));
+    err = parse_policy("lewi_rebalance", &pol);     assert(!err && pol==POLICY_LEWI_REBALANCE);
+    printf("Policy: %s\n", policy_tostr(pol));
 
     interaction_mode_t mode;
     err = parse_mode("", &mode);                    assert(err);
@@ -89,5 +97,19 @@ int main(int argc, char *argv[]) {
     err = parse_mode("polling", &mode);             assert(!err && mode==MODE_POLLING);
     err = parse_mode("async", &mode);               assert(!err && mode==MODE_ASYNC);
 
+    helper_placement_t placement;
+    err = parse_helper_placement("", &placement);   assert(err);
+    err = parse_helper_placement("process", &placement);
+    assert(!err && placement==HELPER_PROCESS);
+    err = parse_helper_placement("least-loaded", &placement);
+    assert(!err && placement==HELPER_LEAST_LOADED);
+    printf("Helper placement: %s\n", helper_placement_tostr(placement));
+
+    helper_sched_t sched;
+    err = parse_helper_sched("null", &sched);       assert(err);
+    err = parse_helper_sched("inherit", &sched);    assert(!err && sched==HELPER_SCHED_INHERIT);
+    err = parse_helper_sched("FIFO", &sched);       assert(!err && sched==HELPER_SCHED_FIFO);
+    printf("Helper scheduling: %s\n", helper_sched_tostr(sched));
+
     return 0;
 }
@@ -74,6 +74,24 @@ static void cb_disable_cpu(int cpuid, void *arg) {
     CPU_CLR(cpuid, &process_mask);
 }
 
+static int num_cpu_set_calls = 0;
+
+static object_t cb_enable_cpu_set_arg = { .n = 8 };
+static void cb_enable_cpu_set(const cpu_set_t *mask, void *arg) {
+    assert( ((object_t*)arg)->n == cb_enable_cpu_set_arg.n );
+    CPU_OR(&process_mask, &process_mask, mask);
+    ++num_cpu_set_calls;
+}
+
+static object_t cb_disable_cpu_set_arg = { .n = 9 };
+static void cb_disable_cpu_set(const cpu_set_t *mask, void *arg) {
+    assert( ((object_t*)arg)->n == cb_disable_cpu_set_arg.n );
+    cpu_set_t xor;
+    CPU_XOR(&xor, &process_mask, mask);
+    CPU_AND(&process_mask, &process_mask, &xor);
+    ++num_cpu_set_calls;
+}
+
 int main( int argc, char **argv ) {
     cpu_set_t mask;
     CPU_ZERO(&mask);
@@ -89,6 +107,8 @@ int main( int argc, char **argv ) {
     assert( add_process_mask(&pm, &mask) == DLB_ERR_NOCBK );
     assert( enable_cpu(&pm, 0) == DLB_ERR_NOCBK );
     assert( disable_cpu(&pm, 0) == DLB_ERR_NOCBK );
+    assert( enable_cpu_set(&pm, &mask) == DLB_ERR_NOCBK );
+    assert( disable_cpu_set(&pm, &mask) == DLB_ERR_NOCBK );
 
     // Set callbacks
     assert( pm_callback_set(&pm, dlb_callback_set_num_threads,
@@ -157,6 +177,35 @@ int main( int argc, char **argv ) {
     assert( disable_cpu(&pm, 2) == DLB_SUCCESS );
     assert( CPU_COUNT(&process_mask) == 2 );
 
+    // CPU set functions fall back to the per-CPU callbacks
+    CPU_ZERO(&mask);
+    CPU_SET(2, &mask);
+    CPU_SET(3, &mask);
+    assert( enable_cpu_set(&pm, &mask) == DLB_SUCCESS );
+    assert( CPU_COUNT(&process_mask) == 4 );
+    assert( disable_cpu_set(&pm, &mask) == DLB_SUCCESS );
+    assert( CPU_COUNT(&process_mask) == 2 );
+    assert( num_cpu_set_calls == 0 );
+
+    // Set and get CPU set callbacks
+    assert( pm_callback_set(&pm, dlb_callback_enable_cpu_set,
+                (dlb_callback_t)cb_enable_cpu_set, &cb_enable_cpu_set_arg) == DLB_SUCCESS );
+    assert( pm_callback_set(&pm, dlb_callback_disable_cpu_set,
+                (dlb_callback_t)cb_disable_cpu_set, &cb_disable_cpu_set_arg) == DLB_SUCCESS );
+    assert( pm_callback_get(&pm, dlb_callback_enable_cpu_set, &cb, &arg) == DLB_SUCCESS );
+    assert( cb == (dlb_callback_t)cb_enable_cpu_set );
+    assert( arg == &cb_enable_cpu_set_arg );
+    assert( pm_callback_get(&pm, dlb_callback_disable_cpu_set, &cb, &arg) == DLB_SUCCESS );
+    assert( cb == (dlb_callback_t)cb_disable_cpu_set );
+    assert( arg == &cb_disable_cpu_set_arg );
+
+    // CPU set callbacks are called once per CPU set
+    assert( enable_cpu_set(&pm, &mask) == DLB_SUCCESS );
+    assert( CPU_COUNT(&process_mask) == 4 );
+    assert( disable_cpu_set(&pm, &mask) == DLB_SUCCESS );
+    assert( CPU_COUNT(&process_mask) == 2 );
+    assert( num_cpu_set_calls == 2 );
+
 
     return 0;
 }
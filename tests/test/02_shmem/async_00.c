@@ -24,32 +24,122 @@
 #include "assert_noshm.h"
 
 #include "LB_comm/shmem_async.h"
+#include "LB_core/spd.h"
 #include "LB_numThreads/numThreads.h"
 #include "apis/dlb_errors.h"
+#include "support/mask_utils.h"
 
+#include <sched.h>
+#include <stdbool.h>
 #include <assert.h>
 
 /* Test message queue */
 
-static int num_cb_called = 0;
-static void cb_enable_cpu(int cpuid, void *arg) { ++num_cb_called; }
-static void cb_disable_cpu(int cpuid, void *arg) { ++num_cb_called; }
+static volatile int num_cb_called = 0;
+static volatile bool cpu_enabled = false;
+static volatile bool block_helper = false;
+static volatile bool helper_blocked = false;
+
+static void cb_enable_cpu(int cpuid, void *arg) {
+    cpu_enabled = true;
+    ++num_cb_called;
+    helper_blocked = block_helper;
+    while (block_helper) sched_yield();
+}
+
+static void cb_disable_cpu(int cpuid, void *arg) {
+    cpu_enabled = false;
+    ++num_cb_called;
+}
+
+static cpu_set_t enabled_mask;
+static void cb_enable_cpu_set(const cpu_set_t *mask, void *arg) {
+    CPU_OR(&enabled_mask, &enabled_mask, mask);
+    ++num_cb_called;
+    helper_blocked = block_helper;
+    while (block_helper) sched_yield();
+}
+
+static void cb_disable_cpu_set(const cpu_set_t *mask, void *arg) {
+    cpu_set_t xor;
+    CPU_XOR(&xor, &enabled_mask, mask);
+    CPU_AND(&enabled_mask, &enabled_mask, &xor);
+    ++num_cb_called;
+}
 
 int main(int argc, char **argv) {
-    pm_interface_t pm = {
-        .dlb_callback_enable_cpu_ptr = cb_enable_cpu,
-        .dlb_callback_enable_cpu_arg = NULL,
-        .dlb_callback_disable_cpu_ptr = cb_disable_cpu,
-        .dlb_callback_disable_cpu_arg = NULL
+    mu_init();
+    mu_testing_set_sys_size(4);
+
+    subprocess_descriptor_t spd = {
+        .id = 42,
+        .process_mask = { .__bits = { 0xf } },
+        .pm = {
+            .dlb_callback_enable_cpu_ptr = cb_enable_cpu,
+            .dlb_callback_enable_cpu_arg = NULL,
+            .dlb_callback_disable_cpu_ptr = cb_disable_cpu,
+            .dlb_callback_disable_cpu_arg = NULL
+        }
     };
-    pid_t pid = 42;
-    cpu_set_t mask = { .__bits = { 0xf } };
+    pid_t pid = spd.id;
+
+    assert( shmem_async_init(&spd, NULL) == DLB_SUCCESS );
+    shmem_async_enable_cpu(pid, 1);
+    shmem_async_disable_cpu(pid, 1);
+    assert( shmem_async_finalize(pid) == DLB_SUCCESS );
+    /* Both requests may have been coalesced */
+    assert( num_cb_called == 1 || num_cb_called == 2 );
+    assert( !cpu_enabled );
 
-    assert( shmem_async_init(pid, &pm, &mask, NULL) == DLB_SUCCESS );
+    /* Requests for the same CPU are coalesced while the helper is busy, and
+     * never overflow the helper */
+    num_cb_called = 0;
+    block_helper = true;
+    assert( shmem_async_init(&spd, NULL) == DLB_SUCCESS );
     shmem_async_enable_cpu(pid, 1);
+    while (!helper_blocked) sched_yield();
+    int i;
+    for (i = 0; i < 1000; ++i) {
+        shmem_async_disable_cpu(pid, 1);
+        shmem_async_enable_cpu(pid, 1);
+    }
     shmem_async_disable_cpu(pid, 1);
+    block_helper = false;
     assert( shmem_async_finalize(pid) == DLB_SUCCESS );
     assert( num_cb_called == 2 );
+    assert( !cpu_enabled );
+
+    /* Mask requests from several producers are delivered in one call per batch */
+    assert( pm_callback_set(&spd.pm, dlb_callback_enable_cpu_set,
+                (dlb_callback_t)cb_enable_cpu_set, NULL) == DLB_SUCCESS );
+    assert( pm_callback_set(&spd.pm, dlb_callback_disable_cpu_set,
+                (dlb_callback_t)cb_disable_cpu_set, NULL) == DLB_SUCCESS );
+    CPU_ZERO(&enabled_mask);
+    num_cb_called = 0;
+    helper_blocked = false;
+    block_helper = true;
+    assert( shmem_async_init(&spd, NULL) == DLB_SUCCESS );
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    CPU_SET(0, &mask);
+    shmem_async_enable_cpu_mask(pid, &mask);
+    while (!helper_blocked) sched_yield();
+    CPU_SET(1, &mask);
+    CPU_SET(2, &mask);
+    shmem_async_disable_cpu_mask(pid, &mask);
+    shmem_async_enable_cpu(pid, 1);
+    shmem_async_enable_cpu(pid, 3);
+    pid_t pids[4] = {0, 0, pid, 0};
+    shmem_async_enable_cpus(pids);
+    block_helper = false;
+    assert( shmem_async_finalize(pid) == DLB_SUCCESS );
+    /* 1st enable, then a single disable of CPU 0 and a single enable of 1-3 */
+    assert( num_cb_called == 3 );
+    CPU_ZERO(&mask);
+    CPU_SET(1, &mask);
+    CPU_SET(2, &mask);
+    CPU_SET(3, &mask);
+    assert( CPU_EQUAL(&enabled_mask, &mask) );
 
     return 0;
 }
@@ -0,0 +1,133 @@
+/*********************************************************************************/
+/*  Copyright 2017 Barcelona Supercomputing Center                               */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <http://www.gnu.org/licenses/>.                 */
+/*********************************************************************************/
+
+/*<testinfo>
+    test_generator="gens/basic-generator"
+</testinfo>*/
+
+#include "assert_noshm.h"
+
+#include "LB_comm/shmem_async.h"
+#include "LB_comm/shmem_cpuinfo.h"
+#include "LB_comm/shmem_procinfo.h"
+#include "LB_core/DLB_kernel.h"
+#include "LB_core/spd.h"
+#include "LB_numThreads/numThreads.h"
+#include "apis/dlb_errors.h"
+#include "support/mask_utils.h"
+#include "support/mytime.h"
+
+#include <sched.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <assert.h>
+
+/* DROM mask application latency: polling vs asynchronous helper thread */
+
+enum { SYS_SIZE = 4 };
+enum { NUM_ITERATIONS = 20 };
+enum { POLL_DELAY = 1000 }; // 1ms, emulates an application polling DROM frequently
+
+static cpu_set_t applied_mask;
+static int64_t applied_time;
+static volatile int num_masks_applied = 0;
+static volatile int polling = 0;
+
+static void cb_set_process_mask(const cpu_set_t *mask, void *arg) {
+    applied_time = get_time_in_ns();
+    memcpy(&applied_mask, mask, sizeof(cpu_set_t));
+    __sync_add_and_fetch(&num_masks_applied, 1);
+}
+
+static void* poll_thread(void *arg) {
+    const subprocess_descriptor_t *spd = arg;
+    while (polling) {
+        poll_drom_update(spd);
+        usleep(POLL_DELAY);
+    }
+    return NULL;
+}
+
+/* Apply NUM_ITERATIONS alternate masks, return the mean time in ns from the
+ * DROM request until the process mask callback is invoked */
+static int64_t measure_latency(const subprocess_descriptor_t *spd) {
+    cpu_set_t masks[2];
+    mu_parse_mask("0-1", &masks[0]);
+    mu_parse_mask("0-3", &masks[1]);
+    int64_t total = 0;
+    int i;
+    for (i = 0; i < NUM_ITERATIONS; ++i) {
+        const cpu_set_t *mask = &masks[i%2];
+        int masks_applied = num_masks_applied;
+        int64_t start = get_time_in_ns();
+        assert( shmem_procinfo__setprocessmask(spd->id, mask, 0) == DLB_SUCCESS );
+        while (num_masks_applied == masks_applied) {
+            usleep(10);
+        }
+        total += applied_time - start;
+        assert( num_masks_applied == masks_applied + 1 );
+        assert( CPU_EQUAL(&applied_mask, mask) );
+    }
+    return total / NUM_ITERATIONS;
+}
+
+int main(int argc, char **argv) {
+    mu_init();
+    mu_testing_set_sys_size(SYS_SIZE);
+
+    subprocess_descriptor_t spd;
+    memset(&spd, 0, sizeof(spd));
+    spd.id = getpid();
+    options_init(&spd.options, NULL);
+    spd.options.drom = true;
+    spd.dlb_enabled = true;
+    mu_parse_mask("0-3", &spd.process_mask);
+    pm_init(&spd.pm);
+    set_lb_funcs(&spd.lb_funcs, POLICY_NONE);
+    assert( pm_callback_set(&spd.pm, dlb_callback_set_process_mask,
+                (dlb_callback_t)cb_set_process_mask, NULL) == DLB_SUCCESS );
+
+    assert( shmem_procinfo__init(spd.id, &spd.process_mask, NULL, NULL) == DLB_SUCCESS );
+    assert( shmem_cpuinfo__init(spd.id, &spd.process_mask, NULL) == DLB_SUCCESS );
+
+    /* Polling mode: a thread polls DROM every POLL_DELAY us */
+    pthread_t thread;
+    polling = 1;
+    pthread_create(&thread, NULL, poll_thread, &spd);
+    int64_t polling_latency = measure_latency(&spd);
+    polling = 0;
+    pthread_join(thread, NULL);
+
+    /* Asynchronous mode: the helper thread applies the mask as soon as it is set */
+    spd.options.mode = MODE_ASYNC;
+    assert( shmem_async_init(&spd, NULL) == DLB_SUCCESS );
+    int64_t async_latency = measure_latency(&spd);
+    assert( shmem_async_finalize(spd.id) == DLB_SUCCESS );
+
+    fprintf(stdout, "DROM latency (polling every %d us): %"PRId64" ns\n",
+            POLL_DELAY, polling_latency);
+    fprintf(stdout, "DROM latency (async helper): %"PRId64" ns\n", async_latency);
+
+    assert( shmem_cpuinfo__finalize(spd.id) == DLB_SUCCESS );
+    assert( shmem_procinfo__finalize(spd.id, false) == DLB_SUCCESS );
+
+    return 0;
+}
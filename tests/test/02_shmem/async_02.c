@@ -0,0 +1,237 @@
+/*********************************************************************************/
+/*  Copyright 2017 Barcelona Supercomputing Center                               */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <http://www.gnu.org/licenses/>.                 */
+/*********************************************************************************/
+
+/*<testinfo>
+    test_generator="gens/basic-generator"
+</testinfo>*/
+
+#include "assert_noshm.h"
+
+#include "LB_comm/shmem_async.h"
+#include "LB_core/spd.h"
+#include "LB_numThreads/numThreads.h"
+#include "apis/dlb_errors.h"
+#include "support/mytime.h"
+#include "support/types.h"
+
+#include <sched.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <assert.h>
+
+/* Enable/disable delivery latency and throughput of the asynchronous helper,
+ * and application slowdown for each helper placement */
+
+enum { NUM_PRODUCERS = 4 };
+enum { NUM_ITERATIONS = 1000 };
+enum { NUM_REQUESTS = 100000 };
+enum { NUM_WORK_ITERATIONS = 2000 };
+enum { WORK_SIZE = 10000 };
+
+static pid_t pid = 42;
+static volatile int num_cb_called[CPU_SETSIZE] = {0};
+static volatile bool cpu_enabled[CPU_SETSIZE] = {false};
+static volatile int64_t last_cb_time = 0;
+static volatile double work_result = 0.0;
+
+static void cb_enable_cpu(int cpuid, void *arg) {
+    last_cb_time = get_time_in_ns();
+    cpu_enabled[cpuid] = true;
+    __sync_add_and_fetch(&num_cb_called[cpuid], 1);
+}
+
+static void cb_disable_cpu(int cpuid, void *arg) {
+    last_cb_time = get_time_in_ns();
+    cpu_enabled[cpuid] = false;
+    __sync_add_and_fetch(&num_cb_called[cpuid], 1);
+}
+
+static void wait_for_callbacks(int cpuid, int expected) {
+    while (num_cb_called[cpuid] < expected) {
+        sched_yield();
+    }
+}
+
+static void reset_callbacks(void) {
+    int i;
+    for (i = 0; i < CPU_SETSIZE; ++i) {
+        num_cb_called[i] = 0;
+        cpu_enabled[i] = false;
+    }
+}
+
+/* Application compute phase */
+static void work(void) {
+    double x = 1.0;
+    int i;
+    for (i = 0; i < WORK_SIZE; ++i) {
+        x = x * 1.000001 + 0.000001;
+    }
+    work_result += x;
+}
+
+/* Elapsed time of the compute loop, requesting a CPU change at each iteration if async */
+static int64_t run_work_loop(bool async) {
+    int64_t start = get_time_in_ns();
+    int i;
+    for (i = 0; i < NUM_WORK_ITERATIONS; ++i) {
+        work();
+        if (async) {
+            if (i % 2 == 0) {
+                shmem_async_enable_cpu(pid, 1);
+            } else {
+                shmem_async_disable_cpu(pid, 1);
+            }
+        }
+    }
+    return get_time_in_ns() - start;
+}
+
+/* Delivery latency of one request at a time */
+static int64_t measure_latency(int cpuid) {
+    int64_t total_latency = 0;
+    num_cb_called[cpuid] = 0;
+    int i;
+    for (i = 0; i < NUM_ITERATIONS; ++i) {
+        int64_t start = get_time_in_ns();
+        if (i % 2 == 0) {
+            shmem_async_enable_cpu(pid, cpuid);
+        } else {
+            shmem_async_disable_cpu(pid, cpuid);
+        }
+        wait_for_callbacks(cpuid, i+1);
+        total_latency += last_cb_time - start;
+    }
+    return total_latency / NUM_ITERATIONS;
+}
+
+static void measure_placement(subprocess_descriptor_t *spd, helper_placement_t placement,
+        int64_t baseline) {
+    reset_callbacks();
+    spd->options.async_placement = placement;
+    assert( shmem_async_init(spd, NULL) == DLB_SUCCESS );
+    int64_t latency = measure_latency(0);
+    int64_t elapsed = run_work_loop(true);
+    assert( shmem_async_finalize(pid) == DLB_SUCCESS );
+    fprintf(stdout, "Async placement %-12s latency: %"PRId64" ns, application slowdown: %.2f%%\n",
+            helper_placement_tostr(placement), latency,
+            100.0 * (elapsed - baseline) / baseline);
+}
+
+/* Latency of requests to the last CPU, i.e., the farthest from the main thread
+ * in large nodes, with a single helper and with one helper per NUMA domain */
+static void measure_numa_helpers(subprocess_descriptor_t *spd, int cpuid) {
+    spd->options.async_placement = HELPER_PROCESS;
+    int64_t latency[2];
+    int numa;
+    for (numa = 0; numa < 2; ++numa) {
+        reset_callbacks();
+        spd->options.async_numa_helpers = numa;
+        assert( shmem_async_init(spd, NULL) == DLB_SUCCESS );
+        latency[numa] = measure_latency(cpuid);
+        assert( shmem_async_finalize(pid) == DLB_SUCCESS );
+    }
+    spd->options.async_numa_helpers = false;
+    fprintf(stdout, "Async latency to CPU %d: single helper %"PRId64" ns,"
+            " per-NUMA helpers %"PRId64" ns\n", cpuid, latency[0], latency[1]);
+}
+
+/* Requests are never blocked by the helper, redundant ones are coalesced */
+static void* producer(void *arg) {
+    int cpuid = *(int*)arg;
+    int i;
+    for (i = 0; i < NUM_REQUESTS; ++i) {
+        if (i % 2 == 0) {
+            shmem_async_enable_cpu(pid, cpuid);
+        } else {
+            shmem_async_disable_cpu(pid, cpuid);
+        }
+    }
+    return NULL;
+}
+
+int main(int argc, char **argv) {
+    subprocess_descriptor_t spd = {
+        .id = pid,
+        .pm = {
+            .dlb_callback_enable_cpu_ptr = cb_enable_cpu,
+            .dlb_callback_enable_cpu_arg = NULL,
+            .dlb_callback_disable_cpu_ptr = cb_disable_cpu,
+            .dlb_callback_disable_cpu_arg = NULL
+        }
+    };
+
+    /* Latency and slowdown for each helper placement. The service CPU is the
+     * last CPU where the test can run */
+    cpu_set_t affinity;
+    sched_getaffinity(0, sizeof(cpu_set_t), &affinity);
+    memcpy(&spd.process_mask, &affinity, sizeof(cpu_set_t));
+    int last_cpu = CPU_SETSIZE - 1;
+    while (!CPU_ISSET(last_cpu, &affinity)) --last_cpu;
+    CPU_SET(last_cpu, &spd.options.async_cpus);
+
+    int64_t baseline = run_work_loop(false);
+    measure_placement(&spd, HELPER_PROCESS, baseline);
+    measure_placement(&spd, HELPER_SERVICE, baseline);
+    measure_placement(&spd, HELPER_SIBLING, baseline);
+    measure_placement(&spd, HELPER_LEAST_LOADED, baseline);
+    measure_numa_helpers(&spd, last_cpu);
+
+    reset_callbacks();
+    spd.options.async_placement = HELPER_PROCESS;
+    assert( shmem_async_init(&spd, NULL) == DLB_SUCCESS );
+
+    /* Latency: one message at a time */
+    int64_t latency = measure_latency(0);
+    num_cb_called[0] = 0;
+
+    /* Throughput: several producers flooding the helper */
+    pthread_t threads[NUM_PRODUCERS];
+    int cpuids[NUM_PRODUCERS];
+    int64_t start = get_time_in_ns();
+    int i;
+    for (i = 0; i < NUM_PRODUCERS; ++i) {
+        cpuids[i] = i;
+        pthread_create(&threads[i], NULL, producer, &cpuids[i]);
+    }
+    for (i = 0; i < NUM_PRODUCERS; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+
+    /* Finalization applies the pending requests */
+    assert( shmem_async_finalize(pid) == DLB_SUCCESS );
+    int64_t elapsed = get_time_in_ns() - start;
+
+    /* The last request of every CPU was a disable */
+    int num_callbacks = 0;
+    for (i = 0; i < NUM_PRODUCERS; ++i) {
+        assert( !cpu_enabled[i] );
+        num_callbacks += num_cb_called[i];
+    }
+    assert( num_callbacks <= NUM_PRODUCERS * NUM_REQUESTS );
+
+    fprintf(stdout, "Async delivery latency: %"PRId64" ns\n", latency);
+    fprintf(stdout, "Async throughput (%d producers): %.0f requests/s, %d callbacks\n",
+            NUM_PRODUCERS, NUM_PRODUCERS * NUM_REQUESTS / (elapsed / 1e9), num_callbacks);
+
+    return 0;
+}
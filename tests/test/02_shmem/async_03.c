@@ -0,0 +1,134 @@
+/*********************************************************************************/
+/*  Copyright 2017 Barcelona Supercomputing Center                               */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <http://www.gnu.org/licenses/>.                 */
+/*********************************************************************************/
+
+/*<testinfo>
+    test_generator="gens/basic-generator"
+</testinfo>*/
+
+#include "assert_noshm.h"
+
+#include "LB_comm/shmem_async.h"
+#include "LB_core/spd.h"
+#include "LB_numThreads/numThreads.h"
+#include "apis/dlb_errors.h"
+#include "support/mask_utils.h"
+#include "support/types.h"
+
+#include <sched.h>
+#include <unistd.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <assert.h>
+
+/* Placement and scheduling of the asynchronous helper thread */
+
+static pid_t pid = 42;
+static volatile int num_cb_called = 0;
+static cpu_set_t helper_affinity;
+static int helper_policy;
+static int helper_nice;
+
+static void cb_enable_cpu(int cpuid, void *arg) {
+    pthread_getaffinity_np(pthread_self(), sizeof(cpu_set_t), &helper_affinity);
+    helper_policy = sched_getscheduler(0);
+    helper_nice = getpriority(PRIO_PROCESS, syscall(SYS_gettid));
+    __sync_add_and_fetch(&num_cb_called, 1);
+}
+
+static void run_helper(subprocess_descriptor_t *spd) {
+    num_cb_called = 0;
+    assert( shmem_async_init(spd, NULL) == DLB_SUCCESS );
+    shmem_async_enable_cpu(pid, 0);
+    while (num_cb_called == 0) {
+        sched_yield();
+    }
+    assert( shmem_async_finalize(pid) == DLB_SUCCESS );
+}
+
+int main(int argc, char **argv) {
+    /* Use the CPUs where the test may actually run */
+    cpu_set_t process_mask;
+    sched_getaffinity(0, sizeof(cpu_set_t), &process_mask);
+    int first_cpu = 0;
+    while (!CPU_ISSET(first_cpu, &process_mask)) ++first_cpu;
+
+    subprocess_descriptor_t spd = {
+        .id = pid,
+        .pm = {
+            .dlb_callback_enable_cpu_ptr = cb_enable_cpu,
+            .dlb_callback_enable_cpu_arg = NULL,
+        }
+    };
+    memcpy(&spd.process_mask, &process_mask, sizeof(cpu_set_t));
+    int default_nice = getpriority(PRIO_PROCESS, 0);
+
+    /* Default placement: the whole process mask, inherited scheduling */
+    run_helper(&spd);
+    assert( CPU_EQUAL(&helper_affinity, &process_mask) );
+    assert( helper_policy == SCHED_OTHER );
+    assert( helper_nice == default_nice );
+
+    /* Service CPU */
+    spd.options.async_placement = HELPER_SERVICE;
+    CPU_ZERO(&spd.options.async_cpus);
+    CPU_SET(first_cpu, &spd.options.async_cpus);
+    run_helper(&spd);
+    assert( CPU_EQUAL(&helper_affinity, &spd.options.async_cpus) );
+
+    /* Service placement without service CPUs falls back to the process mask */
+    CPU_ZERO(&spd.options.async_cpus);
+    run_helper(&spd);
+    assert( CPU_EQUAL(&helper_affinity, &process_mask) );
+
+    /* Least loaded CPU: a single CPU of the process */
+    spd.options.async_placement = HELPER_LEAST_LOADED;
+    run_helper(&spd);
+    assert( CPU_COUNT(&helper_affinity) == 1 );
+    assert( mu_is_subset(&helper_affinity, &process_mask) );
+
+    /* SMT sibling: never a CPU of the process, unless there is none to use */
+    spd.options.async_placement = HELPER_SIBLING;
+    run_helper(&spd);
+    cpu_set_t intxn;
+    CPU_AND(&intxn, &helper_affinity, &process_mask);
+    assert( CPU_COUNT(&intxn) == 0 || CPU_EQUAL(&helper_affinity, &process_mask) );
+
+    /* Scheduling policy and nice value, which do not need privileges */
+    spd.options.async_placement = HELPER_PROCESS;
+    spd.options.async_sched = HELPER_SCHED_BATCH;
+    spd.options.async_priority = 5;
+    run_helper(&spd);
+    assert( helper_policy == SCHED_BATCH );
+    assert( helper_nice == 5 || default_nice > 5 );
+
+    spd.options.async_sched = HELPER_SCHED_IDLE;
+    spd.options.async_priority = 0;
+    run_helper(&spd);
+    assert( helper_policy == SCHED_IDLE );
+
+    /* Real-time policies may not be allowed, the helper must work anyway */
+    spd.options.async_sched = HELPER_SCHED_FIFO;
+    spd.options.async_priority = 1;
+    run_helper(&spd);
+    assert( helper_policy == SCHED_FIFO || helper_policy == SCHED_OTHER );
+
+    return 0;
+}
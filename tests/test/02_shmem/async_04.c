@@ -0,0 +1,129 @@
+/*********************************************************************************/
+/*  Copyright 2017 Barcelona Supercomputing Center                               */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <http://www.gnu.org/licenses/>.                 */
+/*********************************************************************************/
+
+/*<testinfo>
+    test_generator="gens/basic-generator"
+</testinfo>*/
+
+#include "assert_noshm.h"
+
+#include "LB_comm/shmem_async.h"
+#include "LB_core/spd.h"
+#include "LB_numThreads/numThreads.h"
+#include "apis/dlb_errors.h"
+#include "apis/dlb_types.h"
+#include "support/mask_utils.h"
+
+#include <sched.h>
+#include <unistd.h>
+#include <string.h>
+#include <pthread.h>
+#include <assert.h>
+
+/* One asynchronous helper per NUMA domain */
+
+enum { SYS_SIZE = 8 };
+enum { NUM_DOMAINS = 2 };
+
+static pid_t pid = 42;
+static volatile int num_cpus_enabled = 0;
+static volatile int num_cb_called = 0;
+static pthread_t cpu_thread[SYS_SIZE];
+static cpu_set_t cb_mask[SYS_SIZE];
+
+static void cb_enable_cpu(int cpuid, void *arg) {
+    cpu_thread[cpuid] = pthread_self();
+    __sync_add_and_fetch(&num_cpus_enabled, 1);
+}
+
+static void cb_enable_cpu_set(const cpu_set_t *cpu_set, void *arg) {
+    int cpuid;
+    for (cpuid = 0; cpuid < SYS_SIZE; ++cpuid) {
+        if (CPU_ISSET(cpuid, cpu_set)) {
+            memcpy(&cb_mask[cpuid], cpu_set, sizeof(cpu_set_t));
+        }
+    }
+    __sync_add_and_fetch(&num_cb_called, 1);
+    __sync_add_and_fetch(&num_cpus_enabled, CPU_COUNT(cpu_set));
+}
+
+static void wait_for_cpus(int expected) {
+    while (num_cpus_enabled < expected) {
+        sched_yield();
+    }
+}
+
+int main(int argc, char **argv) {
+    mu_init();
+    mu_testing_set_sys(SYS_SIZE, NUM_DOMAINS);
+
+    subprocess_descriptor_t spd = {
+        .id = pid,
+        .process_mask = { .__bits = { 0xff } },
+    };
+    pm_callback_set(&spd.pm, dlb_callback_enable_cpu, (dlb_callback_t)cb_enable_cpu, NULL);
+
+    /* Single helper by default */
+    assert( shmem_async_init(&spd, NULL) == DLB_SUCCESS );
+    shmem_async_enable_cpu(pid, 0);
+    shmem_async_enable_cpu(pid, 7);
+    wait_for_cpus(2);
+    assert( pthread_equal(cpu_thread[0], cpu_thread[7]) );
+    assert( shmem_async_finalize(pid) == DLB_SUCCESS );
+
+    /* One helper per domain, requests are routed by CPU */
+    num_cpus_enabled = 0;
+    spd.options.async_numa_helpers = true;
+    assert( shmem_async_init(&spd, NULL) == DLB_SUCCESS );
+    shmem_async_enable_cpu(pid, 0);
+    shmem_async_enable_cpu(pid, 3);
+    shmem_async_enable_cpu(pid, 4);
+    shmem_async_enable_cpu(pid, 7);
+    wait_for_cpus(4);
+    assert( pthread_equal(cpu_thread[0], cpu_thread[3]) );
+    assert( pthread_equal(cpu_thread[4], cpu_thread[7]) );
+    assert( !pthread_equal(cpu_thread[0], cpu_thread[4]) );
+
+    /* Masks are split among the helpers */
+    num_cpus_enabled = 0;
+    pm_callback_set(&spd.pm, dlb_callback_enable_cpu_set,
+            (dlb_callback_t)cb_enable_cpu_set, NULL);
+    cpu_set_t mask = { .__bits = { 0x3c } };  /* 2-5 */
+    shmem_async_enable_cpu_mask(pid, &mask);
+    wait_for_cpus(4);
+    assert( num_cb_called == 2 );
+    cpu_set_t first_half = { .__bits = { 0x0c } };
+    cpu_set_t second_half = { .__bits = { 0x30 } };
+    assert( CPU_EQUAL(&cb_mask[2], &first_half) );
+    assert( CPU_EQUAL(&cb_mask[5], &second_half) );
+
+    /* Per-CPU process arrays are split too */
+    num_cpus_enabled = 0;
+    num_cb_called = 0;
+    pid_t pids[SYS_SIZE] = {0, pid, 0, 0, 0, 0, pid, 0};
+    shmem_async_enable_cpus(pids);
+    wait_for_cpus(2);
+    assert( num_cb_called == 2 );
+
+    /* Finalization joins every helper */
+    assert( shmem_async_finalize(pid) == DLB_SUCCESS );
+    assert( shmem_async_finalize(pid) == DLB_ERR_NOSHMEM );
+
+    return 0;
+}
@@ -0,0 +1,145 @@
+/*********************************************************************************/
+/*  Copyright 2017 Barcelona Supercomputing Center                               */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <http://www.gnu.org/licenses/>.                 */
+/*********************************************************************************/
+
+/*<testinfo>
+    test_generator="gens/basic-generator"
+</testinfo>*/
+
+#include "assert_noshm.h"
+
+#include "LB_comm/shmem_barrier.h"
+#include "apis/dlb_errors.h"
+#include "support/mask_utils.h"
+#include "support/options.h"
+#include "support/mytime.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+/* Node barrier correctness and latency from 2 to 256 participants, comparing
+ * the flat and the hierarchical barriers over 8 NUMA domains */
+
+void __gcov_flush() __attribute__((weak));
+
+enum { MIN_PARTICIPANTS = 2 };
+enum { MAX_PARTICIPANTS = 256 };
+enum { NUM_ITERATIONS = 100 };
+enum { NUM_DOMAINS = 8 };
+
+struct data {
+    pthread_barrier_t start;
+    volatile int arrivals;
+};
+
+static void run_barriers(struct data *data, int nparticipants, int cpuid,
+        bool hierarchical, const char *shmem_key) {
+    cpu_set_t process_mask;
+    CPU_ZERO(&process_mask);
+    CPU_SET(cpuid, &process_mask);
+    char args[64];
+    snprintf(args, sizeof(args), "--shm-key=%s%s", shmem_key,
+            hierarchical ? " --barrier-hierarchical" : "");
+    options_t options;
+    options_init(&options, args);
+    shmem_barrier_init(&process_mask, &options);
+    int error = pthread_barrier_wait(&data->start);
+    assert(error == 0 || error == PTHREAD_BARRIER_SERIAL_THREAD);
+
+    int i;
+    for (i = 0; i < NUM_ITERATIONS; ++i) {
+        __sync_fetch_and_add(&data->arrivals, 1);
+        assert( shmem_barrier(NULL) == DLB_SUCCESS );
+        /* Everyone arrived to this barrier, and nobody went through the next one */
+        int arrivals = data->arrivals;
+        assert( arrivals >= nparticipants * (i+1) );
+        assert( arrivals <= nparticipants * (i+2) );
+    }
+
+    /* Nobody finalizes while the others still use the barrier */
+    error = pthread_barrier_wait(&data->start);
+    assert(error == 0 || error == PTHREAD_BARRIER_SERIAL_THREAD);
+    shmem_barrier_finalize();
+}
+
+static int64_t measure_barriers(struct data *data, int nparticipants, bool hierarchical) {
+    char shmem_key[32];
+    snprintf(shmem_key, sizeof(shmem_key), "barrier_%s_%d",
+            hierarchical ? "hier" : "flat", nparticipants);
+
+    pthread_barrierattr_t attr;
+    assert( pthread_barrierattr_init(&attr) == 0 );
+    assert( pthread_barrierattr_setpshared(&attr, PTHREAD_PROCESS_SHARED) == 0 );
+    assert( pthread_barrier_init(&data->start, &attr, nparticipants) == 0 );
+    assert( pthread_barrierattr_destroy(&attr) == 0 );
+    data->arrivals = 0;
+
+    /* Create a child process per participant-1, spread evenly across domains */
+    int stride = MAX_PARTICIPANTS / nparticipants;
+    int child;
+    for (child = 1; child < nparticipants; ++child) {
+        pid_t pid = fork();
+        assert( pid >= 0 );
+        if (pid == 0) {
+            run_barriers(data, nparticipants, child * stride, hierarchical, shmem_key);
+            if (__gcov_flush) __gcov_flush();
+            _exit(EXIT_SUCCESS);
+        }
+    }
+
+    /* Master process measures the whole sequence of barriers */
+    int64_t start = get_time_in_ns();
+    run_barriers(data, nparticipants, 0, hierarchical, shmem_key);
+    int64_t elapsed = get_time_in_ns() - start;
+
+    /* Wait for all child processes */
+    int wstatus;
+    while (wait(&wstatus) > 0) {
+        assert( WIFEXITED(wstatus) && WEXITSTATUS(wstatus) == EXIT_SUCCESS );
+    }
+    assert( pthread_barrier_destroy(&data->start) == 0 );
+
+    return elapsed / NUM_ITERATIONS;
+}
+
+int main(int argc, char **argv) {
+    /* Children inherit the system topology, which bounds the processes per shmem */
+    mu_testing_set_sys(MAX_PARTICIPANTS, NUM_DOMAINS);
+
+    struct data *data = mmap(NULL, sizeof(struct data), PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    assert( data != MAP_FAILED );
+
+    int nparticipants;
+    for (nparticipants = MIN_PARTICIPANTS; nparticipants <= MAX_PARTICIPANTS;
+            nparticipants *= 2) {
+        int64_t flat = measure_barriers(data, nparticipants, false);
+        int64_t hier = measure_barriers(data, nparticipants, true);
+        fprintf(stdout, "Barrier latency (%d participants): flat %"PRId64" ns,"
+                " hierarchical %"PRId64" ns\n", nparticipants, flat, hier);
+    }
+
+    munmap(data, sizeof(struct data));
+    return 0;
+}
@@ -0,0 +1,195 @@
+/*********************************************************************************/
+/*  Copyright 2017 Barcelona Supercomputing Center                               */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <http://www.gnu.org/licenses/>.                 */
+/*********************************************************************************/
+
+/*<testinfo>
+    test_generator="gens/basic-generator"
+</testinfo>*/
+
+#include "assert_noshm.h"
+
+#include "LB_comm/shmem_barrier.h"
+#include "apis/dlb_errors.h"
+#include "support/mask_utils.h"
+#include "support/options.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+/* Named barriers: attach/detach semantics and independent groups */
+
+void __gcov_flush() __attribute__((weak));
+
+enum { SYS_SIZE = 4 };
+enum { NUM_PROCS = 4 };
+enum { NUM_ITERATIONS_A = 100 };
+enum { NUM_ITERATIONS_B = 10 };
+
+static const char *dlb_args = "--shm-key=barrier_01";
+
+struct data {
+    pthread_barrier_t start;
+    volatile int arrivals_a;
+    volatile int arrivals_b;
+};
+
+static void sync_start(struct data *data) {
+    int error = pthread_barrier_wait(&data->start);
+    assert(error == 0 || error == PTHREAD_BARRIER_SERIAL_THREAD);
+}
+
+/* Processes 0 and 1 form group A, processes 2 and 3 form group B */
+static void run_groups(struct data *data, int id) {
+    cpu_set_t process_mask;
+    CPU_ZERO(&process_mask);
+    CPU_SET(id, &process_mask);
+    options_t options;
+    options_init(&options, dlb_args);
+    shmem_barrier_init(&process_mask, &options);
+    bool group_a = id < NUM_PROCS/2;
+    const char *name = group_a ? "group_a" : "group_b";
+    volatile int *arrivals = group_a ? &data->arrivals_a : &data->arrivals_b;
+    int iterations = group_a ? NUM_ITERATIONS_A : NUM_ITERATIONS_B;
+    assert( shmem_barrier_attach(name) == DLB_SUCCESS );
+    assert( shmem_barrier_attach(name) == DLB_NOUPDT );
+    sync_start(data);
+
+    /* Each group synchronizes independently, with a different number of barriers */
+    int i;
+    for (i = 0; i < iterations; ++i) {
+        __sync_fetch_and_add(arrivals, 1);
+        assert( shmem_barrier(name) == DLB_SUCCESS );
+        int n = *arrivals;
+        assert( n >= NUM_PROCS/2 * (i+1) );
+        assert( n <= NUM_PROCS/2 * (i+2) );
+    }
+    assert( shmem_barrier_detach(name) == DLB_SUCCESS );
+    assert( shmem_barrier_detach(name) == DLB_ERR_PERM );
+    assert( shmem_barrier(name) == DLB_ERR_PERM );
+
+    /* All processes are still attached to the default barrier */
+    assert( shmem_barrier(NULL) == DLB_SUCCESS );
+    assert( data->arrivals_a == NUM_PROCS/2 * NUM_ITERATIONS_A );
+    assert( data->arrivals_b == NUM_PROCS/2 * NUM_ITERATIONS_B );
+
+    /* A participant detaching releases the ones waiting for it */
+    if (id < 2) {
+        assert( shmem_barrier_attach("dynamic") == DLB_SUCCESS );
+        assert( shmem_barrier(NULL) == DLB_SUCCESS );
+        if (id == 0) {
+            usleep(1000);
+            assert( shmem_barrier_detach("dynamic") == DLB_SUCCESS );
+        } else {
+            assert( shmem_barrier("dynamic") == DLB_SUCCESS );
+        }
+    } else {
+        assert( shmem_barrier(NULL) == DLB_SUCCESS );
+    }
+
+    sync_start(data);
+    shmem_barrier_finalize();
+}
+
+int main(int argc, char **argv) {
+    mu_init();
+    mu_testing_set_sys_size(SYS_SIZE);
+
+    /* Single process: barrier namespace */
+    cpu_set_t process_mask;
+    CPU_ZERO(&process_mask);
+    CPU_SET(0, &process_mask);
+    options_t options;
+    options_init(&options, dlb_args);
+    shmem_barrier_init(&process_mask, &options);
+    {
+        assert( shmem_barrier_attach(NULL) == DLB_NOUPDT );
+        assert( shmem_barrier_attach("") == DLB_NOUPDT );
+        assert( shmem_barrier_attach("default") == DLB_NOUPDT );
+        assert( shmem_barrier(NULL) == DLB_SUCCESS );
+        assert( shmem_barrier("foo") == DLB_ERR_PERM );
+        assert( shmem_barrier_detach("foo") == DLB_ERR_PERM );
+        assert( shmem_barrier_attach("foo") == DLB_SUCCESS );
+        assert( shmem_barrier("foo") == DLB_SUCCESS );
+
+        /* Long names are truncated */
+        char long_name[64] = "a_very_long_barrier_name_with_more_than_32_characters";
+        assert( shmem_barrier_attach(long_name) == DLB_SUCCESS );
+        long_name[40] = '\0';
+        assert( shmem_barrier_attach(long_name) == DLB_NOUPDT );
+        assert( shmem_barrier_detach(long_name) == DLB_SUCCESS );
+
+        /* Exhaust all barriers, default and foo already in use */
+        int i;
+        char name[16];
+        for (i = 0; i < SYS_SIZE*2 - 2; ++i) {
+            snprintf(name, sizeof(name), "bar_%d", i);
+            assert( shmem_barrier_attach(name) == DLB_SUCCESS );
+        }
+        assert( shmem_barrier_attach("one_more") == DLB_ERR_NOMEM );
+        assert( shmem_barrier_detach("foo") == DLB_SUCCESS );
+        assert( shmem_barrier_attach("one_more") == DLB_SUCCESS );
+
+        /* Detaching from the default barrier */
+        assert( shmem_barrier_detach(NULL) == DLB_SUCCESS );
+        assert( shmem_barrier(NULL) == DLB_ERR_PERM );
+    }
+    shmem_barrier_finalize();
+    assert( shmem_barrier(NULL) == DLB_ERR_NOSHMEM );
+    assert( shmem_barrier_attach("foo") == DLB_ERR_NOSHMEM );
+    assert( shmem_barrier_detach("foo") == DLB_ERR_NOSHMEM );
+
+    /* Multiple processes: independent groups */
+    struct data *data = mmap(NULL, sizeof(struct data), PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    assert( data != MAP_FAILED );
+
+    pthread_barrierattr_t attr;
+    assert( pthread_barrierattr_init(&attr) == 0 );
+    assert( pthread_barrierattr_setpshared(&attr, PTHREAD_PROCESS_SHARED) == 0 );
+    assert( pthread_barrier_init(&data->start, &attr, NUM_PROCS) == 0 );
+    assert( pthread_barrierattr_destroy(&attr) == 0 );
+    data->arrivals_a = 0;
+    data->arrivals_b = 0;
+
+    int id;
+    for (id = 1; id < NUM_PROCS; ++id) {
+        pid_t pid = fork();
+        assert( pid >= 0 );
+        if (pid == 0) {
+            run_groups(data, id);
+            if (__gcov_flush) __gcov_flush();
+            _exit(EXIT_SUCCESS);
+        }
+    }
+    run_groups(data, 0);
+
+    int wstatus;
+    while (wait(&wstatus) > 0) {
+        assert( WIFEXITED(wstatus) && WEXITSTATUS(wstatus) == EXIT_SUCCESS );
+    }
+    assert( pthread_barrier_destroy(&data->start) == 0 );
+    munmap(data, sizeof(struct data));
+
+    return 0;
+}
@@ -0,0 +1,168 @@
+/*********************************************************************************/
+/*  Copyright 2017 Barcelona Supercomputing Center                               */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <http://www.gnu.org/licenses/>.                 */
+/*********************************************************************************/
+
+/*<testinfo>
+    test_generator="gens/basic-generator"
+</testinfo>*/
+
+#include "assert_noshm.h"
+
+#include "LB_comm/shmem_barrier.h"
+#include "apis/dlb_errors.h"
+#include "support/mask_utils.h"
+#include "support/options.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+/* Hierarchical barrier: 8 processes over 4 NUMA domains, with participants
+ * and whole domains detaching while the rest are waiting, and a participant
+ * attaching while its domain waits for the rest */
+
+void __gcov_flush() __attribute__((weak));
+
+enum { NUM_PROCS = 8 };
+enum { NUM_DOMAINS = 4 };
+enum { NUM_ITERATIONS = 100 };
+
+static const char *dlb_args = "--shm-key=barrier_02 --barrier-hierarchical";
+
+struct data {
+    pthread_barrier_t start;
+    volatile int arrivals;
+};
+
+static void sync_start(struct data *data) {
+    int error = pthread_barrier_wait(&data->start);
+    assert(error == 0 || error == PTHREAD_BARRIER_SERIAL_THREAD);
+}
+
+static void run_barriers(struct data *data, int nparticipants) {
+    int i;
+    for (i = 0; i < NUM_ITERATIONS; ++i) {
+        __sync_fetch_and_add(&data->arrivals, 1);
+        assert( shmem_barrier(NULL) == DLB_SUCCESS );
+        int arrivals = data->arrivals;
+        assert( arrivals >= nparticipants * (i+1) );
+        assert( arrivals <= nparticipants * (i+2) );
+    }
+}
+
+/* Process id runs on CPU id, domain id/2 */
+static void run(struct data *data, int id) {
+    cpu_set_t process_mask;
+    CPU_ZERO(&process_mask);
+    CPU_SET(id, &process_mask);
+    options_t options;
+    options_init(&options, dlb_args);
+    shmem_barrier_init(&process_mask, &options);
+    sync_start(data);
+
+    /* All processes */
+    run_barriers(data, NUM_PROCS);
+    sync_start(data);
+
+    /* Process 1 leaves while its domain mate and the rest are waiting */
+    if (id == 1) {
+        usleep(1000);
+        assert( shmem_barrier_detach(NULL) == DLB_SUCCESS );
+    } else {
+        assert( shmem_barrier(NULL) == DLB_SUCCESS );
+    }
+
+    /* Domain 1 leaves while the rest are waiting */
+    if (id == 2 || id == 3) {
+        usleep(1000);
+        assert( shmem_barrier_detach(NULL) == DLB_SUCCESS );
+    } else if (id != 1) {
+        assert( shmem_barrier(NULL) == DLB_SUCCESS );
+    }
+
+    /* Remaining processes: 0, 4, 5, 6, 7 */
+    if (id == 0 || id >= 4) {
+        if (id == 0) data->arrivals = 0;
+        assert( shmem_barrier(NULL) == DLB_SUCCESS );
+        run_barriers(data, NUM_PROCS - 3);
+    }
+
+    /* Process 1 attaches again while process 0, alone in domain 0, waits at the
+     * top level for domains 2 and 3: it joins the next episode */
+    sync_start(data);
+    if (id == 0) data->arrivals = 0;
+    sync_start(data);
+    if (id == 0 || id >= 4) {
+        if (id >= 4) usleep(2000);
+        __sync_fetch_and_add(&data->arrivals, 1);
+        assert( shmem_barrier(NULL) == DLB_SUCCESS );
+        if (id >= 4) usleep(2000);
+        __sync_fetch_and_add(&data->arrivals, 1);
+        assert( shmem_barrier(NULL) == DLB_SUCCESS );
+    } else if (id == 1) {
+        usleep(1000);
+        assert( shmem_barrier_attach(NULL) == DLB_SUCCESS );
+        __sync_fetch_and_add(&data->arrivals, 1);
+        assert( shmem_barrier(NULL) == DLB_SUCCESS );
+        assert( data->arrivals >= 2*(NUM_PROCS - 3) + 1 );
+    }
+
+    sync_start(data);
+    shmem_barrier_finalize();
+}
+
+int main(int argc, char **argv) {
+    mu_testing_set_sys(NUM_PROCS, NUM_DOMAINS);
+
+    struct data *data = mmap(NULL, sizeof(struct data), PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    assert( data != MAP_FAILED );
+
+    pthread_barrierattr_t attr;
+    assert( pthread_barrierattr_init(&attr) == 0 );
+    assert( pthread_barrierattr_setpshared(&attr, PTHREAD_PROCESS_SHARED) == 0 );
+    assert( pthread_barrier_init(&data->start, &attr, NUM_PROCS) == 0 );
+    assert( pthread_barrierattr_destroy(&attr) == 0 );
+    data->arrivals = 0;
+
+    int id;
+    for (id = 1; id < NUM_PROCS; ++id) {
+        pid_t pid = fork();
+        assert( pid >= 0 );
+        if (pid == 0) {
+            run(data, id);
+            if (__gcov_flush) __gcov_flush();
+            _exit(EXIT_SUCCESS);
+        }
+    }
+    run(data, 0);
+
+    int wstatus;
+    while (wait(&wstatus) > 0) {
+        assert( WIFEXITED(wstatus) && WEXITSTATUS(wstatus) == EXIT_SUCCESS );
+    }
+    assert( pthread_barrier_destroy(&data->start) == 0 );
+    munmap(data, sizeof(struct data));
+
+    return 0;
+}
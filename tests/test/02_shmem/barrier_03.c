@@ -0,0 +1,123 @@
+/*********************************************************************************/
+/*  Copyright 2017 Barcelona Supercomputing Center                               */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <http://www.gnu.org/licenses/>.                 */
+/*********************************************************************************/
+
+/*<testinfo>
+    test_generator="gens/basic-generator"
+</testinfo>*/
+
+#include "assert_noshm.h"
+
+#include "LB_comm/shmem_barrier.h"
+#include "apis/dlb_errors.h"
+#include "support/mask_utils.h"
+#include "support/options.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+/* Barrier arrival skew statistics: one process always arrives late */
+
+void __gcov_flush() __attribute__((weak));
+
+enum { NUM_PROCS = 2 };
+enum { NUM_ITERATIONS = 20 };
+enum { DELAY_US = 2000 };
+
+static const char *dlb_args = "--shm-key=barrier_03 --barrier-lend-threshold=100";
+
+static void sync_start(pthread_barrier_t *start) {
+    int error = pthread_barrier_wait(start);
+    assert(error == 0 || error == PTHREAD_BARRIER_SERIAL_THREAD);
+}
+
+static void run(pthread_barrier_t *start, int id) {
+    cpu_set_t process_mask;
+    CPU_ZERO(&process_mask);
+    CPU_SET(id, &process_mask);
+    options_t options;
+    options_init(&options, dlb_args);
+    shmem_barrier_init(&process_mask, &options);
+    sync_start(start);
+
+    int episodes;
+    double avg_skew, max_skew, imbalance;
+    assert( shmem_barrier_get_stats("foo", &episodes, &avg_skew, &max_skew, &imbalance)
+            == DLB_ERR_PERM );
+    assert( shmem_barrier_get_stats(NULL, &episodes, &avg_skew, &max_skew, &imbalance)
+            == DLB_SUCCESS );
+    assert( episodes == 0 && avg_skew == 0.0 && max_skew == 0.0 && imbalance == 0.0 );
+
+    int i;
+    for (i = 0; i < NUM_ITERATIONS; ++i) {
+        if (id == 1) usleep(DELAY_US);
+        assert( shmem_barrier(NULL) == DLB_SUCCESS );
+    }
+
+    /* Process 0 waits for process 1 on every episode, around half of the time */
+    assert( shmem_barrier_get_stats(NULL, &episodes, &avg_skew, &max_skew, &imbalance)
+            == DLB_SUCCESS );
+    assert( episodes == NUM_ITERATIONS );
+    assert( avg_skew >= DELAY_US * 1e-6 );
+    assert( max_skew >= avg_skew );
+    assert( imbalance > 0.1 && imbalance < 0.6 );
+    if (id == 0) {
+        fprintf(stdout, "Average skew: %.3f ms, max skew: %.3f ms, imbalance: %.2f\n",
+                avg_skew * 1e3, max_skew * 1e3, imbalance);
+    }
+
+    sync_start(start);
+    shmem_barrier_finalize();
+}
+
+int main(int argc, char **argv) {
+    mu_init();
+    mu_testing_set_sys_size(NUM_PROCS);
+
+    pthread_barrier_t *start = mmap(NULL, sizeof(pthread_barrier_t),
+            PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    assert( start != MAP_FAILED );
+
+    pthread_barrierattr_t attr;
+    assert( pthread_barrierattr_init(&attr) == 0 );
+    assert( pthread_barrierattr_setpshared(&attr, PTHREAD_PROCESS_SHARED) == 0 );
+    assert( pthread_barrier_init(start, &attr, NUM_PROCS) == 0 );
+    assert( pthread_barrierattr_destroy(&attr) == 0 );
+
+    pid_t pid = fork();
+    assert( pid >= 0 );
+    if (pid == 0) {
+        run(start, 1);
+        if (__gcov_flush) __gcov_flush();
+        _exit(EXIT_SUCCESS);
+    }
+    run(start, 0);
+
+    int wstatus;
+    assert( wait(&wstatus) == pid );
+    assert( WIFEXITED(wstatus) && WEXITSTATUS(wstatus) == EXIT_SUCCESS );
+    assert( pthread_barrier_destroy(start) == 0 );
+    munmap(start, sizeof(pthread_barrier_t));
+
+    return 0;
+}
@@ -0,0 +1,230 @@
+/*********************************************************************************/
+/*  Copyright 2017 Barcelona Supercomputing Center                               */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <http://www.gnu.org/licenses/>.                 */
+/*********************************************************************************/
+
+/*<testinfo>
+    test_generator="gens/basic-generator"
+</testinfo>*/
+
+#include "assert_noshm.h"
+
+#include "LB_comm/shmem.h"
+#include "LB_comm/shmem_cpuinfo.h"
+#include "apis/dlb_errors.h"
+#include "support/mask_utils.h"
+#include "support/mytime.h"
+
+#include <sched.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <assert.h>
+
+/* Borrowers prefer the CPUs whose owners expect to lend them for longer, and
+ * as a consequence they are preempted less often by the owners' reclaims */
+
+enum { SYS_SIZE = 8 };
+enum { NUM_PROCS = 4 };
+enum { CPUS_PER_PROC = 2 };
+enum { NUM_ROUNDS = 100 };
+enum { HOLD_TIME_US = 5000 };
+
+static const pid_t pids[NUM_PROCS] = {111, 222, 333, 444};
+static int cpus_priority_array[SYS_SIZE];
+static pid_t new_guests[SYS_SIZE];
+static pid_t victims[SYS_SIZE];
+
+static void get_mask(int proc, cpu_set_t *mask) {
+    CPU_ZERO(mask);
+    int cpuid;
+    for (cpuid = proc*CPUS_PER_PROC; cpuid < (proc+1)*CPUS_PER_PROC; ++cpuid) {
+        CPU_SET(cpuid, mask);
+    }
+}
+
+/* Every process but the borrower lends its CPUs with the given durations in
+ * microseconds (0 if unknown) */
+static void lend_all(const int64_t *durations) {
+    int p;
+    for (p = 1; p < NUM_PROCS; ++p) {
+        cpu_set_t mask;
+        get_mask(p, &mask);
+        assert( shmem_cpuinfo__set_lend_duration(pids[p], durations[p] * 1000)
+                == DLB_SUCCESS );
+        assert( shmem_cpuinfo__lend_cpu_mask(pids[p], &mask, new_guests) == DLB_SUCCESS );
+    }
+}
+
+static void reclaim_all(void) {
+    int p;
+    for (p = 1; p < NUM_PROCS; ++p) {
+        assert( shmem_cpuinfo__reclaim_all(pids[p], new_guests, victims) >= DLB_SUCCESS );
+    }
+    assert( shmem_cpuinfo__return_all(pids[0], new_guests) >= DLB_SUCCESS );
+    cpu_set_t mask;
+    for (p = 0; p < NUM_PROCS; ++p) {
+        assert( shmem_cpuinfo__get_guested_cpus(pids[p], &mask) == DLB_SUCCESS );
+        assert( CPU_COUNT(&mask) == CPUS_PER_PROC );
+    }
+}
+
+static void borrow(int ncpus, cpu_set_t *borrowed) {
+    assert( shmem_cpuinfo__borrow_cpus(pids[0], PRIO_ANY, cpus_priority_array, NULL, ncpus,
+                new_guests) == DLB_SUCCESS );
+    CPU_ZERO(borrowed);
+    int cpuid;
+    for (cpuid = 0; cpuid < SYS_SIZE; ++cpuid) {
+        if (new_guests[cpuid] == pids[0]) {
+            CPU_SET(cpuid, borrowed);
+        }
+    }
+    assert( CPU_COUNT(borrowed) == ncpus );
+}
+
+/* Rounds in which the lenders publish their lend durations or not, and reclaim
+ * their CPUs once the duration expires. The borrower holds the CPUs it borrows
+ * for a fixed time, count the borrowed CPUs that come back as victims of the
+ * owners' reclaims */
+static int count_preemptions(bool publish) {
+    static const int64_t choices[] = {10, 100, 1000, 10000, 100000, 200000};
+    enum { NUM_CHOICES = sizeof(choices) / sizeof(choices[0]) };
+    srand(0);
+    int preemptions = 0;
+    int round;
+    for (round = 0; round < NUM_ROUNDS; ++round) {
+        int64_t durations[NUM_PROCS] = {0};
+        int p;
+        for (p = 1; p < NUM_PROCS; ++p) {
+            durations[p] = choices[rand() % NUM_CHOICES];
+        }
+        int64_t start = get_time_in_ns();
+        if (publish) {
+            lend_all(durations);
+        } else {
+            int64_t unknown[NUM_PROCS] = {0};
+            lend_all(unknown);
+        }
+        cpu_set_t borrowed;
+        borrow(CPUS_PER_PROC, &borrowed);
+
+        bool reclaimed[NUM_PROCS] = {false};
+        int64_t elapsed;
+        while ((elapsed = (get_time_in_ns() - start) / 1000) < HOLD_TIME_US) {
+            for (p = 1; p < NUM_PROCS; ++p) {
+                if (!reclaimed[p] && elapsed >= durations[p]) {
+                    cpu_set_t mask;
+                    get_mask(p, &mask);
+                    assert( shmem_cpuinfo__reclaim_cpu_mask(pids[p], &mask, new_guests,
+                                victims) >= DLB_SUCCESS );
+                    int cpuid;
+                    for (cpuid = 0; cpuid < SYS_SIZE; ++cpuid) {
+                        if (CPU_ISSET(cpuid, &mask) && victims[cpuid] == pids[0]) {
+                            assert( CPU_ISSET(cpuid, &borrowed) );
+                            ++preemptions;
+                        }
+                    }
+                    reclaimed[p] = true;
+                }
+            }
+            usleep(10);
+        }
+        reclaim_all();
+    }
+    return preemptions;
+}
+
+int main( int argc, char **argv ) {
+    mu_init();
+    mu_testing_set_sys_size(SYS_SIZE);
+
+    int p, i;
+    for (p = 0; p < NUM_PROCS; ++p) {
+        cpu_set_t mask;
+        get_mask(p, &mask);
+        assert( shmem_cpuinfo__init(pids[p], &mask, NULL) == DLB_SUCCESS );
+    }
+    for (i = 0; i < SYS_SIZE; ++i) {
+        cpus_priority_array[i] = i;
+    }
+
+    cpu_set_t borrowed;
+    cpu_set_t expected;
+
+    /* Without expected durations, the priority order is kept */
+    {
+        int64_t durations[NUM_PROCS] = {0, 0, 0, 0};
+        lend_all(durations);
+        borrow(2, &borrowed);
+        get_mask(1, &expected);
+        assert( CPU_EQUAL(&borrowed, &expected) );
+        reclaim_all();
+    }
+
+    /* Known durations first, longest first, then unknown, then overdue */
+    {
+        int64_t durations[NUM_PROCS] = {0, 1000, 10000000, 0};
+        lend_all(durations);
+        borrow(2, &borrowed);
+        get_mask(2, &expected);
+        assert( CPU_EQUAL(&borrowed, &expected) );
+
+        usleep(2000);
+        borrow(2, &borrowed);
+        get_mask(3, &expected);
+        assert( CPU_EQUAL(&borrowed, &expected) );
+
+        borrow(2, &borrowed);
+        get_mask(1, &expected);
+        assert( CPU_EQUAL(&borrowed, &expected) );
+        reclaim_all();
+    }
+
+    /* Acquire follows the same order for the non-owned CPUs */
+    {
+        int64_t durations[NUM_PROCS] = {0, 10000000, 0, 20000000};
+        lend_all(durations);
+        assert( shmem_cpuinfo__acquire_cpus(pids[0], PRIO_ANY, cpus_priority_array, NULL, 2,
+                    new_guests, victims) == DLB_SUCCESS );
+        assert( new_guests[6] == pids[0] && new_guests[7] == pids[0] );
+        assert( new_guests[2] == -1 && new_guests[3] == -1 );
+        reclaim_all();
+    }
+
+    /* The expected duration only applies to the subsequent lends */
+    {
+        int64_t durations[NUM_PROCS] = {0, 0, 0, 0};
+        lend_all(durations);
+        assert( shmem_cpuinfo__set_lend_duration(pids[1], 10000000000LL) == DLB_SUCCESS );
+        borrow(2, &borrowed);
+        get_mask(1, &expected);
+        assert( CPU_EQUAL(&borrowed, &expected) );
+        reclaim_all();
+    }
+    assert( shmem_cpuinfo__set_lend_duration(pids[1], -1) == DLB_ERR_PERM );
+
+    /* Reclaim-induced preemptions with and without published durations */
+    int legacy = count_preemptions(false);
+    int aware = count_preemptions(true);
+    assert( aware * 2 < legacy );
+
+    for (p = 0; p < NUM_PROCS; ++p) {
+        assert( shmem_cpuinfo__finalize(pids[p]) == DLB_SUCCESS );
+    }
+
+    return 0;
+}
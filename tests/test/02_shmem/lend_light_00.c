@@ -0,0 +1,224 @@
+/*********************************************************************************/
+/*  Copyright 2017 Barcelona Supercomputing Center                               */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <http://www.gnu.org/licenses/>.                 */
+/*********************************************************************************/
+
+/*<testinfo>
+    test_generator="gens/basic-generator"
+</testinfo>*/
+
+#include "assert_noshm.h"
+
+#include "LB_comm/comm_lend_light.h"
+#include "support/mask_utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+/* Stress test of the counter-based LeWI shared memory: processes lend, reclaim
+ * and borrow concurrently, CPUs must be neither lost nor over-granted.
+ * Operations run concurrently under a shared lock, which the processes take
+ * exclusively from time to time to sample the CPUs in use in the middle of the
+ * other processes' rounds */
+
+void __gcov_flush() __attribute__((weak));
+
+enum { NUM_PROCS = 8 };
+enum { DEFAULT_CPUS = 2 };
+enum { NUM_DOMAINS = 2 };
+enum { NUM_ROUNDS = 50 };
+enum { OPS_PER_ROUND = 200 };
+enum { OPS_PER_SAMPLE = 50 };
+
+static const char *shmem_key = "lend_light_00";
+
+struct data {
+    pthread_barrier_t barrier;
+    pthread_rwlock_t ops_lock;
+    volatile int cpus[NUM_PROCS];
+    volatile int in_use;
+};
+
+static void sync_all(struct data *data) {
+    int error = pthread_barrier_wait(&data->barrier);
+    assert(error == 0 || error == PTHREAD_BARRIER_SERIAL_THREAD);
+}
+
+/* CPUs are conserved: the ones in use plus the idle ones minus the ones
+ * reclaimed but still borrowed are always the CPUs of the node. With no idle
+ * CPUs, the ones in use exceed the node size at most by the debt.
+ * No operation may be in flight */
+static void check_invariant(lend_light_t *handle, struct data *data) {
+    int in_use = 0;
+    int i;
+    for (i = 0; i < NUM_PROCS; ++i) {
+        assert( data->cpus[i] >= 0 );
+        in_use += data->cpus[i];
+    }
+    assert( in_use == data->in_use );
+    int idle = getIdleCpus(handle);
+    int debt = getDebtCpus(handle);
+    assert( idle >= 0 );
+    assert( debt >= 0 );
+    assert( in_use + idle - debt == NUM_PROCS * DEFAULT_CPUS );
+}
+
+/* Wait for the operations in flight and check the invariant */
+static void sample_invariant(lend_light_t *handle, struct data *data) {
+    assert( pthread_rwlock_wrlock(&data->ops_lock) == 0 );
+    check_invariant(handle, data);
+    assert( pthread_rwlock_unlock(&data->ops_lock) == 0 );
+}
+
+static void set_cpus(struct data *data, int id, int cpus) {
+    __sync_fetch_and_add(&data->in_use, cpus - data->cpus[id]);
+    data->cpus[id] = cpus;
+}
+
+/* The ledger of each process only accounts the CPUs over its default ones as
+ * borrowed, and it never owes more than that */
+static void check_ledger(lend_light_t *handle, int my_cpus) {
+    int lent, borrowed, owed;
+    getLedgerEntry(handle, &lent, &borrowed, &owed);
+    assert( lent >= 0 );
+    assert( borrowed == (my_cpus > DEFAULT_CPUS ? my_cpus - DEFAULT_CPUS : 0) );
+    assert( owed >= 0 && owed <= borrowed );
+}
+
+static void run(struct data *data, int id) {
+    cpu_set_t process_mask;
+    CPU_ZERO(&process_mask);
+    CPU_SET(id * DEFAULT_CPUS, &process_mask);
+    CPU_SET(id * DEFAULT_CPUS + 1, &process_mask);
+    lend_light_t *handle = ConfigShMem(DEFAULT_CPUS, id % 2, &process_mask, shmem_key);
+    sync_all(data);
+
+    unsigned int seed = id;
+    int my_cpus = DEFAULT_CPUS;
+    int round;
+    for (round = 0; round < NUM_ROUNDS; ++round) {
+        int op;
+        for (op = 0; op < OPS_PER_ROUND; ++op) {
+            assert( pthread_rwlock_rdlock(&data->ops_lock) == 0 );
+            switch (rand_r(&seed) % 3) {
+                case 0:
+                    if (my_cpus > 1) {
+                        releaseCpus(handle, my_cpus - 1);
+                        my_cpus = 1;
+                    }
+                    break;
+                case 1:
+                    my_cpus = acquireCpus(handle, my_cpus);
+                    break;
+                case 2:
+                    my_cpus = checkIdleCpus(handle, my_cpus, 1 + rand_r(&seed) % 4);
+                    break;
+            }
+            assert( my_cpus >= 0 );
+            set_cpus(data, id, my_cpus);
+            assert( pthread_rwlock_unlock(&data->ops_lock) == 0 );
+
+            if (op % OPS_PER_SAMPLE == id) {
+                sample_invariant(handle, data);
+            }
+        }
+
+        sync_all(data);
+        if (id == 0) check_invariant(handle, data);
+        check_ledger(handle, my_cpus);
+        sync_all(data);
+    }
+
+    /* Every process reclaims its CPUs, then greedy processes and borrowers
+     * return the extra ones */
+    my_cpus = acquireCpus(handle, my_cpus);
+    set_cpus(data, id, my_cpus);
+    sync_all(data);
+    if (my_cpus > DEFAULT_CPUS) {
+        releaseCpus(handle, my_cpus - DEFAULT_CPUS);
+        my_cpus = DEFAULT_CPUS;
+        set_cpus(data, id, my_cpus);
+    }
+    sync_all(data);
+    if (id == 0) {
+        check_invariant(handle, data);
+        my_cpus = checkIdleCpus(handle, my_cpus, 0);
+        assert( my_cpus == DEFAULT_CPUS );
+        assert( getDebtCpus(handle) == 0 );
+        assert( getIdleCpus(handle) == 0 );
+    }
+    assert( my_cpus == DEFAULT_CPUS );
+    check_ledger(handle, my_cpus);
+
+    sync_all(data);
+    finalize_comm(handle);
+}
+
+int main(int argc, char **argv) {
+    mu_testing_set_sys(NUM_PROCS * DEFAULT_CPUS, NUM_DOMAINS);
+
+    struct data *data = mmap(NULL, sizeof(struct data), PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    assert( data != MAP_FAILED );
+
+    pthread_barrierattr_t attr;
+    assert( pthread_barrierattr_init(&attr) == 0 );
+    assert( pthread_barrierattr_setpshared(&attr, PTHREAD_PROCESS_SHARED) == 0 );
+    assert( pthread_barrier_init(&data->barrier, &attr, NUM_PROCS) == 0 );
+    assert( pthread_barrierattr_destroy(&attr) == 0 );
+
+    /* Prefer the processes sampling, the rest keep taking the lock */
+    pthread_rwlockattr_t rwattr;
+    assert( pthread_rwlockattr_init(&rwattr) == 0 );
+    assert( pthread_rwlockattr_setpshared(&rwattr, PTHREAD_PROCESS_SHARED) == 0 );
+    assert( pthread_rwlockattr_setkind_np(&rwattr,
+                PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP) == 0 );
+    assert( pthread_rwlock_init(&data->ops_lock, &rwattr) == 0 );
+    assert( pthread_rwlockattr_destroy(&rwattr) == 0 );
+    data->in_use = NUM_PROCS * DEFAULT_CPUS;
+    int i;
+    for (i = 0; i < NUM_PROCS; ++i) {
+        data->cpus[i] = DEFAULT_CPUS;
+    }
+
+    int id;
+    for (id = 1; id < NUM_PROCS; ++id) {
+        pid_t pid = fork();
+        assert( pid >= 0 );
+        if (pid == 0) {
+            run(data, id);
+            if (__gcov_flush) __gcov_flush();
+            _exit(EXIT_SUCCESS);
+        }
+    }
+    run(data, 0);
+
+    int wstatus;
+    while (wait(&wstatus) > 0) {
+        assert( WIFEXITED(wstatus) && WEXITSTATUS(wstatus) == EXIT_SUCCESS );
+    }
+    assert( pthread_barrier_destroy(&data->barrier) == 0 );
+    assert( pthread_rwlock_destroy(&data->ops_lock) == 0 );
+    munmap(data, sizeof(struct data));
+
+    return 0;
+}
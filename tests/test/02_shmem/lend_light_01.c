@@ -0,0 +1,158 @@
+/*********************************************************************************/
+/*  Copyright 2017 Barcelona Supercomputing Center                               */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <http://www.gnu.org/licenses/>.                 */
+/*********************************************************************************/
+
+/*<testinfo>
+    test_generator="gens/basic-generator"
+</testinfo>*/
+
+#include "assert_noshm.h"
+
+#include "LB_comm/comm_lend_light.h"
+#include "support/mask_utils.h"
+
+#include <stdlib.h>
+#include <assert.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+/* LeWI ledger: CPUs reclaimed by their owner are owed by the processes that
+ * borrowed them, other processes are not asked to return anything */
+
+void __gcov_flush() __attribute__((weak));
+
+enum { NUM_PROCS = 3 };
+enum { DEFAULT_CPUS = 2 };
+enum { OWNER = 0, BORROWER = 1, BYSTANDER = 2 };
+
+static const char *shmem_key = "lend_light_01";
+
+struct data {
+    pthread_barrier_t barrier;
+};
+
+static void sync_all(struct data *data) {
+    int error = pthread_barrier_wait(&data->barrier);
+    assert(error == 0 || error == PTHREAD_BARRIER_SERIAL_THREAD);
+}
+
+static void run(struct data *data, int id) {
+    cpu_set_t process_mask;
+    CPU_ZERO(&process_mask);
+    CPU_SET(id * DEFAULT_CPUS, &process_mask);
+    CPU_SET(id * DEFAULT_CPUS + 1, &process_mask);
+    lend_light_t *handle = ConfigShMem(DEFAULT_CPUS, 0, &process_mask, shmem_key);
+    sync_all(data);
+
+    int my_cpus = DEFAULT_CPUS;
+    int lent, borrowed, owed;
+
+    /* The owner lends one CPU */
+    if (id == OWNER) {
+        releaseCpus(handle, 1);
+        my_cpus = 1;
+        getLedgerEntry(handle, &lent, &borrowed, &owed);
+        assert( lent == 1 && borrowed == 0 && owed == 0 );
+    }
+    sync_all(data);
+
+    /* The borrower takes it */
+    if (id == BORROWER) {
+        my_cpus = checkIdleCpus(handle, my_cpus, 1);
+        assert( my_cpus == DEFAULT_CPUS + 1 );
+        getLedgerEntry(handle, &lent, &borrowed, &owed);
+        assert( lent == 0 && borrowed == 1 && owed == 0 );
+    }
+    sync_all(data);
+
+    /* The owner reclaims it, the borrower owes it */
+    if (id == OWNER) {
+        my_cpus = acquireCpus(handle, my_cpus);
+        assert( my_cpus == DEFAULT_CPUS );
+        getLedgerEntry(handle, &lent, &borrowed, &owed);
+        assert( lent == 0 && borrowed == 0 && owed == 0 );
+        assert( getDebtCpus(handle) == 1 );
+    }
+    sync_all(data);
+    if (id == BORROWER) {
+        getLedgerEntry(handle, &lent, &borrowed, &owed);
+        assert( borrowed == 1 && owed == 1 );
+    }
+    sync_all(data);
+
+    /* The bystander is not involved and cannot borrow anything */
+    if (id == BYSTANDER) {
+        my_cpus = checkIdleCpus(handle, my_cpus, 1);
+        assert( my_cpus == DEFAULT_CPUS );
+        getLedgerEntry(handle, &lent, &borrowed, &owed);
+        assert( lent == 0 && borrowed == 0 && owed == 0 );
+        assert( getDebtCpus(handle) == 1 );
+    }
+    sync_all(data);
+
+    /* The borrower returns exactly the owed CPU */
+    if (id == BORROWER) {
+        my_cpus = checkIdleCpus(handle, my_cpus, 1);
+        assert( my_cpus == DEFAULT_CPUS );
+        getLedgerEntry(handle, &lent, &borrowed, &owed);
+        assert( lent == 0 && borrowed == 0 && owed == 0 );
+        assert( getDebtCpus(handle) == 0 );
+        assert( getIdleCpus(handle) == 0 );
+    }
+    sync_all(data);
+    assert( my_cpus == DEFAULT_CPUS );
+
+    finalize_comm(handle);
+}
+
+int main(int argc, char **argv) {
+    mu_testing_set_sys(NUM_PROCS * DEFAULT_CPUS, 1);
+
+    struct data *data = mmap(NULL, sizeof(struct data), PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    assert( data != MAP_FAILED );
+
+    pthread_barrierattr_t attr;
+    assert( pthread_barrierattr_init(&attr) == 0 );
+    assert( pthread_barrierattr_setpshared(&attr, PTHREAD_PROCESS_SHARED) == 0 );
+    assert( pthread_barrier_init(&data->barrier, &attr, NUM_PROCS) == 0 );
+    assert( pthread_barrierattr_destroy(&attr) == 0 );
+
+    int id;
+    for (id = 1; id < NUM_PROCS; ++id) {
+        pid_t pid = fork();
+        assert( pid >= 0 );
+        if (pid == 0) {
+            run(data, id);
+            if (__gcov_flush) __gcov_flush();
+            _exit(EXIT_SUCCESS);
+        }
+    }
+    run(data, 0);
+
+    int wstatus;
+    while (wait(&wstatus) > 0) {
+        assert( WIFEXITED(wstatus) && WEXITSTATUS(wstatus) == EXIT_SUCCESS );
+    }
+    assert( pthread_barrier_destroy(&data->barrier) == 0 );
+    munmap(data, sizeof(struct data));
+
+    return 0;
+}
@@ -0,0 +1,143 @@
+/*********************************************************************************/
+/*  Copyright 2017 Barcelona Supercomputing Center                               */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <http://www.gnu.org/licenses/>.                 */
+/*********************************************************************************/
+
+/*<testinfo>
+    test_generator="gens/basic-generator"
+</testinfo>*/
+
+#include "assert_noshm.h"
+
+#include "LB_comm/shmem_procinfo.h"
+#include "apis/dlb_errors.h"
+#include "apis/dlb_types.h"
+#include "support/mask_utils.h"
+
+#include <sched.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <string.h>
+#include <assert.h>
+
+// Atomic repartition of several processes with setprocessmasks
+
+enum { SYS_SIZE = 8 };
+
+static void polldrom_all(const pid_t *pids, int n) {
+    int i;
+    cpu_set_t mask;
+    for (i = 0; i < n; ++i) {
+        shmem_procinfo__polldrom(pids[i], NULL, &mask);
+    }
+}
+
+int main( int argc, char **argv ) {
+    mu_init();
+    mu_testing_set_sys_size(SYS_SIZE);
+
+    pid_t pid = getpid();
+    pid_t pids[3] = { pid, pid+1, pid+2 };
+    cpu_set_t masks[3];
+    cpu_set_t mask;
+    int i;
+
+    // Initialize external and preregister: [0-3], [4-5], [6-7]
+    assert( shmem_procinfo_ext__init(NULL) == DLB_SUCCESS );
+    CPU_ZERO(&masks[0]); for (i=0; i<4; ++i) CPU_SET(i, &masks[0]);
+    CPU_ZERO(&masks[1]); CPU_SET(4, &masks[1]); CPU_SET(5, &masks[1]);
+    CPU_ZERO(&masks[2]); CPU_SET(6, &masks[2]); CPU_SET(7, &masks[2]);
+    for (i=0; i<3; ++i) {
+        assert( shmem_procinfo_ext__preinit(pids[i], &masks[i], 0) == DLB_SUCCESS );
+    }
+
+    // Swap the first two partitions: [0-1], [2-5], [6-7] unmodified
+    // Sequential calls would fail here because [2-5] overlaps with current [0-3]
+    CPU_ZERO(&masks[0]); CPU_SET(0, &masks[0]); CPU_SET(1, &masks[0]);
+    CPU_ZERO(&masks[1]); for (i=2; i<6; ++i) CPU_SET(i, &masks[1]);
+    assert( shmem_procinfo__setprocessmasks(pids, masks, 2, 0) == DLB_SUCCESS );
+    for (i=0; i<2; ++i) {
+        assert( shmem_procinfo__getprocessmask(pids[i], &mask, 0) == DLB_SUCCESS );
+        assert( CPU_EQUAL(&mask, &masks[i]) );
+    }
+    assert( shmem_procinfo__getprocessmask(pids[2], &mask, 0) == DLB_SUCCESS );
+    assert( CPU_EQUAL(&mask, &masks[2]) );
+
+    // Targets are dirty until they poll
+    assert( shmem_procinfo__setprocessmasks(pids, masks, 2, 0) == DLB_ERR_PDIRTY );
+    polldrom_all(pids, 3);
+
+    // Overlapping masks, empty masks and unknown pids are rejected
+    cpu_set_t bad_masks[2];
+    pid_t bad_pids[2] = { pids[0], pid+42 };
+    memcpy(&bad_masks[0], &masks[0], sizeof(cpu_set_t));
+    memcpy(&bad_masks[1], &masks[0], sizeof(cpu_set_t));
+    assert( shmem_procinfo__setprocessmasks(pids, bad_masks, 2, 0) == DLB_ERR_PERM );
+    CPU_ZERO(&bad_masks[1]);
+    assert( shmem_procinfo__setprocessmasks(pids, bad_masks, 2, 0) == DLB_ERR_PERM );
+    assert( shmem_procinfo__setprocessmasks(bad_pids, masks, 2, 0) == DLB_ERR_NOPROC );
+
+    // A non-target process cannot be left without CPUs: [0], [1-7] would empty pids[2]
+    CPU_ZERO(&bad_masks[0]); CPU_SET(0, &bad_masks[0]);
+    CPU_ZERO(&bad_masks[1]); for (i=1; i<SYS_SIZE; ++i) CPU_SET(i, &bad_masks[1]);
+    assert( shmem_procinfo__setprocessmasks(pids, bad_masks, 2, 0) == DLB_ERR_PERM );
+
+    // Nothing was modified after the failed attempts
+    for (i=0; i<3; ++i) {
+        assert( shmem_procinfo__getprocessmask(pids[i], &mask, 0) == DLB_SUCCESS );
+        assert( CPU_EQUAL(&mask, &masks[i]) );
+    }
+
+    // Stealing from a non-target process: [0-2], [3-6], pids[2] keeps [7]
+    CPU_ZERO(&masks[0]); for (i=0; i<3; ++i) CPU_SET(i, &masks[0]);
+    CPU_ZERO(&masks[1]); for (i=3; i<7; ++i) CPU_SET(i, &masks[1]);
+    assert( shmem_procinfo__setprocessmasks(pids, masks, 2, 0) == DLB_SUCCESS );
+    assert( shmem_procinfo__getprocessmask(pids[2], &mask, 0) == DLB_SUCCESS );
+    assert( CPU_COUNT(&mask) == 1 && CPU_ISSET(7, &mask) );
+    polldrom_all(pids, 3);
+
+    // The first target is not modified if the second one cannot be applied
+    CPU_ZERO(&bad_masks[0]); CPU_SET(0, &bad_masks[0]);
+    CPU_ZERO(&bad_masks[1]); CPU_SET(7, &bad_masks[1]);
+    assert( shmem_procinfo__setprocessmasks(pids, bad_masks, 2, 0) == DLB_ERR_PERM );
+    for (i=0; i<2; ++i) {
+        assert( shmem_procinfo__getprocessmask(pids[i], &mask, 0) == DLB_SUCCESS );
+        assert( CPU_EQUAL(&mask, &masks[i]) );
+    }
+
+    // CPUs released by the targets become free: [0], [3], and can be acquired: [1-2,4-7]
+    CPU_ZERO(&masks[0]); CPU_SET(0, &masks[0]);
+    CPU_ZERO(&masks[1]); CPU_SET(3, &masks[1]);
+    assert( shmem_procinfo__setprocessmasks(pids, masks, 2, 0) == DLB_SUCCESS );
+    polldrom_all(pids, 3);
+    CPU_ZERO(&masks[2]);
+    for (i=1; i<SYS_SIZE; ++i) if (i != 3) CPU_SET(i, &masks[2]);
+    assert( shmem_procinfo__setprocessmasks(&pids[2], &masks[2], 1, 0) == DLB_SUCCESS );
+    for (i=0; i<3; ++i) {
+        assert( shmem_procinfo__getprocessmask(pids[i], &mask, 0) == DLB_SUCCESS );
+        assert( CPU_EQUAL(&mask, &masks[i]) );
+    }
+    polldrom_all(pids, 3);
+
+    // Finalize
+    for (i=0; i<3; ++i) {
+        assert( shmem_procinfo_ext__postfinalize(pids[i], false) == DLB_SUCCESS );
+    }
+    assert( shmem_procinfo_ext__finalize() == DLB_SUCCESS );
+
+    return 0;
+}
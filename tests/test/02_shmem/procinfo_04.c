@@ -0,0 +1,141 @@
+/*********************************************************************************/
+/*  Copyright 2017 Barcelona Supercomputing Center                               */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <http://www.gnu.org/licenses/>.                 */
+/*********************************************************************************/
+/*<testinfo>
+    test_generator="gens/basic-generator"
+</testinfo>*/
+
+#include "assert_noshm.h"
+
+#include "LB_core/efficiency.h"
+#include "LB_comm/shmem_procinfo.h"
+#include "apis/dlb_errors.h"
+
+#include <sched.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <assert.h>
+
+// Efficiency counters published by the sub-process and read by an external process
+
+static volatile double sink = 0.0;
+
+static void busy_work(void) {
+    int i;
+    for (i = 0; i < 10000000; ++i) {
+        sink += (double)i * 0.5;
+    }
+}
+
+enum { NUM_THREADS = 8 };
+
+static void* concurrent_mpi(void *arg) {
+    efficiency_into_mpi();
+    usleep(50000);
+    efficiency_out_of_mpi();
+    return NULL;
+}
+
+static double get_seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+int main( int argc, char **argv ) {
+    pid_t pid = getpid();
+    cpu_set_t process_mask;
+    sched_getaffinity(0, sizeof(cpu_set_t), &process_mask);
+
+    // Initialize sub-process and the efficiency counters
+    assert( shmem_procinfo__init(pid, &process_mask, NULL, NULL) == DLB_SUCCESS );
+    assert( shmem_procinfo_ext__init(NULL) == DLB_SUCCESS );
+
+    // Before the first update, IPC is not available
+    double ipc;
+    assert( shmem_procinfo__getipc(pid, &ipc) == DLB_SUCCESS );
+    assert( ipc == -1.0 );
+    assert( shmem_procinfo__getipc(pid+1, &ipc) == DLB_ERR_NOPROC );
+
+    // CPU time consumed before the initialization is not accounted
+    while (clock() < CLOCKS_PER_SEC/5);
+    double start = get_seconds();
+    efficiency_init(pid);
+
+    // Useful computation, MPI and nested DLB intervals
+    busy_work();
+    efficiency_into_mpi();
+    usleep(50000);
+    efficiency_out_of_mpi();
+    efficiency_into_dlb();
+    efficiency_into_dlb();
+    usleep(10000);
+    efficiency_out_of_dlb();
+    usleep(10000);
+    efficiency_out_of_dlb();
+    busy_work();
+
+    // Concurrent MPI calls from several threads are accounted once
+    pthread_t threads[NUM_THREADS];
+    int i;
+    for (i = 0; i < NUM_THREADS; ++i) {
+        pthread_create(&threads[i], NULL, concurrent_mpi, NULL);
+    }
+    for (i = 0; i < NUM_THREADS; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    efficiency_update(true);
+    double elapsed = get_seconds() - start;
+
+    // Check fractions
+    double useful, mpi, dlb;
+    assert( shmem_procinfo__gettimefractions(pid, &useful, &mpi, &dlb) == DLB_SUCCESS );
+    assert( useful >= 0.0 && useful <= 1.0 );
+    assert( mpi > 0.0 && mpi <= 1.0 );
+    assert( dlb > 0.0 && dlb <= 1.0 );
+    assert( mpi > dlb );
+    assert( mpi * elapsed < 0.25 );
+    assert( useful > 0.0 );
+    assert( useful + mpi + dlb > 0.99 && useful + mpi + dlb < 1.01 );
+    assert( shmem_procinfo__gettimefractions(pid+1, &useful, &mpi, &dlb) == DLB_ERR_NOPROC );
+
+    // Check list
+    double useful_list[1];
+    int nelems;
+    shmem_procinfo__getusefulfraction_list(useful_list, &nelems, 1);
+    assert( nelems == 1 );
+    assert( useful_list[0] == useful );
+
+    // IPC is either not available or a positive value
+    assert( shmem_procinfo__getipc(pid, &ipc) == DLB_SUCCESS );
+    assert( ipc == -1.0 || ipc > 0.0 );
+
+    // CPU usage has been published as well, the main thread is the only one computing
+    double avg_usage = shmem_procinfo__getcpuavgusage(pid);
+    assert( avg_usage > 0.0 && avg_usage < 101.0 );
+
+    // Finalize
+    efficiency_finalize();
+    assert( shmem_procinfo__finalize(pid, false) == DLB_SUCCESS );
+    assert( shmem_procinfo_ext__finalize() == DLB_SUCCESS );
+    assert( shmem_procinfo__getipc(pid, &ipc) == DLB_ERR_NOSHMEM );
+
+    return 0;
+}
@@ -0,0 +1,120 @@
+/*********************************************************************************/
+/*  Copyright 2017 Barcelona Supercomputing Center                               */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <http://www.gnu.org/licenses/>.                 */
+/*********************************************************************************/
+
+/*<testinfo>
+    test_generator="gens/basic-generator"
+</testinfo>*/
+
+#include "assert_loop.h"
+#include "assert_noshm.h"
+
+#include "apis/dlb_errors.h"
+#include "LB_comm/comm_lend_light.h"
+#include "LB_core/spd.h"
+#include "LB_policies/lewi.h"
+#include "LB_numThreads/numThreads.h"
+#include "support/mask_utils.h"
+#include "support/options.h"
+
+#include <unistd.h>
+
+/* LeWI policy in asynchronous mode */
+
+enum { SYS_SIZE = 8 };
+enum { DEFAULT_CPUS = 4 };
+
+static volatile int nthreads;
+
+static void cb_set_num_threads(int num_threads, void *arg) {
+    nthreads = num_threads;
+}
+
+int main( int argc, char **argv ) {
+    mu_init();
+    mu_testing_set_sys_size(SYS_SIZE);
+
+    subprocess_descriptor_t spd;
+    options_init(&spd.options, "--mode=async");
+    pm_init(&spd.pm);
+    spd.id = getpid();
+    CPU_ZERO(&spd.process_mask);
+    int i;
+    for (i = 0; i < DEFAULT_CPUS; ++i) {
+        CPU_SET(i, &spd.process_mask);
+    }
+    assert( pm_callback_set(&spd.pm, dlb_callback_set_num_threads,
+                (dlb_callback_t)cb_set_num_threads, NULL) == DLB_SUCCESS );
+
+    // Init
+    assert( lewi_Init(&spd) == DLB_SUCCESS );
+    assert( nthreads == DEFAULT_CPUS );
+
+    // Another subprocess attached to the same shared memory
+    cpu_set_t other_mask;
+    CPU_ZERO(&other_mask);
+    for (i = DEFAULT_CPUS; i < SYS_SIZE; ++i) {
+        CPU_SET(i, &other_mask);
+    }
+    lend_light_t *other = ConfigShMem(SYS_SIZE - DEFAULT_CPUS, 0, &other_mask,
+            spd.options.shm_key);
+
+    // Another process releases 2 CPUs, the helper borrows them without polling
+    releaseCpus(other, 2);
+    assert_loop( nthreads == DEFAULT_CPUS + 2 );
+
+    // The other process acquires them back, the helper returns them
+    releaseCpus(other, -2);
+    assert_loop( nthreads == DEFAULT_CPUS );
+
+    // CPUs lent by the process itself are not borrowed back by its helper
+    assert( lewi_Lend(&spd) == DLB_SUCCESS );
+    assert( nthreads == 1 );
+    usleep(10000);
+    assert( nthreads == 1 );
+    assert( lewi_Reclaim(&spd) == DLB_SUCCESS );
+    assert( nthreads == DEFAULT_CPUS );
+
+    // Same for blocking calls
+    assert( lewi_IntoBlockingCall(&spd) == DLB_SUCCESS );
+    assert( nthreads == 1 );
+    usleep(10000);
+    assert( nthreads == 1 );
+    assert( lewi_OutOfBlockingCall(&spd, 0) == DLB_SUCCESS );
+    assert( nthreads == DEFAULT_CPUS );
+
+    // Max parallelism is honoured by the helper
+    assert( lewi_SetMaxParallelism(&spd, DEFAULT_CPUS + 1) == DLB_SUCCESS );
+    releaseCpus(other, 2);
+    assert_loop( nthreads == DEFAULT_CPUS + 1 );
+    releaseCpus(other, -2);
+    assert_loop( nthreads == DEFAULT_CPUS );
+
+    // No borrowing while disabled
+    assert( lewi_DisableDLB(&spd) == DLB_SUCCESS );
+    releaseCpus(other, 2);
+    usleep(10000);
+    assert( nthreads == DEFAULT_CPUS );
+    releaseCpus(other, -2);
+
+    // Finalize
+    assert( lewi_Finalize(&spd) == DLB_SUCCESS );
+    finalize_comm(other);
+
+    return 0;
+}
@@ -0,0 +1,111 @@
+/*********************************************************************************/
+/*  Copyright 2017 Barcelona Supercomputing Center                               */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <http://www.gnu.org/licenses/>.                 */
+/*********************************************************************************/
+
+/*<testinfo>
+    test_generator="gens/basic-generator"
+</testinfo>*/
+
+#include "assert_noshm.h"
+
+#include "apis/dlb_errors.h"
+#include "LB_core/spd.h"
+#include "LB_policies/lewi.h"
+#include "LB_numThreads/numThreads.h"
+#include "support/mask_utils.h"
+#include "support/options.h"
+
+#include <unistd.h>
+
+/* LeWI policy with two subprocesses in the same process */
+
+enum { SYS_SIZE = 8 };
+enum { DEFAULT_CPUS = 4 };
+
+static void cb_set_num_threads(int num_threads, void *arg) {
+    *(int*)arg = num_threads;
+}
+
+static void init_spd(subprocess_descriptor_t *spd, int first_cpu, int *nthreads) {
+    options_init(&spd->options, NULL);
+    pm_init(&spd->pm);
+    spd->id = getpid();
+    CPU_ZERO(&spd->process_mask);
+    int i;
+    for (i = first_cpu; i < first_cpu + DEFAULT_CPUS; ++i) {
+        CPU_SET(i, &spd->process_mask);
+    }
+    assert( pm_callback_set(&spd->pm, dlb_callback_set_num_threads,
+                (dlb_callback_t)cb_set_num_threads, nthreads) == DLB_SUCCESS );
+}
+
+int main( int argc, char **argv ) {
+    mu_init();
+    mu_testing_set_sys_size(SYS_SIZE);
+
+    int nthreads1 = 0;
+    int nthreads2 = 0;
+    subprocess_descriptor_t spd1;
+    subprocess_descriptor_t spd2;
+    init_spd(&spd1, 0, &nthreads1);
+    init_spd(&spd2, DEFAULT_CPUS, &nthreads2);
+
+    // Init
+    assert( lewi_Init(&spd1) == DLB_SUCCESS );
+    assert( lewi_Init(&spd2) == DLB_SUCCESS );
+    assert( nthreads1 == DEFAULT_CPUS );
+    assert( nthreads2 == DEFAULT_CPUS );
+
+    // Subprocess 1 lends, subprocess 2 borrows
+    assert( lewi_Lend(&spd1) == DLB_SUCCESS );
+    assert( nthreads1 == 1 );
+    assert( nthreads2 == DEFAULT_CPUS );
+    assert( lewi_Borrow(&spd2) == DLB_SUCCESS );
+    assert( nthreads1 == 1 );
+    assert( nthreads2 == 2*DEFAULT_CPUS - 1 );
+
+    // Subprocess 1 reclaims, subprocess 2 returns the borrowed CPUs
+    assert( lewi_Reclaim(&spd1) == DLB_SUCCESS );
+    assert( nthreads1 == DEFAULT_CPUS );
+    assert( lewi_Borrow(&spd2) == DLB_SUCCESS );
+    assert( nthreads2 == DEFAULT_CPUS );
+    assert( lewi_Borrow(&spd1) == DLB_NOUPDT );
+
+    // Max parallelism is private to each subprocess
+    assert( lewi_SetMaxParallelism(&spd2, DEFAULT_CPUS + 1) == DLB_SUCCESS );
+    assert( lewi_Lend(&spd1) == DLB_SUCCESS );
+    assert( lewi_Borrow(&spd2) == DLB_SUCCESS );
+    assert( nthreads2 == DEFAULT_CPUS + 1 );
+    assert( lewi_Reclaim(&spd1) == DLB_SUCCESS );
+    assert( lewi_Borrow(&spd2) == DLB_SUCCESS );
+    assert( nthreads2 == DEFAULT_CPUS );
+
+    // Disabling one subprocess does not affect the other one
+    assert( lewi_DisableDLB(&spd2) == DLB_SUCCESS );
+    assert( lewi_Borrow(&spd2) == DLB_ERR_DISBLD );
+    assert( lewi_Lend(&spd1) == DLB_SUCCESS );
+    assert( nthreads1 == 1 );
+    assert( lewi_Reclaim(&spd1) == DLB_SUCCESS );
+    assert( nthreads1 == DEFAULT_CPUS );
+
+    // Finalize
+    assert( lewi_Finalize(&spd1) == DLB_SUCCESS );
+    assert( lewi_Finalize(&spd2) == DLB_SUCCESS );
+
+    return 0;
+}
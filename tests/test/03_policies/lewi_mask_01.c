@@ -118,8 +118,8 @@ int main( int argc, char **argv ) {
     assert( spd1.options.mode == spd2.options.mode );
     mode = spd1.options.mode;
     if (mode == MODE_ASYNC) {
-        assert( shmem_async_init(spd2.id, &spd2.pm, &spd2.process_mask, NULL) == DLB_SUCCESS );
-        assert( shmem_async_init(spd1.id, &spd1.pm, &spd1.process_mask, NULL) == DLB_SUCCESS );
+        assert( shmem_async_init(&spd2, NULL) == DLB_SUCCESS );
+        assert( shmem_async_init(&spd1, NULL) == DLB_SUCCESS );
     }
 
     int err;
@@ -0,0 +1,134 @@
+/*********************************************************************************/
+/*  Copyright 2017 Barcelona Supercomputing Center                               */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <http://www.gnu.org/licenses/>.                 */
+/*********************************************************************************/
+
+/*<testinfo>
+    test_generator="gens/basic-generator"
+</testinfo>*/
+
+#include "assert_noshm.h"
+#include "policy_fixture.h"
+
+#include "LB_policies/lewi_predict.h"
+
+#include <stdio.h>
+#include <unistd.h>
+
+/* LeWI_predict policy: once the iteration pattern is known, only the long
+ * blocking calls lend the CPUs, and they are reclaimed before the predicted
+ * end of the call. In polling mode, the reclaimed CPUs are enabled when the
+ * process leaves the call, from the application thread */
+
+enum { SYS_SIZE = 8 };
+enum { DEFAULT_CPUS = 4 };
+enum { SHORT_CALL_US = 100 };
+enum { LONG_CALL_US = 100000 };
+enum { NUM_ITERS = 5 };
+
+static void short_call(const subprocess_descriptor_t *spd, int is_iter, bool predicted) {
+    spd->lb_funcs.into_blocking_call(spd);
+    if (predicted) {
+        /* Not worth lending */
+        assert( get_ncpus(spd) == DEFAULT_CPUS );
+    }
+    usleep(SHORT_CALL_US);
+    spd->lb_funcs.out_of_blocking_call(spd, is_iter);
+    assert( get_ncpus(spd) == DEFAULT_CPUS );
+    assert_enabled_mask(spd);
+}
+
+static void long_call(const subprocess_descriptor_t *spd, const subprocess_descriptor_t *other,
+        bool predicted) {
+    spd->lb_funcs.into_blocking_call(spd);
+    if (predicted) {
+        /* CPUs lent at the beginning of the call, other process may use them */
+        assert( get_ncpus(spd) <= 1 );
+        usleep(LONG_CALL_US / 10);
+        assert( get_ncpus(spd) <= 1 );
+        assert( other->lb_funcs.borrow(other) == DLB_SUCCESS );
+        assert( get_ncpus(other) > DEFAULT_CPUS );
+        assert_enabled_mask(other);
+
+        /* CPUs are reclaimed before the end of the call, the other process
+         * only has to return them */
+        usleep(LONG_CALL_US * 17 / 20);
+        assert( other->lb_funcs.return_all(other) == DLB_SUCCESS );
+        assert( get_ncpus(other) == DEFAULT_CPUS );
+        assert( get_ncpus(spd) == DEFAULT_CPUS );
+        assert_enabled_mask(other);
+        usleep(LONG_CALL_US / 20);
+    } else {
+        usleep(LONG_CALL_US);
+    }
+    spd->lb_funcs.out_of_blocking_call(spd, 0);
+    assert( get_ncpus(spd) == DEFAULT_CPUS );
+    assert_enabled_mask(spd);
+}
+
+int main( int argc, char **argv ) {
+    mu_init();
+    mu_testing_set_sys_size(SYS_SIZE);
+
+    subprocess_descriptor_t spd;
+    subprocess_descriptor_t other_spd;
+    /* Threshold large enough to tolerate scheduling noise in the short calls */
+    char dlb_args[64];
+    snprintf(dlb_args, sizeof(dlb_args), "--lewi-predict-threshold=%d", LONG_CALL_US / 5);
+    init_spd(&spd, 111, 0, DEFAULT_CPUS, get_policy_descriptor(POLICY_LEWI_PREDICT),
+            dlb_args);
+    init_spd(&other_spd, 222, DEFAULT_CPUS, DEFAULT_CPUS,
+            get_policy_descriptor(POLICY_LEWI_MASK), NULL);
+    assert( spd.lb_descriptor->flags & DLB_POLICY_USES_ITERATIONS );
+    assert( lewi_predict_GetPeriod(&spd) == 0 );
+
+    /* Iteration of three blocking calls: short, short, long. The pattern is
+     * known after the second iteration boundary, and the durations are
+     * predicted from the third iteration */
+    int iter;
+    for (iter = 0; iter < NUM_ITERS; ++iter) {
+        bool predicted = iter >= 2;
+        short_call(&spd, 1, predicted);
+        if (iter >= 1) {
+            assert( lewi_predict_GetPeriod(&spd) == 3 );
+        }
+        short_call(&spd, 0, predicted);
+        if (predicted) {
+            assert( lewi_predict_GetPrediction(&spd) > LONG_CALL_US * 1000LL / 2 );
+        }
+        long_call(&spd, &other_spd, predicted);
+    }
+
+    /* Pattern and last iteration time are published */
+    int period;
+    double iter_time;
+    assert( shmem_procinfo__getiterinfo(spd.id, &period, &iter_time) == DLB_SUCCESS );
+    assert( period == 3 );
+    assert( iter_time >= LONG_CALL_US / 1e6 );
+    assert( shmem_procinfo__getiterinfo(333, &period, &iter_time) == DLB_ERR_NOPROC );
+
+    /* A different pattern discards the predictions */
+    short_call(&spd, 1, true);
+    short_call(&spd, 1, false);
+    assert( lewi_predict_GetPeriod(&spd) == 1 );
+    assert( lewi_predict_GetPrediction(&spd) < LONG_CALL_US * 1000LL / 2 );
+
+    finalize_spd(&spd);
+    finalize_spd(&other_spd);
+
+    return 0;
+}
@@ -0,0 +1,132 @@
+/*********************************************************************************/
+/*  Copyright 2017 Barcelona Supercomputing Center                               */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <http://www.gnu.org/licenses/>.                 */
+/*********************************************************************************/
+
+/*<testinfo>
+    test_generator="gens/basic-generator"
+</testinfo>*/
+
+#include "assert_noshm.h"
+#include "policy_fixture.h"
+
+#include "LB_policies/lewi_rebalance.h"
+
+#include <stdio.h>
+#include <unistd.h>
+
+/* LeWI_rebalance policy: two processes with the same CPUs but three times more
+ * work in the second one. The CPU ownership converges to a balanced partition
+ * and then the processes stop lending their CPUs in the blocking calls */
+
+enum { SYS_SIZE = 8 };
+enum { DEFAULT_CPUS = 4 };
+enum { WORK_FAST_US = 32000 };      // CPU time per iteration
+enum { WORK_SLOW_US = 96000 };
+enum { WINDOW = 3 };
+enum { NUM_ITERS = 30 };
+
+static int get_owned_cpus(const subprocess_descriptor_t *spd) {
+    cpu_set_t mask;
+    assert( shmem_procinfo__getprocessmask(spd->id, &mask, 0) == DLB_SUCCESS );
+    return CPU_COUNT(&mask);
+}
+
+/* Both processes compute their work with the CPUs they own and the one that
+ * finishes first waits for the other one in a blocking call */
+static void iteration(const subprocess_descriptor_t *fast, const subprocess_descriptor_t *slow) {
+    int fast_time = WORK_FAST_US / get_owned_cpus(fast);
+    int slow_time = WORK_SLOW_US / get_owned_cpus(slow);
+    const subprocess_descriptor_t *first = fast_time <= slow_time ? fast : slow;
+    const subprocess_descriptor_t *second = fast_time <= slow_time ? slow : fast;
+    int first_time = fast_time <= slow_time ? fast_time : slow_time;
+    int second_time = fast_time <= slow_time ? slow_time : fast_time;
+
+    usleep(first_time);
+    first->lb_funcs.into_blocking_call(first);
+    if (lewi_rebalance_IsLending(first)) {
+        assert( get_ncpus(first) <= 1 );
+    } else {
+        assert( get_ncpus(first) == get_owned_cpus(first) );
+    }
+    usleep(second_time - first_time);
+    second->lb_funcs.into_blocking_call(second);
+
+    fast->lb_funcs.out_of_blocking_call(fast, 1);
+    slow->lb_funcs.out_of_blocking_call(slow, 1);
+    assert( get_ncpus(fast) == get_owned_cpus(fast) );
+    assert( get_ncpus(slow) == get_owned_cpus(slow) );
+    assert_enabled_mask(fast);
+    assert_enabled_mask(slow);
+}
+
+int main( int argc, char **argv ) {
+    mu_init();
+    mu_testing_set_sys_size(SYS_SIZE);
+
+    subprocess_descriptor_t fast;
+    subprocess_descriptor_t slow;
+    char dlb_args[64];
+    snprintf(dlb_args, sizeof(dlb_args), "--lewi-rebalance-window=%d", WINDOW);
+    init_spd(&fast, 111, 0, DEFAULT_CPUS, get_policy_descriptor(POLICY_LEWI_REBALANCE),
+            dlb_args);
+    init_spd(&slow, 222, DEFAULT_CPUS, DEFAULT_CPUS,
+            get_policy_descriptor(POLICY_LEWI_REBALANCE), dlb_args);
+    assert( fast.lb_descriptor->flags & DLB_POLICY_USES_ITERATIONS );
+    assert( lewi_rebalance_IsLending(&fast) );
+    assert( lewi_rebalance_IsLending(&slow) );
+
+    int iter;
+    for (iter = 0; iter < NUM_ITERS; ++iter) {
+        iteration(&fast, &slow);
+    }
+
+    /* CPUs are distributed proportionally to the work, by the coordinator */
+    assert( get_owned_cpus(&fast) == 2 );
+    assert( get_owned_cpus(&slow) == 6 );
+    int repartitions = lewi_rebalance_GetRepartitions(&fast);
+    assert( repartitions >= 1 && repartitions <= 3 );
+    assert( lewi_rebalance_GetRepartitions(&slow) == 0 );
+    assert( get_mask_updates(&fast) == repartitions );
+    assert( get_mask_updates(&slow) == repartitions );
+
+    /* The measurements are published */
+    process_balance_t balance;
+    assert( shmem_procinfo__getbalance(slow.id, &balance) == DLB_SUCCESS );
+    assert( balance.window > 0 );
+    assert( balance.ncpus == 6 );
+    assert( balance.work > 0.0 );
+    assert( shmem_procinfo__getbalance(333, &balance) == DLB_ERR_NOPROC );
+
+    /* Ownership is not moved anymore and, once balanced, the processes stop
+     * lending their CPUs every iteration (some window may exceed the
+     * tolerance because of the system noise) */
+    int lending_iters = 0;
+    for (iter = 0; iter < NUM_ITERS / 2; ++iter) {
+        iteration(&fast, &slow);
+        lending_iters += lewi_rebalance_IsLending(&fast) + lewi_rebalance_IsLending(&slow);
+    }
+    assert( lending_iters < NUM_ITERS / 2 );
+    assert( lewi_rebalance_GetRepartitions(&fast) == repartitions );
+    assert( get_owned_cpus(&fast) == 2 );
+    assert( get_owned_cpus(&slow) == 6 );
+
+    finalize_spd(&fast);
+    finalize_spd(&slow);
+
+    return 0;
+}
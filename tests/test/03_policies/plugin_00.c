@@ -0,0 +1,149 @@
+/*********************************************************************************/
+/*  Copyright 2017 Barcelona Supercomputing Center                               */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <http://www.gnu.org/licenses/>.                 */
+/*********************************************************************************/
+
+/*<testinfo>
+    test_generator="gens/basic-generator"
+</testinfo>*/
+
+#include "assert_noshm.h"
+#include "policy_fixture.h"
+
+#include "apis/dlb_plugin.h"
+#include "LB_core/policy_plugin.h"
+#include "LB_core/DLB_kernel.h"
+
+#include <dlfcn.h>
+#include <stdlib.h>
+
+/* Policy plugins: in-tree descriptors, loading errors, and the test plugin
+ * built along the tests, which lends and reclaims the whole process mask
+ * through the plugin services */
+
+enum { SYS_SIZE = 8 };
+enum { DEFAULT_CPUS = 4 };
+
+static const dlb_policy_descriptor_t* old_plugin_entry(const dlb_plugin_services_t *s) {
+    static dlb_policy_descriptor_t old_descriptor = {
+        .abi_version = DLB_PLUGIN_ABI_VERSION + 1,
+        .name = "old_plugin",
+    };
+    return &old_descriptor;
+}
+
+static const dlb_policy_descriptor_t* null_plugin_entry(const dlb_plugin_services_t *s) {
+    return NULL;
+}
+
+int main( int argc, char **argv ) {
+    mu_init();
+    mu_testing_set_sys_size(SYS_SIZE);
+
+    /* In-tree policies are exposed through the plugin descriptors */
+    const policy_t policies[] = {POLICY_LEWI, POLICY_LEWI_MASK, POLICY_RAL, POLICY_PERAL};
+    int i;
+    for (i = 0; i < sizeof(policies)/sizeof(policies[0]); ++i) {
+        const dlb_policy_descriptor_t *descriptor = get_policy_descriptor(policies[i]);
+        assert( descriptor != NULL );
+        assert( descriptor->abi_version == DLB_PLUGIN_ABI_VERSION );
+        assert( strcmp(descriptor->name, policy_tostr(policies[i])) == 0 );
+        assert( !(descriptor->flags & DLB_POLICY_USES_CPUINFO)
+                == (policies[i] == POLICY_LEWI) );
+    }
+    assert( get_policy_descriptor(POLICY_NONE) == NULL );
+
+    /* Callbacks not provided are disabled */
+    subprocess_descriptor_t spd;
+    set_policy_funcs(&spd.lb_funcs, NULL);
+    assert( spd.lb_funcs.init(&spd) == DLB_SUCCESS );
+    assert( spd.lb_funcs.lend(&spd) == DLB_ERR_NOPOL );
+    assert( spd.lb_funcs.borrow_cpu_mask(&spd, NULL) == DLB_ERR_NOPOL );
+
+    /* Loading errors */
+    const dlb_policy_descriptor_t *descriptor = NULL;
+    void *handle = NULL;
+    assert( policy_plugin_load("/nonexistent/plugin.so", &descriptor, &handle)
+            == DLB_ERR_NOENT );
+    assert( policy_plugin_load("libc.so.6", &descriptor, &handle) == DLB_ERR_NOENT );
+    assert( policy_plugin_attach(old_plugin_entry, &descriptor) == DLB_ERR_NOCOMP );
+    assert( policy_plugin_attach(null_plugin_entry, &descriptor) == DLB_ERR_NOPOL );
+    assert( descriptor == NULL && handle == NULL );
+
+    /* The test plugin is built with the tests */
+    const char *plugin_path = getenv("DLB_TEST_PLUGIN");
+    assert( plugin_path != NULL );
+    assert( policy_plugin_load(plugin_path, &descriptor, &handle) == DLB_SUCCESS );
+    assert( handle != NULL );
+    assert( strcmp(descriptor->name, "test_plugin") == 0 );
+    assert( descriptor->funcs.lend != NULL && descriptor->funcs.borrow == NULL );
+    policy_plugin_unload(handle);
+
+    /* Plugin policy selected with --lewi-policy, working along an in-tree policy */
+    char dlb_args[MAX_OPTION_LENGTH];
+    snprintf(dlb_args, MAX_OPTION_LENGTH, "--lewi --lewi-policy=plugin:%s", plugin_path);
+    cpu_set_t process_mask;
+    mu_parse_mask("0-3", &process_mask);
+    memset(&spd, 0, sizeof(subprocess_descriptor_t));
+    assert( Initialize(&spd, 111, 0, &process_mask, dlb_args) == DLB_SUCCESS );
+    assert( spd.plugin_handle != NULL );
+    assert( strcmp(spd.lb_descriptor->name, "test_plugin") == 0 );
+    assert( spd.policy_info != NULL );
+    int (*get_nlends)(const subprocess_descriptor_t*);
+    *(void**)&get_nlends = dlsym(spd.plugin_handle, "test_plugin_get_nlends");
+    assert( get_nlends != NULL );
+    track_spd(&spd);
+
+    subprocess_descriptor_t other_spd;
+    init_spd(&other_spd, 222, DEFAULT_CPUS, DEFAULT_CPUS,
+            get_policy_descriptor(POLICY_LEWI_MASK), NULL);
+    assert( spd.lb_funcs.borrow(&spd) == DLB_ERR_NOPOL );
+
+    assert( spd.lb_funcs.lend(&spd) == DLB_SUCCESS );
+    assert( get_nlends(&spd) == 1 );
+    assert( get_ncpus(&spd) == 0 );
+    assert_enabled_mask(&spd);
+
+    assert( other_spd.lb_funcs.borrow(&other_spd) == DLB_SUCCESS );
+    assert( get_ncpus(&other_spd) == 2*DEFAULT_CPUS );
+    assert_enabled_mask(&other_spd);
+
+    assert( spd.lb_funcs.reclaim(&spd) == DLB_NOTED );
+    assert( CPU_EQUAL(get_enabled_mask(&spd), &process_mask) );
+    assert( other_spd.lb_funcs.return_all(&other_spd) == DLB_SUCCESS );
+    assert( get_ncpus(&spd) == DEFAULT_CPUS );
+    assert( get_ncpus(&other_spd) == DEFAULT_CPUS );
+    assert_enabled_mask(&spd);
+    assert_enabled_mask(&other_spd);
+
+    assert( Finish(&spd) == DLB_SUCCESS );
+    untrack_spd(&spd);
+    assert( spd.policy_info == NULL );
+    assert( spd.plugin_handle == NULL );
+    finalize_spd(&other_spd);
+
+    /* A plugin that cannot be loaded falls back to the default policy */
+    memset(&spd, 0, sizeof(subprocess_descriptor_t));
+    assert( Initialize(&spd, 111, 0, &process_mask,
+                "--lewi --lewi-policy=plugin:/nonexistent/plugin.so") == DLB_SUCCESS );
+    assert( spd.lb_policy == POLICY_LEWI_MASK );
+    assert( spd.lb_descriptor == get_policy_descriptor(POLICY_LEWI_MASK) );
+    assert( spd.plugin_handle == NULL );
+    assert( Finish(&spd) == DLB_SUCCESS );
+
+    return 0;
+}
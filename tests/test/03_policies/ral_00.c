@@ -0,0 +1,106 @@
+/*********************************************************************************/
+/*  Copyright 2017 Barcelona Supercomputing Center                               */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <http://www.gnu.org/licenses/>.                 */
+/*********************************************************************************/
+
+/*<testinfo>
+    test_generator="gens/basic-generator"
+</testinfo>*/
+
+#include "assert_noshm.h"
+#include "policy_fixture.h"
+
+#include "LB_policies/RaL.h"
+
+#include <unistd.h>
+
+/* RaL policy: the own CPUs recovered after each iteration adapt to the
+ * measured computation time, the rest of them are disabled */
+
+enum { SYS_SIZE = 8 };
+enum { DEFAULT_CPUS = 4 };
+enum { COMPUTATION_US = 1000 };
+enum { NUM_ITERS = 6 };
+
+int main( int argc, char **argv ) {
+    mu_init();
+    mu_testing_set_sys_size(SYS_SIZE);
+
+    subprocess_descriptor_t ral_spd;
+    subprocess_descriptor_t other_spd;
+    init_spd(&ral_spd, 111, 0, DEFAULT_CPUS, get_policy_descriptor(POLICY_RAL), NULL);
+    init_spd(&other_spd, 222, DEFAULT_CPUS, DEFAULT_CPUS,
+            get_policy_descriptor(POLICY_LEWI_MASK), NULL);
+    assert( get_ncpus(&ral_spd) == DEFAULT_CPUS );
+    assert( get_ncpus(&other_spd) == DEFAULT_CPUS );
+
+    /* Short computation and blocking calls of decreasing duration: one CPU is
+     * released after each iteration, at least one is kept. Then a longer
+     * iteration recovers one CPU */
+    const int blocking_us[NUM_ITERS] = {100000, 80000, 60000, 40000, 20000, 150000};
+    const int expected_cpus[NUM_ITERS] = {4, 3, 2, 1, 1, 2};
+    int i;
+    for (i = 0; i < NUM_ITERS; ++i) {
+        usleep(COMPUTATION_US);
+        ral_spd.lb_funcs.into_blocking_call(&ral_spd);
+        assert( get_ncpus(&ral_spd) <= 1 );
+        usleep(blocking_us[i]);
+        ral_spd.lb_funcs.out_of_blocking_call(&ral_spd, 1);
+        assert( RaL_GetMaxCpus(&ral_spd) == expected_cpus[i] );
+        assert( get_ncpus(&ral_spd) == expected_cpus[i] );
+        assert( CPU_COUNT(get_enabled_mask(&ral_spd)) == expected_cpus[i] );
+        assert_enabled_mask(&ral_spd);
+    }
+
+    /* The CPUs not needed by RaL can be borrowed by other processes */
+    assert( other_spd.lb_funcs.borrow(&other_spd) == DLB_SUCCESS );
+    assert( get_ncpus(&other_spd) == 2*DEFAULT_CPUS - 2 );
+    assert_enabled_mask(&other_spd);
+
+    /* RaL does not borrow while its computation is short */
+    assert( ral_spd.lb_funcs.borrow(&ral_spd) == DLB_NOUPDT );
+
+    /* A long iteration recovers a CPU, reclaimed from the borrower */
+    usleep(COMPUTATION_US);
+    ral_spd.lb_funcs.into_blocking_call(&ral_spd);
+    usleep(300000);
+    int error = ral_spd.lb_funcs.out_of_blocking_call(&ral_spd, 1);
+    assert( error == DLB_SUCCESS || error == DLB_NOTED );
+    assert( RaL_GetMaxCpus(&ral_spd) == 3 );
+    other_spd.lb_funcs.return_all(&other_spd);
+    assert( get_ncpus(&ral_spd) == 3 );
+    assert( get_ncpus(&other_spd) == 2*DEFAULT_CPUS - 3 );
+    assert_enabled_mask(&ral_spd);
+    assert_enabled_mask(&other_spd);
+
+    finalize_spd(&ral_spd);
+    finalize_spd(&other_spd);
+
+    /* PERaL behaves like RaL */
+    init_spd(&ral_spd, 111, 0, DEFAULT_CPUS, get_policy_descriptor(POLICY_PERAL), NULL);
+    for (i = 0; i < 2; ++i) {
+        usleep(COMPUTATION_US);
+        ral_spd.lb_funcs.into_blocking_call(&ral_spd);
+        usleep(blocking_us[i]);
+        ral_spd.lb_funcs.out_of_blocking_call(&ral_spd, 1);
+        assert( RaL_GetMaxCpus(&ral_spd) == expected_cpus[i] );
+        assert_enabled_mask(&ral_spd);
+    }
+    finalize_spd(&ral_spd);
+
+    return 0;
+}
@@ -68,6 +68,7 @@ int main( int argc, char **argv ) {
     assert( DLB_LendCpu(0) == DLB_ERR_NOPOL );
     assert( DLB_LendCpus(1) == DLB_ERR_NOPOL );
     assert( DLB_LendCpuMask(&process_mask) == DLB_ERR_NOPOL );
+    assert( DLB_SetLendDuration(1000) == DLB_ERR_NOPOL );
 
     // Reclaim
     assert( DLB_Reclaim() == DLB_ERR_NOPOL );
@@ -92,6 +93,13 @@ int main( int argc, char **argv ) {
     // Misc
     assert( DLB_CheckCpuAvailability(0) == DLB_ERR_NOPOL );
     assert( DLB_Barrier() == DLB_SUCCESS );
+    assert( DLB_BarrierNamed("foo") == DLB_ERR_NOSHMEM );
+    assert( DLB_BarrierAttach("foo") == DLB_ERR_NOSHMEM );
+    assert( DLB_BarrierDetach("foo") == DLB_ERR_NOSHMEM );
+    int episodes;
+    double avg_skew, max_skew, imbalance;
+    assert( DLB_BarrierGetStats("foo", &episodes, &avg_skew, &max_skew, &imbalance)
+            == DLB_ERR_NOSHMEM );
     assert( DLB_PollDROM(NULL, NULL) == DLB_ERR_DISBLD );
     assert( DLB_SetVariable("--drom", "1") == DLB_ERR_PERM );
     assert( DLB_SetVariable("--debug-opts", "foo") == DLB_SUCCESS );
@@ -114,7 +122,10 @@ int main( int argc, char **argv ) {
     // Call DLB_PrintShmem with full node
     sched_getaffinity(0, sizeof(cpu_set_t), &process_mask);
     assert( DLB_Init(0, &process_mask, "--lewi") == DLB_SUCCESS );
+    assert( DLB_SetLendDuration(-1) == DLB_ERR_PERM );
+    assert( DLB_SetLendDuration(1000) == DLB_SUCCESS );
     DLB_LendCpu(0);
+    assert( DLB_SetLendDuration(0) == DLB_SUCCESS );
     assert( DLB_PrintShmem(4, DLB_COLOR_AUTO) == DLB_SUCCESS );
     assert( DLB_Finalize() == DLB_SUCCESS );
 
@@ -41,6 +41,7 @@ program test
     if (dlb_lendcpu(0) /= DLB_ERR_NOPOL ) call abort
     if (dlb_lendcpus(1) /= DLB_ERR_NOPOL ) call abort
     if (dlb_lendcpumask(process_mask) /= DLB_ERR_NOPOL ) call abort
+    if (dlb_setlendduration(1000) /= DLB_ERR_NOPOL ) call abort
 
     ! Reclaim
     if (dlb_reclaim() /= DLB_ERR_NOPOL ) call abort
@@ -0,0 +1,152 @@
+#ifndef POLICY_FIXTURE_H
+#define POLICY_FIXTURE_H
+
+#include "apis/dlb_errors.h"
+#include "LB_core/spd.h"
+#include "LB_core/lb_funcs.h"
+#include "LB_comm/shmem_procinfo.h"
+#include "LB_comm/shmem_cpuinfo.h"
+#include "LB_numThreads/numThreads.h"
+#include "support/mask_utils.h"
+#include "support/options.h"
+
+#include <sched.h>
+#include <string.h>
+#include <pthread.h>
+#include <assert.h>
+
+/* Subprocess descriptors for the policy tests. Each subprocess registers its
+ * own CPUs in the shared memories and the PM callbacks keep track of the CPUs
+ * enabled in the subprocess, starting with the process mask, and of the
+ * number of process mask updates. In polling mode,
+ * the callbacks must be invoked from the thread that initialized the
+ * subprocess */
+
+enum { FIXTURE_MAX_SPDS = 4 };
+
+typedef struct {
+    const subprocess_descriptor_t *spd;
+    pthread_t app_thread;
+    cpu_set_t enabled_mask;
+    int mask_updates;
+} fixture_spd_t;
+
+static fixture_spd_t fixture_spds[FIXTURE_MAX_SPDS];
+
+static void fixture_cb_enable_cpu(int cpuid, void *arg) {
+    fixture_spd_t *fixture = arg;
+    assert( fixture->spd->options.mode == MODE_ASYNC
+            || pthread_equal(fixture->app_thread, pthread_self()) );
+    CPU_SET(cpuid, &fixture->enabled_mask);
+}
+
+static void fixture_cb_disable_cpu(int cpuid, void *arg) {
+    fixture_spd_t *fixture = arg;
+    assert( fixture->spd->options.mode == MODE_ASYNC
+            || pthread_equal(fixture->app_thread, pthread_self()) );
+    CPU_CLR(cpuid, &fixture->enabled_mask);
+}
+
+static void fixture_cb_set_process_mask(const cpu_set_t *mask, void *arg) {
+    fixture_spd_t *fixture = arg;
+    assert( fixture->spd->options.mode == MODE_ASYNC
+            || pthread_equal(fixture->app_thread, pthread_self()) );
+    memcpy(&fixture->enabled_mask, mask, sizeof(cpu_set_t));
+    ++fixture->mask_updates;
+}
+
+/* Track the CPUs enabled in an initialized subprocess */
+static void track_spd(subprocess_descriptor_t *spd) {
+    int slot;
+    for (slot = 0; slot < FIXTURE_MAX_SPDS && fixture_spds[slot].spd != NULL; ++slot);
+    assert( slot < FIXTURE_MAX_SPDS );
+
+    fixture_spd_t *fixture = &fixture_spds[slot];
+    fixture->spd = spd;
+    fixture->app_thread = pthread_self();
+    memcpy(&fixture->enabled_mask, &spd->process_mask, sizeof(cpu_set_t));
+    fixture->mask_updates = 0;
+    assert( pm_callback_set(&spd->pm, dlb_callback_enable_cpu,
+                (dlb_callback_t)fixture_cb_enable_cpu, fixture) == DLB_SUCCESS );
+    assert( pm_callback_set(&spd->pm, dlb_callback_disable_cpu,
+                (dlb_callback_t)fixture_cb_disable_cpu, fixture) == DLB_SUCCESS );
+    assert( pm_callback_set(&spd->pm, dlb_callback_set_process_mask,
+                (dlb_callback_t)fixture_cb_set_process_mask, fixture) == DLB_SUCCESS );
+}
+
+static void untrack_spd(const subprocess_descriptor_t *spd) {
+    int slot;
+    for (slot = 0; slot < FIXTURE_MAX_SPDS; ++slot) {
+        if (fixture_spds[slot].spd == spd) {
+            fixture_spds[slot].spd = NULL;
+        }
+    }
+}
+
+static __attribute__((unused)) void init_spd(subprocess_descriptor_t *spd, pid_t id,
+        int first_cpu, int ncpus, const dlb_policy_descriptor_t *descriptor,
+        const char *dlb_args) {
+    memset(spd, 0, sizeof(subprocess_descriptor_t));
+    spd->id = id;
+    options_init(&spd->options, dlb_args);
+    pm_init(&spd->pm);
+    CPU_ZERO(&spd->process_mask);
+    int cpuid;
+    for (cpuid = first_cpu; cpuid < first_cpu + ncpus; ++cpuid) {
+        CPU_SET(cpuid, &spd->process_mask);
+    }
+    track_spd(spd);
+
+    assert( shmem_procinfo__init(spd->id, &spd->process_mask, NULL, NULL) == DLB_SUCCESS );
+    assert( shmem_cpuinfo__init(spd->id, &spd->process_mask, NULL) == DLB_SUCCESS );
+    spd->lb_descriptor = descriptor;
+    set_policy_funcs(&spd->lb_funcs, descriptor);
+    assert( spd->lb_funcs.init(spd) == DLB_SUCCESS );
+}
+
+static __attribute__((unused)) void finalize_spd(subprocess_descriptor_t *spd) {
+    assert( spd->lb_funcs.finalize(spd) == DLB_SUCCESS );
+    assert( shmem_cpuinfo__finalize(spd->id) == DLB_SUCCESS );
+    assert( shmem_procinfo__finalize(spd->id, false) == DLB_SUCCESS );
+    untrack_spd(spd);
+}
+
+static const fixture_spd_t* get_fixture(const subprocess_descriptor_t *spd) {
+    int slot;
+    for (slot = 0; slot < FIXTURE_MAX_SPDS; ++slot) {
+        if (fixture_spds[slot].spd == spd) {
+            return &fixture_spds[slot];
+        }
+    }
+    assert( 0 );
+    return NULL;
+}
+
+/* CPUs enabled in the subprocess through the PM callbacks */
+static __attribute__((unused)) const cpu_set_t* get_enabled_mask(
+        const subprocess_descriptor_t *spd) {
+    return &get_fixture(spd)->enabled_mask;
+}
+
+/* Process masks set in the subprocess through the PM callbacks */
+static __attribute__((unused)) int get_mask_updates(const subprocess_descriptor_t *spd) {
+    return get_fixture(spd)->mask_updates;
+}
+
+/* CPUs guested by the subprocess in the cpuinfo shared memory */
+static __attribute__((unused)) int get_ncpus(const subprocess_descriptor_t *spd) {
+    cpu_set_t mask;
+    assert( shmem_cpuinfo__get_guested_cpus(spd->id, &mask) == DLB_SUCCESS );
+    return CPU_COUNT(&mask);
+}
+
+/* The CPUs enabled in the subprocess are the ones it guests */
+#define assert_enabled_mask(spd)                                                \
+    do {                                                                        \
+        cpu_set_t _guested;                                                     \
+        assert( shmem_cpuinfo__get_guested_cpus((spd)->id, &_guested)           \
+                == DLB_SUCCESS );                                               \
+        assert( CPU_EQUAL(&_guested, get_enabled_mask(spd)) );                  \
+    } while(0);
+
+#endif /* POLICY_FIXTURE_H */